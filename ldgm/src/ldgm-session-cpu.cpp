@@ -16,6 +16,7 @@
  * =====================================================================================
  */
 
+#include <algorithm>
 #include <stdlib.h>
 #include <stdio.h>
 #if defined __SSE2__ || _M_IX86_FP == 2
@@ -24,9 +25,16 @@
 #include <string.h>
 #include <time.h>
 
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+#define LDGM_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
 #include "ldgm-session-cpu.h"
 #include "timer-util.h"
 
+#define MIN_ROWS_PER_THREAD 32 ///< minimal count of parity rows computed by a thread
+
 using namespace std;
 
 #ifdef _WIN32
@@ -134,6 +142,66 @@ xor_using_sse (char* source, char* dest, int packet_size)
     return dest;
 }
 
+#ifdef LDGM_X86_DISPATCH
+__attribute__((target("avx2")))
+static char*
+xor_using_avx2 (char* source, char* dest, int packet_size)
+{
+    int i = 0;
+    for ( ; i + 64 <= packet_size; i += 64 )
+    {
+        __m256i s0 = _mm256_loadu_si256((__m256i *) (source + i));
+        __m256i s1 = _mm256_loadu_si256((__m256i *) (source + i + 32));
+        __m256i d0 = _mm256_loadu_si256((__m256i *) (dest + i));
+        __m256i d1 = _mm256_loadu_si256((__m256i *) (dest + i + 32));
+        _mm256_storeu_si256((__m256i *) (dest + i), _mm256_xor_si256(s0, d0));
+        _mm256_storeu_si256((__m256i *) (dest + i + 32), _mm256_xor_si256(s1, d1));
+    }
+    if ( i < packet_size )
+        xor_using_sse(source + i, dest + i, packet_size - i);
+    return dest;
+}
+
+__attribute__((target("avx512f")))
+static char*
+xor_using_avx512 (char* source, char* dest, int packet_size)
+{
+    int i = 0;
+    for ( ; i + 128 <= packet_size; i += 128 )
+    {
+        __m512i s0 = _mm512_loadu_si512(source + i);
+        __m512i s1 = _mm512_loadu_si512(source + i + 64);
+        __m512i d0 = _mm512_loadu_si512(dest + i);
+        __m512i d1 = _mm512_loadu_si512(dest + i + 64);
+        _mm512_storeu_si512(dest + i, _mm512_xor_si512(s0, d0));
+        _mm512_storeu_si512(dest + i + 64, _mm512_xor_si512(s1, d1));
+    }
+    if ( i < packet_size )
+        xor_using_avx2(source + i, dest + i, packet_size - i);
+    return dest;
+}
+#endif
+
+typedef char* (*xor_func_t)(char* source, char* dest, int packet_size);
+
+/*
+ * Selects the widest XOR kernel supported by the CPU we are running on.
+ */
+static xor_func_t
+select_xor_impl ()
+{
+#ifdef LDGM_X86_DISPATCH
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx512f") )
+        return xor_using_avx512;
+    if ( __builtin_cpu_supports("avx2") )
+        return xor_using_avx2;
+#endif
+    return xor_using_sse;
+}
+
+static const xor_func_t xor_packets = select_xor_impl();
+
 void *
 LDGM_session_cpu::alloc_buf (int buf_size)
 {
@@ -147,44 +215,98 @@ LDGM_session_cpu::alloc_buf (int buf_size)
 
 }
 
+/*
+ * Computes parity rows [first, last) - every row is XOR of its data neighbours
+ * and of the preceding row (staircase). The row preceding the first one is
+ * not included.
+ */
 void
-LDGM_session_cpu::encode ( char* data_ptr, char* parity_ptr )
+LDGM_session_cpu::encode_rows ( char* data_ptr, char* parity_ptr, int first, int last )
 {
-//    start encoding
-   // printf ( "packet_size: %d\n", this->packet_size );
-
-    char *parity_packet;
-
-	parity_packet = (char *) aligned_malloc(packet_size, 16);
-	if (!parity_packet)
-	{
-		printf ( "Error while using posix_memalign\n" );
-		return;
-	}
-	memset(parity_packet, 0, packet_size);
-
-    for ( int m = 0; m < param_m; ++m) {
-//	printf ( "m: %d\n", m );
+    for ( int m = first; m < last; ++m) {
+        char *parity_packet = parity_ptr + m*packet_size;
+        bool empty = true;
 
-//	printf ( "max w: %d\n", max_row_weight );
         //Find out which packets to XOR
         for ( int k = 0; k < max_row_weight+2; ++k) {
             int idx = pcm[m*(max_row_weight+2) + k];
-//	    printf ( "adept: %d\n", idx );
             if (idx > -1 && idx < param_k) {
-//		printf ( "xoring idx: %d\n", idx );
                 char *ptr = data_ptr + idx*packet_size;
-                parity_packet = xor_using_sse(ptr, parity_packet, packet_size);
+                if ( empty )
+                    memcpy(parity_packet, ptr, packet_size);
+                else
+                    xor_packets(ptr, parity_packet, packet_size);
+                empty = false;
             }
         }
+        if ( empty )
+            memset(parity_packet, 0, packet_size);
 
-        //Add the new parity packet to overall parity
-        memcpy ( parity_ptr + m*packet_size, parity_packet, packet_size );
+        if ( m > first )
+            xor_packets(parity_packet - packet_size, parity_packet, packet_size);
     }
+}		/* -----  end of method LDGM_session_cpu::encode_rows  ----- */
 
-	aligned_free(parity_packet);
+/**
+ * Range of parity rows processed by one task of LDGM_session_cpu::encode()
+ */
+struct encode_range {
+    LDGM_session_cpu *session;
+    char *data_ptr;
+    char *parity_ptr;
+    int first;
+    int last;
+};
 
-    return ;
+void *
+LDGM_session_cpu::encode_rows_task ( void *arg )
+{
+    struct encode_range *r = (struct encode_range *) arg;
+    r->session->encode_rows(r->data_ptr, r->parity_ptr, r->first, r->last);
+    return NULL;
+}
+
+/**
+ * XORs the final value of the row preceding the range to all rows of the
+ * range except the last one (that has been already fixed).
+ */
+void *
+LDGM_session_cpu::add_carry_task ( void *arg )
+{
+    struct encode_range *r = (struct encode_range *) arg;
+    int packet_size = r->session->packet_size;
+    char *carry = r->parity_ptr + (r->first - 1)*packet_size;
+    for ( int m = r->first; m < r->last - 1; ++m )
+        xor_packets(carry, r->parity_ptr + m*packet_size, packet_size);
+    return NULL;
+}
+
+void
+LDGM_session_cpu::encode ( char* data_ptr, char* parity_ptr )
+{
+    int threads = max(min(encode_threads, param_m / MIN_ROWS_PER_THREAD), 1);
+    if ( threads == 1 || run_parallel == NULL )
+    {
+        encode_rows(data_ptr, parity_ptr, 0, param_m);
+        return;
+    }
+
+    //Rows are split into ranges computed in parallel,
+    //each range starting with zero staircase value
+    int rows = (param_m + threads - 1) / threads;
+    int ranges = (param_m + rows - 1) / rows;
+    vector<struct encode_range> tasks(ranges);
+    for ( int r = 0; r < ranges; ++r )
+        tasks[r] = { this, data_ptr, parity_ptr, r*rows, min<int>(param_m, (r+1)*rows) };
+    run_parallel(encode_rows_task, ranges, tasks.data(), sizeof tasks[0], NULL);
+
+    //Now fix the staircase - last rows of the ranges sequentially ...
+    for ( int r = 1; r < ranges; ++r )
+        xor_packets(parity_ptr + (tasks[r].first - 1)*packet_size,
+                parity_ptr + (tasks[r].last - 1)*packet_size, packet_size);
+
+    //... and the remaining rows of each range in parallel
+    run_parallel(add_carry_task, ranges - 1, tasks.data() + 1, sizeof tasks[0], NULL);
 }		/* -----  end of method LDGM_session_cpu::encode  ----- */
 
 void
@@ -240,178 +362,83 @@ LDGM_session_cpu::encode_naive ( char* data_ptr, char* parity_ptr )
     return ;
 }		/* -----  end of method LDGM_session_cpu::encode  ----- */
 
-void iterate ( Tanner_graph *g);
+/*
+ * Builds adjacency of constraint and variable nodes from the parity check
+ * matrix. Variable nodes 0..K-1 are data symbols, K..K+M-1 parity symbols.
+ */
+void
+LDGM_session_cpu::build_graph ()
+{
+    int var_count = param_k + param_m;
+    int row_len = max_row_weight + 2;
+
+    c_offset.assign(param_m + 1, 0);
+    c_adj.clear();
+    v_offset.assign(var_count + 1, 0);
+
+    for ( int m = 0; m < param_m; ++m) {
+        for ( int k = 0; k < row_len; ++k ) {
+            int idx = pcm [ m*row_len + k];
+            if( idx > -1 && idx < var_count ) {
+                c_adj.push_back(idx);
+                v_offset[idx + 1]++;
+            }
+        }
+        c_offset[m + 1] = c_adj.size();
+    }
+
+    for ( int v = 0; v < var_count; ++v)
+        v_offset[v + 1] += v_offset[v];
+    v_adj.resize(c_adj.size());
+    vector<int> fill(v_offset.begin(), v_offset.end() - 1);
+    for ( int m = 0; m < param_m; ++m)
+        for ( int j = c_offset[m]; j < c_offset[m + 1]; ++j)
+            v_adj[fill[c_adj[j]]++] = m;
+
+    graph_generation = pcm_generation;
+    graph_k = param_k;
+    graph_m = param_m;
+}		/* -----  end of method LDGM_session_cpu::build_graph  ----- */
 
 char*
 LDGM_session_cpu::decode_frame ( char* received, int buf_size, int* frame_size,
-                                 std::map<int, int> valid_data )
+                                 const valid_data_t &valid_data )
 {
-//    printf ( "buf_size: %d\n", buf_size );
-
     Timer_util interval;
     interval.start();
 
-
-    Tanner_graph graph;
+    if ( graph_generation != pcm_generation || graph_k != param_k || graph_m != param_m )
+        build_graph();
 
     int p_size = buf_size/(param_m+param_k);
     this->packet_size = p_size;
-//    printf ( "p_size %d\n", p_size );
-    graph.set_data_size(p_size);
-
-    //Timer_util timer;
-
-    int i;
-    int index = 0;
-
-
-//    while ( i < (param_k + param_m)*p_size)
-//    {
-//	printf ( "%2d|", (unsigned char)received[i++] );
-//    }
-
-    //one variable node per each data packet in block K
-    for ( i = 0; i < param_k; ++i )
-        graph.add_node(Node::variable_node, index++, received + i*p_size);
-
-    //one variable node per each parity packet in block M
-    for ( i = 0; i < param_m; ++i)
-        graph.add_node(Node::variable_node, index++, received + (i + param_k)*p_size);
-
-    //one constraint node per each row of generation matrix
-    for ( i = 0; i < param_m; ++i)
-        graph.add_node(Node::constraint_node, index++, NULL);
-
-    create_edges(&graph);
-
-//    printf("Graph created in: %.3f s\n", t);
-
-    /*      printf ( "graf\n" );
-     *     for(map<int, Node>::iterator it = graph.nodes.begin(); it != graph.nodes.end(); ++it) {
-     *      Node n = it->second;
-     *      for ( int i = 0; i < p_size; ++i)
-     *          printf("%2d|", *(unsigned char *)(n.getDataPtr() + i));
-     *      printf ( "---\n" );
-     *      }
-     */
-
-    /*      for(map<int, Node>::iterator it = graph.nodes.begin(); it != graph.nodes.end(); ++it) {
-     *      Node n = it->second;
-     *      printf ( "neigbours of %d (count %lu): ", it->first, (it->second).neighbours.size() );
-     *      for(vector<int>::iterator itr = n.neighbours.begin(); itr != n.neighbours.end(); ++itr)
-     *          printf ( "%d ", *itr );
-     *      printf ( "\n" );
-     *     }
-     */
-
-    //We need to merge intervals in the valid data vector
-    map <int, int> merged_intervals;
-    map<int,int>::iterator map_it;
-
-    if ( valid_data.size() != 0 )
-    {
-        for ( map_it = valid_data.begin(); map_it != valid_data.end(); )
-        {
-            int start = map_it->first;
-            int length = map_it->second;
-            while ( start + length == (++map_it)->first )
-                length += map_it->second;
-            merged_intervals.insert ( pair<int, int> (start, length) );
-        }
-    }
-    /*     printf ( "Valid data: \n" );
-     *     for ( map_it = valid_data.begin(); map_it != valid_data.end(); ++map_it)
-     *     {
-     * 	printf ( "|%d-%d| ", map_it->first, map_it->second );
-     *     }
-     *     printf ( "\n" );
-     *
-     *     printf ( "Merged intervals: \n" );
-     *     for ( map_it = merged_intervals.begin(); map_it != merged_intervals.end(); ++map_it)
-     *     {
-     * 	printf ( "|%d-%d| ", map_it->first, map_it->second );
-     *     }
-     *     printf ( "\n" );
-     *
-     */
-
-
-
-    map<int, Node>::iterator it;
-    if ( merged_intervals.size() != 0)
-    {
-        it = graph.nodes.find(0);
-        while (it != graph.nodes.find(param_k+param_m)) {
-            (*it).second.setDone(false);
-            int node_offset = (*it).second.getDataPtr() - received;
-//	    printf ( "offset: %d\n", node_offset );
-
-            map_it = merged_intervals.begin();
-            //Find the offset in valid data which is equal, or the first offset which is
-            //lower than node offset
-            bool found = false;
-            while ( (map_it->first <= node_offset) && map_it != merged_intervals.end() )
-            {
-                map_it++;
-                found = true;
-            }
-            if ( found )
-                map_it--;
-
-            //Next, find out if some interval covers this symbol
-            if ( found && (map_it->first + map_it->second) >=
-                    (node_offset + p_size) )
-            {
-                (*it).second.setDone(true);
-//		printf ( "setting node %d with offset %d and size %d as done\n", it->first,
-//			node_offset, p_size);
-            }
-
-            ++it;
-        }
-    }
+    int var_count = param_k + param_m;
 
-    int not_done = 0;
-    for ( it = graph.nodes.begin(); it != graph.nodes.find(param_k); it++)
+    //mark symbols that are completely covered by received data - runs are
+    //sorted and disjoint so one pass is sufficient
+    done.assign(var_count, 0);
+    for ( valid_data_t::const_iterator it = valid_data.begin(); it != valid_data.end(); ++it )
     {
-        if ( !it->second.isDone())
-        {
-            memset(it->second.getDataPtr(), 0, p_size);
-//	    printf ( "resetting node: %d\n", it->first );
-            not_done++;
-        }
-    }
-//    printf ( "not done: %d\n", not_done );
-    /*     srand(time(NULL));
-     *     for ( int j = 0; j < 100; j++)
-     *     {
-     * 	it = graph.nodes.find(rand()%(param_k+param_m));
-     * 	(*it).second.setDone(false);
-     *     }
-     */
-    int iter = 0;
-
-    while ( needs_decoding(&graph) && iter < 4) {
-//	printf ( "iteratin\n" );
-        iterate(&graph);
-        iter++;
+        long long start = it->first;
+        long long end = start + it->second;
+        int first = (start + p_size - 1) / p_size;
+        int last = min<long long>(end / p_size, var_count);
+        for ( int v = first; v < last; ++v )
+            done[v] = 1;
     }
 
-//    printf("decoding process: %.3f s\n", t);
+    for ( int v = 0; v < param_k; ++v )
+        if ( !done[v] )
+            memset(received + v*p_size, 0, p_size);
 
-    //printf ( "iterations: %d\n", iter );
+    peel(received, p_size);
 
     int undecoded = 0;
-    it = graph.nodes.find(0);
-    while ( it != graph.nodes.find(param_k) ) {
-        if (!(*it).second.isDone())
+    for ( int v = 0; v < param_k; ++v )
+        if ( !done[v] )
             undecoded++;
-        ++it;
-    }
 //    printf ( "Number of not recovered data packets: %d\n", undecoded );
 
-    //    printf("rest: %.3f s\n", t);
-
     if ( undecoded == 0 )
     {
         union int_bytes {
@@ -427,93 +454,54 @@ LDGM_session_cpu::decode_frame ( char* received, int buf_size, int* frame_size,
 
 
     interval.end();
-    //printf("time: %e\n",elapsed/1000.0 );
     this->elapsed_sum2 += interval.elapsed_time_ms();
     this->no_frames2++;
 
-    if(this->no_frames==150){
-        //printf("TIME: %f ms\n",this->elapsed_sum/(double)this->no_frames );
-    }
-
     return received + LDGM_session::HEADER_SIZE;
 }		/* -----  end ofmethod LDGM_session_cpu::decode  ----- */
 
 
+/*
+ * Peeling decoder - every constraint with exactly one missing neighbour
+ * restores it as XOR of the remaining ones. Constraints that become solvable
+ * by the recovery are put to the work queue so that each constraint is
+ * examined only when some of its neighbours changes.
+ */
 void
-LDGM_session_cpu::iterate ( Tanner_graph *graph )
+LDGM_session_cpu::peel ( char* received, int p_size )
 {
-    map<int, Node>::iterator it_c;
-    vector<int> vec;
-
-    static int recovered = 0;
-
-    //select the first constraint node
-    it_c = graph->nodes.find ( param_k + param_m );
-
-    //iterate through constraint nodes
-    while ( it_c != graph->nodes.end() ) {
-        //iterate the node's neighbours to find out how many of them are not decoded
-        map<int, Node>::iterator it_v;
-        for(vector<int>::iterator j = it_c->second.neighbours.begin();
-                j != it_c->second.neighbours.end(); ++j) {
-            it_v = graph->nodes.find(*j);
-            if ( !it_v->second.isDone() )
-                vec.push_back(*j);
-        }
-//	printf ( "node %d has %d undecoded neighbours\n", it_c->first, vec.size() );
-
-        //we can restore the missing packet
-        if ( vec.size() == 1)
-        {
-            int r_index = vec.front();
-
-//	    if ( r_index == 0 )
-//	    {
-//		printf ( "repairing first block\n" );
-//	    }
-            it_v = graph->nodes.find(r_index);
-            memset(it_v->second.getDataPtr(), 0, packet_size);
-            char *r_data = it_v->second.getDataPtr();
-            //find other nodes connected to this constraint node and XOR their values
-            int count = 0;
-            for(vector<int>::iterator j = it_c->second.neighbours.begin();
-                    j != it_c->second.neighbours.end(); ++j)
-            {
-                if ( *j != r_index )
-                {
-//		    printf ( "decode, packet_size: %d\n", packet_size );
-                    char *g_data = (graph->nodes.find(*j))->second.getDataPtr();
-                    //XOR
-                    xor_using_sse(g_data, r_data, packet_size);
-                    count++;
-                }
-            }
-            /*           //validate recovered packet
-             *          for ( int i = 0; i < param_k; ++i) {
-             *              if(!memcmp(r_data, lost_ptr + i*packet_size, packet_size)) {
-             *                  printf ( "packet ok\n" );
-             *                  break;
-             *              }
-             *          }
-             */
-            if ( count > 0 )
-                it_v->second.setDone(true);
-            recovered++;
-            /*           printf ( "restored data: \n" );
-             *          for ( int  i = 0; i < packet_size; ++i)
-             *              printf ( "%2d|", (unsigned char)(*(it_v->second.getDataPtr() + i)) );
-             *          printf ( "---\n" );
-             */
-
-
-        }
-        vec.clear();
-
-        ++it_c;
+    unknown.assign(param_m, 0);
+    work_queue.clear();
+    for ( int c = 0; c < param_m; ++c) {
+        for ( int j = c_offset[c]; j < c_offset[c + 1]; ++j)
+            if ( !done[c_adj[j]] )
+                unknown[c]++;
+        if ( unknown[c] == 1 )
+            work_queue.push_back(c);
     }
-//    printf ( "recovered: %d\n", recovered );
-
-    return;
-
-}
 
+    while ( !work_queue.empty() ) {
+        int c = work_queue.back();
+        work_queue.pop_back();
+        //other neighbour may have been recovered meanwhile
+        if ( unknown[c] != 1 || c_offset[c + 1] - c_offset[c] < 2 )
+            continue;
+
+        int r_index = -1;
+        for ( int j = c_offset[c]; j < c_offset[c + 1]; ++j)
+            if ( !done[c_adj[j]] )
+                r_index = c_adj[j];
+
+        char *r_data = received + r_index*p_size;
+        memset(r_data, 0, p_size);
+        //XOR the other nodes connected to this constraint node
+        for ( int j = c_offset[c]; j < c_offset[c + 1]; ++j)
+            if ( c_adj[j] != r_index )
+                xor_packets(received + c_adj[j]*p_size, r_data, p_size);
+        done[r_index] = 1;
+
+        for ( int j = v_offset[r_index]; j < v_offset[r_index + 1]; ++j)
+            if ( --unknown[v_adj[j]] == 1 )
+                work_queue.push_back(v_adj[j]);
+    }
+}		/* -----  end of method LDGM_session_cpu::peel  ----- */
@@ -20,6 +20,8 @@
 #ifndef  LDGM_SESSION_CPU_INC
 #define  LDGM_SESSION_CPU_INC
 
+#include <vector>
+
 #include "ldgm-session.h"
 //#include "timer-util.h"
 
@@ -33,7 +35,7 @@ class LDGM_session_cpu : public LDGM_session
 {
     public:
 	/* ====================  LIFECYCLE     ======================================= */
-	LDGM_session_cpu () {
+	LDGM_session_cpu () : run_parallel(NULL), encode_threads(1), graph_generation(0) {
 		printf("CPU LDGM in progress .... \n");
 		elapsed_sum=0.0;
 		no_frames=0;
@@ -48,12 +50,23 @@ class LDGM_session_cpu : public LDGM_session
 	void
 	    encode_naive (char*, char*);
 
-	char*                                                                             
-	    decode_frame ( char* received_data, int buf_size, int* frame_size,
-		    std::map<int, int> valid_data );
+	/**
+	 * Function running count tasks task(data + i * data_len) in parallel
+	 * and waiting for them (eg. task_run_parallel() of UltraGrid)
+	 */
+	typedef void (*parallel_run_t)(void *(*task)(void *), int count, void *data, size_t data_len, void **res);
 
+	/**
+	 * Sets a thread pool used to compute parity of one frame, parity is
+	 * computed by the calling thread if not set
+	 * @param workers  number of threads of the pool
+	 */
 	void
-	    iterate ( Tanner_graph *graph);
+	    set_parallel ( parallel_run_t run, int workers ) { run_parallel = run; encode_threads = workers; }
+
+	char*                                                                             
+	    decode_frame ( char* received_data, int buf_size, int* frame_size,
+		    const valid_data_t &valid_data );
 
 	void
 	    free_out_buf (char *buf);
@@ -65,10 +78,46 @@ class LDGM_session_cpu : public LDGM_session
 	/* ====================  DATA MEMBERS  ======================================= */
 
     private:
+	void
+	    encode_rows ( char* data_ptr, char* parity_ptr, int first, int last );
+
+	static void *
+	    encode_rows_task ( void *arg );
+
+	static void *
+	    add_carry_task ( void *arg );
+
+	void
+	    build_graph ();
+
+	void
+	    peel ( char* received, int p_size );
+
 	/* ====================  DATA MEMBERS  ======================================= */
     double elapsed_sum;
 	long no_frames;
 
+	parallel_run_t run_parallel;
+	int encode_threads;
+
+	/*
+	 * Tanner graph in CSR form, built once per parity check matrix. Neighbours
+	 * (variable nodes) of constraint c are c_adj[c_offset[c]] .. c_adj[c_offset[c+1] - 1],
+	 * constraints containing variable node v are v_adj[v_offset[v]] .. v_adj[v_offset[v+1] - 1].
+	 */
+	std::vector<int> c_offset;
+	std::vector<int> c_adj;
+	std::vector<int> v_offset;
+	std::vector<int> v_adj;
+	unsigned int graph_generation; ///< pcm_generation the graph was built for (0 - none)
+	unsigned short graph_k;
+	unsigned short graph_m;
+
+	/* per-frame decoding state (kept to avoid reallocations) */
+	std::vector<char> done;         ///< per variable node
+	std::vector<int> unknown;       ///< per constraint - count of not yet known neighbours
+	std::vector<int> work_queue;    ///< constraints with exactly one unknown neighbour
+
 }; /* -----  end of class LDGM_session_cpu  ----- */
 
 #endif   /* ----- #ifndef LDGM_SESSION_CPU_INC  ----- */
@@ -15,6 +15,7 @@
  *
  * =====================================================================================
  */
+#include <algorithm>
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -162,7 +163,7 @@ void LDGM_session_gpu::encode ( char *source_data, char *parity )
 
 }
 
-char *LDGM_session_gpu::decode_frame ( char *received_data, int buf_size, int *frame_size, std::map<int, int> valid_data )
+char *LDGM_session_gpu::decode_frame ( char *received_data, int buf_size, int *frame_size, const valid_data_t &valid_data )
 {
     char *received = received_data;
 
@@ -172,22 +173,6 @@ char *LDGM_session_gpu::decode_frame ( char *received_data, int buf_size, int *f
     int p_size = buf_size / (param_m + param_k);
     // printf("%d p_size K: %d, M: %d, buf_size: %d, max_row_weight: %d \n",p_size,param_k,param_m,buf_size,max_row_weight);
 
-    //We need to merge intervals in the valid data vector
-    std::map <int, int> merged_intervals;
-    std::map<int, int>::iterator map_it;
-
-    if ( valid_data.size() != 0 )
-    {
-        for ( map_it = valid_data.begin(); map_it != valid_data.end(); )
-        {
-            int start = map_it->first;
-            int length = map_it->second;
-            while ( start + length == (++map_it)->first )
-                length += map_it->second;
-            merged_intervals.insert ( std::pair<int, int> (start, length) );
-        }
-    }
-
     
 
     cudaError_t error;
@@ -209,7 +194,7 @@ char *LDGM_session_gpu::decode_frame ( char *received_data, int buf_size, int *f
     memset(sync_vec, 0, sizeof(int) * (param_k + param_m));
     int not_done = 0;
 
-    if ( merged_intervals.size() != 0
+    if ( valid_data.size() != 0
        )
     {
 
@@ -217,14 +202,11 @@ char *LDGM_session_gpu::decode_frame ( char *received_data, int buf_size, int *f
         {
             int node_offset = i * p_size;
 
-            map_it = merged_intervals.begin();
+            valid_data_t::const_iterator map_it = std::upper_bound ( valid_data.begin(), valid_data.end(),
+                    node_offset, [] ( int offset, const std::pair<int, int> &interval ) {
+                            return offset < interval.first; } );
 
-            bool found = false;
-            while ( (map_it->first <= node_offset) && map_it != merged_intervals.end() )
-            {
-                map_it++;
-                found = true;
-            }
+            bool found = map_it != valid_data.begin();
             if ( found ) map_it--;
 
             if ( found && (map_it->first + map_it->second) >=
@@ -70,6 +70,7 @@ LDGM_session::set_pcMatrix ( char* fname)
         }
     }
     this->max_row_weight = w_f - 2; //w_f stores number of columns in adjacency list
+    pcm_generation++;
 
     /*     for ( int i = 0; i < param_m; i++)
      *     {
@@ -40,7 +40,7 @@ class LDGM_session : public Coding_session
 	LDGM_session () :                          /* constructor **/
                 pcMatrix(NULL), pcm(NULL), param_k(0), param_m(0), row_weight(0),
                 packet_size(0), max_row_weight(0), received_ptr(NULL),
-                lost_ptr(NULL), elapsed_sum2(0.0), no_frames2(0)
+                lost_ptr(NULL), elapsed_sum2(0.0), no_frames2(0), pcm_generation(0)
         {
         }
 	virtual ~LDGM_session ();                      /* destructor **/
@@ -86,7 +86,7 @@ class LDGM_session : public Coding_session
 
 	virtual char*
 	    decode_frame ( char* received_data, int buf_size, int* frame_size, 
-		    std::map<int, int>  valid_data ) = 0;
+		    const valid_data_t &valid_data ) = 0;
 
 	void
 	    set_params ( unsigned short k,
@@ -121,6 +121,8 @@ class LDGM_session : public Coding_session
 	double elapsed_sum2;
 	long no_frames2;
 
+	unsigned int pcm_generation; ///< incremented whenever pcm is replaced
+
         static const int HEADER_SIZE = 4;
 
     private:
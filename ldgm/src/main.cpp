@@ -230,7 +230,7 @@ demo(int k, int m, int frame_size, char* matrix_fname, char* data_fname, int cpu
     int buf_size;
     int f_size;
     char *decoded;
-    map<int, int>  valid_data;
+    valid_data_t  valid_data;
     int ps;
     srand(time(NULL));
     if (cpu)
@@ -252,7 +252,11 @@ demo(int k, int m, int frame_size, char* matrix_fname, char* data_fname, int cpu
                                 size = buf_size - j;
                         }
                         if(rand() % 100 > PACKET_LOSS * 100 ) {
-                                valid_data.insert(pair<int,int>(j, size));
+                                if (!valid_data.empty() && valid_data.back().first + valid_data.back().second == j) {
+                                        valid_data.back().second += size;
+                                } else {
+                                        valid_data.push_back(pair<int,int>(j, size));
+                                }
                                 total += size;
                         } else {
                                 if(j == 0) {
@@ -10,6 +10,11 @@
 #include <string.h>
 #include <assert.h>
 
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+#define FEC_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
 /*
  * Primitive polynomials - see Lin & Costello, Appendix A,
  * and  Lee & Messerschmitt, p. 453.
@@ -166,7 +171,7 @@ generate_gf (void) {
  * calls are unfrequent in my typical apps so I did not bother.
  */
 #define addmul(dst, src, c, sz)                 \
-    if (c != 0) _addmul1(dst, src, c, sz)
+    if (c != 0) addmul_impl(dst, src, c, sz)
 
 #define UNROLL 16               /* 1, 4, 8, 16 */
 static void
@@ -205,6 +210,111 @@ _addmul1(gf*restrict dst, const gf*restrict src, gf c, size_t sz) {
         GF_ADDMULC (*dst, *src);
 }
 
+#ifdef FEC_X86_DISPATCH
+/*
+ * SIMD variants of _addmul1() - c * x is computed with two 16-entry lookups
+ * (pshufb), one for the low and one for the high nibble of x:
+ * c * x = c * (x & 0x0f) ^ c * (x & 0xf0)
+ */
+static void
+_init_nibble_tables(gf c, gf*restrict lo, gf*restrict hi) {
+    int i;
+    for (i = 0; i < 16; i++) {
+        lo[i] = gf_mul(c, i);
+        hi[i] = gf_mul(c, i << 4);
+    }
+}
+
+__attribute__((target("ssse3")))
+static void
+_addmul_ssse3(gf*restrict dst, const gf*restrict src, gf c, size_t sz) {
+    gf lo[16], hi[16];
+    size_t i = 0;
+    _init_nibble_tables(c, lo, hi);
+    __m128i tbl_lo = _mm_loadu_si128((const __m128i *) lo);
+    __m128i tbl_hi = _mm_loadu_si128((const __m128i *) hi);
+    __m128i mask = _mm_set1_epi8(0x0f);
+
+    for (; i + 32 <= sz; i += 32) {
+        __m128i s0 = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i s1 = _mm_loadu_si128((const __m128i *) (src + i + 16));
+        __m128i p0 = _mm_xor_si128(_mm_shuffle_epi8(tbl_lo, _mm_and_si128(s0, mask)),
+                _mm_shuffle_epi8(tbl_hi, _mm_and_si128(_mm_srli_epi64(s0, 4), mask)));
+        __m128i p1 = _mm_xor_si128(_mm_shuffle_epi8(tbl_lo, _mm_and_si128(s1, mask)),
+                _mm_shuffle_epi8(tbl_hi, _mm_and_si128(_mm_srli_epi64(s1, 4), mask)));
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_xor_si128(p0, _mm_loadu_si128((const __m128i *) (dst + i))));
+        _mm_storeu_si128((__m128i *) (dst + i + 16), _mm_xor_si128(p1, _mm_loadu_si128((const __m128i *) (dst + i + 16))));
+    }
+    for (; i + 16 <= sz; i += 16) {
+        __m128i s0 = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i p0 = _mm_xor_si128(_mm_shuffle_epi8(tbl_lo, _mm_and_si128(s0, mask)),
+                _mm_shuffle_epi8(tbl_hi, _mm_and_si128(_mm_srli_epi64(s0, 4), mask)));
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_xor_si128(p0, _mm_loadu_si128((const __m128i *) (dst + i))));
+    }
+    if (i < sz)
+        _addmul1(dst + i, src + i, c, sz - i);
+}
+
+__attribute__((target("avx2")))
+static void
+_addmul_avx2(gf*restrict dst, const gf*restrict src, gf c, size_t sz) {
+    gf lo[16], hi[16];
+    size_t i = 0;
+    _init_nibble_tables(c, lo, hi);
+    /* vpshufb works within 128-bit lanes, so both lanes hold the table */
+    __m256i tbl_lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) lo));
+    __m256i tbl_hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) hi));
+    __m256i mask = _mm256_set1_epi8(0x0f);
+
+    for (; i + 64 <= sz; i += 64) {
+        __m256i s0 = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i s1 = _mm256_loadu_si256((const __m256i *) (src + i + 32));
+        __m256i p0 = _mm256_xor_si256(_mm256_shuffle_epi8(tbl_lo, _mm256_and_si256(s0, mask)),
+                _mm256_shuffle_epi8(tbl_hi, _mm256_and_si256(_mm256_srli_epi64(s0, 4), mask)));
+        __m256i p1 = _mm256_xor_si256(_mm256_shuffle_epi8(tbl_lo, _mm256_and_si256(s1, mask)),
+                _mm256_shuffle_epi8(tbl_hi, _mm256_and_si256(_mm256_srli_epi64(s1, 4), mask)));
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_xor_si256(p0, _mm256_loadu_si256((const __m256i *) (dst + i))));
+        _mm256_storeu_si256((__m256i *) (dst + i + 32), _mm256_xor_si256(p1, _mm256_loadu_si256((const __m256i *) (dst + i + 32))));
+    }
+    for (; i + 32 <= sz; i += 32) {
+        __m256i s0 = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i p0 = _mm256_xor_si256(_mm256_shuffle_epi8(tbl_lo, _mm256_and_si256(s0, mask)),
+                _mm256_shuffle_epi8(tbl_hi, _mm256_and_si256(_mm256_srli_epi64(s0, 4), mask)));
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_xor_si256(p0, _mm256_loadu_si256((const __m256i *) (dst + i))));
+    }
+    if (i < sz)
+        _addmul_ssse3(dst + i, src + i, c, sz - i);
+}
+#endif /* FEC_X86_DISPATCH */
+
+typedef void (*addmul_func_t)(gf*restrict dst, const gf*restrict src, gf c, size_t sz);
+
+static const struct {
+    const char *name;
+    addmul_func_t func;
+} addmul_impls[] = {
+#ifdef FEC_X86_DISPATCH
+    { "avx2", _addmul_avx2 },
+    { "ssse3", _addmul_ssse3 },
+#endif
+    { "scalar", _addmul1 },
+};
+
+static addmul_func_t addmul_impl = _addmul1;
+static const char *addmul_impl_name = "scalar";
+
+static int
+addmul_impl_supported(const char *name) {
+#ifdef FEC_X86_DISPATCH
+    __builtin_cpu_init();
+    if (strcmp(name, "avx2") == 0)
+        return __builtin_cpu_supports("avx2");
+    if (strcmp(name, "ssse3") == 0)
+        return __builtin_cpu_supports("ssse3");
+#endif
+    return strcmp(name, "scalar") == 0;
+}
+
 /*
  * computes C = AB where A is n*k, B is k*m, C is n*m
  */
@@ -401,6 +511,28 @@ init_fec (void) {
     generate_gf();
     _init_mul_table();
     fec_initialized = 1;
+    fec_select_impl(NULL);
+}
+
+const char *
+fec_select_impl(const char *name) {
+    unsigned i;
+    if (fec_initialized == 0)
+        init_fec ();
+    for (i = 0; i < sizeof addmul_impls / sizeof addmul_impls[0]; i++) {
+        if ((name == NULL || strcmp(name, addmul_impls[i].name) == 0) &&
+                addmul_impl_supported(addmul_impls[i].name)) {
+            addmul_impl = addmul_impls[i].func;
+            addmul_impl_name = addmul_impls[i].name;
+            return addmul_impl_name;
+        }
+    }
+    return NULL;
+}
+
+const char *
+fec_get_impl(void) {
+    return addmul_impl_name;
 }
 
 /*
@@ -494,9 +626,10 @@ fec_encode(const fec_t* code, const gf*restrict const*restrict const src, gf*res
  *
  * @param matrix a space allocated for a k by k matrix
  */
-static void
-build_decode_matrix_into_space(const fec_t*restrict const code, const unsigned*const restrict index, const unsigned k, gf*restrict const matrix) {
+void
+fec_build_decode_matrix(const fec_t*restrict const code, const unsigned*const restrict index, gf*restrict const matrix) {
     unsigned char i;
+    unsigned k = code->k;
     gf* p;
     for (i=0, p=matrix; i < k; i++, p += k) {
         if (index[i] < k) {
@@ -510,12 +643,10 @@ build_decode_matrix_into_space(const fec_t*restrict const code, const unsigned*c
 }
 
 void
-fec_decode(const fec_t* code, const gf*restrict const*restrict const inpkts, gf*restrict const*restrict const outpkts, const unsigned*restrict const index, size_t sz) {
-    gf* m_dec = (gf*)alloca(code->k * code->k);
+fec_decode_with_matrix(const fec_t* code, const gf*restrict const m_dec, const gf*restrict const*restrict const inpkts, gf*restrict const*restrict const outpkts, const unsigned*restrict const index, size_t sz) {
     unsigned char outix=0;
     unsigned char row=0;
     unsigned char col=0;
-    build_decode_matrix_into_space(code, index, code->k, m_dec);
 
     for (row=0; row<code->k; row++) {
         assert ((index[row] >= code->k) || (index[row] == row)); /* If the block whose number is i is present, then it is required to be in the i'th element. */
@@ -528,6 +659,13 @@ fec_decode(const fec_t* code, const gf*restrict const*restrict const inpkts, gf*
     }
 }
 
+void
+fec_decode(const fec_t* code, const gf*restrict const*restrict const inpkts, gf*restrict const*restrict const outpkts, const unsigned*restrict const index, size_t sz) {
+    gf* m_dec = (gf*)alloca(code->k * code->k);
+    fec_build_decode_matrix(code, index, m_dec);
+    fec_decode_with_matrix(code, m_dec, inpkts, outpkts, index, sz);
+}
+
 /**
  * zfec -- fast forward error correction library with Python interface
  *
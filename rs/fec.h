@@ -42,6 +42,27 @@ void fec_encode(const fec_t* code, const gf*restrict const*restrict const src, g
  */
 void fec_decode(const fec_t* code, const gf*restrict const*restrict const inpkts, gf*restrict const*restrict const outpkts, const unsigned*restrict const index, size_t sz);
 
+/**
+ * fec_decode() split into two steps, so that the decode matrix can be
+ * computed only once when decoding the packets by parts (eg. in parallel).
+ * @param matrix space for a k by k matrix
+ */
+void fec_build_decode_matrix(const fec_t* code, const unsigned* index, gf* matrix);
+/**
+ * @param m_dec matrix computed by fec_build_decode_matrix()
+ * @see fec_decode() for other parameters
+ */
+void fec_decode_with_matrix(const fec_t* code, const gf* m_dec, const gf*restrict const*restrict const inpkts, gf*restrict const*restrict const outpkts, const unsigned*restrict const index, size_t sz);
+
+/**
+ * Selects implementation of GF(2^8) multiply-accumulate used by fec_encode()
+ * and fec_decode(). By default, the fastest one supported by the CPU is used.
+ * @param name "avx2", "ssse3", "scalar" or NULL for the fastest supported one
+ * @return name of the selected implementation or NULL if not available
+ */
+const char *fec_select_impl(const char *name);
+const char *fec_get_impl(void);
+
 #if defined(_MSC_VER)
 #define alloca _alloca
 #else
@@ -51,6 +51,10 @@
 
 #include <string.h>
 #include <openssl/aes.h>
+#include <openssl/evp.h>
+
+#define GCM_IV_LEN 12
+#define GCM_TAG_LEN 16
 
 struct openssl_decrypt {
         AES_KEY key;
@@ -58,6 +62,8 @@ struct openssl_decrypt {
         unsigned char ivec[AES_BLOCK_SIZE];
         unsigned char ecount[AES_BLOCK_SIZE];
         unsigned int num;
+
+        EVP_CIPHER_CTX *gcm_ctx;
 };
 
 static int openssl_decrypt_init(struct openssl_decrypt **state,
@@ -78,6 +84,16 @@ static int openssl_decrypt_init(struct openssl_decrypt **state,
         AES_set_encrypt_key(hash, 128, &s->key);
         // for ECB it should be AES_set_decrypt_key(hash, 128, &s->key);
 
+        s->gcm_ctx = EVP_CIPHER_CTX_new();
+        if (s->gcm_ctx == NULL ||
+                        EVP_DecryptInit_ex(s->gcm_ctx, EVP_aes_128_gcm(), NULL, hash, NULL) != 1 ||
+                        EVP_CIPHER_CTX_ctrl(s->gcm_ctx, EVP_CTRL_GCM_SET_IVLEN, GCM_IV_LEN, NULL) != 1) {
+                log_msg(LOG_LEVEL_ERROR, "Unable to initialize AES-GCM context!\n");
+                EVP_CIPHER_CTX_free(s->gcm_ctx);
+                free(s);
+                return -1;
+        }
+
         *state = s;
         return 0;
 }
@@ -86,6 +102,7 @@ static void openssl_decrypt_destroy(struct openssl_decrypt *s)
 {
         if(!s)
                 return;
+        EVP_CIPHER_CTX_free(s->gcm_ctx);
         free(s);
 }
 
@@ -127,11 +144,49 @@ static void openssl_decrypt_block(struct openssl_decrypt *s,
         }
 }
 
+/**
+ * Decrypts and verifies packet encrypted by openssl_encrypt_gcm()
+ * @retval 0 if authentication fails
+ */
+static int openssl_decrypt_gcm(struct openssl_decrypt *s,
+                const char *ciphertext, int ciphertext_len,
+                const char *aad, int aad_len,
+                char *plaintext)
+{
+        const int overhead = sizeof(uint32_t) + GCM_IV_LEN + GCM_TAG_LEN;
+        uint32_t data_len;
+        if (ciphertext_len < overhead) {
+                return 0;
+        }
+        memcpy(&data_len, ciphertext, sizeof(uint32_t));
+        if (data_len > (uint32_t) (ciphertext_len - overhead)) {
+                return 0;
+        }
+        const unsigned char *iv = (const unsigned char *) ciphertext + sizeof(uint32_t);
+        const unsigned char *in = iv + GCM_IV_LEN;
+
+        int len;
+        if (EVP_DecryptInit_ex(s->gcm_ctx, NULL, NULL, NULL, iv) != 1 ||
+                        (aad_len > 0 && EVP_DecryptUpdate(s->gcm_ctx, NULL, &len,
+                                                          (const unsigned char *) aad, aad_len) != 1) ||
+                        EVP_DecryptUpdate(s->gcm_ctx, (unsigned char *) plaintext, &len, in, data_len) != 1 ||
+                        EVP_CIPHER_CTX_ctrl(s->gcm_ctx, EVP_CTRL_GCM_SET_TAG, GCM_TAG_LEN,
+                                const_cast<unsigned char *>(in + data_len)) != 1 ||
+                        EVP_DecryptFinal_ex(s->gcm_ctx, (unsigned char *) plaintext + len, &len) != 1) {
+                return 0;
+        }
+        return data_len;
+}
+
 static int openssl_decrypt(struct openssl_decrypt *decrypt,
                 const char *ciphertext, int ciphertext_len,
                 const char *aad, int aad_len,
                 char *plaintext, enum openssl_mode mode)
 {
+        if (mode == MODE_AES128_GCM) {
+                return openssl_decrypt_gcm(decrypt, ciphertext, ciphertext_len, aad, aad_len, plaintext);
+        }
+
         UNUSED(ciphertext_len);
         uint32_t data_len;
         memcpy(&data_len, ciphertext, sizeof(uint32_t));
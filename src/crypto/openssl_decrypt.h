@@ -41,7 +41,7 @@
 #ifdef __cplusplus
 #include "crypto/openssl_encrypt.h" // enum openssl_mode
 
-#define OPENSSL_DECRYPT_ABI_VERSION 1
+#define OPENSSL_DECRYPT_ABI_VERSION 2
 
 struct openssl_decrypt;
 
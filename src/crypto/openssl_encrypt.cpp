@@ -49,8 +49,12 @@
 
 #include <string.h>
 #include <openssl/aes.h>
+#include <openssl/evp.h>
 #include <openssl/rand.h>
 
+#define GCM_IV_LEN 12
+#define GCM_TAG_LEN 16
+
 struct openssl_encrypt {
         AES_KEY key;
 
@@ -59,6 +63,9 @@ struct openssl_encrypt {
         unsigned char ivec[16];
         unsigned int num;
         unsigned char ecount[16];
+
+        EVP_CIPHER_CTX *gcm_ctx;
+        uint32_t gcm_counter; ///< per-packet part of GCM IV (the rest is random)
 };
 
 static int openssl_encrypt_init(struct openssl_encrypt **state, const char *passphrase,
@@ -81,7 +88,26 @@ static int openssl_encrypt_init(struct openssl_encrypt **state, const char *pass
                 return -1;
         }
         s->mode = mode;
-        assert(s->mode == MODE_AES128_CFB || MODE_AES128_CTR); // only functional by now
+        assert(s->mode == MODE_AES128_CFB || s->mode == MODE_AES128_CTR || s->mode == MODE_AES128_GCM); // only functional by now
+#ifndef HAVE_AES_CTR128_ENCRYPT
+        if (s->mode == MODE_AES128_CTR) {
+                log_msg(LOG_LEVEL_ERROR, "AES CTR not compiled in!\n");
+                free(s);
+                return -1;
+        }
+#endif
+
+        if (s->mode == MODE_AES128_GCM) {
+                s->gcm_ctx = EVP_CIPHER_CTX_new();
+                if (s->gcm_ctx == NULL ||
+                                EVP_EncryptInit_ex(s->gcm_ctx, EVP_aes_128_gcm(), NULL, hash, NULL) != 1 ||
+                                EVP_CIPHER_CTX_ctrl(s->gcm_ctx, EVP_CTRL_GCM_SET_IVLEN, GCM_IV_LEN, NULL) != 1) {
+                        log_msg(LOG_LEVEL_ERROR, "Unable to initialize AES-GCM context!\n");
+                        EVP_CIPHER_CTX_free(s->gcm_ctx);
+                        free(s);
+                        return -1;
+                }
+        }
 
         *state = s;
         return 0;
@@ -105,6 +131,7 @@ static void openssl_encrypt_block(struct openssl_encrypt *s, unsigned char *plai
 
         switch(s->mode) {
                 case MODE_AES128_NONE:
+                case MODE_AES128_GCM: // handled by openssl_encrypt_gcm()
                         abort();
                 case MODE_AES128_CTR:
 #ifdef HAVE_AES_CTR128_ENCRYPT
@@ -132,12 +159,52 @@ static void openssl_encrypt_block(struct openssl_encrypt *s, unsigned char *plai
 
 static void openssl_encrypt_destroy(struct openssl_encrypt *s)
 {
+        EVP_CIPHER_CTX_free(s->gcm_ctx);
         free(s);
 }
 
+/**
+ * Encrypts and authenticates whole packet at once. Output is:
+ * data_len (4 B) | IV (12 B) | ciphertext (data_len B) | tag (16 B)
+ *
+ * IV consists of 8 random bytes and per-packet counter. Random part is
+ * regenerated when the counter wraps around so that IV is never reused.
+ */
+static int openssl_encrypt_gcm(struct openssl_encrypt *s,
+                char *plaintext, int data_len, char *aad, int aad_len, char *ciphertext)
+{
+        memcpy(ciphertext, &data_len, sizeof(uint32_t));
+        unsigned char *iv = (unsigned char *) ciphertext + sizeof(uint32_t);
+        unsigned char *out = iv + GCM_IV_LEN;
+
+        if (s->gcm_counter == 0 && !RAND_bytes(s->ivec, 8)) {
+                log_msg(LOG_LEVEL_ERROR, "Unable to generate IV!\n");
+                return 0;
+        }
+        s->gcm_counter++;
+        memcpy(iv, s->ivec, 8);
+        memcpy(iv + 8, &s->gcm_counter, sizeof(uint32_t));
+
+        int len;
+        if (EVP_EncryptInit_ex(s->gcm_ctx, NULL, NULL, NULL, iv) != 1 ||
+                        (aad_len > 0 && EVP_EncryptUpdate(s->gcm_ctx, NULL, &len,
+                                                          (unsigned char *) aad, aad_len) != 1) ||
+                        EVP_EncryptUpdate(s->gcm_ctx, out, &len, (unsigned char *) plaintext, data_len) != 1 ||
+                        EVP_EncryptFinal_ex(s->gcm_ctx, out + len, &len) != 1 ||
+                        EVP_CIPHER_CTX_ctrl(s->gcm_ctx, EVP_CTRL_GCM_GET_TAG, GCM_TAG_LEN, out + data_len) != 1) {
+                log_msg(LOG_LEVEL_ERROR, "AES-GCM encryption failed!\n");
+                return 0;
+        }
+        return sizeof(uint32_t) + GCM_IV_LEN + data_len + GCM_TAG_LEN;
+}
+
 static int openssl_encrypt(struct openssl_encrypt *encryption,
                 char *plaintext, int data_len, char *aad, int aad_len, char *ciphertext)
 {
+        if (encryption->mode == MODE_AES128_GCM) {
+                return openssl_encrypt_gcm(encryption, plaintext, data_len, aad, aad_len, ciphertext);
+        }
+
         uint32_t crc = 0xffffffff;
         memcpy(ciphertext, &data_len, sizeof(uint32_t));
         ciphertext += sizeof(uint32_t);
@@ -174,6 +241,8 @@ static int openssl_get_overhead(struct openssl_encrypt *s)
                 case MODE_AES128_CTR:
                         return sizeof(uint32_t) /* data_len */ +
                                 16 /* nonce + counter */ + sizeof(uint32_t) /* crc */;
+                case MODE_AES128_GCM:
+                        return sizeof(uint32_t) /* data_len */ + GCM_IV_LEN + GCM_TAG_LEN;
                 default:
                         abort();
         }
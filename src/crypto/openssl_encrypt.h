@@ -46,16 +46,17 @@ enum openssl_mode {
         MODE_AES128_NONE = 0,
         MODE_AES128_CTR = 1, // no autenticity, only integrity (CRC)
         MODE_AES128_CFB = 2,
-        MODE_AES128_MAX = MODE_AES128_CFB,
+        MODE_AES128_GCM = 3, // authenticated encryption
+        MODE_AES128_MAX = MODE_AES128_GCM,
         MODE_AES128_ECB = -1, // do not use
 };
 
 
-#define MAX_CRYPTO_EXTRA_DATA 24 // == maximal overhead of available encryptions
-#define MAX_CRYPTO_PAD 0 // CTR does not need padding
+#define MAX_CRYPTO_EXTRA_DATA 32 // == maximal overhead of available encryptions
+#define MAX_CRYPTO_PAD 0 // neither CTR nor GCM needs padding
 #define MAX_CRYPTO_EXCEED (MAX_CRYPTO_EXTRA_DATA + MAX_CRYPTO_PAD)
 
-#define OPENSSL_ENCRYPT_ABI_VERSION 1
+#define OPENSSL_ENCRYPT_ABI_VERSION 2
 
 struct openssl_encrypt_info {
         /**
@@ -171,9 +171,13 @@ void state_transcoder_decompress::worker()
                         output_ports.emplace_back(msg.new_recompress_state, true);
                         break;
                 case message::FRAME:
-                        for (unsigned int i = 0; i < output_ports.size(); ++i) {
-                                if (output_ports[i].active)
-                                        recompress_process_async(output_ports[i].state, msg.frame);
+                        {
+                                vector<void *> active_ports;
+                                for (unsigned int i = 0; i < output_ports.size(); ++i) {
+                                        if (output_ports[i].active)
+                                                active_ports.push_back(output_ports[i].state);
+                                }
+                                recompress_process_async(active_ports, msg.frame);
                         }
                         break;
                 }
@@ -8,29 +8,191 @@
 
 #include "debug.h"
 #include "host.h"
+#include "module.h"
 #include "rtp/rtp.h"
+#include "utils/synchronized_queue.h"
+#include "video_compress.h"
+#include "video_frame.h"
 
 #include "video_rxtx/ultragrid_rtp.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <deque>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
+struct recompress_encoder;
+
+#define MAX_PENDING_DESTS 64
+
+/**
+ * Returns a copy of frame metadata sharing the data with the original. The
+ * sending path of each port writes to the frame (compress_start/end,
+ * paused_play), so the ports must not share one instance.
+ */
+static shared_ptr<video_frame> port_frame(shared_ptr<video_frame> const & frame)
+{
+        struct video_frame *copy = vf_alloc(frame->tile_count);
+        struct tile *tiles = copy->tiles;
+        memcpy(copy, frame.get(), sizeof *copy);
+        memset(&copy->callbacks, 0, sizeof copy->callbacks);
+        copy->tiles = tiles;
+        memcpy(copy->tiles, frame->tiles, frame->tile_count * sizeof(struct tile));
+        // keep the original (and its data) alive as long as the copy exists
+        return shared_ptr<video_frame>(copy, [frame](struct video_frame *f) { vf_free(f); });
+}
+
 struct state_recompress {
         state_recompress(unique_ptr<ultragrid_rtp_video_rxtx> && vr, string const & h, int tp)
                 : video_rxtx(std::move(vr)), host(h), t0(chrono::system_clock::now()),
-                frames(0), tx_port(tp) {
+                frames(0), tx_port(tp), encoder(nullptr) {
         }
 
-        unique_ptr<ultragrid_rtp_video_rxtx> video_rxtx;
+        unique_ptr<ultragrid_rtp_video_rxtx> video_rxtx; ///< sends (already compressed) frames
         string host;
 
         chrono::system_clock::time_point t0;
         int frames;
         int tx_port;
+        struct recompress_encoder *encoder; ///< shared compression, NULL for "none"
 };
 
+/**
+ * Compression shared by all output ports requesting the same configuration.
+ * Every frame is compressed once and passed to ports that were active when
+ * the frame arrived.
+ */
+struct recompress_encoder {
+        explicit recompress_encoder(string const & cfg) : config(cfg), mod(), compress(nullptr), ports(0) {
+        }
+
+        string config;
+        struct module mod;
+        struct compress_state *compress;
+        int ports; ///< number of ports using this encoder, guarded by encoders_lock
+
+        synchronized_queue<pair<shared_ptr<video_frame>, vector<state_recompress *>>, 1> queue;
+        mutex lock;
+        vector<state_recompress *> members; ///< ports using this encoder
+        /// receivers of frames passed to the compression, in order, one
+        /// entry per frame (compressed frames are popped in the same order)
+        deque<vector<state_recompress *>> dests;
+        thread compress_thread;
+        thread send_thread;
+
+        void compress_loop() {
+                while (true) {
+                        auto item = queue.pop();
+                        bool poisoned = !item.first;
+                        if (!poisoned) {
+                                lock_guard<mutex> lk(lock);
+                                dests.push_back(std::move(item.second));
+                                // a compression that drops frames would leave stale
+                                // entries behind - keep the list bounded
+                                if (dests.size() > MAX_PENDING_DESTS) {
+                                        dests.pop_front();
+                                }
+                        }
+                        compress_frame(compress, std::move(item.first));
+                        if (poisoned) {
+                                return;
+                        }
+                }
+        }
+
+        void send_loop() {
+                shared_ptr<video_frame> out;
+                while ((out = compress_pop(compress))) {
+                        lock_guard<mutex> lk(lock);
+                        if (dests.empty()) {
+                                continue;
+                        }
+                        for (auto port : dests.front()) {
+                                // skip ports removed while the frame was being compressed
+                                if (find(members.begin(), members.end(), port) != members.end()) {
+                                        port->video_rxtx->send(port_frame(out));
+                                }
+                        }
+                        dests.pop_front();
+                }
+        }
+
+        void add_port(state_recompress *port) {
+                lock_guard<mutex> lk(lock);
+                members.push_back(port);
+        }
+
+        void remove_port(state_recompress *port) {
+                lock_guard<mutex> lk(lock);
+                members.erase(remove(members.begin(), members.end(), port), members.end());
+        }
+};
+
+static mutex encoders_lock;
+static map<string, recompress_encoder *> encoders; ///< indexed by compression configuration
+
+/**
+ * Returns encoder for given compression configuration, creates a new one if
+ * no other port uses the configuration.
+ */
+static recompress_encoder *encoder_get(struct module *parent, const char *compress)
+{
+        lock_guard<mutex> lk(encoders_lock);
+        auto it = encoders.find(compress);
+        if (it != encoders.end()) {
+                it->second->ports += 1;
+                log_msg(LOG_LEVEL_NOTICE, "Reusing running encoder %s (%d ports).\n", compress, it->second->ports);
+                return it->second;
+        }
+
+        auto enc = new recompress_encoder(compress);
+        module_init_default(&enc->mod);
+        enc->mod.cls = MODULE_CLASS_DATA;
+        module_register(&enc->mod, get_root_module(parent));
+        if (compress_init(&enc->mod, compress, &enc->compress) != 0) {
+                module_done(&enc->mod);
+                delete enc;
+                return nullptr;
+        }
+        enc->ports = 1;
+        enc->compress_thread = thread(&recompress_encoder::compress_loop, enc);
+        enc->send_thread = thread(&recompress_encoder::send_loop, enc);
+        encoders[compress] = enc;
+        return enc;
+}
+
+/**
+ * Detaches port from its encoder, the encoder is stopped if it was the last
+ * one using it.
+ */
+static void encoder_put(state_recompress *port)
+{
+        recompress_encoder *enc = port->encoder;
+        enc->remove_port(port);
+
+        unique_lock<mutex> lk(encoders_lock);
+        if (--enc->ports > 0) {
+                return;
+        }
+        encoders.erase(enc->config);
+        lk.unlock();
+
+        enc->queue.push({});
+        enc->compress_thread.join();
+        enc->send_thread.join();
+        module_done(CAST_MODULE(enc->compress));
+        module_done(&enc->mod);
+        delete enc;
+}
+
 void *recompress_init(struct module *parent,
                 const char *host, const char *compress, unsigned short rx_port,
                 unsigned short tx_port, int mtu, char *fec, long long bitrate)
@@ -43,7 +205,7 @@ void *recompress_init(struct module *parent,
         // common
         params["parent"].ptr = parent;
         params["exporter"].ptr = NULL;
-        params["compression"].ptr = (void *) compress;
+        params["compression"].ptr = (void *) "none";
         params["rxtx_mode"].i = MODE_SENDER;
         params["paused"].b = false;
 
@@ -72,20 +234,27 @@ void *recompress_init(struct module *parent,
                         rxtx->m_port_id = string(host) + ":" + to_string(tx_port);
                 }
 
-                return new state_recompress(
+                auto s = new state_recompress(
                                 decltype(state_recompress::video_rxtx)(dynamic_cast<ultragrid_rtp_video_rxtx *>(rxtx)),
                                 host,
                                 tx_port
                                 );
+                if (strcmp(compress, "none") != 0) {
+                        s->encoder = encoder_get(parent, compress);
+                        if (!s->encoder) {
+                                delete s;
+                                return nullptr;
+                        }
+                        s->encoder->add_port(s);
+                }
+                return s;
         } catch (...) {
                 return nullptr;
         }
 }
 
-void recompress_process_async(void *state, shared_ptr<video_frame> frame)
+static void recompress_update_stats(state_recompress *s, video_frame *frame)
 {
-        auto s = static_cast<state_recompress *>(state);
-
         s->frames += 1;
 
         chrono::system_clock::time_point now = chrono::system_clock::now();
@@ -100,8 +269,28 @@ void recompress_process_async(void *state, shared_ptr<video_frame> frame)
                 s->t0 = now;
                 s->frames = 0;
         }
+}
 
-        s->video_rxtx->send(frame);
+/**
+ * Passes frame to all given ports. Ports sharing an encoder get the frame
+ * compressed only once.
+ */
+void recompress_process_async(vector<void *> const & states, shared_ptr<video_frame> frame)
+{
+        map<recompress_encoder *, vector<state_recompress *>> shared;
+        for (void *state : states) {
+                auto s = static_cast<state_recompress *>(state);
+                recompress_update_stats(s, frame.get());
+                if (s->encoder) {
+                        shared[s->encoder].push_back(s);
+                } else {
+                        s->video_rxtx->send(port_frame(frame));
+                }
+        }
+
+        for (auto & enc : shared) {
+                enc.first->queue.push({frame, std::move(enc.second)});
+        }
 }
 
 void recompress_assign_ssrc(void *state, uint32_t ssrc)
@@ -122,6 +311,9 @@ void recompress_done(void *state)
 {
         auto s = static_cast<state_recompress *>(state);
 
+        if (s->encoder) {
+                encoder_put(s);
+        }
         s->video_rxtx->join();
 
         delete s;
@@ -25,5 +25,6 @@ uint32_t recompress_get_ssrc(void *state);
 #ifdef __cplusplus
 #include <memory>
 #include <string>
-void recompress_process_async(void *state, std::shared_ptr<video_frame> frame);
+#include <vector>
+void recompress_process_async(std::vector<void *> const & states, std::shared_ptr<video_frame> frame);
 #endif
@@ -24,6 +24,7 @@
 #include "utils/misc.h"
 #include "tv.h"
 
+#include <algorithm>
 #include <cinttypes>
 #include <map>
 #include <string>
@@ -34,6 +35,8 @@ using namespace std;
 struct item;
 
 #define REPLICA_MAGIC 0xd2ff3323
+/// max number of queued packets passed to each replica socket at once (one sendmmsg() if available)
+#define SEND_WINDOW 64
 
 struct replica {
     replica(const char *addr, uint16_t rx_port, uint16_t tx_port, int bufsize, struct module *parent, int force_ip_version) {
@@ -46,6 +49,7 @@ struct replica {
         }
         if (udp_set_send_buf(sock, bufsize) != TRUE)
             fprintf(stderr, "Cannot set send buffer!\n");
+        udp_set_send_batch(sock, SEND_WINDOW);
         module_init_default(&mod);
         mod.cls = MODULE_CLASS_PORT;
         mod.name = (char *) malloc(strlen(addr) + 2 /* [ ] for IPv6 addr */ + 5 /* port */ + 1 /* '\0' */);
@@ -55,6 +59,7 @@ struct replica {
         module_register(&mod, parent);
         type = replica::type_t::NONE;
         recompress = nullptr;
+        sender_idx = 0;
     }
 
     ~replica() {
@@ -76,36 +81,67 @@ struct replica {
     enum type_t type;
     socket_udp *sock;
     void *recompress;
+    int sender_idx; ///< index of sender thread forwarding to this replica
+};
+
+/**
+ * Reader of the shared packet ring. Packets [window_begin, window_end) are
+ * being processed by the consumer.
+ */
+struct packet_consumer {
+    uint64_t cursor = 0;    ///< sequence number of next packet to be taken
+    uint64_t window_begin = 0;
+    uint64_t window_end = 0;
+    uint64_t dropped = 0;   ///< packets overwritten before the consumer took them
+};
+
+/// buffer replaced in the ring while some consumers were still processing it
+struct detached_buf {
+    uint64_t seq;
+    char *buf;
+    int ref;
+};
+
+/// thread forwarding packets to a group of replicas
+struct sender_thread : public packet_consumer {
+    sender_thread() {
+        pthread_mutex_init(&lock, NULL);
+    }
+    ~sender_thread() {
+        pthread_mutex_destroy(&lock);
+    }
+    struct hd_rum_translator_state *s = nullptr;
+    pthread_t thread;
+    pthread_mutex_t lock; ///< held while sending, protects replicas and their types
+    vector<replica *> replicas;
 };
 
 struct hd_rum_translator_state {
-    hd_rum_translator_state() : mod(), control_state(nullptr), queue(nullptr), qhead(nullptr),
-            qtail(nullptr), qempty(1), qfull(0), decompress(nullptr) {
+    hd_rum_translator_state() : mod(), control_state(nullptr), queue(nullptr), qsize(0),
+            qwritten(0), qreserved(0), qclosed(false), decompress(nullptr) {
         module_init_default(&mod);
         mod.cls = MODULE_CLASS_ROOT;
-        pthread_mutex_init(&qempty_mtx, NULL);
-        pthread_mutex_init(&qfull_mtx, NULL);
-        pthread_cond_init(&qempty_cond, NULL);
-        pthread_cond_init(&qfull_cond, NULL);
+        pthread_mutex_init(&qmtx, NULL);
+        pthread_cond_init(&qdata_cond, NULL);
     }
     ~hd_rum_translator_state() {
-        pthread_mutex_destroy(&qempty_mtx);
-        pthread_mutex_destroy(&qfull_mtx);
-        pthread_cond_destroy(&qempty_cond);
-        pthread_cond_destroy(&qfull_cond);
+        pthread_mutex_destroy(&qmtx);
+        pthread_cond_destroy(&qdata_cond);
         module_done(&mod);
     }
     struct module mod;
     struct control_state *control_state;
     struct item *queue;
-    struct item *qhead;
-    struct item *qtail;
-    int qempty;
-    int qfull;
-    pthread_mutex_t qempty_mtx;
-    pthread_mutex_t qfull_mtx;
-    pthread_cond_t qempty_cond;
-    pthread_cond_t qfull_cond;
+    int qsize;
+    uint64_t qwritten;  ///< number of packets written to the ring (sequence number of next one)
+    uint64_t qreserved; ///< qwritten + 1 if the next slot was already reserved (reader only)
+    bool qclosed;
+    pthread_mutex_t qmtx; ///< protects qwritten, qclosed, consumers' positions, detached and replicas
+    pthread_cond_t qdata_cond;
+    vector<detached_buf> detached;
+
+    struct packet_consumer transcoder; ///< consumer feeding hd_rum_decompress (writer thread)
+    vector<sender_thread *> senders;
 
     vector<replica *> replicas;
     void *decompress;
@@ -115,8 +151,9 @@ struct hd_rum_translator_state {
  * Prototypes
  */
 static struct item *qinit(int qsize);
-static void qdestroy(struct item *queue);
+static void qdestroy(struct item *queue, int qsize);
 static void *writer(void *arg);
+static void *sender(void *arg);
 static void signal_handler(int signal);
 void exit_uv(int status);
 
@@ -156,22 +193,9 @@ static void signal_handler(int signal)
     exit_uv(0);
 }
 
-#define MAX_PKT_SIZE 10000
-
-#ifdef WIN32
-struct wsa_aux_storage {
-    WSAOVERLAPPED *overlapped;
-    int ref;
-};
-#define ALIGNMENT std::alignment_of<wsa_aux_storage>::value
-#define OFFSET ((MAX_PKT_SIZE + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT)
-#define SIZE (OFFSET + sizeof(wsa_aux_storage))
-#else
-#define SIZE MAX_PKT_SIZE
-#endif
+#define SIZE 10000
 
 struct item {
-    struct item *next;
     long size;
     char *buf;
 };
@@ -191,23 +215,96 @@ static struct item *qinit(int qsize)
 
     for (i = 0; i < qsize; i++) {
         queue[i].buf = (char *) malloc(SIZE);
-        queue[i].next = queue + i + 1;
     }
-    queue[qsize - 1].next = queue;
 
     return queue;
 }
 
-static void qdestroy(struct item *queue)
+static void qdestroy(struct item *queue, int qsize)
 {
-    struct item *q = queue;
-    do {
-        free(q->buf);
-        q = q->next;
-    } while (q != queue);
+    for (int i = 0; i < qsize; i++) {
+        free(queue[i].buf);
+    }
     free(queue);
 }
 
+/**
+ * Releases the previous window of consumer c and waits for new packets.
+ *
+ * @param[out] window taken packets, buffers remain valid until next call
+ * @returns    number of taken packets (at most SEND_WINDOW), 0 if the ring
+ *             was closed and all packets were consumed
+ */
+static int qtake(struct hd_rum_translator_state *s, struct packet_consumer *c, struct item *window)
+{
+    pthread_mutex_lock(&s->qmtx);
+    for (auto it = s->detached.begin(); it != s->detached.end(); ) {
+        if (it->seq >= c->window_begin && it->seq < c->window_end && --it->ref == 0) {
+            free(it->buf);
+            it = s->detached.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    c->window_begin = c->window_end;
+    while (c->cursor == s->qwritten && !s->qclosed) {
+        pthread_cond_wait(&s->qdata_cond, &s->qmtx);
+    }
+    int count = (int) min<uint64_t>(s->qwritten - c->cursor, SEND_WINDOW);
+    for (int i = 0; i < count; ++i) {
+        window[i] = s->queue[(c->cursor + i) % s->qsize];
+    }
+    c->window_begin = c->cursor;
+    c->window_end = c->cursor += count;
+    pthread_mutex_unlock(&s->qmtx);
+    return count;
+}
+
+/**
+ * Returns the ring slot for the next packet. The reader never waits for
+ * consumers - those that lag behind whole ring drop the oldest packet and if
+ * a consumer is still sending it, the buffer is detached and a new one is
+ * put in the ring (so that a blocked output doesn't stall the others).
+ */
+static struct item *qreserve(struct hd_rum_translator_state *s)
+{
+    struct item *item = &s->queue[s->qwritten % s->qsize];
+    if (s->qwritten < (uint64_t) s->qsize || s->qwritten < s->qreserved) {
+        return item;
+    }
+    s->qreserved = s->qwritten + 1;
+
+    uint64_t seq = s->qwritten - s->qsize;
+    int ref = 0;
+    pthread_mutex_lock(&s->qmtx);
+    auto check = [&](struct packet_consumer *c) {
+        if (seq >= c->cursor) {
+            c->dropped += seq + 1 - c->cursor;
+            c->cursor = seq + 1;
+        } else if (seq >= c->window_begin && seq < c->window_end) {
+            ref += 1;
+        }
+    };
+    check(&s->transcoder);
+    for (auto snd : s->senders) {
+        check(snd);
+    }
+    if (ref > 0) {
+        s->detached.push_back({seq, item->buf, ref});
+        item->buf = (char *) malloc(SIZE);
+    }
+    pthread_mutex_unlock(&s->qmtx);
+    return item;
+}
+
+static void qpush(struct hd_rum_translator_state *s)
+{
+    pthread_mutex_lock(&s->qmtx);
+    s->qwritten += 1;
+    pthread_cond_broadcast(&s->qdata_cond);
+    pthread_mutex_unlock(&s->qmtx);
+}
+
 static struct response *change_replica_type(struct hd_rum_translator_state *s,
         struct module *mod, struct message *msg, int index)
 {
@@ -215,16 +312,23 @@ static struct response *change_replica_type(struct hd_rum_translator_state *s,
 
     struct msg_universal *data = (struct msg_universal *) msg;
 
+    enum replica::type_t type;
     if (strcasecmp(data->text, "sock") == 0) {
-        r->type = replica::type_t::USE_SOCK;
+        type = replica::type_t::USE_SOCK;
         log_msg(LOG_LEVEL_NOTICE, "Output port %d is now forwarding.\n", index);
     } else if (strcasecmp(data->text, "recompress") == 0) {
-        r->type = replica::type_t::RECOMPRESS;
+        type = replica::type_t::RECOMPRESS;
         log_msg(LOG_LEVEL_NOTICE, "Output port %d is now transcoding.\n", index);
     } else {
         fprintf(stderr, "Unknown replica type \"%s\"\n", data->text);
         return new_response(RESPONSE_BAD_REQUEST, NULL);
     }
+    struct sender_thread *snd = s->senders[r->sender_idx];
+    pthread_mutex_lock(&snd->lock);
+    pthread_mutex_lock(&s->qmtx);
+    r->type = type;
+    pthread_mutex_unlock(&s->qmtx);
+    pthread_mutex_unlock(&snd->lock);
 
     hd_rum_decompress_set_active(s->decompress, r->recompress,
             r->type == replica::type_t::RECOMPRESS);
@@ -232,17 +336,87 @@ static struct response *change_replica_type(struct hd_rum_translator_state *s,
     return new_response(RESPONSE_OK, NULL);
 }
 
-#ifdef WIN32
-static VOID CALLBACK wsa_deleter(DWORD /* dwErrorCode */,
-        DWORD /* dwNumberOfBytesTransfered */,
-        LPOVERLAPPED lpOverlapped, long unsigned int) {
-    struct wsa_aux_storage *aux = (struct wsa_aux_storage *) ((char *) lpOverlapped->Pointer + OFFSET);
-    if (--aux->ref == 0) {
-        free(aux->overlapped);
-        free(lpOverlapped->Pointer);
+/**
+ * Adds replica to the sender thread with the least replicas.
+ */
+static void add_replica(struct hd_rum_translator_state *s, struct replica *rep)
+{
+    int idx = 0;
+    for (unsigned int i = 1; i < s->senders.size(); i++) {
+        if (s->senders[i]->replicas.size() < s->senders[idx]->replicas.size()) {
+            idx = i;
+        }
     }
+    rep->sender_idx = idx;
+    pthread_mutex_lock(&s->senders[idx]->lock);
+    s->senders[idx]->replicas.push_back(rep);
+    pthread_mutex_unlock(&s->senders[idx]->lock);
+
+    pthread_mutex_lock(&s->qmtx);
+    s->replicas.push_back(rep);
+    pthread_mutex_unlock(&s->qmtx);
+}
+
+static void remove_replica(struct hd_rum_translator_state *s, int index)
+{
+    struct replica *rep = s->replicas[index];
+    struct sender_thread *snd = s->senders[rep->sender_idx];
+    pthread_mutex_lock(&snd->lock);
+    snd->replicas.erase(find(snd->replicas.begin(), snd->replicas.end(), rep));
+    pthread_mutex_unlock(&snd->lock);
+
+    pthread_mutex_lock(&s->qmtx);
+    s->replicas.erase(s->replicas.begin() + index);
+    pthread_mutex_unlock(&s->qmtx);
+    delete rep;
 }
+
+/**
+ * Forwards packets to replicas of one sender thread that don't need
+ * transcoding. Each window of packets is passed to a replica socket at once
+ * (a single sendmmsg() if available).
+ */
+static void *sender(void *arg)
+{
+    struct sender_thread *snd = (struct sender_thread *) arg;
+    struct hd_rum_translator_state *s = snd->s;
+
+    struct item items[SEND_WINDOW];
+    int count;
+    while ((count = qtake(s, snd, items)) > 0) {
+#ifdef WIN32
+        WSABUF window[SEND_WINDOW];
+#else
+        struct iovec window[SEND_WINDOW];
+#endif
+        for (int i = 0; i < count; ++i) {
+#ifdef WIN32
+            window[i].buf = items[i].buf;
+            window[i].len = items[i].size;
+#else
+            window[i].iov_base = items[i].buf;
+            window[i].iov_len = items[i].size;
 #endif
+        }
+
+        pthread_mutex_lock(&snd->lock);
+        for (auto rep : snd->replicas) {
+            if (rep->type != replica::type_t::USE_SOCK) {
+                continue;
+            }
+            udp_async_start(rep->sock, count);
+            for (int i = 0; i < count; ++i) {
+                if (udp_sendv(rep->sock, &window[i], 1, NULL) < 0) {
+                    perror("Hd-rum-translator send");
+                }
+            }
+            udp_async_wait(rep->sock);
+        }
+        pthread_mutex_unlock(&snd->lock);
+    }
+
+    return NULL;
+}
 
 static void *writer(void *arg)
 {
@@ -287,8 +461,7 @@ static void *writer(void *arg)
                 }
                 if (index >= 0) {
                     hd_rum_decompress_remove_port(s->decompress, index);
-                    delete s->replicas[index];
-                    s->replicas.erase(s->replicas.begin() + index);
+                    remove_replica(s, index);
                     log_msg(LOG_LEVEL_NOTICE, "Deleted output port %d.\n", index);
                 }
             } else if (strncasecmp(msg->text, "create-port", strlen("create-port")) == 0) {
@@ -332,7 +505,7 @@ static void *writer(void *arg)
                     free_message((struct message *) msg, new_response(RESPONSE_INT_SERV_ERR, err_msg));
                     continue;
                 }
-                s->replicas.push_back(rep);
+                add_replica(s, rep);
 
                 if (compress) {
                     rep->type = replica::type_t::RECOMPRESS;
@@ -341,8 +514,7 @@ static void *writer(void *arg)
                             host, compress,
                             0, tx_port, 1500, fec, RATE_UNLIMITED);
                     if (!rep->recompress) {
-                        delete s->replicas[s->replicas.size() - 1];
-                        s->replicas.erase(s->replicas.end() - 1);
+                        remove_replica(s, s->replicas.size() - 1);
 
                         log_msg(LOG_LEVEL_ERROR, "Unable to create recompress!\n");
                     } else {
@@ -368,70 +540,20 @@ static void *writer(void *arg)
             free_message((struct message *) msg, r ? r : new_response(RESPONSE_OK, NULL));
         }
 
-        // then process incoming packets
-        while (s->qhead != s->qtail) {
-            if(s->qhead->size == 0) { // poisoned pill
-                return NULL;
-            }
-
-            // pass it for transcoding if needed
-            if (hd_rum_decompress_get_num_active_ports(s->decompress) > 0) {
-                ssize_t ret = hd_rum_decompress_write(s->decompress, s->qhead->buf, s->qhead->size);
+        // then pass incoming packets for transcoding if needed
+        struct item items[SEND_WINDOW];
+        int count = qtake(s, &s->transcoder, items);
+        if (count == 0) {
+            break;
+        }
+        if (hd_rum_decompress_get_num_active_ports(s->decompress) > 0) {
+            for (int i = 0; i < count; ++i) {
+                ssize_t ret = hd_rum_decompress_write(s->decompress, items[i].buf, items[i].size);
                 if (ret < 0) {
                     perror("hd_rum_decompress_write");
                 }
             }
-
-            // distribute it to output ports that don't need transcoding
-#ifdef WIN32
-            // send it asynchronously in MSW (performance optimalization)
-            SleepEx(0, TRUE); // allow system to call our completion routines in APC
-            int ref = 0;
-            for (unsigned int i = 0; i < s->replicas.size(); i++) {
-                if(s->replicas[i]->type == replica::type_t::USE_SOCK) {
-                    ref++;
-                }
-            }
-            struct wsa_aux_storage *aux = (struct wsa_aux_storage *) ((char *) s->qhead->buf + OFFSET);
-            memset(aux, 0, sizeof *aux);
-            aux->overlapped = (WSAOVERLAPPED *) calloc(ref, sizeof(WSAOVERLAPPED));
-            aux->ref = ref;
-            int overlapped_idx = 0;
-            for (unsigned int i = 0; i < s->replicas.size(); i++) {
-                if(s->replicas[i]->type == replica::type_t::USE_SOCK) {
-                    aux->overlapped[overlapped_idx].Pointer = s->qhead->buf;
-                    ssize_t ret = udp_send_wsa_async(s->replicas[i]->sock, s->qhead->buf, s->qhead->size, wsa_deleter, &aux->overlapped[overlapped_idx]);
-                    if (ret < 0) {
-                        perror("Hd-rum-translator send");
-                    }
-                    overlapped_idx += 1;
-                }
-            }
-            // reallocate the buffer since the last one will be freeed automaticaly
-            s->qhead->buf = (char *) malloc(SIZE);
-#else
-            for (unsigned int i = 0; i < s->replicas.size(); i++) {
-                if(s->replicas[i]->type == replica::type_t::USE_SOCK) {
-                    ssize_t ret = udp_send(s->replicas[i]->sock, s->qhead->buf, s->qhead->size);
-                    if (ret < 0) {
-                        perror("Hd-rum-translator send");
-                    }
-                }
-            }
-#endif
-            s->qhead = s->qhead->next;
-
-            pthread_mutex_lock(&s->qfull_mtx);
-            s->qfull = 0;
-            pthread_cond_signal(&s->qfull_cond);
-            pthread_mutex_unlock(&s->qfull_mtx);
         }
-
-        pthread_mutex_lock(&s->qempty_mtx);
-        if (s->qempty)
-            pthread_cond_wait(&s->qempty_cond, &s->qempty_mtx);
-        s->qempty = 1;
-        pthread_mutex_unlock(&s->qempty_mtx);
     }
 
     return NULL;
@@ -445,6 +567,7 @@ static void usage(const char *progname) {
                 "\t\t--blend - enable blending from original to newly received stream, increases latency\n"
                 "\t\t--conference <width>:<height>[:fps] - enable combining of multiple inputs, increases latency\n"
                 "\t\t--capture-filter <cfg_string> - apply video capture filter to incoming video\n"
+                "\t\t--sender-threads <n> - number of threads forwarding packets to output ports (default 1)\n"
                 "\t\t--help\n"
                 "\t\t--verbose\n"
                 "\t\t-v\n");
@@ -483,6 +606,7 @@ struct cmdline_parameters {
     int control_connection_type = 0;
     struct hd_rum_output_conf out_conf = {NORMAL, NULL};
     const char *capture_filter = NULL;
+    int sender_threads = 1;
     bool verbose = false;
 };
 
@@ -513,6 +637,12 @@ static bool parse_fmt(int argc, char **argv, struct cmdline_parameters *parsed)
             parsed->out_conf.arg = item;
         } else if(strcmp(argv[start_index], "--capture-filter") == 0) {
             parsed->capture_filter = argv[++start_index];
+        } else if(strcmp(argv[start_index], "--sender-threads") == 0) {
+            parsed->sender_threads = atoi(argv[++start_index]);
+            if (parsed->sender_threads <= 0) {
+                fprintf(stderr, "Error: invalid number of sender threads\n");
+                exit(EXIT_FAIL_USAGE);
+            }
         } else if(strcmp(argv[start_index], "--help") == 0) {
             usage(argv[0]);
             return false;
@@ -618,17 +748,33 @@ static bool parse_fmt(int argc, char **argv, struct cmdline_parameters *parsed)
     return true;
 }
 
+/**
+ * Formats output ports with their lag (packets received but not yet
+ * forwarded or transcoded) and count of packets dropped because the port
+ * couldn't keep up.
+ */
 static string format_port_list(struct hd_rum_translator_state *s)
 {
-    ostringstream oss;
+    ostringstream ports, lag, dropped;
+    pthread_mutex_lock(&s->qmtx);
     for (auto it : s->replicas) {
-        if (!oss.str().empty()) {
-            oss << ",";
+        if (!ports.str().empty()) {
+            ports << ",";
+            lag << ",";
+            dropped << ",";
         }
-        oss << it->host << ":" << it->m_tx_port;
+        struct packet_consumer *c = it->type == replica::type_t::RECOMPRESS ? &s->transcoder
+                : static_cast<packet_consumer *>(s->senders[it->sender_idx]);
+        ports << it->host << ":" << it->m_tx_port;
+        lag << s->qwritten - c->cursor;
+        dropped << c->dropped;
     }
+    pthread_mutex_unlock(&s->qmtx);
 
-    return oss.str();
+    if (ports.str().empty()) {
+        return {};
+    }
+    return " portList " + ports.str() + " portLag " + lag.str() + " portDropped " + dropped.str();
 }
 
 int main(int argc, char **argv)
@@ -639,6 +785,7 @@ int main(int argc, char **argv)
     int bufsize;
     socket_udp *sock_in;
     pthread_t thread;
+    struct item *item = NULL;
     int err = 0;
     int i;
     struct cmdline_parameters params;
@@ -703,7 +850,8 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    state.qhead = state.qtail = state.queue = qinit(qsize);
+    state.queue = qinit(qsize);
+    state.qsize = qsize;
 
     /* input socket */
     if ((sock_in = udp_init_if("localhost", NULL, params.port, 0, 255, false, false)) == NULL) {
@@ -718,6 +866,10 @@ int main(int argc, char **argv)
     printf("listening on *:%d\n", params.port);
 
     state.replicas.resize(params.host_count);
+    for (i = 0; i < params.sender_threads; i++) {
+        state.senders.push_back(new sender_thread());
+        state.senders[i]->s = &state;
+    }
 
     if (params.control_port != -1) {
         if(control_init(params.control_port, params.control_connection_type, &state.control_state, &state.mod) != 0) {
@@ -746,6 +898,8 @@ int main(int argc, char **argv)
             fputs(s.c_str(), stderr);
             return EXIT_FAILURE;
         }
+        state.replicas[i]->sender_idx = i % params.sender_threads;
+        state.senders[i % params.sender_threads]->replicas.push_back(state.replicas[i]);
 
         if(params.hosts[i].compression == NULL) {
             state.replicas[i]->type = replica::type_t::USE_SOCK;
@@ -778,6 +932,12 @@ int main(int argc, char **argv)
         fprintf(stderr, "cannot create writer thread\n");
         return 2;
     }
+    for (auto snd : state.senders) {
+        if (pthread_create(&snd->thread, NULL, sender, (void *) snd)) {
+            fprintf(stderr, "cannot create sender thread\n");
+            return 2;
+        }
+    }
 
     uint64_t received_data = 0;
     uint64_t received_pkts = 0;
@@ -789,18 +949,13 @@ int main(int argc, char **argv)
     /* main loop */
     while (!should_exit) {
         struct timeval timeout = { 1, 0 };
-        while (state.qtail->next != state.qhead
-               && (state.qtail->size = udp_recv_timeout(sock_in, state.qtail->buf, SIZE, &timeout)) > 0
+        while ((item = qreserve(&state)) != NULL
+               && (item->size = udp_recv_timeout(sock_in, item->buf, SIZE, &timeout)) > 0
                && !should_exit) {
-            received_data += state.qtail->size;
+            received_data += item->size;
             received_pkts += 1;
 
-            state.qtail = state.qtail->next;
-
-            pthread_mutex_lock(&state.qempty_mtx);
-            state.qempty = 0;
-            pthread_cond_signal(&state.qempty_cond);
-            pthread_mutex_unlock(&state.qempty_mtx);
+            qpush(&state);
 
             struct timeval t;
             gettimeofday(&t, NULL);
@@ -808,11 +963,8 @@ int main(int argc, char **argv)
             if (seconds > 5.0) {
                 unsigned long long int cur_data = (received_data - last_data);
                 unsigned long long int bps = cur_data / seconds;
-                string port_list = format_port_list(&state);
                 string statline = "FWD receivedBytes " + to_string(received_data) + " receivedPackets " + to_string(received_pkts) + " timestamp " + to_string(time_since_epoch_in_ms());
-                if (!port_list.empty()) {
-                    statline += " portList " + format_port_list(&state);
-                }
+                statline += format_port_list(&state);
                 control_report_stats(state.control_state, statline);
                 log_msg(LOG_LEVEL_INFO, "Received %llu bytes in %g seconds = %llu B/s.\n", cur_data, seconds, bps);
                 t0 = t;
@@ -820,32 +972,23 @@ int main(int argc, char **argv)
             }
             timeout = { 1, 0 };
         }
-
-        if (state.qtail->size <= 0)
-            continue;
-
-        pthread_mutex_lock(&state.qfull_mtx);
-        if (state.qfull)
-            pthread_cond_wait(&state.qfull_cond, &state.qfull_mtx);
-        state.qfull = 1;
-        pthread_mutex_unlock(&state.qfull_mtx);
     }
 
-    if (state.qtail->size < 0 && !should_exit) {
+    if (item != NULL && item->size < 0 && !should_exit) {
         printf("read: %s\n", strerror(err));
         return 2;
     }
 
-    // pass poisoned pill to the worker
-    state.qtail->size = 0;
-    state.qtail = state.qtail->next;
-
-    pthread_mutex_lock(&state.qempty_mtx);
-    state.qempty = 0;
-    pthread_cond_signal(&state.qempty_cond);
-    pthread_mutex_unlock(&state.qempty_mtx);
+    // let the writer and senders finish queued packets
+    pthread_mutex_lock(&state.qmtx);
+    state.qclosed = true;
+    pthread_cond_broadcast(&state.qdata_cond);
+    pthread_mutex_unlock(&state.qmtx);
 
     pthread_join(thread, NULL);
+    for (auto snd : state.senders) {
+        pthread_join(snd->thread, NULL);
+    }
 
     if(state.decompress) {
         hd_rum_decompress_done(state.decompress);
@@ -854,12 +997,15 @@ int main(int argc, char **argv)
     for (unsigned int i = 0; i < state.replicas.size(); i++) {
         delete state.replicas[i];
     }
+    for (auto snd : state.senders) {
+        delete snd;
+    }
 
     control_done(state.control_state);
 
     udp_exit(sock_in);
 
-    qdestroy(state.queue);
+    qdestroy(state.queue, state.qsize);
 
     printf("Exit\n");
 
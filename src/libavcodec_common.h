@@ -193,5 +193,20 @@ static bool libav_codec_has_extradata(codec_t codec) {
         return false;
 }
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void av_to_uv_convert_t(char *dst_buffer, AVFrame *in_frame, int width, int height, int pitch);
+/**
+ * Returns conversion from decoded AVFrame to UltraGrid codec or NULL if there is none.
+ * @note implemented in video_decompress/libavcodec.c
+ */
+av_to_uv_convert_t *get_av_to_uv_conversion(int av_codec, codec_t uv_codec);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif // LIBAVCODEC_COMMON_H_
 
@@ -80,6 +80,7 @@
 #include "ug_runtime_error.h"
 #include "utils/misc.h"
 #include "utils/net.h"
+#include "utils/video_frame_pool.h"
 #include "utils/wait_obj.h"
 #include "video.h"
 #include "video_capture.h"
@@ -93,6 +94,8 @@
 #include "audio/codec.h"
 #include "audio/utils.h"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -362,6 +365,36 @@ static void usage(const char *exec_path, bool full = false)
  *
  * @param[in] arg pointer to UltraGrid (root) module
  */
+/**
+ * Copies a frame that the capture driver reuses (it has no dispose callback)
+ * to a pooled frame, so that the driver may grab next frame while the copy is
+ * being compressed.
+ */
+static shared_ptr<video_frame> get_pooled_copy(video_frame_pool<default_data_allocator> &pool,
+                struct video_desc *pool_desc, size_t *pool_data_len, struct video_frame *frame)
+{
+        size_t data_len = 0;
+        for (unsigned int i = 0; i < frame->tile_count; ++i) {
+                data_len = max<size_t>(data_len, frame->tiles[i].data_len);
+        }
+        struct video_desc desc = video_desc_from_frame(frame);
+        if (!video_desc_eq(desc, *pool_desc) || data_len > *pool_data_len) {
+                *pool_desc = desc;
+                *pool_data_len = data_len;
+                pool.reconfigure(desc, data_len);
+        }
+
+        shared_ptr<video_frame> ret = pool.get_frame();
+        for (unsigned int i = 0; i < frame->tile_count; ++i) {
+                memcpy(ret->tiles[i].data, frame->tiles[i].data, frame->tiles[i].data_len);
+                ret->tiles[i].data_len = frame->tiles[i].data_len;
+        }
+        char metadata[VF_METADATA_SIZE];
+        vf_store_metadata(frame, metadata);
+        vf_restore_metadata(ret.get(), metadata);
+        return ret;
+}
+
 static void *capture_thread(void *arg)
 {
         struct module *uv_mod = (struct module *)arg;
@@ -370,18 +403,29 @@ static void *capture_thread(void *arg)
 
         wait_obj = wait_obj_init();
 
+        video_frame_pool<default_data_allocator> pool;
+        struct video_desc pool_desc{};
+        size_t pool_data_len = 0;
+
         while (!should_exit) {
                 /* Capture and transmit video... */
                 struct audio_frame *audio;
+                auto t0 = chrono::steady_clock::now();
                 struct video_frame *tx_frame = vidcap_grab(uv->capture_device, &audio);
                 if (tx_frame != NULL) {
+                        uv->state_video_rxtx->add_stage_time(PIPELINE_CAPTURE,
+                                        chrono::duration_cast<chrono::duration<double>>(chrono::steady_clock::now() - t0).count());
                         if(audio) {
                                 audio_sdi_send(uv->audio, audio);
                         }
                         //tx_frame = vf_get_copy(tx_frame);
                         bool wait_for_cur_uncompressed_frame;
                         shared_ptr<video_frame> frame;
-                        if (!tx_frame->callbacks.dispose) {
+                        if (!tx_frame->callbacks.dispose && uv->state_video_rxtx->is_pipelined()) {
+                                // copy instead of waiting until the frame is compressed
+                                wait_for_cur_uncompressed_frame = false;
+                                frame = get_pooled_copy(pool, &pool_desc, &pool_data_len, tx_frame);
+                        } else if (!tx_frame->callbacks.dispose) {
                                 wait_obj_reset(wait_obj);
                                 wait_for_cur_uncompressed_frame = true;
                                 frame = shared_ptr<video_frame>(tx_frame, [wait_obj](struct video_frame *) {
@@ -41,15 +41,16 @@
 #include "types.h"
 
 #ifdef __cplusplus
-#include <map>
 #include <memory>
 
+#include "rtp/packet_coverage.h"
+
 struct video_frame;
 
 struct fec {
         virtual std::shared_ptr<video_frame> encode(std::shared_ptr<video_frame>) = 0;
         virtual void decode(char *in, int in_len, char **out, int *len,
-                        const std::map<int, int> &) = 0;
+                        const packet_coverage &) = 0;
         virtual ~fec() {}
 
         static fec *create_from_config(const char *str);
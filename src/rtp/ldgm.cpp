@@ -82,6 +82,7 @@
 #include "rtp/rtp.h"
 #include "rtp/rtp_callback.h"
 #include "transmit.h"
+#include "utils/worker.h"
 #include "video.h"
 
 using namespace std;
@@ -236,7 +237,9 @@ void ldgm::init(unsigned int k, unsigned int m, unsigned int c, unsigned int see
 
                 }
         } else {
-                m_coding_session = unique_ptr<LDGM_session>(new LDGM_session_cpu());
+                LDGM_session_cpu *session = new LDGM_session_cpu();
+                session->set_parallel(task_run_parallel, get_worker_count());
+                m_coding_session = unique_ptr<LDGM_session>(session);
         }
 
         set_params(k, m, c, seed);
@@ -247,9 +250,9 @@ ldgm::ldgm(unsigned int k, unsigned int m, unsigned int c, unsigned int seed)
         init(k, m, c, seed);
 }
 
-void ldgm::decode(char *frame, int size, char **out, int *out_size, const map<int, int> &packets) {
+void ldgm::decode(char *frame, int size, char **out, int *out_size, const packet_coverage &packets) {
         char *decoded;
-        decoded = m_coding_session->decode_frame(frame, size, out_size, packets);
+        decoded = m_coding_session->decode_frame(frame, size, out_size, packets.runs());
         *out = decoded;
 }
 
@@ -55,27 +55,42 @@
 #include "net_udp.h"
 #include "rtp.h"
 #include "utils/net.h"
+#include "utils/spsc_queue.h"
 
 #ifdef NEED_ADDRINFO_H
 #include "addrinfo.h"
 #endif
 
+#ifdef HAVE_SENDMMSG
+#include <netinet/udp.h>
+#endif
+
 #include <algorithm>
-#include <condition_variable>
-#include <chrono>
-#include <mutex>
-#include <queue>
+#include <atomic>
+#include <vector>
 
-using std::condition_variable;
+using std::atomic;
 using std::max;
-using std::mutex;
-using std::queue;
-using std::unique_lock;
 
 #define DEFAULT_MAX_UDP_READER_QUEUE_LEN (1920/3*8*1080/1152) //< 10-bit FullHD frame divided by 1280 MTU packets (minus headers)
 
+#define UDP_PACKET_BUF_LEN (RTP_MAX_PACKET_LEN + sizeof(struct sockaddr_storage)) ///< packet + source address (see rtp_recv_data())
+#define UDP_POOL_CHUNK 256         ///< buffers allocated at once when the pool is exhausted
+#define DEFAULT_UDP_POOL_SIZE (4 * DEFAULT_MAX_UDP_READER_QUEUE_LEN)
+#define UDP_READER_BATCH 64        ///< max packets received with one recvmmsg()
+
+#ifdef HAVE_SENDMMSG
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#define UDP_BATCH_MAX_IOV 3        ///< RTP header + payload header + data (see rtp_send_data_hdr())
+#define UDP_GSO_MAX_SEGMENTS 64    ///< kernel limit (UDP_MAX_SEGMENTS)
+#define UDP_GSO_MAX_BYTES 65000    ///< must fit into one IP datagram
+#endif
+
 static int resolve_address(socket_udp *s, const char *addr, uint16_t tx_port);
 static void *udp_reader(void *arg);
+static void udp_packet_pool_release(struct udp_packet_pool *pool);
 
 #define IPv4	4
 #define IPv6	6
@@ -126,11 +141,50 @@ struct ip_mreq {
 #endif
 
 struct item {
+    inline item() : buf(nullptr), size(0) {}
     inline item(uint8_t *b, int s) :  buf(b), size(s) {}
     uint8_t *buf;
     int size;
 };
 
+struct udp_packet_pool;
+
+/**
+ * Receive buffer header, packet data (as returned by udp_packet_alloc())
+ * immediately follows.
+ */
+struct udp_packet_buf {
+        struct udp_packet_pool *pool; ///< NULL if allocated individually
+        struct udp_packet_buf *next;
+        alignas(16) char data[UDP_PACKET_BUF_LEN];
+};
+
+/**
+ * Pool of receive buffers
+ *
+ * Buffers are allocated in chunks and returned with udp_packet_free() (from
+ * any thread) to a lock-free stack. Only a single thread (the UDP reader or,
+ * if the socket is not multithreaded, the RTP receiver) takes buffers from
+ * the pool so the stack is not prone to the ABA problem - the allocating thread
+ * always takes all returned buffers at once.
+ *
+ * The pool is destroyed after the socket is closed and all buffers returned.
+ */
+struct udp_packet_pool {
+        atomic<struct udp_packet_buf *> returned{nullptr};
+        struct udp_packet_buf *free_list = nullptr;  ///< owned by the allocating thread
+        std::vector<struct udp_packet_buf *> chunks;
+        unsigned int max_buffers = 0;
+        atomic<int> refcount{1};                     ///< outstanding buffers + socket
+        bool exhausted_reported = false;
+
+        ~udp_packet_pool() {
+                for (auto c : chunks) {
+                        delete [] c;
+                }
+        }
+};
+
 /*
  * Local part of the socket
  *
@@ -145,16 +199,17 @@ struct socket_udp_local {
 #endif
 
 
+        struct udp_packet_pool *pool;
+
         // for multithreaded receiving
         pthread_t thread_id;
-        queue<struct item> packets;
+        spsc_queue<struct item> *packets; ///< reader thread -> RTP receiver
         unsigned int max_packets;
-        mutex lock;
-        condition_variable boss_cv;
-        condition_variable reader_cv;
 
-        bool should_exit;
         fd_t should_exit_fd[2];
+
+        int send_batch;         ///< max packets passed to one sendmmsg() (0 - disabled)
+        bool send_gso;          ///< merge equally-sized packets with UDP_SEGMENT
 };
 
 /*
@@ -174,6 +229,17 @@ struct _socket_udp {
         bool overlapping_active;
         int overlapped_max;
         int overlapped_count;
+#elif defined HAVE_SENDMMSG
+        // batched sending (see udp_async_start())
+        struct mmsghdr *batch_msgs;     ///< one entry per queued packet
+        struct mmsghdr *batch_send;     ///< entries passed to sendmmsg (GSO-merged)
+        struct iovec *batch_iov;        ///< iovecs of queued packets, stored contiguously
+        char *batch_cmsg;               ///< UDP_SEGMENT control messages for batch_send
+        void **dispose_udata;
+        int batch_max;
+        int batch_count;
+        int batch_iov_count;
+        bool batching_active;
 #endif
 };
 
@@ -658,6 +724,17 @@ socket_udp *udp_init(const char *addr, uint16_t rx_port, uint16_t tx_port,
 ADD_TO_PARAM(udp_queue_len, "udp-queue-len",
                 "* udp-queue-len=<l>\n"
                 "  Use different queue size than default DEFAULT_MAX_UDP_READER_QUEUE_LEN\n");
+ADD_TO_PARAM(udp_pool_size, "udp-pool-size",
+                "* udp-pool-size=<n>\n"
+                "  Maximal number of preallocated receive buffers (default DEFAULT_UDP_POOL_SIZE)\n");
+#ifdef HAVE_SENDMMSG
+ADD_TO_PARAM(udp_send_batch, "udp-send-batch",
+                "* udp-send-batch=<n>\n"
+                "  Send video packets in batches of (at most) <n> packets with sendmmsg()\n");
+ADD_TO_PARAM(udp_gso, "udp-gso",
+                "* udp-gso\n"
+                "  Use UDP segmentation offload (UDP_SEGMENT) for batched sending (requires udp-send-batch)\n");
+#endif
 /**
  * udp_init_if:
  * Creates a session for sending and receiving UDP datagrams over IP
@@ -808,6 +885,20 @@ socket_udp *udp_init_if(const char *addr, const char *iface, uint16_t rx_port,
                 abort();
         }
 
+#ifdef HAVE_SENDMMSG
+        if (get_commandline_param("udp-send-batch")) {
+                s->local->send_batch = max(atoi(get_commandline_param("udp-send-batch")), 0);
+                s->local->send_gso = get_commandline_param("udp-gso") != NULL;
+        }
+#endif
+
+        s->local->pool = new udp_packet_pool();
+        if (get_commandline_param("udp-pool-size")) {
+                s->local->pool->max_buffers = atoi(get_commandline_param("udp-pool-size"));
+        } else {
+                s->local->pool->max_buffers = DEFAULT_UDP_POOL_SIZE;
+        }
+
         s->local->multithreaded = multithreaded;
         if (multithreaded) {
                 if (!get_commandline_param("udp-queue-len")) {
@@ -815,6 +906,8 @@ socket_udp *udp_init_if(const char *addr, const char *iface, uint16_t rx_port,
                 } else {
                         s->local->max_packets = atoi(get_commandline_param("udp-queue-len"));
                 }
+                s->local->max_packets = max(s->local->max_packets, 1u);
+                s->local->packets = new spsc_queue<struct item>(s->local->max_packets);
                 platform_pipe_init(s->local->should_exit_fd);
                 pthread_create(&s->local->thread_id, NULL, udp_reader, s);
         }
@@ -896,17 +989,21 @@ void udp_exit(socket_udp * s)
                         char c = 0;
                         int ret = send(s->local->should_exit_fd[1], &c, 1, 0);
                         assert (ret == 1);
-                        s->local->should_exit = true;
-                        s->local->reader_cv.notify_one();
                         pthread_join(s->local->thread_id, NULL);
-                        while (!s->local->packets.empty()) {
-                                auto it = s->local->packets.front();
-                                free(it.buf);
-                                s->local->packets.pop();
+                        struct udp_recv_queue_stats stats;
+                        udp_get_recv_queue_stats(s, &stats);
+                        log_msg(stats.dropped > 0 ? LOG_LEVEL_WARNING : LOG_LEVEL_VERBOSE,
+                                        "[NET UDP] Receive queue: capacity %u, max occupancy %u, dropped %llu packets.\n",
+                                        stats.capacity, stats.max_occupancy, stats.dropped);
+                        struct item it;
+                        while (s->local->packets->pop(it)) {
+                                udp_packet_free(it.buf);
                         }
+                        delete s->local->packets;
                         platform_pipe_close(s->local->should_exit_fd[1]);
                 }
                 CLOSESOCKET(s->local->fd);
+                udp_packet_pool_release(s->local->pool);
                 delete s->local;
         }
 
@@ -964,12 +1061,145 @@ int udp_sendv(socket_udp * s, LPWSABUF vector, int count, void *d)
         }
 }
 #else
+#ifdef HAVE_SENDMMSG
+static void udp_batch_flush(socket_udp *s);
+
+/**
+ * Queues packet to be sent by the next udp_batch_flush(). Vector content is
+ * copied, pointed data must remain valid until the flush.
+ */
+static int udp_batch_enqueue(socket_udp *s, struct iovec *vector, int count, void *d)
+{
+        assert(count <= UDP_BATCH_MAX_IOV);
+
+        struct msghdr *msg = &s->batch_msgs[s->batch_count].msg_hdr;
+        memset(msg, 0, sizeof *msg);
+        msg->msg_name = (void *) &s->sock;
+        msg->msg_namelen = s->sock_len;
+        msg->msg_iov = s->batch_iov + s->batch_iov_count;
+        msg->msg_iovlen = count;
+        memcpy(msg->msg_iov, vector, count * sizeof(struct iovec));
+
+        s->dispose_udata[s->batch_count] = d;
+        s->batch_iov_count += count;
+        s->batch_count += 1;
+
+        if (s->batch_count == s->batch_max) {
+                udp_batch_flush(s);
+        }
+
+        return 0;
+}
+
+static size_t udp_msg_len(const struct msghdr *msg)
+{
+        size_t len = 0;
+        for (size_t i = 0; i < msg->msg_iovlen; ++i) {
+                len += msg->msg_iov[i].iov_len;
+        }
+        return len;
+}
+
+/**
+ * Merges consecutive equally-sized packets queued from index first into
+ * GSO super-packets (last packet of each may be shorter).
+ *
+ * @returns number of entries written to s->batch_send
+ */
+static int udp_batch_prepare_gso(socket_udp *s, int first, int *first_pkt)
+{
+        int nr_msgs = 0;
+        int i = first;
+        while (i < s->batch_count) {
+                struct msghdr *msg = &s->batch_send[nr_msgs].msg_hdr;
+                *msg = s->batch_msgs[i].msg_hdr;
+                first_pkt[nr_msgs] = i;
+                size_t seg_len = udp_msg_len(msg);
+                size_t total = seg_len;
+                int segments = 1;
+                i += 1;
+                while (i < s->batch_count && segments < UDP_GSO_MAX_SEGMENTS) {
+                        size_t len = udp_msg_len(&s->batch_msgs[i].msg_hdr);
+                        if (len > seg_len || total + len > UDP_GSO_MAX_BYTES) {
+                                break;
+                        }
+                        // iovecs are stored contiguously so we just extend the range
+                        msg->msg_iovlen += s->batch_msgs[i].msg_hdr.msg_iovlen;
+                        total += len;
+                        segments += 1;
+                        i += 1;
+                        if (len < seg_len) { // only the last segment may be shorter
+                                break;
+                        }
+                }
+                if (segments > 1) {
+                        char *cbuf = s->batch_cmsg + nr_msgs * CMSG_SPACE(sizeof(uint16_t));
+                        msg->msg_control = cbuf;
+                        msg->msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+                        struct cmsghdr *cm = CMSG_FIRSTHDR(msg);
+                        cm->cmsg_level = SOL_UDP;
+                        cm->cmsg_type = UDP_SEGMENT;
+                        cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                        uint16_t gso_size = seg_len;
+                        memcpy(CMSG_DATA(cm), &gso_size, sizeof gso_size);
+                }
+                nr_msgs += 1;
+        }
+        return nr_msgs;
+}
+
+/**
+ * Sends all packets queued by udp_batch_enqueue() with as few syscalls as
+ * possible.
+ */
+static void udp_batch_flush(socket_udp *s)
+{
+        int sent = 0; // packets
+        while (sent < s->batch_count) {
+                int first_pkt[s->batch_max + 1];
+                int nr_msgs;
+                struct mmsghdr *msgs;
+                if (s->local->send_gso) {
+                        nr_msgs = udp_batch_prepare_gso(s, sent, first_pkt);
+                        first_pkt[nr_msgs] = s->batch_count;
+                        msgs = s->batch_send;
+                } else {
+                        nr_msgs = s->batch_count - sent;
+                        msgs = s->batch_msgs + sent;
+                }
+                int ret = sendmmsg(s->local->fd, msgs, nr_msgs, 0);
+                if (ret < 0) {
+                        if (s->local->send_gso && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT)) {
+                                log_msg(LOG_LEVEL_WARNING, "[NET UDP] UDP segmentation offload not supported, disabling.\n");
+                                s->local->send_gso = false;
+                                continue;
+                        }
+                        socket_error("sendmmsg");
+                        break;
+                }
+                sent = s->local->send_gso ? first_pkt[ret] : sent + ret;
+        }
+
+        for (int i = 0; i < s->batch_count; ++i) {
+                free(s->dispose_udata[i]);
+        }
+        s->batch_count = 0;
+        s->batch_iov_count = 0;
+}
+#endif // defined HAVE_SENDMMSG
+
 int udp_sendv(socket_udp * s, struct iovec *vector, int count, void *d)
 {
         struct msghdr msg;
 
         assert(s != NULL);
 
+#ifdef HAVE_SENDMMSG
+        if (s->batching_active) {
+                return udp_batch_enqueue(s, vector, count, d);
+        }
+#endif
+
         msg.msg_name = (void *) & s->sock;
         msg.msg_namelen = s->sock_len;
         msg.msg_iov = vector;
@@ -985,13 +1215,97 @@ int udp_sendv(socket_udp * s, struct iovec *vector, int count, void *d)
 }
 #endif // WIN32
 
+static void udp_packet_pool_release(struct udp_packet_pool *pool)
+{
+        if (--pool->refcount == 0) {
+                delete pool;
+        }
+}
+
+/**
+ * Returns buffer for a received packet of UDP_PACKET_BUF_LEN bytes. The buffer
+ * must be freed with udp_packet_free().
+ *
+ * @note
+ * Must be called only from one thread for given socket (see udp_packet_pool)
+ */
+void *udp_packet_alloc(socket_udp *s)
+{
+        struct udp_packet_pool *pool = s->local->pool;
+
+        if (pool->free_list == nullptr) {
+                pool->free_list = pool->returned.exchange(nullptr);
+        }
+        if (pool->free_list == nullptr && pool->chunks.size() * UDP_POOL_CHUNK < pool->max_buffers) {
+                struct udp_packet_buf *chunk = new udp_packet_buf[UDP_POOL_CHUNK];
+                for (int i = 0; i < UDP_POOL_CHUNK; ++i) {
+                        chunk[i].pool = pool;
+                        chunk[i].next = i + 1 < UDP_POOL_CHUNK ? &chunk[i + 1] : nullptr;
+                }
+                pool->chunks.push_back(chunk);
+                pool->free_list = chunk;
+        }
+
+        struct udp_packet_buf *buf = pool->free_list;
+        if (buf != nullptr) {
+                pool->free_list = buf->next;
+                ++pool->refcount;
+        } else {
+                if (!pool->exhausted_reported) {
+                        log_msg(LOG_LEVEL_WARNING, "[NET UDP] Receive buffer pool exhausted (%u buffers), "
+                                        "consider increasing udp-pool-size.\n", pool->max_buffers);
+                        pool->exhausted_reported = true;
+                }
+                buf = (struct udp_packet_buf *) malloc(sizeof(struct udp_packet_buf));
+                buf->pool = nullptr;
+        }
+
+        return buf->data;
+}
+
+/**
+ * Frees buffer obtained from udp_packet_alloc() or received with udp_recv_data().
+ * May be called from any thread.
+ */
+void udp_packet_free(void *packet)
+{
+        if (packet == nullptr) {
+                return;
+        }
+
+        struct udp_packet_buf *buf = (struct udp_packet_buf *) ((char *) packet - offsetof(struct udp_packet_buf, data));
+        struct udp_packet_pool *pool = buf->pool;
+        if (pool == nullptr) {
+                free(buf);
+                return;
+        }
+
+        buf->next = pool->returned.load(std::memory_order_relaxed);
+        while (!pool->returned.compare_exchange_weak(buf->next, buf,
+                                std::memory_order_release, std::memory_order_relaxed))
+                ;
+        udp_packet_pool_release(pool);
+}
+
 /**
  * When receiving data in separate thread, this function fetches data
  * from socket and puts it in queue.
+ *
+ * If supported, packets are received in batches with recvmmsg() directly
+ * into buffers taken from the socket pool and handed over to the lock-free
+ * queue. Consumer is woken up at most once per batch. If the queue is full,
+ * packets are dropped (and counted, see udp_get_recv_queue_stats()).
  */
 static void *udp_reader(void *arg)
 {
         socket_udp *s = (socket_udp *) arg;
+#ifdef HAVE_RECVMMSG
+        const int batch = std::min<int>(UDP_READER_BATCH, s->local->max_packets);
+#else
+        const int batch = 1;
+#endif
+        uint8_t *packets[UDP_READER_BATCH] = {};
+        int sizes[UDP_READER_BATCH];
 
         while (1) {
                 fd_set fds;
@@ -1008,14 +1322,39 @@ static void *udp_reader(void *arg)
                 if (FD_ISSET(s->local->should_exit_fd[0], &fds)) {
                         break;
                 }
-                uint8_t *packet = (uint8_t *) malloc(RTP_MAX_PACKET_LEN);
-                uint8_t *buffer = ((uint8_t *) packet) + RTP_PACKET_HEADER_SIZE;
+                for (int i = 0; i < batch; ++i) {
+                        if (packets[i] == NULL) {
+                                packets[i] = (uint8_t *) udp_packet_alloc(s);
+                        }
+                }
 
-                int size = recvfrom(s->local->fd, (char *) buffer,
+#ifdef HAVE_RECVMMSG
+                struct mmsghdr msgs[UDP_READER_BATCH];
+                struct iovec iov[UDP_READER_BATCH];
+                for (int i = 0; i < batch; ++i) {
+                        iov[i].iov_base = packets[i] + RTP_PACKET_HEADER_SIZE;
+                        iov[i].iov_len = RTP_MAX_PACKET_LEN - RTP_PACKET_HEADER_SIZE;
+                        memset(&msgs[i].msg_hdr, 0, sizeof msgs[i].msg_hdr);
+                        msgs[i].msg_hdr.msg_iov = &iov[i];
+                        msgs[i].msg_hdr.msg_iovlen = 1;
+                }
+                int count = recvmmsg(s->local->fd, msgs, batch, MSG_DONTWAIT, NULL);
+                if (count <= 0) {
+                        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                                socket_error("recvmmsg");
+                        }
+                        continue;
+                }
+                for (int i = 0; i < count; ++i) {
+                        sizes[i] = msgs[i].msg_len;
+                }
+#else
+                int count = 1;
+                sizes[0] = recvfrom(s->local->fd, (char *) packets[0] + RTP_PACKET_HEADER_SIZE,
                                 RTP_MAX_PACKET_LEN - RTP_PACKET_HEADER_SIZE,
                                 0, 0, 0);
 
-                if (size <= 0) {
+                if (sizes[0] <= 0) {
                         /// @todo
                         /// In MSW, this block is called as often as packet is sent if
                         /// we got WSAECONNRESET error (noone is listening). This can have
@@ -1023,20 +1362,20 @@ static void *udp_reader(void *arg)
                         socket_error("recvfrom");
                         continue;
                 }
+#endif
 
-                unique_lock<mutex> lk(s->local->lock);
-                s->local->reader_cv.wait(lk, [s]{return s->local->packets.size() < s->local->max_packets || s->local->should_exit;});
-                if (s->local->should_exit) {
-                        free(packet);
-                        break;
+                for (int i = 0; i < count; ++i) {
+                        // if the queue is full, the buffer is reused for next packet
+                        if (sizes[i] > 0 && s->local->packets->push(item(packets[i], sizes[i]))) {
+                                packets[i] = NULL;
+                        }
                 }
-
-                s->local->packets.emplace(packet, size);
-
-                lk.unlock();
-                s->local->boss_cv.notify_one();
+                s->local->packets->notify();
         }
 
+        for (int i = 0; i < batch; ++i) {
+                udp_packet_free(packets[i]);
+        }
         platform_pipe_close(s->local->should_exit_fd[0]);
 
         return NULL;
@@ -1090,15 +1429,7 @@ bool udp_not_empty(socket_udp * s, struct timeval *timeout)
 {
         assert(s->local->multithreaded);
 
-        unique_lock<mutex> lk(s->local->lock);
-        if (timeout) {
-                std::chrono::microseconds tmout_us =
-                        std::chrono::microseconds(timeout->tv_sec * 1000000ll + timeout->tv_usec);
-                s->local->boss_cv.wait_for(lk, tmout_us, [s]{return !s->local->packets.empty();});
-        } else {
-                s->local->boss_cv.wait(lk, [s]{return !s->local->packets.empty();});
-        }
-        return !s->local->packets.empty();
+        return s->local->packets->wait_not_empty(timeout ? timeout->tv_sec * 1000000ll + timeout->tv_usec : -1);
 }
 
 /**
@@ -1129,24 +1460,34 @@ int udp_recvfrom(socket_udp *s, char *buffer, int buflen, struct sockaddr *src_a
  * Receives data from multithreaded socket.
  *
  * @param[in] s       UDP socket state
- * @param[out] buffer data received from socket. Must be freed by caller!
+ * @param[out] buffer data received from socket. Must be freed by caller with udp_packet_free()!
  * @returns           length of the received datagram
  */
 int udp_recv_data(socket_udp * s, char **buffer)
 {
         assert(s->local->multithreaded);
-        int ret;
-        unique_lock<mutex> lk(s->local->lock);
 
-        auto it = s->local->packets.front();
+        struct item it;
+        if (!s->local->packets->pop(it)) {
+                *buffer = NULL;
+                return 0;
+        }
         *buffer = (char *) it.buf;
-        ret = it.size;
-        s->local->packets.pop();
+        return it.size;
+}
 
-        lk.unlock();
-        s->local->reader_cv.notify_one();
+/**
+ * Returns statistics of the receive queue of multithreaded socket so that
+ * it can be sized (udp-queue-len).
+ */
+void udp_get_recv_queue_stats(socket_udp *s, struct udp_recv_queue_stats *stats)
+{
+        assert(s->local->multithreaded);
 
-        return ret;
+        stats->capacity = s->local->packets->capacity();
+        stats->occupancy = s->local->packets->size();
+        stats->max_occupancy = s->local->packets->max_occupancy();
+        stats->dropped = s->local->packets->dropped();
 }
 
 #ifndef WIN32
@@ -1352,6 +1693,27 @@ int udp_set_send_buf(socket_udp *s, int size)
         return TRUE;
 }
 
+/**
+ * Overrides the sendmmsg() batch size given by the "udp-send-batch" param for
+ * this socket (0 or 1 disables batching). Used by tools that always send
+ * multiple packets at once, eg. the hd-rum-translator reflector.
+ *
+ * @retval TRUE  batching is supported and was set
+ * @retval FALSE sendmmsg() is not available, udp_async_start() returns 1
+ */
+int udp_set_send_batch(socket_udp *s, int packets)
+{
+#ifdef HAVE_SENDMMSG
+        assert(!s->batching_active);
+        s->local->send_batch = max(packets, 0);
+        return TRUE;
+#else
+        UNUSED(s);
+        UNUSED(packets);
+        return FALSE;
+#endif
+}
+
 /*
  * TODO: This should be definitely removed. We need to solve audio burst avoidance first.
  */
@@ -1384,12 +1746,18 @@ void udp_flush_recv_buf(socket_udp *s)
  * By calling this function under MSW, caller indicates that following packets
  * can be send in asynchronous manner. Caller should then call udp_async_wait()
  * to ensure that all packets were actually sent.
+ *
+ * Under Linux, if udp-send-batch is set, packets are queued and sent in batches
+ * with sendmmsg() (optionally using GSO), either when the batch is full or on
+ * udp_async_flush()/udp_async_wait().
+ *
+ * @returns number of packets that are sent together (1 if not batching)
  */
-void udp_async_start(socket_udp *s, int nr_packets)
+int udp_async_start(socket_udp *s, int nr_packets)
 {
 #ifdef WIN32
         if (!s->local->is_wsa_overlapped) {
-                return;
+                return 1;
         }
 
         if (nr_packets > s->overlapped_max) {
@@ -1406,9 +1774,47 @@ void udp_async_start(socket_udp *s, int nr_packets)
 
         s->overlapped_count = 0;
         s->overlapping_active = true;
+#elif defined HAVE_SENDMMSG
+        if (s->local->send_batch <= 1) {
+                return 1;
+        }
+
+        int batch = std::min(nr_packets, s->local->send_batch);
+        if (batch > s->batch_max) {
+                s->batch_msgs = (struct mmsghdr *) realloc(s->batch_msgs, batch * sizeof(struct mmsghdr));
+                s->batch_send = (struct mmsghdr *) realloc(s->batch_send, batch * sizeof(struct mmsghdr));
+                s->batch_iov = (struct iovec *) realloc(s->batch_iov, batch * UDP_BATCH_MAX_IOV * sizeof(struct iovec));
+                s->batch_cmsg = (char *) realloc(s->batch_cmsg, batch * CMSG_SPACE(sizeof(uint16_t)));
+                s->dispose_udata = (void **) realloc(s->dispose_udata, batch * sizeof(void *));
+                memset(s->batch_send, 0, batch * sizeof(struct mmsghdr));
+        }
+        s->batch_max = batch;
+        s->batch_count = 0;
+        s->batch_iov_count = 0;
+        s->batching_active = true;
+        return batch;
 #else
         UNUSED(nr_packets);
         UNUSED(s);
+#endif
+        return 1;
+}
+
+/**
+ * Sends packets queued since udp_async_start() or last udp_async_flush() call
+ * so that caller can pace transmission by whole batches.
+ *
+ * @note
+ * Under MSW, this is no-op, sending is managed by the OS.
+ */
+void udp_async_flush(socket_udp *s)
+{
+#ifdef HAVE_SENDMMSG
+        if (s->batching_active && s->batch_count > 0) {
+                udp_batch_flush(s);
+        }
+#else
+        UNUSED(s);
 #endif
 }
 
@@ -1434,6 +1840,11 @@ void udp_async_wait(socket_udp *s)
                 free(s->dispose_udata[i]);
         }
         s->overlapping_active = false;
+#elif defined HAVE_SENDMMSG
+        if (!s->batching_active)
+                return;
+        udp_async_flush(s);
+        s->batching_active = false;
 #else
         UNUSED(s);
 #endif
@@ -1448,6 +1859,12 @@ static void udp_clean_async_state(socket_udp *s)
         free(s->overlapped);
         free(s->overlapped_events);
         free(s->dispose_udata);
+#elif defined HAVE_SENDMMSG
+        free(s->batch_msgs);
+        free(s->batch_send);
+        free(s->batch_iov);
+        free(s->batch_cmsg);
+        free(s->dispose_udata);
 #else
         UNUSED(s);
 #endif
@@ -1568,9 +1985,9 @@ int udp_recv_timeout(socket_udp *s, char *buffer, int buflen, struct timeval *ti
                         char *data = NULL;
                         len = udp_recv_data(s, (char **) &data);
                         if (len > 0) {
-                                memcpy(buffer, data, len);
+                                memcpy(buffer, data + RTP_PACKET_HEADER_SIZE, len);
                         }
-                        free(data);
+                        udp_packet_free(data);
                 }
         } else {
                 udp_fd_zero_r(&fd);
@@ -65,7 +65,8 @@ int         udp_send(socket_udp *s, char *buffer, int buflen);
 int         udp_sendto(socket_udp *s, char *buffer, int buflen, struct sockaddr *dst_addr, socklen_t addrlen);
 
 int         udp_recvv(socket_udp *s, struct msghdr *m);
-void        udp_async_start(socket_udp *s, int nr_packets);
+int         udp_async_start(socket_udp *s, int nr_packets);
+void        udp_async_flush(socket_udp *s);
 void        udp_async_wait(socket_udp *s);
 #ifdef WIN32
 int         udp_sendv(socket_udp *s, LPWSABUF vector, int count, void *d);
@@ -83,6 +84,7 @@ int         udp_fd_isset(socket_udp *s);
 
 int         udp_set_recv_buf(socket_udp *s, int size);
 int         udp_set_send_buf(socket_udp *s, int size);
+int         udp_set_send_batch(socket_udp *s, int packets);
 void        udp_flush_recv_buf(socket_udp *s);
 
 struct udp_fd_r {
@@ -95,7 +97,17 @@ void	    udp_fd_zero_r(struct udp_fd_r *);
 void        udp_fd_set_r(socket_udp *s, struct udp_fd_r *);
 int         udp_fd_isset_r(socket_udp *s, struct udp_fd_r *);
 
+struct udp_recv_queue_stats {
+        unsigned int capacity;
+        unsigned int occupancy;
+        unsigned int max_occupancy;     ///< high-water mark
+        unsigned long long dropped;     ///< packets dropped because the queue was full
+};
+
 int         udp_recv_data(socket_udp * s, char **buffer);
+void        udp_get_recv_queue_stats(socket_udp *s, struct udp_recv_queue_stats *stats);
+void       *udp_packet_alloc(socket_udp *s);
+void        udp_packet_free(void *packet);
 bool        udp_not_empty(socket_udp *s, struct timeval *timeout);
 int         udp_port_pair_is_free(const char *addr, int force_ip_version, int even_port);
 bool        udp_is_ipv6(socket_udp *s);
@@ -0,0 +1,117 @@
+/**
+ * @file   rtp/packet_coverage.h
+ * @brief  Run-length record of received byte ranges of a buffer
+ */
+/*
+ * Copyright (c) 2018 CESNET z.s.p.o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PACKET_COVERAGE_H_
+#define PACKET_COVERAGE_H_
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Records which parts of a (frame) buffer have been received
+ *
+ * Data are kept as a sorted array of disjoint runs <offset, length> where
+ * adjacent runs are merged on insertion. Without packet loss the whole buffer
+ * is thus represented by a single run, every loss adds one run. Packets
+ * arriving in order (either ascending or descending) are added in O(1).
+ *
+ * The runs can be passed directly to FEC decoders (it is the valid_data_t
+ * type of LDGM library).
+ */
+class packet_coverage {
+public:
+        typedef std::vector<std::pair<int, int> > runs_t;
+
+        packet_coverage() {
+                m_runs.reserve(INITIAL_RUNS);
+        }
+
+        /// Adds received interval [offset, offset + len)
+        void add(int offset, int len) {
+                if (len <= 0) {
+                        return;
+                }
+                int end = offset + len;
+                // first run that ends at or after offset (can be merged with)
+                auto first = std::lower_bound(m_runs.begin(), m_runs.end(), offset,
+                                [](std::pair<int, int> const & run, int off) { return run.first + run.second < off; });
+                auto last = first;
+                int new_start = offset;
+                int new_end = end;
+                while (last != m_runs.end() && last->first <= end) {
+                        new_start = std::min(new_start, last->first);
+                        new_end = std::max(new_end, last->first + last->second);
+                        m_bytes -= last->second;
+                        ++last;
+                }
+                m_bytes += new_end - new_start;
+                if (first == last) {
+                        m_runs.insert(first, std::make_pair(new_start, new_end - new_start));
+                } else {
+                        *first = std::make_pair(new_start, new_end - new_start);
+                        m_runs.erase(first + 1, last);
+                }
+        }
+
+        /// @returns true if interval [offset, offset + len) was completely received
+        bool covers(int offset, int len) const {
+                auto it = std::upper_bound(m_runs.begin(), m_runs.end(), offset,
+                                [](int off, std::pair<int, int> const & run) { return off < run.first; });
+                if (it == m_runs.begin()) {
+                        return false;
+                }
+                --it;
+                return it->first + it->second >= offset + len;
+        }
+
+        void clear() {
+                m_runs.clear();
+                m_bytes = 0;
+        }
+
+        runs_t const & runs() const { return m_runs; }
+        /// @returns number of received bytes
+        int bytes() const { return m_bytes; }
+
+private:
+        static constexpr int INITIAL_RUNS = 16;
+        runs_t m_runs;
+        int m_bytes = 0;
+};
+
+#endif // PACKET_COVERAGE_H_
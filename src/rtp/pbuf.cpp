@@ -63,17 +63,33 @@
 #include "rtp/ptime.h"
 #include "rtp/pbuf.h"
 
+#include <utility>
+#include <vector>
+
 #define PBUF_MAGIC	0xcafebabe
 
 #define STATS_INTERVAL 100
 
+#define PBUF_INITIAL_FRAME_SLOTS 16   ///< must be power of two
+#define PBUF_INITIAL_FRAME_PKTS 1024  ///< must be power of two
+#define PBUF_MAX_FRAME_PKTS (1<<15)   ///< half of the RTP sequence number space
+
+/**
+ * Frame slot. Slots are kept in a ring (struct pbuf::frames) and reused,
+ * packets are stored in the pkts index at position seqno & (pkts.size() - 1),
+ * so insertion is O(1) regardless of packet order. The index grows when
+ * a frame spans more sequence numbers than it can hold and the grown
+ * storage is kept for subsequent frames.
+ */
 struct pbuf_node {
-        struct pbuf_node *nxt;
-        struct pbuf_node *prv;
         uint32_t rtp_timestamp; /* RTP timestamp for the frame           */
         std::chrono::high_resolution_clock::time_point arrival_time;    /* Arrival time of first packet in frame */
         std::chrono::high_resolution_clock::time_point playout_time;    /* Playout time for the frame            */
-        struct coded_data *cdata;       /*                                       */
+        std::vector<struct coded_data> pkts; ///< packet index keyed by sequence number
+        uint16_t first_seq;     ///< lowest sequence number seen
+        uint16_t last_seq;      ///< highest sequence number seen
+        int pkt_count;          ///< number of packets stored in pkts
+        struct coded_data *cdata; ///< packets linked in descending seqno order, NULL if empty
         int decoded;            /* Non-zero if we've decoded this frame  */
         int mbit;               /* determines if mbit of frame had been seen */
         uint32_t magic;         /* For debugging                         */
@@ -81,76 +97,73 @@ struct pbuf_node {
 };
 
 struct pbuf {
-        struct pbuf_node *frst;
-        struct pbuf_node *last;
+        std::vector<struct pbuf_node> frames; ///< ring of frame slots, ordered by RTP timestamp
+        unsigned int frst = 0;  ///< index of the oldest frame in frames
+        unsigned int count = 0; ///< number of frames in the buffer
         long long int playout_delay_us;
         volatile int *offset_ms;
 
         // for statistics
         /// @todo figure out packet duplication
-        int pkt_count[2]; // first buffer is for last_report_seq + STATS_INTERVAL
+        int pkt_count[2] = {}; // first buffer is for last_report_seq + STATS_INTERVAL
                           // second for last_report_seq + 2 * STATS_INTERVAL
         int last_report_seq;
-        int received_pkts, expected_pkts; // currently computed values
-        int received_pkts_last, expected_pkts_last; // values for last interval
-        long long int received_pkts_cum, expected_pkts_cum; // cumulative values
+        int received_pkts = 0, expected_pkts = 0; // currently computed values
+        int received_pkts_last = 0, expected_pkts_last = 0; // values for last interval
+        long long int received_pkts_cum = 0, expected_pkts_cum = 0; // cumulative values
         int last_rtp_seq;
-        uint32_t last_display_ts;
-        int longest_gap; // longest loss
+        uint32_t last_display_ts = 0;
+        int longest_gap = 0; // longest loss
 };
 
-static void free_cdata(struct coded_data *head);
+static void free_cdata(struct pbuf_node *frame);
 static int frame_complete(struct pbuf_node *frame);
 
 /*********************************************************************************/
 
+static inline struct pbuf_node *frame_at(struct pbuf *playout_buf, unsigned int i)
+{
+        return &playout_buf->frames[(playout_buf->frst + i) & (playout_buf->frames.size() - 1)];
+}
+
+static inline struct pbuf_node *last_frame(struct pbuf *playout_buf)
+{
+        return frame_at(playout_buf, playout_buf->count - 1);
+}
+
 static void pbuf_validate(struct pbuf *playout_buf)
 {
         /* Run through the entire playout buffer, checking pointers, etc.  */
         /* Only used in debugging mode, since it's a lot of overhead [csp] */
 #ifdef NDEF
-        struct pbuf_node *cpb, *ppb;
-        struct coded_data *ccd, *pcd;
-
-        cpb = playout_buf->frst;
-        ppb = NULL;
-        while (cpb != NULL) {
+        for (unsigned int i = 0; i < playout_buf->count; ++i) {
+                struct pbuf_node *cpb = frame_at(playout_buf, i);
                 assert(cpb->magic == PBUF_MAGIC);
-                assert(cpb->prv == ppb);
-                if (cpb->prv != NULL) {
-                        assert(cpb->prv->nxt == cpb);
+                if (i > 0) {
                         /* stored in RTP timestamp order */
-                        assert(cpb->rtp_timestamp > ppb->rtp_timestamp);
-                        /* stored in playout time order  */
-                        /* TODO: eventually check why is this assert always failng */
-                        // assert(tv_gt(cpb->ptime, ppb->ptime));  
-                }
-                if (cpb->nxt != NULL) {
-                        assert(cpb->nxt->prv == cpb);
-                } else {
-                        assert(cpb = playout_buf->last);
+                        assert(cpb->rtp_timestamp > frame_at(playout_buf, i - 1)->rtp_timestamp);
                 }
-                if (cpb->cdata != NULL) {
-                        /* We have coded data... check all the pointers on that list too */
-                        ccd = cpb->cdata;
-                        pcd = NULL;
-                        while (ccd != NULL) {
-                                assert(ccd->prv == pcd);
-                                if (ccd->prv != NULL) {
-                                        assert(ccd->prv->nxt == ccd);
-                                        /* list is descending - cant really check this now */
-                                        //assert(ccd->seqno < pcd->seqno); 
-                                        assert(ccd->data != NULL);
-                                }
-                                if (ccd->nxt != NULL) {
-                                        assert(ccd->nxt->prv == ccd);
-                                }
-                                pcd = ccd;
-                                ccd = ccd->nxt;
+                /* check that the packet index is consistent */
+                int pkt_count = 0;
+                unsigned int mask = cpb->pkts.size() - 1;
+                for (uint16_t seq = cpb->first_seq; ; ++seq) {
+                        struct coded_data *ccd = &cpb->pkts[seq & mask];
+                        if (ccd->data != NULL) {
+                                assert(ccd->seqno == seq);
+                                pkt_count += 1;
+                        }
+                        if (seq == cpb->last_seq) {
+                                break;
                         }
                 }
-                ppb = cpb;
-                cpb = cpb->nxt;
+                assert(pkt_count == cpb->pkt_count);
+                /* check that the linked list holds the same packets in descending order */
+                pkt_count = 0;
+                for (struct coded_data *ccd = cpb->cdata; ccd != NULL; ccd = ccd->nxt) {
+                        assert(ccd->nxt == NULL || (int16_t)(ccd->seqno - ccd->nxt->seqno) > 0);
+                        pkt_count += 1;
+                }
+                assert(pkt_count == cpb->pkt_count);
         }
 #else
         UNUSED(playout_buf);
@@ -159,22 +172,16 @@ static void pbuf_validate(struct pbuf *playout_buf)
 
 struct pbuf *pbuf_init(volatile int *delay_ms)
 {
-        struct pbuf *playout_buf = NULL;
-
-        playout_buf = (struct pbuf *) calloc(1, sizeof(struct pbuf));
-        if (playout_buf != NULL) {
-                playout_buf->frst = NULL;
-                playout_buf->last = NULL;
-                /* Playout delay... should really be adaptive, based on the */
-                /* jitter, but we use a (conservative) fixed 32ms delay for */
-                /* now (2 video frames at 60fps).                           */
-                playout_buf->offset_ms = delay_ms;
-                playout_buf->playout_delay_us = 0.032 * 1000 * 1000;
-                playout_buf->last_rtp_seq = -1;
-                playout_buf->last_report_seq = -1;
-        } else {
-                debug_msg("Failed to allocate memory for playout buffer\n");
-        }
+        struct pbuf *playout_buf = new pbuf();
+
+        playout_buf->frames.resize(PBUF_INITIAL_FRAME_SLOTS);
+        /* Playout delay... should really be adaptive, based on the */
+        /* jitter, but we use a (conservative) fixed 32ms delay for */
+        /* now (2 video frames at 60fps).                           */
+        playout_buf->offset_ms = delay_ms;
+        playout_buf->playout_delay_us = 0.032 * 1000 * 1000;
+        playout_buf->last_rtp_seq = -1;
+        playout_buf->last_report_seq = -1;
         return playout_buf;
 }
 
@@ -191,123 +198,208 @@ void pbuf_destroy(struct pbuf *playout_buf) {
                                         playout_buf->expected_pkts_cum * 100.0);
                 }
 
-                struct pbuf_node *curr = playout_buf->frst;
-                while (curr != NULL) {
-                        struct pbuf_node *temp = curr->nxt;
-                        if (curr == playout_buf->frst) {
-                                playout_buf->frst = curr->nxt;
-                        }
-                        if (curr == playout_buf->last) {
-                                playout_buf->last = curr->prv;
-                        }
-                        if (curr->nxt != NULL) {
-                                curr->nxt->prv = curr->prv;
-                        }
-                        if (curr->prv != NULL) {
-                                curr->prv->nxt = curr->nxt;
+                for (unsigned int i = 0; i < playout_buf->count; ++i) {
+                        free_cdata(frame_at(playout_buf, i));
+                }
+                delete playout_buf;
+        }
+}
+
+/**
+ * Enlarges packet index of the frame to hold at least span consecutive
+ * sequence numbers.
+ */
+static bool grow_pkt_index(struct pbuf_node *node, unsigned int span)
+{
+        if (span > PBUF_MAX_FRAME_PKTS) {
+                return false;
+        }
+        size_t new_size = node->pkts.size();
+        while (new_size < span) {
+                new_size *= 2;
+        }
+        std::vector<struct coded_data> pkts(new_size);
+        unsigned int old_mask = node->pkts.size() - 1;
+        for (uint16_t seq = node->first_seq; ; ++seq) {
+                pkts[seq & (new_size - 1)] = node->pkts[seq & old_mask];
+                if (seq == node->last_seq) {
+                        break;
+                }
+        }
+        node->pkts = std::move(pkts);
+        return true;
+}
+
+/**
+ * Links all packets of the frame into the list passed to decoders. The list
+ * is stored in descending order of sequence numbers (the packet with the
+ * M bit comes first). Needed only when the packet index has been moved,
+ * otherwise the list is kept up to date by link_packet().
+ */
+static void relink_cdata(struct pbuf_node *frame)
+{
+        frame->cdata = NULL;
+        unsigned int mask = frame->pkts.size() - 1;
+        struct coded_data *prv = NULL;
+        for (uint16_t seq = frame->last_seq; ; --seq) {
+                struct coded_data *curr = &frame->pkts[seq & mask];
+                if (curr->data != NULL) {
+                        curr->prv = prv;
+                        curr->nxt = NULL;
+                        if (prv != NULL) {
+                                prv->nxt = curr;
+                        } else {
+                                frame->cdata = curr;
                         }
-                        free_cdata(curr->cdata);
-                        delete curr;
-                        curr = temp;
+                        prv = curr;
+                }
+                if (seq == frame->first_seq) {
+                        break;
                 }
-                free(playout_buf);
         }
 }
 
+/**
+ * Inserts a newly stored packet into the frame's list. Packets arriving in
+ * order are prepended in O(1), otherwise the nearest following packet is
+ * looked up in the index.
+ */
+static void link_packet(struct pbuf_node *node, struct coded_data *entry)
+{
+        if (entry->seqno == node->last_seq) { // highest seqno - goes first
+                entry->prv = NULL;
+                entry->nxt = node->cdata;
+                if (node->cdata != NULL) {
+                        node->cdata->prv = entry;
+                }
+                node->cdata = entry;
+                return;
+        }
+
+        unsigned int mask = node->pkts.size() - 1;
+        uint16_t seq = entry->seqno + 1;
+        while (node->pkts[seq & mask].data == NULL) { // terminates at last_seq
+                ++seq;
+        }
+        struct coded_data *following = &node->pkts[seq & mask];
+        entry->prv = following;
+        entry->nxt = following->nxt;
+        if (following->nxt != NULL) {
+                following->nxt->prv = entry;
+        }
+        following->nxt = entry;
+}
+
 static void add_coded_unit(struct pbuf_node *node, rtp_packet * pkt)
 {
         /* Add "pkt" to the frame represented by "node". The "node" has    */
         /* previously been created, and has some coded data already...     */
 
-        /* New arrivals are added at the head of the list, which is stored */
-        /* in descending order of packets as they arrive (NOT necessarily  */
-        /* descending sequence number order, as the network might reorder) */
-
-        struct coded_data *tmp, *curr, *prv;
-
         assert(node->rtp_timestamp == pkt->ts);
-        assert(node->cdata != NULL);
 
-        tmp = (struct coded_data *) malloc(sizeof(struct coded_data));
-        if (tmp == NULL) {
-                /* this is bad, out of memory, drop the packet... */
-                free(pkt);
+        uint16_t first_seq = (int16_t)(pkt->seq - node->first_seq) < 0 ? pkt->seq : node->first_seq;
+        uint16_t last_seq = (int16_t)(pkt->seq - node->last_seq) > 0 ? pkt->seq : node->last_seq;
+        unsigned int span = (uint16_t)(last_seq - first_seq) + 1u;
+        bool moved = false;
+        if (span > node->pkts.size()) {
+                if (!grow_pkt_index(node, span)) {
+                        /* the frame is too long (or the packet is a stray one), drop it... */
+                        rtp_packet_free(pkt);
+                        return;
+                }
+                moved = true;
+        }
+
+        struct coded_data *entry = &node->pkts[pkt->seq & (node->pkts.size() - 1)];
+        if (entry->data != NULL) {
+                /* duplicate packet */
+                rtp_packet_free(pkt);
                 return;
         }
 
-        tmp->seqno = pkt->seq;
-        tmp->data = pkt;
+        entry->seqno = pkt->seq;
+        entry->data = pkt;
+        node->first_seq = first_seq;
+        node->last_seq = last_seq;
+        node->pkt_count += 1;
         node->mbit |= pkt->m;
-        if((int16_t)(tmp->seqno - node->cdata->seqno) > 0){
-                tmp->prv = NULL;
-                tmp->nxt = node->cdata;
-                node->cdata->prv = tmp;
-                node->cdata = tmp;
+        if (moved) {
+                relink_cdata(node);
         } else {
-                curr = node->cdata;
-                if (curr == NULL){
-                        /* this is bad, out of memory, drop the packet... */
-                        free(pkt);
-                        free(tmp);
-                } else {
-                        while (curr != NULL &&  ((int16_t)(tmp->seqno - curr->seqno) < 0)){
-                                prv = curr;
-                                curr = curr->nxt;
-                        }
-                        if (curr == NULL) {
-                                tmp->nxt = NULL;
-                                tmp->prv = prv;
-                                prv->nxt = tmp;
-                        }else if ((int16_t)(tmp->seqno - curr->seqno) > 0){
-                                tmp->nxt = curr;
-                                tmp->prv = curr->prv;
-                                tmp->prv->nxt = tmp;
-                                curr->prv = tmp;
-                        } else {
-                                /* this is bad, something went terribly wrong... */
-                                free(pkt);
-                                free(tmp);
-                        }
-                }
+                link_packet(node, entry);
         }
 }
 
-static struct pbuf_node *create_new_pnode(rtp_packet * pkt, long long playout_delay_us)
+/**
+ * Initializes (possibly reused) frame slot with its first packet.
+ */
+static void init_pnode(struct pbuf_node *node, rtp_packet * pkt, long long playout_delay_us)
 {
-        struct pbuf_node *tmp;
-
         perf_record(UVP_CREATEPBUF, pkt->ts);
 
-        tmp = new struct pbuf_node();
-        if (tmp != NULL) {
-                tmp->magic = PBUF_MAGIC;
-                tmp->rtp_timestamp = pkt->ts;
-                tmp->mbit = pkt->m;
-                tmp->playout_time =
-                        tmp->arrival_time = std::chrono::high_resolution_clock::now();
-                tmp->playout_time += std::chrono::microseconds(playout_delay_us);
-
-                tmp->cdata = (struct coded_data *) malloc(sizeof(struct coded_data));
-                if (tmp->cdata != NULL) {
-                        tmp->cdata->nxt = NULL;
-                        tmp->cdata->prv = NULL;
-                        tmp->cdata->seqno = pkt->seq;
-                        tmp->cdata->data = pkt;
+        node->magic = PBUF_MAGIC;
+        node->rtp_timestamp = pkt->ts;
+        node->mbit = pkt->m;
+        node->decoded = 0;
+        node->completed = false;
+        node->playout_time =
+                node->arrival_time = std::chrono::high_resolution_clock::now();
+        node->playout_time += std::chrono::microseconds(playout_delay_us);
+
+        if (node->pkts.empty()) {
+                node->pkts.resize(PBUF_INITIAL_FRAME_PKTS);
+        }
+        struct coded_data *entry = &node->pkts[pkt->seq & (node->pkts.size() - 1)];
+        entry->seqno = pkt->seq;
+        entry->data = pkt;
+        entry->nxt = entry->prv = NULL;
+        node->first_seq = node->last_seq = pkt->seq;
+        node->pkt_count = 1;
+        node->cdata = entry;
+}
+
+/**
+ * Appends a new frame slot at the end of the ring, the ring is enlarged if full.
+ */
+static struct pbuf_node *append_pnode(struct pbuf *playout_buf)
+{
+        if (playout_buf->count == playout_buf->frames.size()) {
+                std::vector<struct pbuf_node> frames(playout_buf->frames.size() * 2);
+                for (unsigned int i = 0; i < playout_buf->count; ++i) {
+                        // moving keeps packet index storage (and thus cdata pointers) intact
+                        frames[i] = std::move(*frame_at(playout_buf, i));
+                }
+                playout_buf->frames = std::move(frames);
+                playout_buf->frst = 0;
+        }
+        playout_buf->count += 1;
+        return last_frame(playout_buf);
+}
+
+/**
+ * Binary search for the frame with given RTP timestamp.
+ * @returns frame or NULL if there isn't any
+ */
+static struct pbuf_node *find_frame(struct pbuf *playout_buf, uint32_t ts)
+{
+        unsigned int lo = 0, hi = playout_buf->count;
+        while (lo < hi) {
+                unsigned int mid = lo + (hi - lo) / 2;
+                struct pbuf_node *curr = frame_at(playout_buf, mid);
+                if (curr->rtp_timestamp == ts) {
+                        return curr;
+                }
+                if (curr->rtp_timestamp < ts) {
+                        lo = mid + 1;
                 } else {
-                        free(pkt);
-                        delete tmp;
-                        return NULL;
+                        hi = mid;
                 }
-        } else {
-                free(pkt);
         }
-        return tmp;
+        return NULL;
 }
 
 void pbuf_insert(struct pbuf *playout_buf, rtp_packet * pkt)
 {
-        struct pbuf_node *tmp;
-
         pbuf_validate(playout_buf);
 
         // collect statistics
@@ -364,39 +456,35 @@ void pbuf_insert(struct pbuf *playout_buf, rtp_packet * pkt)
                 playout_buf->longest_gap = 0;
         }
 
-        if (playout_buf->frst == NULL && playout_buf->last == NULL) {
+        long long playout_delay_us = playout_buf->playout_delay_us + 1000 * (playout_buf->offset_ms ? *playout_buf->offset_ms : 0);
+
+        if (playout_buf->count == 0) {
                 /* playout buffer is empty - add new frame */
-                playout_buf->frst = create_new_pnode(pkt, playout_buf->playout_delay_us + 1000 * (playout_buf->offset_ms ? *playout_buf->offset_ms : 0));
-                playout_buf->last = playout_buf->frst;
+                init_pnode(append_pnode(playout_buf), pkt, playout_delay_us);
                 return;
         }
 
-        if (playout_buf->last->rtp_timestamp == pkt->ts) {
+        struct pbuf_node *last = last_frame(playout_buf);
+        if (last->rtp_timestamp == pkt->ts) {
                 /* Packet belongs to last frame in playout_buf this is the */
                 /* most likely scenario - although...                      */
-                add_coded_unit(playout_buf->last, pkt);
+                add_coded_unit(last, pkt);
         } else {
-                if (playout_buf->last->rtp_timestamp < pkt->ts) {
+                if (last->rtp_timestamp < pkt->ts) {
                         /* Packet belongs to a new frame... */
-                        tmp = create_new_pnode(pkt, playout_buf->playout_delay_us + 1000 * (playout_buf->offset_ms ? *playout_buf->offset_ms : 0));
-                        playout_buf->last->nxt = tmp;
-                        playout_buf->last->completed = true;
-                        tmp->prv = playout_buf->last;
-                        playout_buf->last = tmp;
+                        last->completed = true;
+                        init_pnode(append_pnode(playout_buf), pkt, playout_delay_us);
                 } else {
                         bool discard_pkt = false;
                         /* Packet belongs to a previous frame... */
-                        if (playout_buf->frst->rtp_timestamp > pkt->ts) {
+                        if (frame_at(playout_buf, 0)->rtp_timestamp > pkt->ts) {
                                 debug_msg("A very old packet - discarded\n");
                                 discard_pkt = true;
                         } else {
                                 debug_msg
                                     ("A packet for a previous frame, but might still be useful\n");
-                                struct pbuf_node *curr = playout_buf->last;
-                                while(curr != playout_buf->frst && curr->rtp_timestamp > pkt->ts){
-                                        curr = curr->prv;
-                                }
-                                if (curr->rtp_timestamp == pkt->ts) {
+                                struct pbuf_node *curr = find_frame(playout_buf, pkt->ts);
+                                if (curr != NULL) {
                                         /* Packet belongs to a previous existing frame... */
                                         add_coded_unit(curr, pkt);
                                 } else {
@@ -409,23 +497,34 @@ void pbuf_insert(struct pbuf *playout_buf, rtp_packet * pkt)
                                         debug_msg
                                                 ("Oops... dropped packet with M bit set\n");
                                 }
-                                free(pkt);
+                                rtp_packet_free(pkt);
                         }
                 }
         }
         pbuf_validate(playout_buf);
 }
 
-static void free_cdata(struct coded_data *head)
+/**
+ * Frees packets of the frame, the packet index is kept for reuse.
+ */
+static void free_cdata(struct pbuf_node *frame)
 {
-        struct coded_data *tmp;
-
-        while (head != NULL) {
-                free(head->data);
-                tmp = head;
-                head = head->nxt;
-                free(tmp);
+        if (frame->pkt_count == 0) {
+                return;
         }
+        unsigned int mask = frame->pkts.size() - 1;
+        for (uint16_t seq = frame->first_seq; ; ++seq) {
+                struct coded_data *curr = &frame->pkts[seq & mask];
+                if (curr->data != NULL) {
+                        rtp_packet_free(curr->data);
+                        curr->data = NULL;
+                }
+                if (seq == frame->last_seq) {
+                        break;
+                }
+        }
+        frame->pkt_count = 0;
+        frame->cdata = NULL;
 }
 
 void pbuf_remove(struct pbuf *playout_buf, std::chrono::high_resolution_clock::time_point const & curr_time)
@@ -434,28 +533,14 @@ void pbuf_remove(struct pbuf *playout_buf, std::chrono::high_resolution_clock::t
         /* time from the playout buffer. Incomplete frames that have passed */
         /* their playout time are also discarded.                           */
 
-        struct pbuf_node *curr, *temp;
-
         pbuf_validate(playout_buf);
 
-        curr = playout_buf->frst;
-        while (curr != NULL) {
-                temp = curr->nxt;
+        while (playout_buf->count > 0) {
+                struct pbuf_node *curr = frame_at(playout_buf, 0);
                 if (curr_time > curr->playout_time && frame_complete(curr)) {
-                        if (curr == playout_buf->frst) {
-                                playout_buf->frst = curr->nxt;
-                        }
-                        if (curr == playout_buf->last) {
-                                playout_buf->last = curr->prv;
-                        }
-                        if (curr->nxt != NULL) {
-                                curr->nxt->prv = curr->prv;
-                        }
-                        if (curr->prv != NULL) {
-                                curr->prv->nxt = curr->nxt;
-                        }
-                        free_cdata(curr->cdata);
-                        delete curr;
+                        free_cdata(curr);
+                        playout_buf->frst = (playout_buf->frst + 1) & (playout_buf->frames.size() - 1);
+                        playout_buf->count -= 1;
                 } else {
                         /* The playout buffer is stored in order, so once  */
                         /* we see one packet that has not yet reached it's */
@@ -463,7 +548,6 @@ void pbuf_remove(struct pbuf *playout_buf, std::chrono::high_resolution_clock::t
                         /* will have done so...                            */
                         break;
                 }
-                curr = temp;
         }
 
         pbuf_validate(playout_buf);
@@ -473,19 +557,18 @@ void pbuf_remove(struct pbuf *playout_buf, std::chrono::high_resolution_clock::t
 static int frame_complete(struct pbuf_node *frame)
 {
         /* Return non-zero if the list of coded_data represents a    */
-        /* complete frame of video. This might have to be passed the */
-        /* seqnum of the last packet in the previous frame, too?     */
-        /* i dont think that would reflect correctly of weather this */
-        /* frame is complete or not - however we should check for all */
-        /* the packtes of a frame being present - perhaps we should  */
-        /* keep a bit vector in pbuf_node? LG.  */
+        /* complete frame of video. The frame is considered complete */
+        /* when either M bit was received or a packet of subsequent  */
+        /* frame arrived. Missing packets (if the caller cares) can  */
+        /* be detected by comparing frame->pkt_count with the span   */
+        /* of sequence numbers (first_seq, last_seq).                */
 
         return (frame->mbit == 1 || frame->completed == true);
 }
 
 int pbuf_is_empty(struct pbuf *playout_buf)
 {
-        if (playout_buf->frst == NULL)
+        if (playout_buf->count == 0)
                 return TRUE;
         else
                 return FALSE;
@@ -498,12 +581,10 @@ pbuf_decode(struct pbuf *playout_buf, std::chrono::high_resolution_clock::time_p
         /* Find the first complete frame that has reached it's playout */
         /* time, and decode it into the framebuffer. Mark the frame as */
         /* decoded, but otherwise leave it in the playout buffer.      */
-        struct pbuf_node *curr;
-
         pbuf_validate(playout_buf);
 
-        curr = playout_buf->frst;
-        while (curr != NULL) {
+        for (unsigned int i = 0; i < playout_buf->count; ++i) {
+                struct pbuf_node *curr = frame_at(playout_buf, i);
                 if (!curr->decoded 
                                 && curr_time > curr->playout_time
                    ) {
@@ -519,7 +600,6 @@ pbuf_decode(struct pbuf *playout_buf, std::chrono::high_resolution_clock::time_p
                                      curr->rtp_timestamp);
                         }
                 }
-                curr = curr->nxt;
         }
         return 0;
 }
@@ -528,4 +608,3 @@ void pbuf_set_playout_delay(struct pbuf *playout_buf, double playout_delay)
 {
         playout_buf->playout_delay_us = playout_delay * 1000 * 1000;
 }
-
@@ -72,7 +72,9 @@
 extern "C" {
 #endif
 
-/* The coded representation of a single frame */
+/* The coded representation of a single frame. Entries are owned by the   */
+/* playout buffer and passed to decoders linked in descending order of    */
+/* sequence numbers.                                                      */
 struct coded_data {
         struct coded_data       *nxt;
         struct coded_data       *prv;
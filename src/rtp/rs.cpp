@@ -41,11 +41,14 @@
 #include "config_win32.h"
 #endif
 
+#include <algorithm>
 #include <bitset>
 #include <stdlib.h>
+#include "host.h"
 #include "rtp/rs.h"
 #include "rtp/rtp_callback.h"
 #include "transmit.h"
+#include "utils/worker.h"
 #include "video.h"
 
 #define DEFAULT_K 128
@@ -54,6 +57,9 @@
 #define MAX_K 255
 #define MAX_N 255
 
+#define MIN_STRIPE_LEN 4096 ///< minimal part of symbol processed by one thread
+#define STRIPE_ALIGN 64
+
 extern "C" {
 #include "rs/fec.h"
 }
@@ -62,8 +68,85 @@ static void usage();
 
 using namespace std;
 
+ADD_TO_PARAM(rs_threads, "rs-threads",
+                "* rs-threads=<n>\n"
+                "  Number of threads used to compute Reed-Solomon FEC of one frame (default\n"
+                "  number of worker pool threads)\n");
+
+static int get_thread_count() {
+        if (get_commandline_param("rs-threads")) {
+                return max(atoi(get_commandline_param("rs-threads")), 1);
+        }
+        return get_worker_count();
+}
+
+namespace {
+/**
+ * Part of symbols (columns [offset, offset + len) of all blocks) to be
+ * encoded or decoded by one thread. RS is column independent.
+ */
+struct rs_stripe {
+        const fec_t *code;
+        const gf *m_dec; ///< decode matrix (decoding only)
+        void **src;      ///< k source blocks
+        void **dst;      ///< output blocks
+        unsigned int *index; ///< encode: dst block numbers, decode: src block numbers
+        unsigned int dst_count;
+        size_t offset;
+        size_t len;
+};
+}
+
+static void *rs_encode_stripe(void *arg) {
+        struct rs_stripe *s = (struct rs_stripe *) arg;
+        const gf *src[s->code->k];
+        gf *dst[s->dst_count];
+        for (unsigned int i = 0; i < s->code->k; ++i) {
+                src[i] = (const gf *) s->src[i] + s->offset;
+        }
+        for (unsigned int i = 0; i < s->dst_count; ++i) {
+                dst[i] = (gf *) s->dst[i] + s->offset;
+        }
+        fec_encode(s->code, src, dst, s->index, s->dst_count, s->len);
+        return NULL;
+}
+
+static void *rs_decode_stripe(void *arg) {
+        struct rs_stripe *s = (struct rs_stripe *) arg;
+        const gf *src[s->code->k];
+        gf *dst[s->dst_count];
+        for (unsigned int i = 0; i < s->code->k; ++i) {
+                src[i] = (const gf *) s->src[i] + s->offset;
+        }
+        for (unsigned int i = 0; i < s->dst_count; ++i) {
+                dst[i] = (gf *) s->dst[i] + s->offset;
+        }
+        fec_decode_with_matrix(s->code, s->m_dec, src, dst, s->index, s->len);
+        return NULL;
+}
+
+/**
+ * Splits symbols of size ss into stripes processed in parallel by the worker
+ * pool (the calling thread processes the last one).
+ */
+static void run_striped(runnable_t func, struct rs_stripe const & templ, size_t ss, int max_threads) {
+        int threads = min<size_t>(max_threads, max<size_t>(ss / MIN_STRIPE_LEN, 1));
+        size_t stripe_len = (ss + threads - 1) / threads;
+        stripe_len = (stripe_len + STRIPE_ALIGN - 1) / STRIPE_ALIGN * STRIPE_ALIGN;
+
+        struct rs_stripe stripes[threads];
+        int count = 0;
+        for (size_t offset = 0; offset < ss; offset += stripe_len) {
+                stripes[count] = templ;
+                stripes[count].offset = offset;
+                stripes[count].len = min(stripe_len, ss - offset);
+                count += 1;
+        }
+        task_run_parallel(func, count, stripes, sizeof stripes[0], NULL);
+}
+
 rs::rs(unsigned int k, unsigned int n)
-        : m_k(k), m_n(n)
+        : m_k(k), m_n(n), m_threads(get_thread_count())
 {
         assert (k <= MAX_K);
         assert (n <= MAX_N);
@@ -95,6 +178,7 @@ rs::rs(const char *c_cfg)
                 usage();
                 throw 1;
         }
+        m_threads = get_thread_count();
 
         state = fec_new(m_k, m_n);
         assert(state != NULL);
@@ -147,8 +231,8 @@ shared_ptr<video_frame> rs::encode(shared_ptr<video_frame> in)
                 dst_idx[m] = m_k + m;
         }
 
-        fec_encode((const fec_t *)state, (gf **) src,
-                        (gf **) dst, dst_idx, m_n-m_k, ss);
+        run_striped(rs_encode_stripe, rs_stripe{(const fec_t *) state, NULL, src, dst, dst_idx, m_n - m_k, 0, 0},
+                        ss, m_threads);
 #endif
 
         out->tiles[0].data_len = buffer_len;
@@ -167,9 +251,9 @@ int rs::get_ss(int hdr_len, int len) {
 }
 
 void rs::decode(char *in, int in_len, char **out, int *len,
-                std::map<int, int> const & c_m)
+                packet_coverage const & coverage)
 {
-        std::map<int, int> m = c_m; // make private copy
+        packet_coverage::runs_t const & m = coverage.runs(); // already merged runs
         unsigned int ss = in_len / m_n;
         void *pkt[m_n];
         unsigned int index[m_n];
@@ -214,18 +298,6 @@ void rs::decode(char *in, int in_len, char **out, int *len,
         *len = out_sz;
         *out = (char *) in + 4;
 #else
-        for (auto it = m.begin(); it != m.end(); ++it) {
-                int start = it->first;
-                int size = it->second;
-
-                while (m.find(start + size) != m.end()) {
-                        auto item = m.find(start + size);
-                        it->second += m[start + size];
-                        size = it->second;
-                        m.erase(item);
-                }
-        }
-
         //const unsigned int bitset_size = m_k;
 
         std::bitset<MAX_K> empty_slots;
@@ -275,8 +347,10 @@ void rs::decode(char *in, int in_len, char **out, int *len,
                 output[i] = (char *) malloc(ss);
         }
 
-        fec_decode((const fec_t *) state, (const gf *const *) pkt,
-                        (gf *const *) output, index, ss);
+        gf m_dec[m_k * m_k];
+        fec_build_decode_matrix((const fec_t *) state, index, m_dec);
+        run_striped(rs_decode_stripe, rs_stripe{(const fec_t *) state, m_dec, pkt, (void **) output, index, m_k, 0, 0},
+                        ss, m_threads);
 
         i = 0;
         for (unsigned int j = 0; j < m_k; ++j) {
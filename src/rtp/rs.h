@@ -38,7 +38,6 @@
 #ifndef __RS_H__
 #define __RS_H__
 
-#include <map>
 #include <memory>
 
 #include "fec.h"
@@ -51,12 +50,13 @@ struct rs : public fec {
         virtual ~rs();
         std::shared_ptr<video_frame> encode(std::shared_ptr<video_frame> frame);
         void decode(char *in, int in_len, char **out, int *len,
-                const std::map<int, int> &);
+                const packet_coverage &);
 
 private:
         int get_ss(int hdr_len, int len);
         void *state;
         unsigned int m_k, m_n;
+        int m_threads; ///< maximal number of threads processing one frame
 };
 
 #endif /* __RS_H__ */
@@ -1559,7 +1559,7 @@ static int rtp_recv_data(struct rtp *session, uint32_t curr_rtp_ts)
                 buffer = ((uint8_t *) packet) + RTP_PACKET_HEADER_SIZE;
         } else {
                 if (!session->opt->reuse_bufs || (packet == NULL)) {
-                        packet = (rtp_packet *) malloc(RTP_MAX_PACKET_LEN + (session->opt->record_source ? sizeof(struct sockaddr_storage) : 0));
+                        packet = (rtp_packet *) udp_packet_alloc(session->rtp_socket);
                         buffer = ((uint8_t *) packet) + RTP_PACKET_HEADER_SIZE;
                 }
                 struct sockaddr_storage *sin = NULL;
@@ -1573,7 +1573,7 @@ static int rtp_recv_data(struct rtp *session, uint32_t curr_rtp_ts)
                                         RTP_MAX_PACKET_LEN - RTP_PACKET_HEADER_SIZE,
                                         (struct sockaddr *) sin, sin ? &addrlen : 0);
                 if (buflen <= 0) {
-                        free(packet);
+                        rtp_packet_free(packet);
                 }
         }
 
@@ -1584,6 +1584,14 @@ static int rtp_recv_data(struct rtp *session, uint32_t curr_rtp_ts)
         return buflen;
 }
 
+/**
+ * Frees packet passed to the application with RX_RTP event.
+ */
+void rtp_packet_free(rtp_packet *packet)
+{
+        udp_packet_free(packet);
+}
+
 static void rtp_process_data(struct rtp *session, uint32_t curr_rtp_ts,
                uint8_t *buffer, rtp_packet *packet, int buflen)
 {
@@ -1685,7 +1693,7 @@ static void rtp_process_data(struct rtp *session, uint32_t curr_rtp_ts,
                 }
 
                 if (!session->opt->reuse_bufs) {
-                        free(packet);
+                        rtp_packet_free(packet);
                 }
         }
 }
@@ -4051,9 +4059,14 @@ bool rtp_is_ipv6(struct rtp *session)
         return udp_is_ipv6(session->rtp_socket);
 }
 
-void rtp_async_start(struct rtp *session, int nr_packets)
+int rtp_async_start(struct rtp *session, int nr_packets)
+{
+       return udp_async_start(session->rtp_socket, nr_packets);
+}
+
+void rtp_async_flush(struct rtp *session)
 {
-       udp_async_start(session->rtp_socket, nr_packets);
+       udp_async_flush(session->rtp_socket);
 }
 
 void rtp_async_wait(struct rtp *session)
@@ -208,6 +208,8 @@ void rtp_recv_callback(struct rtp *session, rtp_event * e)
                                pckt_rtp->data_len + 40);
                 if (pckt_rtp->data_len > 0) {   /* Only process packets that contain data... */
                         pbuf_insert(state->playout_buffer, pckt_rtp);
+                } else {
+                        rtp_packet_free(pckt_rtp);
                 }
                 break;
         case RX_TFRC_RX:
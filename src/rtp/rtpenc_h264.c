@@ -58,138 +58,152 @@
 #include "compat/platform_spin.h"
 #include "video_frame.h"
 
-//UTILS DECLARATIONS
-uint32_t test4Bytes(struct rtpenc_h264_state *rtpench264state);
-unsigned char* startOfFrame(struct rtpenc_h264_state *rtpench264state);
-unsigned char* nextToParse(struct rtpenc_h264_state *rtpench264state);
-void checkEndOfFrame(struct rtpenc_h264_state *rtpench264state,
-		unsigned numBytesNeeded);
-uint8_t get1Byte(struct rtpenc_h264_state *rtpench264state);
-void setFromState(struct rtpenc_h264_state *rtpench264state);
-void setToState(struct rtpenc_h264_state *rtpench264state);
-void skipBytes(struct rtpenc_h264_state *rtpench264state, unsigned numBytes);
-bool haveSeenEOF(struct rtpenc_h264_state *rtpench264state); //EndOfFrame
-unsigned curNALSize(struct rtpenc_h264_state *rtpench264state);
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+#define RTPENC_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
 
-struct rtpenc_h264_state * rtpenc_h264_init_state() {
-	struct rtpenc_h264_state *rtpench264state;
-
-	rtpench264state = calloc(1, sizeof(struct rtpenc_h264_state));
-	rtpench264state->curParserIndex = 0;
-	rtpench264state->curParserIndexOffset = 0;
-	rtpench264state->haveSeenFirstStartCode = false;
-	rtpench264state->inputFrameSize = 0;
-	rtpench264state->haveSeenEOF = false;
-
-	return rtpench264state;
-}
 
-unsigned rtpenc_h264_frame_parse(struct rtpenc_h264_state *rtpench264state,	uint8_t *buf_in, int size) {
-
-	uint32_t next4Bytes = 0l;
-
-	if (!rtpench264state->haveSeenFirstStartCode) {
-		//reset pointers and params of interest for this new frame to parse and send
-		rtpench264state->startOfFrame = rtpench264state->from = rtpench264state->to = buf_in;
-		rtpench264state->curParserIndex = 0;
-		rtpench264state->inputFrameSize = size;
-		rtpench264state->curParserIndexOffset = 0;
-		// The frame must start with a 0x00000001:
-		// Skip over any input bytes that precede the first 0x00000001 and assert it
-		while (test4Bytes(rtpench264state) != 0x00000001) {
-			get1Byte(rtpench264state);
-			if(haveSeenEOF(rtpench264state)){
-				error_msg("No NAL found!\n");
-				return 0; //this shouldn't happen -> this would mean that we got new frame but no start code was found inside....
-			}
-		}
-		skipBytes(rtpench264state, 4); // skip this initial code
-		setFromState(rtpench264state); //set 'from' pointer of curr input frame
-		rtpench264state->haveSeenFirstStartCode = true;
-
-	} else {
-		//CONTINUE WITH THE SAME FRAME
-		// Assert: next4Bytes starts with 0x00000001 or 0x000001, and we've saved and sent all previous bytes (forming a complete NAL unit).
-		// Skip over these remaining bytes
-		if (test4Bytes(rtpench264state) == 0x00000001) {
-			skipBytes(rtpench264state, 4);
-		} else {
-			skipBytes(rtpench264state, 3);
+/**
+ * Scalar reference implementation of rtpenc_h264_find_startcode_t.
+ */
+static const uint8_t *find_startcode_c(const uint8_t *p, const uint8_t *end)
+{
+	for (; end - p >= 3; p++) {
+		if (p[2] > 1) {
+			// Common case: 0x000001 doesn't begin at p, p + 1 nor p + 2
+			p += 2;
+			continue;
 		}
-		if(haveSeenEOF(rtpench264state)){
-			error_msg("No NAL found!\n");
-			return 0; //this shouldn't happen -> this would mean that we got more to parse but we run out of space....
+		if (p[0] == 0 && p[1] == 0 && p[2] == 1) {
+			return p;
 		}
-
-		setFromState(rtpench264state); //re-set 'from' pointer of current input data
 	}
+	return end;
+}
 
-	// Then save everything up until the next 0x00000001 (4 bytes) or 0x000001 (3 bytes), or we hit EOF.
-	// Also make note of the first byte, because it contains the "nal_unit_type":
-	next4Bytes = test4Bytes(rtpench264state);
-	rtpench264state->firstByteOfNALUnit = next4Bytes >> 24;
-
-	while (next4Bytes != 0x00000001 && (next4Bytes & 0xFFFFFF00) != 0x00000100 && !haveSeenEOF(rtpench264state)) {
-		// We save at least some of "next4Bytes".
-		if ((unsigned) (next4Bytes & 0xFF) > 1) {
-			// Common case: 0x00000001 or 0x000001 definitely doesn't begin anywhere in "next4Bytes", so we save all of it:
-			skipBytes(rtpench264state, 4);
-		} else {
-			// Save the first byte, and continue testing the rest:
-			skipBytes(rtpench264state, 1);
+#ifdef RTPENC_X86_DISPATCH
+/*
+ * Vector versions compare three overlapping loads (offsets 0, 1 and 2) against
+ * 0x00, 0x00 and 0x01 respectively, so that bit i of the resulting mask is set
+ * iff a start code begins at p + i. The remaining tail is scanned by the
+ * scalar code.
+ */
+__attribute__((target("sse2")))
+static const uint8_t *find_startcode_sse2(const uint8_t *p, const uint8_t *end)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+	for (; end - p >= 16 + 2; p += 16) {
+		__m128i z0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) p), zero);
+		__m128i z1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p + 1)), zero);
+		__m128i o2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p + 2)), one);
+		int mask = _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(z0, z1), o2));
+		if (mask != 0) {
+			return p + __builtin_ctz(mask);
 		}
-		next4Bytes = test4Bytes(rtpench264state);
 	}
-	setToState(rtpench264state);
+	return find_startcode_c(p, end);
+}
 
-	return curNALSize(rtpench264state);
+__attribute__((target("avx2")))
+static const uint8_t *find_startcode_avx2(const uint8_t *p, const uint8_t *end)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi8(1);
+	for (; end - p >= 32 + 2; p += 32) {
+		__m256i z0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) p), zero);
+		__m256i z1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (p + 1)), zero);
+		__m256i o2 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (p + 2)), one);
+		unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(z0, z1), o2));
+		if (mask != 0) {
+			return p + __builtin_ctz(mask);
+		}
+	}
+	return find_startcode_sse2(p, end);
 }
+#endif
 
-//UTILS
-uint32_t test4Bytes(struct rtpenc_h264_state *rtpench264state) {
-	checkEndOfFrame(rtpench264state, 4);
+static rtpenc_h264_find_startcode_t find_startcode = find_startcode_c;
 
-	unsigned char const* ptr = nextToParse(rtpench264state);
-	return (ptr[0] << 24) | (ptr[1] << 16) | (ptr[2] << 8) | ptr[3];
-}
-unsigned char* startOfFrame(struct rtpenc_h264_state *rtpench264state) {
-	return rtpench264state->startOfFrame;
-}
-unsigned char* nextToParse(struct rtpenc_h264_state *rtpench264state) {
-	return &startOfFrame(rtpench264state)[rtpench264state->curParserIndex];
+#ifdef RTPENC_X86_DISPATCH
+__attribute__((constructor))
+static void rtpenc_h264_detect_simd(void)
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		find_startcode = find_startcode_avx2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		find_startcode = find_startcode_sse2;
+	}
 }
-void checkEndOfFrame(struct rtpenc_h264_state *rtpench264state,
-		unsigned numBytesNeeded) {
-	// assure EOF check
-	if (rtpench264state->curParserIndex + numBytesNeeded
-			>= rtpench264state->inputFrameSize){
-		rtpench264state->haveSeenEOF = true;
+#endif
+
+rtpenc_h264_find_startcode_t rtpenc_h264_get_find_startcode(enum vc_simd_level level)
+{
+	switch (level) {
+	case VC_SIMD_NONE:
+		return find_startcode_c;
+#ifdef RTPENC_X86_DISPATCH
+	case VC_SIMD_SSSE3: // SSE2 is enough
+		return find_startcode_sse2;
+	case VC_SIMD_AVX2:
+		return find_startcode_avx2;
+#endif
+	default:
+		return NULL;
 	}
 }
-uint8_t get1Byte(struct rtpenc_h264_state *rtpench264state) { // byte-aligned
-	checkEndOfFrame(rtpench264state, 1);
-	return startOfFrame(rtpench264state)[rtpench264state->curParserIndex++];
+
+const uint8_t *rtpenc_h264_find_startcode(const uint8_t *p, const uint8_t *end)
+{
+	return find_startcode(p, end);
 }
-void setFromState(struct rtpenc_h264_state *rtpench264state) {
-	rtpench264state->from = rtpench264state->startOfFrame
-			+ rtpench264state->curParserIndex;
-	rtpench264state->curParserIndexOffset = rtpench264state->curParserIndex;
+
+struct rtpenc_h264_state * rtpenc_h264_init_state() {
+	return calloc(1, sizeof(struct rtpenc_h264_state));
 }
-void setToState(struct rtpenc_h264_state *rtpench264state) {
-	if(haveSeenEOF(rtpench264state)) {
-		rtpench264state->to = rtpench264state->startOfFrame + rtpench264state->inputFrameSize;
-	} else {
-		rtpench264state->to = rtpench264state->from
-			+ (rtpench264state->curParserIndex - rtpench264state->curParserIndexOffset);
+
+void rtpenc_h264_done_state(struct rtpenc_h264_state *rtpench264state) {
+	if (!rtpench264state) {
+		return;
 	}
+	free(rtpench264state->nals);
+	free(rtpench264state);
 }
-void skipBytes(struct rtpenc_h264_state *rtpench264state, unsigned numBytes) {
-	checkEndOfFrame(rtpench264state, numBytes);
-	rtpench264state->curParserIndex += numBytes;
-}
-bool haveSeenEOF(struct rtpenc_h264_state *rtpench264state) {
-	return rtpench264state->haveSeenEOF;
-}
-unsigned curNALSize(struct rtpenc_h264_state *rtpench264state) {
-	return (rtpench264state->to - rtpench264state->from);
+
+int rtpenc_h264_find_nals(struct rtpenc_h264_state *rtpench264state, const uint8_t *buf, int size) {
+	const uint8_t *end = buf + size;
+
+	// The frame must start with a 0x00000001:
+	// Skip over any input bytes that precede the first 0x00000001
+	const uint8_t *p = find_startcode(buf, end);
+	while (p != end && (p == buf || p[-1] != 0)) {
+		p = find_startcode(p + 3, end);
+	}
+	if (p == end) {
+		error_msg("No NAL found!\n");
+		return 0;
+	}
+
+	int count = 0;
+	while (p != end) {
+		const uint8_t *nal = p + 3;
+		p = find_startcode(nal, end);
+		// NAL unit ends at the next 0x00000001 (4 bytes) or 0x000001 (3 bytes), or at EOF
+		const uint8_t *nal_end = p != end && p[-1] == 0 ? p - 1 : p;
+		if (nal_end == nal) {
+			continue;
+		}
+		if (count == rtpench264state->nals_max) {
+			rtpench264state->nals_max = rtpench264state->nals_max ? 2 * rtpench264state->nals_max : 16;
+			rtpench264state->nals = realloc(rtpench264state->nals,
+					rtpench264state->nals_max * sizeof(struct rtpenc_h264_nal));
+		}
+		rtpench264state->nals[count].offset = nal - buf;
+		rtpench264state->nals[count].len = nal_end - nal;
+		count++;
+	}
+
+	return count;
 }
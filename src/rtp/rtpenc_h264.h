@@ -44,29 +44,53 @@
 #ifndef _RTP_ENC_H264_H
 #define _RTP_ENC_H264_H
 
+#include "video_codec.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define RTPENC_H264_PT 96
 
+/// NAL unit of an Annex-B stream (without the start code)
+struct rtpenc_h264_nal {
+	unsigned offset;     ///< offset of the NAL unit header within the frame
+	unsigned len;
+};
+
 struct rtpenc_h264_state {
-	bool haveSeenFirstStartCode;
-	uint8_t firstByteOfNALUnit;
-	unsigned char* startOfFrame;
-	unsigned char* to;
-	unsigned char* from;
-	unsigned maxPacketSize;
-	unsigned curNALOffset;
-	bool lastNALUnitFragment;
-	unsigned curParserIndex; // <= inputFrameSize
-	unsigned curParserIndexOffset;
-	unsigned inputFrameSize;
-	bool haveSeenEOF;
+	struct rtpenc_h264_nal *nals; ///< NAL units found by the last rtpenc_h264_find_nals() call
+	int nals_max;
+};
+
+/// RTP payload of one packet - NAL unit or its FU-A fragment (pointing to frame data)
+struct rtpenc_h264_packet {
+	uint8_t hdr[2];      ///< FU indicator and FU header
+	int hdr_len;         ///< 0 for a single NAL unit packet, 2 for FU-A
+	unsigned char *data;
+	unsigned len;
+	bool m;              ///< RTP marker bit (last packet of the frame)
 };
 
+/**
+ * @returns pointer to the first 0x000001 sequence in [p, end) or end if there is none
+ */
+typedef const uint8_t *(*rtpenc_h264_find_startcode_t)(const uint8_t *p, const uint8_t *end);
+
 struct rtpenc_h264_state * rtpenc_h264_init_state(void);
-unsigned rtpenc_h264_frame_parse(struct rtpenc_h264_state *rtpench264state, uint8_t *buf_in, int size);
+void rtpenc_h264_done_state(struct rtpenc_h264_state *rtpench264state);
+/// Start code scanner using the best instruction set supported by the CPU
+const uint8_t *rtpenc_h264_find_startcode(const uint8_t *p, const uint8_t *end);
+/// @returns start code scanner implementation for given level or NULL if not available
+rtpenc_h264_find_startcode_t rtpenc_h264_get_find_startcode(enum vc_simd_level level);
+/**
+ * Finds all NAL units of an Annex-B frame in a single pass and stores them to
+ * rtpench264state->nals. The frame must start with 0x00000001 (any preceding
+ * bytes are skipped), empty NAL units are omitted.
+ *
+ * @returns number of NAL units
+ */
+int rtpenc_h264_find_nals(struct rtpenc_h264_state *rtpench264state, const uint8_t *buf, int size);
 
 #ifdef __cplusplus
 }
@@ -85,12 +85,14 @@
 #include "module.h"
 #include "perf.h"
 #include "rtp/fec.h"
+#include "rtp/packet_coverage.h"
 #include "rtp/rtp.h"
 #include "rtp/rtp_callback.h"
 #include "rtp/pbuf.h"
 #include "rtp/video_decoders.h"
 #include "utils/synchronized_queue.h"
 #include "utils/timed_message.h"
+#include "utils/worker.h"
 #include "video.h"
 #include "video_decompress.h"
 #include "video_display.h"
@@ -100,7 +102,6 @@
 #include <future>
 #endif
 #include <iostream>
-#include <map>
 #include <memory>
 #include <queue>
 #include <sstream>
@@ -112,6 +113,8 @@
 
 #define MOD_NAME "[video dec.] "
 
+#define LINE_DECODER_MIN_PACKETS_PER_THREAD 16
+
 using namespace std;
 
 struct state_video_decoder;
@@ -132,15 +135,6 @@ static void *decompress_thread(void *args);
 static void cleanup(struct state_video_decoder *decoder);
 static void decoder_process_message(struct module *);
 
-static int sum_map(map<int, int> const & m) {
-        int ret = 0;
-        for (map<int, int>::const_iterator it = m.begin();
-                        it != m.end(); ++it) {
-                ret += it->second;
-        }
-        return ret;
-}
-
 namespace {
 
 #ifdef HAVE_LIBAVCODEC_AVCODEC_H
@@ -166,12 +160,24 @@ struct line_decoder {
         double               src_bpp;      ///< Source pixelformat BPP (bytes)
         double               dst_bpp;      ///< Destination pixelformat BPP (bytes)
         int                  shifts[3];    ///< requested red,green and blue shift (in bits)
-        decoder_t            decode_line;  ///< actual decoding function
+        struct vc_conversion_path conversion; ///< actual decoding function(s)
         unsigned int         dst_linesize; ///< destination linesize
         unsigned int         dst_pitch;    ///< framebuffer pitch - it can be larger if SDL resolution is larger than data */
         unsigned int         src_linesize; ///< source linesize
 };
 
+/**
+ * Packet waiting to be decoded by line decoder, used if line decoding is
+ * performed in parallel (see "decoder-line-threads" parameter).
+ */
+struct line_decoder_job {
+        struct line_decoder *line_decoder;
+        struct tile         *tile;
+        uint32_t             data_pos;
+        unsigned char       *source;
+        int                  len;
+};
+
 struct reported_statistics_cumul {
         mutex             lock;
         unsigned long long int     received_bytes_total = 0;
@@ -197,6 +203,42 @@ struct reported_statistics_cumul {
         }
 };
 
+/**
+ * Recycles packet_coverage arrays of received frames, so that neither the
+ * arrays nor the run vectors of individual substreams are allocated per
+ * frame. Arrays are returned from ~frame_msg, ie. after the FEC and
+ * decompress threads are done with the frame.
+ */
+struct packet_coverage_pool {
+        /// @returns cleared array of count packet_coverage instances
+        unique_ptr<packet_coverage[]> get(unsigned int count) {
+                lock_guard<mutex> lk(lock);
+                if (count != substreams) { // substream count changed - drop arrays of the old size
+                        free_lists.clear();
+                        substreams = count;
+                }
+                if (free_lists.empty()) {
+                        return unique_ptr<packet_coverage[]>(new packet_coverage[count]);
+                }
+                unique_ptr<packet_coverage[]> ret = std::move(free_lists.back());
+                free_lists.pop_back();
+                return ret;
+        }
+        void put(unique_ptr<packet_coverage[]> &&list, unsigned int count) {
+                for (unsigned int i = 0; i < count; ++i) {
+                        list[i].clear(); // keeps capacity
+                }
+                lock_guard<mutex> lk(lock);
+                if (count == substreams) {
+                        free_lists.push_back(std::move(list));
+                }
+        }
+
+        mutex lock;
+        vector<unique_ptr<packet_coverage[]>> free_lists;
+        unsigned int substreams = 0;
+};
+
 // message definitions
 struct frame_msg {
         inline frame_msg(struct control_state *c, struct reported_statistics_cumul &sr) : control(c), recv_frame(nullptr),
@@ -209,7 +251,7 @@ struct frame_msg {
                         lock_guard<mutex> lk(stats.lock);
                         int received_bytes = 0;
                         for (unsigned int i = 0; i < recv_frame->tile_count; ++i) {
-                                received_bytes += sum_map(pckt_list[i]);
+                                received_bytes += pckt_list[i].bytes();
                         }
                         int expected_bytes = vf_get_data_len(recv_frame);
                         if (recv_frame->fec_params.type != FEC_NONE) {
@@ -245,12 +287,17 @@ struct frame_msg {
                 }
                 vf_free(recv_frame);
                 vf_free(nofec_frame);
+                if (pckt_pool && pckt_list) {
+                        pckt_pool->put(std::move(pckt_list), pckt_list_len);
+                }
         }
         struct control_state *control;
         vector <uint32_t> buffer_num;
         struct video_frame *recv_frame; ///< received frame with FEC and/or compression
         struct video_frame *nofec_frame; ///< frame without FEC
-        unique_ptr<map<int, int>[]> pckt_list;
+        unique_ptr<packet_coverage[]> pckt_list; ///< received data of individual substreams
+        unsigned int pckt_list_len = 0;
+        struct packet_coverage_pool *pckt_pool = nullptr; ///< pool to return pckt_list to
         unsigned long long int received_pkts_cum, expected_pkts_cum;
         struct reported_statistics_cumul &stats;
         unsigned long long int nanoPerFrameDecompress = 0;
@@ -309,6 +356,7 @@ struct state_video_decoder
         /// @}
 
         unsigned int      max_substreams = 0; ///< maximal number of expected substreams
+        struct packet_coverage_pool pckt_pool; ///< recycled received-data records of frames
         change_il_t       change_il = NULL;      ///< function to change interlacing, if needed. Otherwise NULL.
         vector<void *>    change_il_state;
 
@@ -341,6 +389,9 @@ struct state_video_decoder
         const struct openssl_decrypt_info *dec_funcs = NULL; ///< decrypt state
         struct openssl_decrypt      *decrypt = NULL; ///< decrypt state
 
+        int line_decoder_threads = 1; ///< number of threads decoding packets with line decoder
+        vector<line_decoder_job> line_decoder_jobs; ///< packets pending for line decoding
+
 #ifdef RECONFIGURE_IN_FUTURE_THREAD
         std::future<bool> reconfiguration_future;
         bool             reconfiguration_in_progress = false;
@@ -413,11 +464,11 @@ static void *fec_thread(void *args) {
                                                 data->recv_frame->tiles[pos].data_len,
                                                 &fec_out_buffer, &fec_out_len, data->pckt_list[pos]);
 
-                                if (data->recv_frame->tiles[pos].data_len != (unsigned int) sum_map(data->pckt_list[pos])) {
+                                if (data->recv_frame->tiles[pos].data_len != (unsigned int) data->pckt_list[pos].bytes()) {
                                         verbose_msg("Frame incomplete - substream %d, buffer %d: expected %u bytes, got %u.\n", pos,
                                                         (unsigned int) data->buffer_num[pos],
                                                         data->recv_frame->tiles[pos].data_len,
-                                                        (unsigned int) sum_map(data->pckt_list[pos]));
+                                                        (unsigned int) data->pckt_list[pos].bytes());
                                 }
 
                                 if(fec_out_len == 0) {
@@ -472,7 +523,7 @@ static void *fec_thread(void *args) {
                                         char *src = fec_out_buffer;
                                         char *dst = tile->data + line_decoder->base_offset;
                                         while(data_pos < (int) fec_out_len) {
-                                                line_decoder->decode_line((unsigned char*)dst, (unsigned char *) src, line_decoder->src_linesize,
+                                                vc_convert_line(&line_decoder->conversion, (unsigned char*)dst, (unsigned char *) src, line_decoder->src_linesize,
                                                                 line_decoder->shifts[0],
                                                                 line_decoder->shifts[1],
                                                                 line_decoder->shifts[2]);
@@ -487,11 +538,11 @@ static void *fec_thread(void *args) {
                                 data->nofec_frame->tiles[i].data_len = data->recv_frame->tiles[i].data_len;
                                 data->nofec_frame->tiles[i].data = data->recv_frame->tiles[i].data;
 
-                                if (data->recv_frame->tiles[i].data_len != (unsigned int) sum_map(data->pckt_list[i])) {
+                                if (data->recv_frame->tiles[i].data_len != (unsigned int) data->pckt_list[i].bytes()) {
                                         verbose_msg("Frame incomplete - substream %d, buffer %d: expected %u bytes, got %u.%s\n", i,
                                                         (unsigned int) data->buffer_num[i],
                                                         data->recv_frame->tiles[i].data_len,
-                                                        (unsigned int) sum_map(data->pckt_list[i]),
+                                                        (unsigned int) data->pckt_list[i].bytes(),
                                                         decoder->decoder_type == EXTERNAL_DECODER && !decoder->accepts_corrupted_frame ? " dropped.\n" : "");
                                         data->is_corrupted = true;
                                         if(decoder->decoder_type == EXTERNAL_DECODER && !decoder->accepts_corrupted_frame) {
@@ -677,6 +728,14 @@ struct state_video_decoder *video_decoder_init(struct module *parent,
                 }
         }
 
+        if (get_commandline_param("decoder-line-threads")) {
+                s->line_decoder_threads = atoi(get_commandline_param("decoder-line-threads"));
+                if (s->line_decoder_threads <= 0) {
+                        s->line_decoder_threads = thread::hardware_concurrency();
+                }
+                log_msg(LOG_LEVEL_INFO, MOD_NAME "Using %d threads for line decoding.\n", s->line_decoder_threads);
+        }
+
         decoder_set_video_mode(s, video_mode);
 
         if(!video_decoder_register_display(s, display)) {
@@ -687,6 +746,11 @@ struct state_video_decoder *video_decoder_init(struct module *parent,
         return s;
 }
 
+ADD_TO_PARAM(decoder_line_threads, "decoder-line-threads",
+                "* decoder-line-threads=<n>\n"
+                "  Number of threads used to decode uncompressed video packets into the\n"
+                "  framebuffer (0 - number of CPUs, default 1 - decode in receiving thread)\n");
+
 /**
  * @brief starts decompress and ldmg threads
  *
@@ -837,17 +901,21 @@ void video_decoder_destroy(struct state_video_decoder *decoder)
 /**
  * This function selects, according to given video description, appropriate
  *
+ * If the codec cannot be displayed natively, the cheapest line decoder
+ * conversion (possibly a chain of decoders) to any of the native codecs is
+ * selected, slow decoders are used only if there is no other possibility.
+ *
  * @param[in]  decoder     decoder to be taken parameters from (video mode, native codecs etc.)
  * @param[in]  desc        incoming video description
- * @param[out] decode_line If chosen decoder is a linedecoder, this variable contains the
- *                         decoding function.
+ * @param[out] conversion  If chosen decoder is a linedecoder, this variable contains the
+ *                         decoding function(s), otherwise conversion->steps is 0.
  * @return                 Output codec, if no decoding function found, -1 is returned.
  */
 static codec_t choose_codec_and_decoder(struct state_video_decoder *decoder, struct video_desc desc,
-                                decoder_t *decode_line)
+                                struct vc_conversion_path *conversion)
 {
         codec_t out_codec = VIDEO_CODEC_NONE;
-        *decode_line = NULL;
+        memset(conversion, 0, sizeof *conversion);
 
         size_t native;
         /* first check if the codec is natively supported */
@@ -860,49 +928,40 @@ static codec_t choose_codec_and_decoder(struct state_video_decoder *decoder, str
                                         && decoder->video_mode != VIDEO_NORMAL)
                                 continue; /* it is a exception, see NOTES #1 */
 
-                        *decode_line = (decoder_t) memcpy;
+                        /* memcpy, or vc_copylineRGBA/vc_copylineRGB for RGBA and RGB
+                         * - another exception - we may change shifts */
+                        get_conversion_path(desc.color_spec, out_codec, false, conversion);
                         decoder->decoder_type = LINE_DECODER;
 
-                        if(desc.color_spec == RGBA || /* another exception - we may change shifts */
-                                        desc.color_spec == RGB) {
-                                *decode_line = desc.color_spec == RGBA ?
-                                        vc_copylineRGBA : vc_copylineRGB;
-                        }
-
                         goto after_linedecoder_lookup;
                 }
         }
-        /* otherwise if we have line decoder */
-        for(native = 0; native < decoder->native_count; ++native)
-        {
-                decoder_t decode;
-                if ((decode = get_decoder_from_to(desc.color_spec, decoder->native_codecs[native], false)) != NULL) {
-                        *decode_line = decode;
-
-                        decoder->decoder_type = LINE_DECODER;
-                        out_codec = decoder->native_codecs[native];
-                        goto after_linedecoder_lookup;
-
+        /* otherwise if we have line decoder (first try without slow decoders) */
+        for (int slow = 0; slow <= 1 && conversion->steps == 0; ++slow) {
+                for(native = 0; native < decoder->native_count; ++native)
+                {
+                        struct vc_conversion_path path;
+                        if (get_conversion_path(desc.color_spec, decoder->native_codecs[native], slow, &path) &&
+                                        (conversion->steps == 0 || path.cost < conversion->cost)) {
+                                *conversion = path;
+                                out_codec = decoder->native_codecs[native];
+                        }
                 }
         }
-        /* the same, but include also slow decoders */
-        for(native = 0; native < decoder->native_count; ++native)
-        {
-                decoder_t decode;
-                if ((decode = get_decoder_from_to(desc.color_spec, decoder->native_codecs[native], true)) != NULL) {
-                        *decode_line = decode;
-
-                        decoder->decoder_type = LINE_DECODER;
-                        out_codec = decoder->native_codecs[native];
-                        goto after_linedecoder_lookup;
-
+        if (conversion->steps > 0) {
+                decoder->decoder_type = LINE_DECODER;
+                ostringstream oss;
+                for (int i = 0; i <= conversion->steps; ++i) {
+                        oss << (i > 0 ? "->" : "") << get_codec_name(conversion->codecs[i]);
                 }
+                LOG(LOG_LEVEL_VERBOSE) << MOD_NAME << "Using line decoder " << oss.str()
+                        << " (" << conversion->cost << " ns/px).\n";
         }
 
 after_linedecoder_lookup:
 
         /* we didn't find line decoder. So try now regular (aka DXT) decoder */
-        if(*decode_line == NULL) {
+        if(conversion->steps == 0) {
                 for(native = 0; native < decoder->native_count; ++native)
                 {
                         out_codec = decoder->native_codecs[native];
@@ -995,7 +1054,7 @@ static bool reconfigure_decoder(struct state_video_decoder *decoder,
                 struct video_desc desc)
 {
         codec_t out_codec;
-        decoder_t decode_line;
+        struct vc_conversion_path conversion;
         enum interlacing_t display_il = PROGRESSIVE;
         //struct video_frame *frame;
         int display_requested_pitch;
@@ -1015,7 +1074,7 @@ static bool reconfigure_decoder(struct state_video_decoder *decoder,
         desc.tile_count = get_video_mode_tiles_x(decoder->video_mode)
                         * get_video_mode_tiles_y(decoder->video_mode);
 
-        out_codec = choose_codec_and_decoder(decoder, desc, &decode_line);
+        out_codec = choose_codec_and_decoder(decoder, desc, &conversion);
         if(out_codec == VIDEO_CODEC_NONE)
                 return false;
         else
@@ -1103,7 +1162,7 @@ static bool reconfigure_decoder(struct state_video_decoder *decoder,
                         out->dst_bpp = get_bpp(out_codec);
                         memcpy(out->shifts, display_requested_rgb_shift, 3 * sizeof(int));
 
-                        out->decode_line = decode_line;
+                        out->conversion = conversion;
                         out->dst_pitch = decoder->pitch;
                         out->src_linesize = vc_get_linesize(desc.width, desc.color_spec);
                         out->dst_linesize = vc_get_linesize(desc.width, out_codec);
@@ -1124,7 +1183,7 @@ static bool reconfigure_decoder(struct state_video_decoder *decoder,
                                         memcpy(out->shifts, display_requested_rgb_shift,
                                                         3 * sizeof(int));
 
-                                        out->decode_line = decode_line;
+                                        out->conversion = conversion;
 
                                         out->dst_pitch = decoder->pitch;
                                         out->src_linesize =
@@ -1146,7 +1205,7 @@ static bool reconfigure_decoder(struct state_video_decoder *decoder,
                                         memcpy(out->shifts, display_requested_rgb_shift,
                                                         3 * sizeof(int));
 
-                                        out->decode_line = decode_line;
+                                        out->conversion = conversion;
                                         out->src_linesize =
                                                 vc_get_linesize(desc.width, desc.color_spec);
                                         out->dst_pitch =
@@ -1268,6 +1327,142 @@ static int check_for_mode_change(struct state_video_decoder *decoder,
 #define ERROR_GOTO_CLEANUP ret = FALSE; goto cleanup;
 #define max(a, b)       (((a) > (b))? (a): (b))
 
+/**
+ * Decodes packet payload with line decoder into the framebuffer tile.
+ * @retval false if the framebuffer is too small for the data
+ */
+static bool decode_packet_lines(struct line_decoder *line_decoder, struct tile *tile,
+                uint32_t data_pos, unsigned char *source, int len)
+{
+        /* MAGIC, don't touch it, you definitely break it
+         *  *source* is data from network, *destination* is frame buffer
+         */
+
+        /* compute Y pos in source frame and convert it to
+         * byte offset in the destination frame
+         */
+        int y = (data_pos / line_decoder->src_linesize) * line_decoder->dst_pitch;
+
+        /* compute X pos in source frame */
+        int s_x = data_pos % line_decoder->src_linesize;
+
+        /* convert X pos from source frame into the destination frame.
+         * it is byte offset from the beginning of a line.
+         */
+        int d_x = ((int)((s_x) / line_decoder->src_bpp)) *
+                line_decoder->dst_bpp;
+
+        /* copy whole packet that can span several lines.
+         * we need to clip data (v210 case) or center data (RGBA, R10k cases)
+         */
+        while (len > 0) {
+                /* len id payload length in source BPP
+                 * decoder needs len in destination BPP, so convert it
+                 */
+                int l = ((int)(len / line_decoder->src_bpp)) * line_decoder->dst_bpp;
+
+                /* do not copy multiple lines, we need to
+                 * copy (& clip, center) line by line
+                 */
+                if (l + d_x > (int) line_decoder->dst_linesize) {
+                        l = line_decoder->dst_linesize - d_x;
+                }
+
+                /* compute byte offset in destination frame */
+                uint32_t offset = y + d_x;
+
+                /* watch the SEGV */
+                if (l + line_decoder->base_offset + offset > tile->data_len) {
+                        return false;
+                }
+                /*decode frame:
+                 * we have offset for destination
+                 * we update source contiguously
+                 * we pass {r,g,b}shifts */
+                vc_convert_line(&line_decoder->conversion, (unsigned char*)tile->data + line_decoder->base_offset + offset, source, l,
+                                line_decoder->shifts[0], line_decoder->shifts[1],
+                                line_decoder->shifts[2]);
+                /* we decoded one line (or a part of one line) to the end of the line
+                 * so decrease *source* len by 1 line (or that part of the line */
+                len -= line_decoder->src_linesize - s_x;
+                /* jump in source by the same amount */
+                source += line_decoder->src_linesize - s_x;
+
+                /* each new line continues from the beginning */
+                d_x = 0;        /* next line from beginning */
+                s_x = 0;
+                y += line_decoder->dst_pitch;  /* next line */
+        }
+        return true;
+}
+
+static void print_framebuffer_too_small(int prints)
+{
+        /* this should not ever happen as we call reconfigure before each packet
+         * iff reconfigure is needed. But if it still happens, something is terribly wrong
+         * say it loudly
+         */
+        if((prints % 100) == 0) {
+                log_msg(LOG_LEVEL_ERROR, "WARNING!! Discarding input data as frame buffer is too small.\n"
+                                "Well this should not happened. Expect troubles pretty soon.\n");
+        }
+}
+
+struct line_decoder_task_data {
+        const struct line_decoder_job *jobs;
+        size_t count;
+        int failed;
+};
+
+static void *line_decoder_task(void *arg)
+{
+        struct line_decoder_task_data *data = (struct line_decoder_task_data *) arg;
+        for (size_t i = 0; i < data->count; ++i) {
+                const struct line_decoder_job *job = &data->jobs[i];
+                if (!decode_packet_lines(job->line_decoder, job->tile, job->data_pos, job->source, job->len)) {
+                        data->failed += 1;
+                }
+        }
+        return NULL;
+}
+
+/**
+ * Decodes packets collected in decoder->line_decoder_jobs. Packets map to
+ * disjoint framebuffer regions, so the list is split into contiguous ranges
+ * (neighbouring packets) processed in parallel by the worker pool.
+ *
+ * @returns number of packets that could not be decoded
+ */
+static int flush_line_decoder_jobs(struct state_video_decoder *decoder)
+{
+        vector<line_decoder_job> &jobs = decoder->line_decoder_jobs;
+        if (jobs.empty()) {
+                return 0;
+        }
+
+        int threads = min<int>(decoder->line_decoder_threads,
+                        (jobs.size() + LINE_DECODER_MIN_PACKETS_PER_THREAD - 1) / LINE_DECODER_MIN_PACKETS_PER_THREAD);
+        struct line_decoder_task_data data[threads];
+        task_result_handle_t handle[threads];
+        size_t per_thread = (jobs.size() + threads - 1) / threads;
+        for (int i = 0; i < threads; ++i) {
+                size_t first = min(i * per_thread, jobs.size());
+                data[i] = { jobs.data() + first, min(per_thread, jobs.size() - first), 0 };
+                // the last range is processed by the calling thread
+                handle[i] = i < threads - 1 ? task_run_async(line_decoder_task, &data[i]) :
+                        line_decoder_task(&data[i]);
+        }
+        int failed = 0;
+        for (int i = 0; i < threads; ++i) {
+                if (i < threads - 1) {
+                        wait_task(handle[i]);
+                }
+                failed += data[i].failed;
+        }
+        jobs.clear();
+        return failed;
+}
+
 /**
  * @brief Decodes a participant buffer representing one video frame.
  * @param cdata        PBUF buffer
@@ -1295,7 +1490,7 @@ int decode_video_frame(struct coded_data *cdata, void *decoder_data, struct pbuf
         // is just the FEC buffer present, so we point to it instead to copying
         struct video_frame *frame = vf_alloc(max_substreams);
         frame->callbacks.data_deleter = vf_data_deleter;
-        unique_ptr<map<int, int>[]> pckt_list(new map<int, int>[max_substreams]);
+        unique_ptr<packet_coverage[]> pckt_list = decoder->pckt_pool.get(max_substreams);
 
         int k = 0, m = 0, c = 0, seed = 0; // LDGM
         int buffer_number, buffer_length;
@@ -1305,6 +1500,9 @@ int decode_video_frame(struct coded_data *cdata, void *decoder_data, struct pbuf
 
         perf_record(UVP_DECODEFRAME, cdata);
 
+        // drop packets left over by a previously aborted frame
+        decoder->line_decoder_jobs.clear();
+
         // We have no framebuffer assigned, exitting
         if(!decoder->display) {
                 vf_free(frame);
@@ -1351,8 +1549,6 @@ int decode_video_frame(struct coded_data *cdata, void *decoder_data, struct pbuf
                 uint32_t tmp;
                 uint32_t *hdr;
                 int len;
-                uint32_t offset;
-                unsigned char *source;
                 char *data;
                 uint32_t data_pos;
                 uint32_t substream;
@@ -1463,6 +1659,8 @@ int decode_video_frame(struct coded_data *cdata, void *decoder_data, struct pbuf
                          * each thread *MUST* wait here if this condition is true
                          */
                         if (check_for_mode_change(decoder, hdr)) {
+                                // pending packets refer to the previous configuration
+                                decoder->line_decoder_jobs.clear();
 #ifdef RECONFIGURE_IN_FUTURE_THREAD
                                 vf_free(frame);
                                 return FALSE;
@@ -1479,7 +1677,7 @@ int decode_video_frame(struct coded_data *cdata, void *decoder_data, struct pbuf
 
                 buffer_num[substream] = buffer_number;
                 frame->tiles[substream].data_len = buffer_length;
-                pckt_list[substream][data_pos] = len;
+                pckt_list[substream].add(data_pos, len);
 
                 if ((pt == PT_VIDEO || pt == PT_ENCRYPT_VIDEO) && decoder->decoder_type == LINE_DECODER) {
                         struct tile *tile = NULL;
@@ -1501,76 +1699,11 @@ int decode_video_frame(struct coded_data *cdata, void *decoder_data, struct pbuf
 
                         /* End of critical section */
 
-                        /* MAGIC, don't touch it, you definitely break it
-                         *  *source* is data from network, *destination* is frame buffer
-                         */
-
-                        /* compute Y pos in source frame and convert it to
-                         * byte offset in the destination frame
-                         */
-                        int y = (data_pos / line_decoder->src_linesize) * line_decoder->dst_pitch;
-
-                        /* compute X pos in source frame */
-                        int s_x = data_pos % line_decoder->src_linesize;
-
-                        /* convert X pos from source frame into the destination frame.
-                         * it is byte offset from the beginning of a line.
-                         */
-                        int d_x = ((int)((s_x) / line_decoder->src_bpp)) *
-                                line_decoder->dst_bpp;
-
-                        /* pointer to data payload in packet */
-                        source = (unsigned char*)(data);
-
-                        /* copy whole packet that can span several lines.
-                         * we need to clip data (v210 case) or center data (RGBA, R10k cases)
-                         */
-                        while (len > 0) {
-                                /* len id payload length in source BPP
-                                 * decoder needs len in destination BPP, so convert it
-                                 */
-                                int l = ((int)(len / line_decoder->src_bpp)) * line_decoder->dst_bpp;
-
-                                /* do not copy multiple lines, we need to
-                                 * copy (& clip, center) line by line
-                                 */
-                                if (l + d_x > (int) line_decoder->dst_linesize) {
-                                        l = line_decoder->dst_linesize - d_x;
-                                }
-
-                                /* compute byte offset in destination frame */
-                                offset = y + d_x;
-
-                                /* watch the SEGV */
-                                if (l + line_decoder->base_offset + offset <= tile->data_len) {
-                                        /*decode frame:
-                                         * we have offset for destination
-                                         * we update source contiguously
-                                         * we pass {r,g,b}shifts */
-                                        line_decoder->decode_line((unsigned char*)tile->data + line_decoder->base_offset + offset, source, l,
-                                                        line_decoder->shifts[0], line_decoder->shifts[1],
-                                                        line_decoder->shifts[2]);
-                                        /* we decoded one line (or a part of one line) to the end of the line
-                                         * so decrease *source* len by 1 line (or that part of the line */
-                                        len -= line_decoder->src_linesize - s_x;
-                                        /* jump in source by the same amount */
-                                        source += line_decoder->src_linesize - s_x;
-                                } else {
-                                        /* this should not ever happen as we call reconfigure before each packet
-                                         * iff reconfigure is needed. But if it still happens, something is terribly wrong
-                                         * say it loudly
-                                         */
-                                        if((prints % 100) == 0) {
-                                                log_msg(LOG_LEVEL_ERROR, "WARNING!! Discarding input data as frame buffer is too small.\n"
-                                                                "Well this should not happened. Expect troubles pretty soon.\n");
-                                        }
-                                        prints++;
-                                        len = 0;
-                                }
-                                /* each new line continues from the beginning */
-                                d_x = 0;        /* next line from beginning */
-                                s_x = 0;
-                                y += line_decoder->dst_pitch;  /* next line */
+                        if (decoder->line_decoder_threads > 1 && pt == PT_VIDEO) {
+                                /* packet data stays valid in the playout buffer until we return */
+                                decoder->line_decoder_jobs.push_back({line_decoder, tile, data_pos, (unsigned char *) data, len});
+                        } else if (!decode_packet_lines(line_decoder, tile, data_pos, (unsigned char *) data, len)) {
+                                print_framebuffer_too_small(prints++);
                         }
                 } else { /* PT_VIDEO_LDGM or external decoder */
                         if(!frame->tiles[substream].data) {
@@ -1585,6 +1718,11 @@ next_packet:
                 cdata = cdata->nxt;
         }
 
+        if (int failed = flush_line_decoder_jobs(decoder)) {
+                print_framebuffer_too_small(prints);
+                prints += failed;
+        }
+
         if(!pckt) {
                 vf_free(frame);
                 return FALSE;
@@ -1610,6 +1748,8 @@ next_packet:
                 fec_msg->recv_frame->fec_params = fec_desc(fec::fec_type_from_pt(pt), k, m, c, seed);
                 fec_msg->recv_frame->ssrc = ssrc;
                 fec_msg->pckt_list = std::move(pckt_list);
+                fec_msg->pckt_list_len = max_substreams;
+                fec_msg->pckt_pool = &decoder->pckt_pool;
                 fec_msg->received_pkts_cum = stats->received_pkts_cum;
                 fec_msg->expected_pkts_cum = stats->expected_pkts_cum;
                 fec_msg->nanoPerFrameExpected = decoder->frame ? 1000000000 / decoder->frame->fps : 0;
@@ -1628,6 +1768,9 @@ cleanup:
         if(ret != TRUE) {
                 vf_free(frame);
         }
+        if (pckt_list) {
+                decoder->pckt_pool.put(std::move(pckt_list), max_substreams);
+        }
 
         pbuf_data->max_frame_size = max(pbuf_data->max_frame_size, frame_size);
         pbuf_data->decoded++;
@@ -80,6 +80,7 @@
 #include "tv.h"
 #include "transmit.h"
 #include "utils/jpeg_reader.h"
+#include "utils/worker.h"
 #include "video.h"
 #include "video_codec.h"
 
@@ -89,6 +90,8 @@
 
 #define FEC_MAX_MULT 10
 
+#define MIN_PACKETS_PER_ENC_TASK 32 ///< minimal count of packets encrypted by one thread
+
 #ifdef HAVE_MACOSX
 #define GET_STARTTIME gettimeofday(&start, NULL)
 #define GET_STOPTIME gettimeofday(&stop, NULL)
@@ -105,6 +108,13 @@
 
 #define DEFAULT_CIPHER_MODE MODE_AES128_CFB
 
+ADD_TO_PARAM(encryption_mode, "encryption-mode", "* encryption-mode={cfb|ctr|gcm}\n"
+                "  cipher mode used with --encryption (default cfb), gcm is authenticated and\n"
+                "  considerably faster but not supported by older receivers\n");
+ADD_TO_PARAM(encryption_threads, "encryption-threads", "* encryption-threads=<n>\n"
+                "  encrypt all packets of a frame with n threads before sending it (default 1 -\n"
+                "  packets are encrypted one by one by the sending thread)\n");
+
 static void tx_update(struct tx *tx, struct video_frame *frame, int substream);
 static void tx_done(struct module *tx);
 static uint32_t format_interl_fps_hdr_row(enum interlacing_t interlacing, double input_fps);
@@ -142,9 +152,17 @@ struct tx {
 
         const struct openssl_encrypt_info *enc_funcs;
         struct openssl_encrypt *encryption;
+        enum openssl_mode encryption_mode;
+        int enc_threads;
+        struct openssl_encrypt **enc_workers; ///< states of additional enc_threads - 1 threads
+        char *enc_arena;                      ///< sealed packets of current tile, tx->mtu B each
+        int *enc_arena_len;
+        int enc_arena_packets;                ///< capacity of enc_arena (in packets)
         long long int bitrate;
 		
         struct rtpenc_h264_state *rtpenc_h264_state;
+        struct rtpenc_h264_packet *h264_packets; ///< payloads of the last packetized H.264 frame
+        int h264_packets_max;
         char tmp_packet[RTP_MAX_MTU];
 };
 
@@ -224,12 +242,41 @@ struct tx *tx_init(struct module *parent, unsigned mtu, enum tx_media_type media
                                 module_done(&tx->mod);
                                 return NULL;
                         }
+                        tx->encryption_mode = DEFAULT_CIPHER_MODE;
+                        if (get_commandline_param("encryption-mode")) {
+                                const char *mode = get_commandline_param("encryption-mode");
+                                if (strcasecmp(mode, "cfb") == 0) {
+                                        tx->encryption_mode = MODE_AES128_CFB;
+                                } else if (strcasecmp(mode, "ctr") == 0) {
+                                        tx->encryption_mode = MODE_AES128_CTR;
+                                } else if (strcasecmp(mode, "gcm") == 0) {
+                                        tx->encryption_mode = MODE_AES128_GCM;
+                                } else {
+                                        log_msg(LOG_LEVEL_ERROR, "Unknown encryption mode: %s\n", mode);
+                                        module_done(&tx->mod);
+                                        return NULL;
+                                }
+                        }
                         if (tx->enc_funcs->init(&tx->encryption,
-                                                encryption, DEFAULT_CIPHER_MODE) != 0) {
+                                                encryption, tx->encryption_mode) != 0) {
                                 fprintf(stderr, "Unable to initialize encryption\n");
                                 module_done(&tx->mod);
                                 return NULL;
                         }
+                        tx->enc_threads = 1;
+                        if (get_commandline_param("encryption-threads")) {
+                                tx->enc_threads = std::max(atoi(get_commandline_param("encryption-threads")), 1);
+                        }
+                        tx->enc_workers = (struct openssl_encrypt **) calloc(tx->enc_threads,
+                                        sizeof(struct openssl_encrypt *));
+                        for (int i = 0; i < tx->enc_threads - 1; ++i) {
+                                if (tx->enc_funcs->init(&tx->enc_workers[i],
+                                                        encryption, tx->encryption_mode) != 0) {
+                                        fprintf(stderr, "Unable to initialize encryption\n");
+                                        module_done(&tx->mod);
+                                        return NULL;
+                                }
+                        }
                 }
 
                 tx->bitrate = bitrate;
@@ -335,6 +382,16 @@ static void tx_done(struct module *mod)
 {
         struct tx *tx = (struct tx *) mod->priv_data;
         assert(tx->magic == TRANSMIT_MAGIC);
+        for (int i = 0; i < tx->enc_threads - 1; ++i) {
+                if (tx->enc_workers[i]) {
+                        tx->enc_funcs->destroy(tx->enc_workers[i]);
+                }
+        }
+        free(tx->enc_workers);
+        free(tx->enc_arena);
+        free(tx->enc_arena_len);
+        rtpenc_h264_done_state(tx->rtpenc_h264_state);
+        free(tx->h264_packets);
         free(tx);
 }
 
@@ -466,6 +523,81 @@ static inline int get_data_len(bool with_fec, int mtu, int hdrs_len,
         return data_len;
 }
 
+namespace {
+/// position of one packet payload within a tile
+struct tx_packet {
+        unsigned int pos;
+        int data_len;
+        int m;
+};
+
+/// range of packets of a tile encrypted by one thread
+struct tx_enc_task {
+        const struct openssl_encrypt_info *enc_funcs;
+        struct openssl_encrypt *encryption;
+        const struct tx_packet *packets;
+        const char *data;      ///< tile data
+        char *rtp_headers;     ///< used as AAD
+        int rtp_hdr_len;
+        int aad_len;
+        char *arena;
+        int *arena_len;
+        int stride;
+        int from;
+        int to;
+};
+}
+
+static void *tx_encrypt_packets(void *arg)
+{
+        struct tx_enc_task *t = (struct tx_enc_task *) arg;
+        for (int i = t->from; i < t->to; ++i) {
+                if (t->packets[i].data_len == 0) {
+                        t->arena_len[i] = 0;
+                        continue;
+                }
+                t->arena_len[i] = t->enc_funcs->encrypt(t->encryption,
+                                const_cast<char *>(t->data) + t->packets[i].pos, t->packets[i].data_len,
+                                t->rtp_headers + i * t->rtp_hdr_len, t->aad_len,
+                                t->arena + (size_t) i * t->stride);
+        }
+        return NULL;
+}
+
+/**
+ * Encrypts all packets of a tile in parallel into tx->enc_arena. Thread
+ * i uses its own encryption state so no synchronization is needed.
+ */
+static void tx_encrypt_tile(struct tx *tx, const char *data, const struct tx_packet *packets,
+                int packet_count, char *rtp_headers, int rtp_hdr_len, int aad_len)
+{
+        if (tx->enc_arena_packets < packet_count) {
+                free(tx->enc_arena);
+                free(tx->enc_arena_len);
+                tx->enc_arena = (char *) malloc((size_t) packet_count * tx->mtu);
+                tx->enc_arena_len = (int *) malloc(packet_count * sizeof(int));
+                tx->enc_arena_packets = packet_count;
+        }
+
+        int threads = std::min(tx->enc_threads, std::max(packet_count / MIN_PACKETS_PER_ENC_TASK, 1));
+        int per_thread = (packet_count + threads - 1) / threads;
+        struct tx_enc_task tasks[threads];
+        task_result_handle_t handles[threads];
+        for (int i = 0; i < threads; ++i) {
+                tasks[i] = tx_enc_task{tx->enc_funcs, i == threads - 1 ? tx->encryption : tx->enc_workers[i],
+                        packets, data, rtp_headers, rtp_hdr_len, aad_len,
+                        tx->enc_arena, tx->enc_arena_len, (int) tx->mtu,
+                        std::min(i * per_thread, packet_count), std::min((i + 1) * per_thread, packet_count)};
+        }
+        for (int i = 0; i < threads - 1; ++i) {
+                handles[i] = task_run_async(tx_encrypt_packets, &tasks[i]);
+        }
+        tx_encrypt_packets(&tasks[threads - 1]);
+        for (int i = 0; i < threads - 1; ++i) {
+                wait_task(handles[i]);
+        }
+}
+
 static void
 tx_send_base(struct tx *tx, struct video_frame *frame, struct rtp *rtp_session,
                 uint32_t ts, int send_m,
@@ -537,7 +669,7 @@ tx_send_base(struct tx *tx, struct video_frame *frame, struct rtp *rtp_session,
                         hdrs_len += (sizeof(video_payload_hdr_t));
                 }
 
-                encryption_hdr[0] = htonl(DEFAULT_CIPHER_MODE << 24);
+                encryption_hdr[0] = htonl(tx->encryption_mode << 24);
                 hdrs_len += sizeof(crypto_payload_hdr_t) + tx->enc_funcs->get_overhead(tx->encryption);
         } else {
                 if (frame->fec_params.type != FEC_NONE) {
@@ -617,29 +749,23 @@ tx_send_base(struct tx *tx, struct video_frame *frame, struct rtp *rtp_session,
 
         // initialize header array with values (except offset which is different among
         // different packts)
-        void *rtp_headers = malloc(packet_count * rtp_hdr_len);
-        uint32_t *rtp_hdr_packet = (uint32_t *) rtp_headers;
+        char *rtp_headers = (char *) malloc(packet_count * rtp_hdr_len);
         for (int i = 0; i < packet_count; ++i) {
-                memcpy(rtp_hdr_packet, rtp_hdr, rtp_hdr_len);
-                rtp_hdr_packet += rtp_hdr_len / sizeof(uint32_t);
-        }
-        rtp_hdr_packet = (uint32_t *) rtp_headers;
-
-        if (!tx->encryption) {
-                rtp_async_start(rtp_session, packet_count);
+                memcpy(rtp_headers + i * rtp_hdr_len, rtp_hdr, rtp_hdr_len);
         }
 
+        // split the tile into packets first
+        struct tx_packet *packets = (struct tx_packet *) malloc(packet_count * sizeof(struct tx_packet));
+        int packet_idx = 0;
         do {
-                GET_STARTTIME;
                 if(tx->fec_scheme == FEC_MULT) {
                         pos = mult_pos[mult_index];
                 }
 
-                int offset = pos + fragment_offset;
+                assert(packet_idx < packet_count);
+                uint32_t *rtp_hdr_packet = (uint32_t *)(void *) (rtp_headers + packet_idx * rtp_hdr_len);
+                rtp_hdr_packet[1] = htonl(pos + fragment_offset);
 
-                rtp_hdr_packet[1] = htonl(offset);
-
-                data = tile->data + pos;
                 data_len = get_data_len(frame->fec_params.type != FEC_NONE, tx->mtu, hdrs_len,
                                 fec_symbol_size, &fec_symbol_offset);
                 if (pos + data_len >= (unsigned int) tile->data_len) {
@@ -648,52 +774,90 @@ tx_send_base(struct tx *tx, struct video_frame *frame, struct rtp *rtp_session,
                         }
                         data_len = tile->data_len - pos;
                 }
+                packets[packet_idx++] = tx_packet{pos, data_len, m};
                 pos += data_len;
+
+                if(tx->fec_scheme == FEC_MULT) {
+                        mult_pos[mult_index] = pos;
+                        mult_first_sent ++;
+                        if(mult_index != 0 || mult_first_sent >= (tx->mult_count - 1))
+                                        mult_index = (mult_index + 1) % tx->mult_count;
+                }
+
+                /* when trippling, we need all streams goes to end */
+                if(tx->fec_scheme == FEC_MULT) {
+                        pos = mult_pos[tx->mult_count - 1];
+                }
+        } while (pos < (unsigned int) tile->data_len);
+        packet_count = packet_idx;
+
+        int aad_len = frame->fec_params.type != FEC_NONE ? sizeof(fec_video_payload_hdr_t) :
+                sizeof(video_payload_hdr_t);
+        // with encryption threads, whole tile is encrypted before sending
+        bool sealed = tx->encryption && tx->enc_threads > 1;
+        if (sealed) {
+                tx_encrypt_tile(tx, tile->data, packets, packet_count, rtp_headers, rtp_hdr_len, aad_len);
+        }
+
+        // packets sent together (with one syscall), traffic shaper then paces whole batches
+        int batch_size = 1;
+        int batched = 0;
+        bool async = !tx->encryption || sealed; // inline-encrypted data live only on stack
+        if (async) {
+                batch_size = rtp_async_start(rtp_session, packet_count);
+        }
+
+        for (int i = 0; i < packet_count; ++i) {
+                if (batched == 0) {
+                        GET_STARTTIME;
+                }
+
+                char *rtp_hdr_packet = rtp_headers + i * rtp_hdr_len;
+                data = tile->data + packets[i].pos;
+                data_len = packets[i].data_len;
                 if(data_len) { /* check needed for FEC_MULT */
-                        char encrypted_data[data_len + MAX_CRYPTO_EXCEED];
+                        char encrypted_data[sealed ? 1 : data_len + MAX_CRYPTO_EXCEED];
 
-                        if (tx->encryption) {
+                        if (sealed) {
+                                data = tx->enc_arena + (size_t) i * tx->mtu;
+                                data_len = tx->enc_arena_len[i];
+                        } else if (tx->encryption) {
                                 data_len = tx->enc_funcs->encrypt(tx->encryption,
                                                 data, data_len,
-                                                (char *) rtp_hdr_packet,
-                                                frame->fec_params.type != FEC_NONE ? sizeof(fec_video_payload_hdr_t) :
-                                                sizeof(video_payload_hdr_t),
+                                                rtp_hdr_packet, aad_len,
                                                 encrypted_data);
                                 data = encrypted_data;
                         }
 
-                        rtp_send_data_hdr(rtp_session, ts, pt, m, 0, 0,
-                                  (char *) rtp_hdr_packet, rtp_hdr_len,
+                        rtp_send_data_hdr(rtp_session, ts, pt, packets[i].m, 0, 0,
+                                  rtp_hdr_packet, rtp_hdr_len,
                                   data, data_len, 0, 0, 0);
                 }
 
-                if(tx->fec_scheme == FEC_MULT) {
-                        mult_pos[mult_index] = pos;
-                        mult_first_sent ++;
-                        if(mult_index != 0 || mult_first_sent >= (tx->mult_count - 1))
-                                        mult_index = (mult_index + 1) % tx->mult_count;
+                bool last = i == packet_count - 1;
+                if (++batched < batch_size && !last) {
+                        continue;
                 }
-
-                /* when trippling, we need all streams goes to end */
-                if(tx->fec_scheme == FEC_MULT) {
-                        pos = mult_pos[tx->mult_count - 1];
+                if (batch_size > 1) {
+                        rtp_async_flush(rtp_session);
                 }
-                rtp_hdr_packet += rtp_hdr_len / sizeof(uint32_t);
 
                 // TRAFFIS SHAPER
-                if (pos < (unsigned int) tile->data_len) { // wait for all but last packet
+                if (!last) { // wait for all but last packet
                         do {
                                 GET_STOPTIME;
                                 GET_DELTA;
-                        } while (packet_rate - delta - overslept > 0);
-                        overslept = -(packet_rate - delta - overslept);
+                        } while (packet_rate * batched - delta - overslept > 0);
+                        overslept = -(packet_rate * batched - delta - overslept);
                         //fprintf(stdout, "%ld ", overslept);
                 }
-        } while (pos < (unsigned int) tile->data_len);
+                batched = 0;
+        }
 
-        if (!tx->encryption) {
+        if (async) {
                 rtp_async_wait(rtp_session);
         }
+        free(packets);
         free(rtp_headers);
 }
 
@@ -743,7 +907,7 @@ void audio_tx_send(struct tx* tx, struct rtp *rtp_session, const audio_frame2 *
 
         int hdrs_len = (rtp_is_ipv6(rtp_session) ? 40 : 20) + 8 + 12 + sizeof(audio_payload_hdr_t); // MTU - IP hdr - UDP hdr - RTP hdr - payload_hdr
         if(tx->encryption) {
-                hdrs_len += sizeof(crypto_payload_hdr_t);
+                hdrs_len += sizeof(crypto_payload_hdr_t) + tx->enc_funcs->get_overhead(tx->encryption);
         }
 
         for(channel = 0; channel < buffer->get_channel_count(); ++channel)
@@ -824,7 +988,7 @@ void audio_tx_send(struct tx* tx, struct rtp *rtp_session, const audio_frame2 *
                         if(data_len) { /* check needed for FEC_MULT */
                                 char encrypted_data[data_len + MAX_CRYPTO_EXCEED];
                                 if(tx->encryption) {
-                                        crypto_hdr[0] = htonl(DEFAULT_CIPHER_MODE << 24);
+                                        crypto_hdr[0] = htonl(tx->encryption_mode << 24);
                                         data_len = tx->enc_funcs->encrypt(tx->encryption,
                                                         const_cast<char *>(data), data_len,
                                                         (char *) audio_hdr, sizeof(audio_payload_hdr_t),
@@ -945,38 +1109,43 @@ void audio_tx_send_standard(struct tx* tx, struct rtp *rtp_session,
 	} while (pos < data_len);
 }
 
+static struct rtpenc_h264_packet *tx_add_h264_packet(struct tx *tx, int *count)
+{
+        if (*count == tx->h264_packets_max) {
+                tx->h264_packets_max = std::max(2 * tx->h264_packets_max, 64);
+                tx->h264_packets = (struct rtpenc_h264_packet *) realloc(tx->h264_packets,
+                                tx->h264_packets_max * sizeof(struct rtpenc_h264_packet));
+        }
+        struct rtpenc_h264_packet *pkt = &tx->h264_packets[(*count)++];
+        memset(pkt, 0, sizeof *pkt);
+        return pkt;
+}
+
 /**
- *  H.264 standard transmission
+ * Splits H.264 Annex-B frame to RTP payloads (single NAL unit packets or
+ * FU-A fragments) stored in tx->h264_packets. Payloads point to the frame
+ * data.
+ *
+ * @returns number of packets
  */
-void tx_send_h264(struct tx *tx, struct video_frame *frame,
-		struct rtp *rtp_session) {
-        assert(frame->tile_count == 1); // std transmit doesn't handle more than one tile
-        assert(!frame->fragment || tx->fec_scheme == FEC_NONE); // currently no support for FEC with fragments
-        assert(!frame->fragment || frame->tile_count); // multiple tiles are not currently supported for fragmented send
-        uint32_t ts = get_std_video_local_mediatime();
-        struct tile *tile = &frame->tiles[0];
-
-	char pt = RTPENC_H264_PT;
-	unsigned char hdr[2];
-	int cc = 0;
-	uint32_t csrc = 0;
-	int m = 0;
-	char *extn = 0;
-	uint16_t extn_len = 0;
-	uint16_t extn_type = 0;
-	unsigned nalsize = 0;
+static int tx_packetize_h264(struct tx *tx, struct video_frame *frame)
+{
+	struct rtpenc_h264_state *st = tx->rtpenc_h264_state;
+	struct tile *tile = &frame->tiles[0];
+	unsigned char hdr[2] = { 0, 0 };
+	int count = 0;
 	uint8_t *data = (uint8_t *) tile->data;
-	int data_len = tile->data_len;
-	tx->rtpenc_h264_state->maxPacketSize = tx->mtu - 40;
-	tx->rtpenc_h264_state->haveSeenEOF = false;
-	tx->rtpenc_h264_state->haveSeenFirstStartCode = false;
+	unsigned maxPacketSize = tx->mtu - 40;
 
-	while ((nalsize = rtpenc_h264_frame_parse(tx->rtpenc_h264_state, data, data_len)) > 0) {
+	int nal_count = rtpenc_h264_find_nals(st, data, tile->data_len);
+	for (int i = 0; i < nal_count; ++i) {
+		uint8_t *from = data + st->nals[i].offset;
+		unsigned nalsize = st->nals[i].len;
+		bool lastNALUnit = i == nal_count - 1;
+		unsigned curNALOffset = 0;
+		bool lastNALUnitFragment = false;
 
-		tx->rtpenc_h264_state->curNALOffset = 0;
-		tx->rtpenc_h264_state->lastNALUnitFragment = false; // by default
-
-		while(!tx->rtpenc_h264_state->lastNALUnitFragment){
+		while(!lastNALUnitFragment){
 			// We have NAL unit data in the buffer.  There are three cases to consider:
 			// 1. There is a new NAL unit in the buffer, and it's small enough to deliver
 			//    to the RTP sink (as is).
@@ -987,32 +1156,27 @@ void tx_send_h264(struct tx *tx, struct video_frame *frame,
 			//    fragment(s) of this.  Deliver the next fragment of this data,
 			//    as a FU packet, with two (H.264) extra preceding header bytes
 			//    (for the "NAL header" and the "FU header").
-			if (tx->rtpenc_h264_state->curNALOffset == 0) { // case 1 or 2
-				if (nalsize	<= tx->rtpenc_h264_state->maxPacketSize) { // case 1
-
-					if (tx->rtpenc_h264_state->haveSeenEOF) m = 1;
-					if (rtp_send_data(rtp_session, ts, pt, m, cc, &csrc,
-							(char *) tx->rtpenc_h264_state->from, nalsize,
-							extn, extn_len, extn_type) < 0) {
-						error_msg("There was a problem sending the RTP packet\n");
-					}
-					tx->rtpenc_h264_state->lastNALUnitFragment = true;
+			struct rtpenc_h264_packet *pkt = tx_add_h264_packet(tx, &count);
+			if (curNALOffset == 0) { // case 1 or 2
+				if (nalsize	<= maxPacketSize) { // case 1
+					pkt->m = lastNALUnit;
+					pkt->data = from;
+					pkt->len = nalsize;
+					lastNALUnitFragment = true;
 				} else { // case 2
 					// We need to send the NAL unit data as FU packets.  Deliver the first
 					// packet now.  Note that we add "NAL header" and "FU header" bytes to the front
 					// of the packet (overwriting the existing "NAL header").
-					hdr[0] = (tx->rtpenc_h264_state->firstByteOfNALUnit & 0xE0) | 28; //FU indicator
-					hdr[1] = 0x80 | (tx->rtpenc_h264_state->firstByteOfNALUnit & 0x1F); // FU header (with S bit)
-
-					if (rtp_send_data_hdr(rtp_session, ts, pt, m, cc, &csrc,
-									(char *) hdr, 2,
-									(char *) tx->rtpenc_h264_state->from + 1, tx->rtpenc_h264_state->maxPacketSize - 2,
-									extn, extn_len, extn_type) < 0) {
-										error_msg("There was a problem sending the RTP packet\n");
-					}
-					tx->rtpenc_h264_state->curNALOffset += tx->rtpenc_h264_state->maxPacketSize - 1;
-					tx->rtpenc_h264_state->lastNALUnitFragment = false;
-					nalsize -= tx->rtpenc_h264_state->maxPacketSize - 1;
+					hdr[0] = (from[0] & 0xE0) | 28; //FU indicator
+					hdr[1] = 0x80 | (from[0] & 0x1F); // FU header (with S bit)
+
+					memcpy(pkt->hdr, hdr, 2);
+					pkt->hdr_len = 2;
+					pkt->data = from + 1;
+					pkt->len = maxPacketSize - 2;
+					curNALOffset += maxPacketSize - 1;
+					lastNALUnitFragment = false;
+					nalsize -= maxPacketSize - 1;
 				}
 			} else { // case 3
 				// We are sending this NAL unit data as FU packets.  We've already sent the
@@ -1022,39 +1186,78 @@ void tx_send_h264(struct tx *tx, struct video_frame *frame,
 				// bit if this is the last fragment.)
 				hdr[1] = hdr[1] & ~0x80;// FU header (no S bit)
 
-				if (nalsize + 1 > tx->rtpenc_h264_state->maxPacketSize) {
+				pkt->hdr_len = 2;
+				pkt->data = from + curNALOffset;
+				if (nalsize + 1 > maxPacketSize) {
 					// We can't send all of the remaining data this time:
-					if (rtp_send_data_hdr(rtp_session, ts, pt, m, cc, &csrc,
-							(char *) hdr, 2,
-							(char *) tx->rtpenc_h264_state->from + tx->rtpenc_h264_state->curNALOffset,
-							tx->rtpenc_h264_state->maxPacketSize - 2, extn, extn_len,
-							extn_type) < 0) {
-								error_msg("There was a problem sending the RTP packet\n");
-					}
-					tx->rtpenc_h264_state->curNALOffset += tx->rtpenc_h264_state->maxPacketSize - 2;
-					tx->rtpenc_h264_state->lastNALUnitFragment = false;
-					nalsize -= tx->rtpenc_h264_state->maxPacketSize - 2;
-
+					pkt->len = maxPacketSize - 2;
+					curNALOffset += maxPacketSize - 2;
+					lastNALUnitFragment = false;
+					nalsize -= maxPacketSize - 2;
 				} else {
 					// This is the last fragment:
-					if (tx->rtpenc_h264_state->haveSeenEOF) m = 1;
-
+					pkt->m = lastNALUnit;
 					hdr[1] |= 0x40;// set the E bit in the FU header
-
-					if (rtp_send_data_hdr(rtp_session, ts, pt, m, cc, &csrc,
-									(char *) hdr, 2,
-									(char *) tx->rtpenc_h264_state->from + tx->rtpenc_h264_state->curNALOffset,
-									nalsize, extn, extn_len, extn_type) < 0) {
-										error_msg("There was a problem sending the RTP packet\n");
-					}
-					tx->rtpenc_h264_state->lastNALUnitFragment = true;
+					pkt->len = nalsize;
+					lastNALUnitFragment = true;
 				}
+				memcpy(pkt->hdr, hdr, 2);
 			}
 		}
+	}
+
+	return count;
+}
+
+/**
+ *  H.264 standard transmission
+ */
+void tx_send_h264(struct tx *tx, struct video_frame *frame,
+		struct rtp *rtp_session) {
+	tx_send_h264_multi(tx, frame, &rtp_session, 1);
+}
+
+/**
+ * Sends H.264 frame to multiple RTP sessions. The frame is parsed and
+ * fragmented only once, per-session RTP headers (SSRC, sequence number) are
+ * created by rtp_send_data*().
+ */
+void tx_send_h264_multi(struct tx *tx, struct video_frame *frame,
+		struct rtp **rtp_sessions, int session_count) {
+        assert(frame->tile_count == 1); // std transmit doesn't handle more than one tile
+        assert(!frame->fragment || tx->fec_scheme == FEC_NONE); // currently no support for FEC with fragments
+        assert(!frame->fragment || frame->tile_count); // multiple tiles are not currently supported for fragmented send
+        uint32_t ts = get_std_video_local_mediatime();
 
-		if (tx->rtpenc_h264_state->haveSeenEOF){
-			return;
+	char pt = RTPENC_H264_PT;
+	int cc = 0;
+	uint32_t csrc = 0;
+	char *extn = 0;
+	uint16_t extn_len = 0;
+	uint16_t extn_type = 0;
+
+	int count = tx_packetize_h264(tx, frame);
+
+	for (int i = 0; i < session_count; ++i) {
+		rtp_async_start(rtp_sessions[i], count);
+		for (int j = 0; j < count; ++j) {
+			struct rtpenc_h264_packet *pkt = &tx->h264_packets[j];
+			int ret;
+			if (pkt->hdr_len == 0) {
+				ret = rtp_send_data(rtp_sessions[i], ts, pt, pkt->m, cc, &csrc,
+						(char *) pkt->data, pkt->len,
+						extn, extn_len, extn_type);
+			} else {
+				ret = rtp_send_data_hdr(rtp_sessions[i], ts, pt, pkt->m, cc, &csrc,
+						(char *) pkt->hdr, pkt->hdr_len,
+						(char *) pkt->data, pkt->len,
+						extn, extn_len, extn_type);
+			}
+			if (ret < 0) {
+				error_msg("There was a problem sending the RTP packet\n");
+			}
 		}
+		rtp_async_wait(rtp_sessions[i]);
 	}
 }
 
@@ -93,6 +93,10 @@ typedef enum {
         HFYU,     ///< HuffYUV
         FFV1,     ///< FFV1
         CFHD,     ///< Cineform
+        I420,     ///< planar YCbCr 420 8-bit - Y plane followed by Cb and Cr planes
+        NV12,     ///< semi-planar YCbCr 420 8-bit - Y plane followed by interleaved CbCr plane
+        P010,     ///< semi-planar YCbCr 420 10-bit - as NV12 but 16-bit little-endian samples, MSB aligned
+        I210,     ///< planar YCbCr 422 10-bit - as I420 (422 subsampled) but 16-bit little-endian samples, LSB aligned
         VIDEO_CODEC_COUNT ///< count of known video codecs (including VIDEO_CODEC_NONE)
 } codec_t;
 
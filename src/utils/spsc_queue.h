@@ -0,0 +1,255 @@
+/**
+ * @file   utils/spsc_queue.h
+ * @brief  bounded lock-free single-producer/single-consumer queue
+ */
+/*
+ * Copyright (c) 2018 CESNET z.s.p.o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SPSC_QUEUE_H_
+#define SPSC_QUEUE_H_
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+#ifdef HAVE_LINUX
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+#define SPSC_CACHE_LINE 64
+
+/**
+ * @brief bounded lock-free single-producer/single-consumer queue
+ *
+ * Producer and consumer indices live in separate cache lines. The consumer
+ * may block in wait_not_empty(), the producer wakes it with notify() - the
+ * wakeup is issued only when the consumer actually sleeps (ie. on empty ->
+ * non-empty transition), so the producer should call notify() once after
+ * pushing a batch of items.
+ *
+ * Queue also keeps statistics (drops and high-water mark) for sizing.
+ *
+ * @tparam T type to be stored (should be cheap to copy)
+ */
+template<typename T>
+class spsc_queue {
+public:
+        /// @param capacity minimal capacity (rounded up to power of two)
+        explicit spsc_queue(unsigned int capacity) : m_mask(round_pow2(capacity) - 1),
+                m_items(new T[m_mask + 1])
+        {
+#ifdef HAVE_LINUX
+                m_event_fd = eventfd(0, EFD_NONBLOCK);
+#endif
+        }
+
+        ~spsc_queue()
+        {
+#ifdef HAVE_LINUX
+                if (m_event_fd != -1) {
+                        close(m_event_fd);
+                }
+#endif
+        }
+
+        spsc_queue(spsc_queue const &) = delete;
+        spsc_queue & operator=(spsc_queue const &) = delete;
+
+        /**
+         * Producer only.
+         * @retval false if queue is full (counted as drop)
+         */
+        bool push(T const & item)
+        {
+                unsigned int tail = m_tail.load(std::memory_order_relaxed);
+                if (tail - m_head_cached > m_mask) {
+                        m_head_cached = m_head.load(std::memory_order_acquire);
+                        if (tail - m_head_cached > m_mask) {
+                                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                                return false;
+                        }
+                }
+                m_items[tail & m_mask] = item;
+                m_tail.store(tail + 1, std::memory_order_release);
+                return true;
+        }
+
+        /**
+         * Producer only - wakes up consumer blocked in wait_not_empty() (if any).
+         */
+        void notify()
+        {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (!m_consumer_waiting.load(std::memory_order_relaxed) ||
+                                !m_consumer_waiting.exchange(false)) {
+                        return;
+                }
+#ifdef HAVE_LINUX
+                uint64_t val = 1;
+                ssize_t ret = write(m_event_fd, &val, sizeof val);
+                (void) ret;
+#else
+                std::lock_guard<std::mutex> lk(m_lock);
+                m_cv.notify_one();
+#endif
+        }
+
+        /**
+         * Consumer only.
+         * @retval false if queue is empty
+         */
+        bool pop(T & item)
+        {
+                unsigned int head = m_head.load(std::memory_order_relaxed);
+                if (head == m_tail_cached && refresh_tail(head) == 0) {
+                        return false;
+                }
+                item = m_items[head & m_mask];
+                m_head.store(head + 1, std::memory_order_release);
+                return true;
+        }
+
+        /**
+         * Consumer only - waits until there is an item in the queue.
+         * @param timeout_us timeout in microseconds, negative value means infinity
+         * @retval true if the queue is not empty
+         */
+        bool wait_not_empty(long long timeout_us)
+        {
+                auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+                while (empty()) {
+                        long long remaining_us = -1;
+                        if (timeout_us >= 0) {
+                                remaining_us = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+                                if (remaining_us <= 0) {
+                                        return false;
+                                }
+                        }
+                        m_consumer_waiting.store(true);
+                        if (empty_seq_cst()) {
+                                sleep(remaining_us);
+                        }
+                        m_consumer_waiting.store(false);
+                }
+                return true;
+        }
+
+        /// Consumer only
+        bool empty()
+        {
+                unsigned int head = m_head.load(std::memory_order_relaxed);
+                return head == m_tail_cached && refresh_tail(head) == 0;
+        }
+
+        /// approximate when called concurrently
+        unsigned int size() const {
+                return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+        }
+        unsigned int capacity() const { return m_mask + 1; }
+        unsigned int max_occupancy() const { return m_max_occupancy.load(std::memory_order_relaxed); }
+        unsigned long long dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+        static unsigned int round_pow2(unsigned int val) {
+                unsigned int ret = 1;
+                while (ret < val) {
+                        ret <<= 1;
+                }
+                return ret;
+        }
+
+        /// Consumer only - updates cached producer position, returns occupancy
+        unsigned int refresh_tail(unsigned int head) {
+                m_tail_cached = m_tail.load(std::memory_order_acquire);
+                unsigned int occupancy = m_tail_cached - head;
+                // sampled whenever the consumer catches up with the cached position
+                if (occupancy > m_max_occupancy.load(std::memory_order_relaxed)) {
+                        m_max_occupancy.store(occupancy, std::memory_order_relaxed);
+                }
+                return occupancy;
+        }
+
+        bool empty_seq_cst() {
+                return m_head.load() == m_tail.load();
+        }
+
+        void sleep(long long timeout_us) {
+#ifdef HAVE_LINUX
+                struct pollfd pfd = { m_event_fd, POLLIN, 0 };
+                if (poll(&pfd, 1, timeout_us < 0 ? -1 : (int) ((timeout_us + 999) / 1000)) > 0) {
+                        uint64_t val;
+                        ssize_t ret = read(m_event_fd, &val, sizeof val);
+                        (void) ret;
+                }
+#else
+                std::unique_lock<std::mutex> lk(m_lock);
+                auto pred = [this]{ return !m_consumer_waiting.load() || !empty_seq_cst(); };
+                if (timeout_us < 0) {
+                        m_cv.wait(lk, pred);
+                } else {
+                        m_cv.wait_for(lk, std::chrono::microseconds(timeout_us), pred);
+                }
+#endif
+        }
+
+        const unsigned int m_mask;
+        std::unique_ptr<T[]> m_items;
+
+        // padding keeps producer and consumer data in separate cache lines
+        // (alignas would require C++17 aligned new for heap-allocated queues)
+        char m_pad0[SPSC_CACHE_LINE];
+        std::atomic<unsigned int> m_head{0};                          ///< consumer position
+        unsigned int m_tail_cached = 0;                               ///< consumer's copy of m_tail
+        std::atomic<unsigned int> m_max_occupancy{0};                 ///< sampled by consumer
+        std::atomic<bool> m_consumer_waiting{false};
+
+        char m_pad1[SPSC_CACHE_LINE];
+        std::atomic<unsigned int> m_tail{0};                          ///< producer position
+        unsigned int m_head_cached = 0;                               ///< producer's copy of m_head
+        std::atomic<unsigned long long> m_dropped{0};
+
+        char m_pad2[SPSC_CACHE_LINE];
+#ifdef HAVE_LINUX
+        int m_event_fd = -1;
+#else
+        std::mutex m_lock;
+        std::condition_variable m_cv;
+#endif
+};
+
+#endif // SPSC_QUEUE_H_
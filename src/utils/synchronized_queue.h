@@ -56,11 +56,15 @@ struct msg_quit : public msg {};
  * if there is no element in the queue.
  *
  * @tparam T type to be stored
- * @tparam max_len maximal length of the queue until it bloks (-1 means unlimited)
+ * @tparam max_len maximal length of the queue until it bloks (-1 means unlimited),
+ *                 may be overriden at runtime by the constructor parameter
  */
 template<typename T = struct msg *, int max_len = 1>
 class synchronized_queue {
 public:
+        synchronized_queue() : m_max_len(max_len) {}
+        explicit synchronized_queue(int len) : m_max_len(len) {}
+
         int size()
         {
                 std::unique_lock<std::mutex> l(m_lock);
@@ -70,8 +74,8 @@ public:
         void push(T const & message)
         {
                 std::unique_lock<std::mutex> l(m_lock);
-                if (max_len != -1) {
-                        m_queue_decremented.wait(l, [this]{return m_queue.size() < (unsigned int) max_len;});
+                if (m_max_len != -1) {
+                        m_queue_decremented.wait(l, [this]{return m_queue.size() < (unsigned int) m_max_len;});
                 }
                 m_queue.push(message);
                 l.unlock();
@@ -81,8 +85,8 @@ public:
         void push(T && message)
         {
                 std::unique_lock<std::mutex> l(m_lock);
-                if (max_len != -1) {
-                        m_queue_decremented.wait(l, [this]{return m_queue.size() < (unsigned int) max_len;});
+                if (m_max_len != -1) {
+                        m_queue_decremented.wait(l, [this]{return m_queue.size() < (unsigned int) m_max_len;});
                 }
                 m_queue.push(std::move(message));
                 l.unlock();
@@ -107,6 +111,7 @@ public:
 
 
 private:
+        int                     m_max_len;
         std::queue<T>           m_queue;
         std::mutex              m_lock;
         std::condition_variable m_queue_decremented;
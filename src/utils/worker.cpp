@@ -51,209 +51,353 @@
 #include "config_win32.h"
 #endif // HAVE_CONFIG_H
 
+#include "debug.h"
+#include "host.h"
 #include "utils/worker.h"
 
-#include <algorithm>
-#include <queue>
-#include <set>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#define MOD_NAME "[worker] "
+#define SLOT_CHUNK 64 ///< task slots allocated at once
 
 using namespace std;
 
-struct wp_worker;
-
-struct worker_state_observer {
-        virtual ~worker_state_observer() {}
-        virtual void notify(wp_worker *) = 0;
+ADD_TO_PARAM(worker_threads, "worker-threads",
+                "* worker-threads=<n>\n"
+                "  Number of threads of the shared worker pool (default number of CPUs)\n");
+ADD_TO_PARAM(worker_affinity, "worker-affinity",
+                "* worker-affinity\n"
+                "  Pin worker pool threads to CPUs (grouped by NUMA nodes)\n");
+
+namespace {
+
+enum {
+        TASK_QUEUED     = 0,
+        TASK_RUNNING    = 1,
+        TASK_DONE       = 2,
+        TASK_STATE_MASK = 3,
+        TASK_GEN_STEP   = 4,
 };
 
 /**
- * @brief Holds data to be passed to worker.
+ * @brief Task slot
+ *
+ * Slots are reused for subsequent tasks so that submitting a task doesn't
+ * allocate. Upper bits of m_state hold a generation number so that a stale
+ * queue entry never claims a task submitted later to the same slot.
  */
-struct wp_task_data {
-        wp_task_data(runnable_t task, void *data, wp_worker *w, bool detached) : m_task(task), m_data(data),
-                m_result(0), m_returned(false), m_w(w), m_detached(detached) {}
-        runnable_t m_task;
-        void *m_data;
-        void *m_result;
-        bool m_returned;
-        struct wp_worker *m_w;
-        bool m_detached;
+struct wp_task {
+        runnable_t         m_task;
+        void              *m_data;
+        void              *m_result;
+        bool               m_detached;
+        atomic<uint64_t>   m_state{0};
+        mutex              m_lock;
+        condition_variable m_done_cv;
+        wp_task           *m_next_free;
+};
+
+/// queue entry - claimed only if the task state still equals to @ref state
+struct wp_entry {
+        wp_task  *task;
+        uint64_t  state;
 };
 
-/**
- * @brief This class represents a worker that is called from within the pool
- */
 struct wp_worker {
-        wp_worker(worker_state_observer &observer) :
-                m_state_observer(observer)
-        {
-                int ret;
-                ret = pthread_mutex_init(&m_lock, NULL);
-                assert(ret == 0);
-                ret = pthread_cond_init(&m_task_ready_cv, NULL);
-                assert(ret == 0);
-                ret = pthread_cond_init(&m_task_completed_cv, NULL);
-                assert(ret == 0);
-
-                ret = pthread_create(&m_thread_id, NULL, wp_worker::enter_loop, this);
-                assert(ret == 0);
-        }
-        ~wp_worker() {
-                wp_task_data *poisoned = new wp_task_data(NULL, NULL, this, false);
-                this->push(poisoned);
-
-                pthread_join(m_thread_id, NULL);
-                pthread_mutex_destroy(&m_lock);
-                pthread_cond_destroy(&m_task_ready_cv);
-                pthread_cond_destroy(&m_task_completed_cv);
-        }
-        static void      *enter_loop(void *args);
-        void              run();
+        mutex           m_lock;
+        deque<wp_entry> m_queue;   ///< owner pops from back, others steal from front
+        thread          m_thread;
+        vector<int>     m_victims; ///< workers to steal from, those from the same NUMA node first
+};
 
-        void              push(wp_task_data *);
-        void             *pop(wp_task_data *);
+thread_local int current_worker = -1; ///< index of the worker running the thread, -1 if not a worker
 
-        queue<wp_task_data*> m_data;
-        pthread_mutex_t   m_lock;
-        pthread_cond_t    m_task_ready_cv;
-        pthread_cond_t    m_task_completed_cv;
-        pthread_t         m_thread_id;
+/**
+ * @returns list of (NUMA node, CPU) pairs ordered by nodes, empty if unknown
+ */
+vector<pair<int, int>> get_numa_cpus()
+{
+        vector<pair<int, int>> ret;
+#ifdef __linux__
+        const int max_nodes = 64;
+        for (int node = 0; node < max_nodes; ++node) {
+                ifstream f("/sys/devices/system/node/node" + to_string(node) + "/cpulist");
+                string range;
+                while (f && getline(f, range, ',')) { // eg. "0-7,16-23"
+                        int first = 0, last = 0;
+                        char dash = '\0';
+                        istringstream iss(range);
+                        iss >> first;
+                        last = (iss >> dash >> last) ? last : first;
+                        for (int cpu = first; cpu <= last; ++cpu) {
+                                ret.push_back({node, cpu});
+                        }
+                }
+        }
+#endif
+        return ret;
+}
 
-        worker_state_observer &m_state_observer;
+/**
+ * @brief Fixed-size pool of threads shared by all users of task_run_async().
+ *
+ * Every worker has its own queue, a task submitted from a worker goes to its
+ * queue, otherwise queues are used round-robin. Idle workers steal from other
+ * queues. A task waited for that hasn't been started yet is run by the
+ * waiting thread itself, so nested tasks cannot deadlock the pool.
+ */
+class worker_pool {
+public:
+        ~worker_pool();
+        task_result_handle_t run_async(runnable_t task, void *data, bool detached);
+        void *wait_task(task_result_handle_t handle);
+        int size();
+
+private:
+        void start();
+        void worker_loop(int idx);
+        bool pop(int idx, wp_entry *e);
+        void run(wp_task *t);
+        wp_task *alloc_slot();
+        void free_slot(wp_task *t);
+
+        once_flag                    m_started;
+        vector<unique_ptr<wp_worker>> m_workers;
+
+        mutex                        m_lock;       ///< protects members below
+        condition_variable           m_work_cv;
+        int                          m_pending = 0; ///< queued entries not yet reserved by a worker
+        bool                         m_exit = false;
+        unsigned int                 m_next_queue = 0;
+        wp_task                     *m_free = nullptr;
+        vector<unique_ptr<wp_task[]>> m_slots;
 };
 
-void *wp_worker::enter_loop(void *args) {
-        wp_worker *instance = (wp_worker *) args;
-        instance->run();
-
-        return NULL;
+worker_pool::~worker_pool()
+{
+        {
+                lock_guard<mutex> lk(m_lock);
+                m_exit = true;
+        }
+        m_work_cv.notify_all();
+        for (auto & w : m_workers) {
+                if (w->m_thread.get_id() == this_thread::get_id()) {
+                        w->m_thread.detach(); // exit() called from within a task
+                } else {
+                        w->m_thread.join();
+                }
+        }
 }
 
-void wp_worker::run() {
-        while(1) {
-                struct wp_task_data *data;
-                pthread_mutex_lock(&m_lock);
-                while(m_data.empty()) {
-                        pthread_cond_wait(&m_task_ready_cv, &m_lock);
+void worker_pool::start()
+{
+        call_once(m_started, [this]() {
+                int count = thread::hardware_concurrency();
+                if (get_commandline_param("worker-threads")) {
+                        count = atoi(get_commandline_param("worker-threads"));
                 }
-                data = m_data.front();
-                m_data.pop();
-                pthread_mutex_unlock(&m_lock);
-
-                // poisoned pill
-                if(data->m_task == NULL) {
-                        delete data;
-                        return;
+                count = max(count, 1);
+
+                auto cpus = get_numa_cpus();
+                bool pin = get_commandline_param("worker-affinity") != nullptr && !cpus.empty();
+                auto node_of = [&](int i) { return cpus.empty() ? 0 : cpus[i % cpus.size()].first; };
+
+                for (int i = 0; i < count; ++i) {
+                        m_workers.emplace_back(new wp_worker);
+                        for (int j = 1; j < count; ++j) { // same node first
+                                if (node_of((i + j) % count) == node_of(i)) {
+                                        m_workers[i]->m_victims.push_back((i + j) % count);
+                                }
+                        }
+                        for (int j = 1; j < count; ++j) {
+                                if (node_of((i + j) % count) != node_of(i)) {
+                                        m_workers[i]->m_victims.push_back((i + j) % count);
+                                }
+                        }
+                }
+                for (int i = 0; i < count; ++i) {
+                        m_workers[i]->m_thread = thread(&worker_pool::worker_loop, this, i);
+#ifdef __linux__
+                        if (pin) {
+                                cpu_set_t set;
+                                CPU_ZERO(&set);
+                                CPU_SET(cpus[i % cpus.size()].second, &set);
+                                if (pthread_setaffinity_np(m_workers[i]->m_thread.native_handle(), sizeof set, &set) != 0) {
+                                        log_msg(LOG_LEVEL_WARNING, MOD_NAME "Unable to set affinity of thread %d\n", i);
+                                }
+                        }
+#endif
                 }
+                log_msg(LOG_LEVEL_VERBOSE, MOD_NAME "Started %d threads%s.\n", count,
+                                pin ? " pinned to CPUs" : "");
+        });
+}
 
-                void *res = data->m_task(data->m_data);
+int worker_pool::size()
+{
+        start();
+        return m_workers.size();
+}
 
-                pthread_mutex_lock(&m_lock);
-                data->m_result = res;
-                data->m_returned = true;
-                pthread_cond_signal(&m_task_completed_cv);
-                m_state_observer.notify(this);
-                if (data->m_detached) {
-                        delete data;
+wp_task *worker_pool::alloc_slot()
+{
+        lock_guard<mutex> lk(m_lock);
+        if (!m_free) {
+                m_slots.emplace_back(new wp_task[SLOT_CHUNK]);
+                for (int i = 0; i < SLOT_CHUNK; ++i) {
+                        m_slots.back()[i].m_next_free = m_free;
+                        m_free = &m_slots.back()[i];
                 }
-                pthread_mutex_unlock(&m_lock);
         }
+        wp_task *t = m_free;
+        m_free = t->m_next_free;
+        return t;
 }
 
-void wp_worker::push(wp_task_data *data) {
-        pthread_mutex_lock(&m_lock);
-        assert(m_data.size() == 0);
-        m_data.push(data);
-        pthread_cond_signal(&m_task_ready_cv);
-        pthread_mutex_unlock(&m_lock);
+void worker_pool::free_slot(wp_task *t)
+{
+        lock_guard<mutex> lk(m_lock);
+        t->m_next_free = m_free;
+        m_free = t;
 }
 
-void *wp_worker::pop(wp_task_data *d) {
-        void *res = NULL;
-
-        pthread_mutex_lock(&m_lock);
-        while(!d->m_returned) {
-                pthread_cond_wait(&m_task_completed_cv, &m_lock);
+/**
+ * Takes an entry from the worker's own queue or steals one from the others.
+ */
+bool worker_pool::pop(int idx, wp_entry *e)
+{
+        {
+                wp_worker &w = *m_workers[idx];
+                lock_guard<mutex> lk(w.m_lock);
+                if (!w.m_queue.empty()) {
+                        *e = w.m_queue.back();
+                        w.m_queue.pop_back();
+                        return true;
+                }
         }
-        res = d->m_result;
-        delete d;
-        pthread_mutex_unlock(&m_lock);
-
-        return res;
+        for (int v : m_workers[idx]->m_victims) {
+                wp_worker &w = *m_workers[v];
+                lock_guard<mutex> lk(w.m_lock);
+                if (!w.m_queue.empty()) {
+                        *e = w.m_queue.front();
+                        w.m_queue.pop_front();
+                        return true;
+                }
+        }
+        return false;
 }
 
-static void func_delete(wp_worker *arg) {
-        delete arg;
+void worker_pool::run(wp_task *t)
+{
+        void *res = t->m_task(t->m_data);
+
+        uint64_t gen = t->m_state.load() & ~(uint64_t) TASK_STATE_MASK;
+        if (t->m_detached) {
+                t->m_state.store(gen | TASK_DONE);
+                free_slot(t);
+                return;
+        }
+        lock_guard<mutex> lk(t->m_lock);
+        t->m_result = res;
+        t->m_state.store(gen | TASK_DONE);
+        t->m_done_cv.notify_all();
 }
 
-class worker_pool : public worker_state_observer
+void worker_pool::worker_loop(int idx)
 {
-        public:
-                worker_pool() {
-                        pthread_mutex_init(&m_lock, NULL);
-                        pthread_cond_init(&m_worker_finished, NULL);
-                }
-
-                ~worker_pool() {
-                        pthread_mutex_lock(&m_lock);
-                        while (m_occupied_workers.size() > 0) {
-                                pthread_cond_wait(&m_worker_finished, &m_lock);
+        current_worker = idx;
+        while (true) {
+                {
+                        unique_lock<mutex> lk(m_lock);
+                        m_work_cv.wait(lk, [this]{ return m_pending > 0 || m_exit; });
+                        if (m_pending == 0) {
+                                return;
                         }
-                        pthread_mutex_unlock(&m_lock);
-
-                        for_each(m_empty_workers.begin(),
-                                        m_empty_workers.end(), func_delete);
-                        pthread_cond_destroy(&m_worker_finished);
-                        pthread_mutex_destroy(&m_lock);
+                        m_pending -= 1;
                 }
-
-                void notify(wp_worker *w) {
-                        pthread_mutex_lock(&m_lock);
-                        m_occupied_workers.erase(w);
-                        m_empty_workers.insert(w);
-                        pthread_mutex_unlock(&m_lock);
-                        pthread_cond_signal(&m_worker_finished);
+                // an entry was reserved for us so it must be somewhere
+                wp_entry e;
+                while (!pop(idx, &e)) {
+                        this_thread::yield();
                 }
-
-                task_result_handle_t run_async(runnable_t task, void *data, bool detached);
-                void *wait_task(task_result_handle_t handle);
-
-        private:
-                set<wp_worker*>    m_empty_workers;
-                set<wp_worker*>    m_occupied_workers;
-                pthread_mutex_t m_lock;
-                pthread_cond_t     m_worker_finished;
-};
+                uint64_t expected = e.state;
+                if (e.task->m_state.compare_exchange_strong(expected,
+                                        (e.state & ~(uint64_t) TASK_STATE_MASK) | TASK_RUNNING)) {
+                        run(e.task);
+                } // else already taken by a waiting thread
+        }
+}
 
 task_result_handle_t worker_pool::run_async(runnable_t task, void *data, bool detached)
 {
-        wp_worker *w;
-        pthread_mutex_lock(&m_lock);
-        if(m_empty_workers.empty()) {
-                m_empty_workers.insert(new wp_worker(*this));
+        start();
+
+        wp_task *t = alloc_slot();
+        t->m_task = task;
+        t->m_data = data;
+        t->m_result = nullptr;
+        t->m_detached = detached;
+        uint64_t state = ((t->m_state.load() & ~(uint64_t) TASK_STATE_MASK) + TASK_GEN_STEP) | TASK_QUEUED;
+        t->m_state.store(state);
+
+        int q = current_worker;
+        if (q < 0) {
+                lock_guard<mutex> lk(m_lock);
+                q = m_next_queue++ % m_workers.size();
+        }
+        {
+                lock_guard<mutex> lk(m_workers[q]->m_lock);
+                m_workers[q]->m_queue.push_back({t, state});
+        }
+        {
+                lock_guard<mutex> lk(m_lock);
+                m_pending += 1;
         }
-        set<wp_worker*>::iterator it = m_empty_workers.begin();
-        assert(it != m_empty_workers.end());
-        w = *it;
-        /// @todo: really weird - it seems like that 'it' instead of 'w' caused some problems
-        m_empty_workers.erase(w);
-        m_occupied_workers.insert(w);
-
-        wp_task_data *d = new wp_task_data(task, data, w, detached);
-        w->push(d);
-        pthread_mutex_unlock(&m_lock);
-
-        return d;
+        m_work_cv.notify_one();
+
+        return t;
 }
 
 void *worker_pool::wait_task(task_result_handle_t handle)
 {
-        wp_task_data *d = (wp_task_data *) handle;
-        wp_worker *w = d->m_w;
-        return w->pop(d);
+        wp_task *t = (wp_task *) handle;
+        uint64_t state = t->m_state.load();
+        if ((state & TASK_STATE_MASK) == TASK_QUEUED && t->m_state.compare_exchange_strong(state,
+                                (state & ~(uint64_t) TASK_STATE_MASK) | TASK_RUNNING)) {
+                run(t); // not started yet - do it ourselves
+        }
+
+        void *res;
+        {
+                unique_lock<mutex> lk(t->m_lock);
+                t->m_done_cv.wait(lk, [t]{ return (t->m_state.load() & TASK_STATE_MASK) == TASK_DONE; });
+                res = t->m_result;
+        }
+        free_slot(t);
+        return res;
 }
 
-static class worker_pool instance;
+worker_pool instance;
+
+} // end of anonymous namespace
 
 /**
  * @brief Runs task asynchronously.
@@ -286,3 +430,42 @@ void *wait_task(task_result_handle_t handle)
         return instance.wait_task(handle);
 }
 
+/**
+ * @brief Runs task for every item of data in parallel and waits for all of them
+ *
+ * This is intended eg. for processing a tile split into stripes. The last
+ * item is processed by the calling thread.
+ *
+ * @param   task       callback to be run
+ * @param   count      number of items in data
+ * @param   data       array of items to be passed to the callback
+ * @param   data_len   size of one item of data
+ * @param[out] res     array of count results of task, may be NULL
+ */
+void task_run_parallel(runnable_t task, int count, void *data, size_t data_len, void **res)
+{
+        task_result_handle_t handles[count];
+        for (int i = 0; i < count - 1; ++i) {
+                handles[i] = task_run_async(task, (char *) data + i * data_len);
+        }
+        void *last = count > 0 ? task((char *) data + (count - 1) * data_len) : nullptr;
+        for (int i = 0; i < count - 1; ++i) {
+                void *r = wait_task(handles[i]);
+                if (res) {
+                        res[i] = r;
+                }
+        }
+        if (res && count > 0) {
+                res[count - 1] = last;
+        }
+}
+
+/**
+ * @returns number of threads of the worker pool, ie. reasonable number of
+ * stripes for task_run_parallel()
+ */
+int get_worker_count(void)
+{
+        return instance.size();
+}
+
@@ -52,7 +52,9 @@
 #endif // HAVE_CONFIG_H
  
 #ifndef WORKER_H_
-#define WORKER_H
+#define WORKER_H_
+
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -67,6 +69,8 @@ task_result_handle_t task_run_async(runnable_t task, void *data);
  */
 void task_run_async_detached(runnable_t task, void *data);
 void *wait_task(task_result_handle_t handle);
+void task_run_parallel(runnable_t task, int count, void *data, size_t data_len, void **res);
+int get_worker_count(void);
 
 
 #ifdef __cplusplus
@@ -646,6 +646,22 @@ static void vidcap_testcard_done(void *state)
         delete s;
 }
 
+/**
+ * Returns a new frame pointing to the current position in the pattern. The
+ * pattern itself is never modified so the frame can be disposed whenever the
+ * frame is processed and the next one can be grabbed in the meanwhile.
+ */
+static struct video_frame *testcard_get_frame(struct video_frame *src)
+{
+        struct video_frame *out = vf_alloc_desc(video_desc_from_frame(src));
+        for (unsigned int i = 0; i < src->tile_count; ++i) {
+                out->tiles[i].data = src->tiles[i].data;
+                out->tiles[i].data_len = src->tiles[i].data_len;
+        }
+        out->callbacks.dispose = vf_free;
+        return out;
+}
+
 static struct video_frame *vidcap_testcard_grab(void *arg, struct audio_frame **audio)
 {
         struct testcard_state *state;
@@ -743,9 +759,9 @@ for(i=0; i < state->frame.src_linesize*state->frame.height/4; i++) {
                         }
                 }
 
-                return state->tiled;
+                return testcard_get_frame(state->tiled);
         }
-        return state->frame;
+        return testcard_get_frame(state->frame);
 }
 
 static struct vidcap_type *vidcap_testcard_probe(bool verbose)
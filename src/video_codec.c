@@ -57,6 +57,7 @@
 #endif // HAVE_CONFIG_H
 
 #include "debug.h"
+#include "tv.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -75,6 +76,11 @@
 #endif
 #endif
 
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+#define VC_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
 #ifdef __cplusplus
 #include <algorithm>
 using std::max;
@@ -108,13 +114,15 @@ struct codec_info_t {
         const char *name_long;           ///< more descriptive name
         uint32_t fcc;                    ///< FourCC
         int h_align;                     ///< Number of pixels each line is aligned to
-        double bpp;                      ///< Number of bytes per pixel
+        double bpp;                      ///< Number of bytes per pixel (for planar formats
+                                         ///< average over all planes)
                                          ///< @note
                                          ///< Should be nonzero even for compressed codecs
                                          ///< when display gets requestes compressed codec
                                          ///< (otherwise division by zero occurs).
         int bits_per_channel;            ///< Number of bits per color channel
-        int block_size;                  ///< Bytes per pixel block (pixelformats only)
+        int block_size;                  ///< Bytes per pixel block (pixelformats only,
+                                         ///< for planar formats block of 2x2 pixels)
         unsigned rgb:1;                  ///< Whether pixelformat is RGB
         unsigned opaque:1;               ///< If codec is opaque (= compressed)
         unsigned interframe:1;           ///< Indicates if compression is interframe
@@ -179,6 +187,14 @@ static const struct codec_info_t codec_info[] = {
                 to_fourcc('F','F','V','1'), 0, 1.0, 8, 0, FALSE, TRUE, FALSE, FALSE, "ffv1"},
         [CFHD] = {"CFHD", "Cineform",
                 to_fourcc('C','F','H','D'), 0, 1.0, 8, 0, FALSE, TRUE, TRUE, FALSE, "cfhd"},
+        [I420] = {"I420", "planar YUV 4:2:0",
+                to_fourcc('I','4','2','0'), 2, 1.5, 8, 6, FALSE, FALSE, FALSE, FALSE, "yuv"},
+        [NV12] = {"NV12", "semi-planar YUV 4:2:0",
+                to_fourcc('N','V','1','2'), 2, 1.5, 8, 6, FALSE, FALSE, FALSE, FALSE, "nv12"},
+        [P010] = {"P010", "10-bit semi-planar YUV 4:2:0",
+                to_fourcc('P','0','1','0'), 2, 3.0, 10, 12, FALSE, FALSE, FALSE, FALSE, "p010"},
+        [I210] = {"I210", "10-bit planar YUV 4:2:2",
+                to_fourcc('I','2','1','0'), 2, 4.0, 10, 16, FALSE, FALSE, FALSE, FALSE, "i210"},
 };
 
 /**
@@ -482,6 +498,54 @@ int get_pf_block_size(codec_t codec)
         }
 }
 
+/// @brief Returns TRUE if pixel format stores components in separate planes
+int codec_is_planar(codec_t codec)
+{
+        return codec == I420 || codec == NV12 || codec == P010 || codec == I210;
+}
+
+/**
+ * @brief Computes layout of a tile in given pixel format
+ *
+ * Planes of planar pixel formats are stored one after another without any
+ * padding (for 4:2:0 formats, chroma planes have (height + 1) / 2 lines).
+ * Packed pixel formats are reported as a single plane.
+ *
+ * @param[out] planes  layout of the planes
+ * @returns            number of planes
+ */
+int vc_get_planes(unsigned int width, unsigned int height, codec_t codec,
+                struct vc_plane planes[VC_MAX_PLANES])
+{
+        if (!codec_is_planar(codec)) {
+                planes[0] = (struct vc_plane) { 0, vc_get_linesize(width, codec), height };
+                return 1;
+        }
+
+        int sample_size = get_bits_per_component(codec) > 8 ? 2 : 1;
+        int luma_width = get_aligned_length(width, codec);
+        int chroma_height = codec == I210 ? (int) height : (int) (height + 1) / 2;
+        int count = codec == NV12 || codec == P010 ? 2 : 3;
+        // interleaved CbCr plane has the same width (in samples) as the luma one
+        int chroma_linesize = (count == 2 ? luma_width : luma_width / 2) * sample_size;
+
+        planes[0] = (struct vc_plane) { 0, luma_width * sample_size, height };
+        for (int i = 1; i < count; ++i) {
+                planes[i].offset = planes[i - 1].offset + planes[i - 1].linesize * planes[i - 1].height;
+                planes[i].linesize = chroma_linesize;
+                planes[i].height = chroma_height;
+        }
+        return count;
+}
+
+/// @brief Returns size of a tile (in bytes) including all its planes
+size_t vc_get_datalen(unsigned int width, unsigned int height, codec_t codec)
+{
+        struct vc_plane planes[VC_MAX_PLANES];
+        int count = vc_get_planes(width, height, codec, planes);
+        return planes[count - 1].offset + (size_t) planes[count - 1].linesize * planes[count - 1].height;
+}
+
 /** @brief Deinterlaces framebuffer.
  *
  * vc_deinterlace performs linear blend deinterlace on a framebuffer.
@@ -774,7 +838,7 @@ vc_copyliner10k(unsigned char *dst, const unsigned char *src, int len, int rshif
         d = (uint32_t *)(void *) dst;
         s = (const void *)(const void *) src;
 
-        while (len > 0) {
+        while (len >= 16) {
                 tmp =
                     (s->
                      r << rshift) | (((s->gh << 2) | s->
@@ -805,6 +869,12 @@ vc_copyliner10k(unsigned char *dst, const unsigned char *src, int len, int rshif
                 *(d++) = tmp;
                 len -= 16;
         }
+        while (len >= 4) {
+                *(d++) = (s->r << rshift) | (((s->gh << 2) | s->gl) << gshift) |
+                        (((s->bh << 4) | s->bl) << bshift);
+                s++;
+                len -= 4;
+        }
 }
 
 /**
@@ -822,7 +892,7 @@ vc_copylineRGBA(unsigned char *dst, const unsigned char *src, int len, int rshif
         if (rshift == 0 && gshift == 8 && bshift == 16) {
                 memcpy(dst, src, len);
         } else {
-                while (len > 0) {
+                while (len >= 16) {
                         register unsigned int r, g, b;
                         tmp = *(s++);
                         r = tmp & 0xff;
@@ -850,6 +920,12 @@ vc_copylineRGBA(unsigned char *dst, const unsigned char *src, int len, int rshif
                         *(d++) = tmp;
                         len -= 16;
                 }
+                while (len >= 4) {
+                        tmp = *(s++);
+                        *(d++) = (tmp & 0xff) << rshift | ((tmp >> 8) & 0xff) << gshift |
+                                ((tmp >> 16) & 0xff) << bshift;
+                        len -= 4;
+                }
         }
 }
 
@@ -948,7 +1024,6 @@ void vc_copylineDVS10(unsigned char *dst, unsigned char *src, int src_len)
  */
 void vc_copylineDVS10(unsigned char *dst, const unsigned char *src, int dst_len)
 {
-        int src_len = dst_len / 1.5; /* right units */
         register const uint64_t *s;
         register uint64_t *d;
 
@@ -957,7 +1032,7 @@ void vc_copylineDVS10(unsigned char *dst, const unsigned char *src, int dst_len)
         d = (uint64_t *)(void *) dst;
         s = (const uint64_t *)(const void *) src;
 
-        while (src_len > 0) {
+        while (dst_len >= 24) {
                 a1 = *(s++);
                 a2 = *(s++);
                 a3 = *(s++);
@@ -972,7 +1047,14 @@ void vc_copylineDVS10(unsigned char *dst, const unsigned char *src, int dst_len)
                 *(d++) = (a2 >> 16) | (a3 << 32);       /* 0xa3|a3|a3|a3|a2|a2|a2|a2 */
                 *(d++) = (a3 >> 32) | (a4 << 16);       /* 0xa4|a4|a4|a4|a4|a4|a3|a3 */
 
-                src_len -= 16;
+                dst_len -= 24;
+        }
+
+        // every 4th (padding) byte is dropped
+        const unsigned char *s_c = (const unsigned char *) s;
+        unsigned char *d_c = (unsigned char *) d;
+        for (int i = 0; i < dst_len; ++i) {
+                d_c[i] = s_c[i / 3 * 4 + i % 3];
         }
 }
 
@@ -1049,13 +1131,13 @@ void vc_copylineRGBAtoRGBwithShift(unsigned char *dst2, const unsigned char *src
         }
 
         uint8_t *dst_c = (uint8_t *) dst;
-        while (dst_len >= 4) {
+        while (dst_len >= 3) {
 		register uint32_t in = *src++;
                 *dst_c++ = (in >> rshift) & 0xff;
                 *dst_c++ = (in >> gshift) & 0xff;
                 *dst_c++ = (in >> bshift) & 0xff;
 
-                dst_len -= 4;
+                dst_len -= 3;
         }
 }
 
@@ -1430,6 +1512,30 @@ void vc_copylineRGBtoR12L(unsigned char *dst, const unsigned char *src, int dst_
         }
 }
 
+/// byte index in R12L block with respect to endianness
+#define R12L_BYTE(x) (((x) & ~3) + END_SWAP(((x) & 3)))
+
+/**
+ * Converts 12-bit packed RGB (see vc_copylineRGBtoR12L()) to 8-bit RGB
+ * by truncating 4 least significant bits of each component.
+ */
+void vc_copylineR12LtoRGB(unsigned char *dst, const unsigned char *src, int dst_len,
+                int rshift, int gshift, int bshift) {
+        UNUSED(rshift);
+        UNUSED(gshift);
+        UNUSED(bshift);
+
+        while (dst_len >= 24) {
+                // 2 components are stored in 3 bytes
+                for (int i = 0; i < 36; i += 3) {
+                        *dst++ = (src[R12L_BYTE(i)] >> 4) | (src[R12L_BYTE(i + 1)] << 4);
+                        *dst++ = src[R12L_BYTE(i + 2)];
+                }
+                src += 36;
+                dst_len -= 24;
+        }
+}
+
 /**
  * @brief Converts RGB to UYVY.
  * Uses full scale Rec. 601 YUV (aka JPEG)
@@ -1733,47 +1839,468 @@ vc_copylineDPX10toRGB(unsigned char *dst, const unsigned char *src, int dst_len)
                 
                 dst_len -= 12;
         }
-        if (dst_len != 0) {
-                /// @todo
-                log_msg(LOG_LEVEL_WARNING, "TODO: incomplete %s implementation!\n", __func__);
+
+        unsigned char *out_c = (unsigned char *) out;
+        while (dst_len >= 3) {
+                register unsigned int val = *in++;
+                *out_c++ = val >> 24;
+                *out_c++ = 0xff & (val >> 14);
+                *out_c++ = 0xff & (val >> 4);
+                dst_len -= 3;
+        }
+}
+
+#ifdef VC_X86_DISPATCH
+/*
+ * SIMD line decoders. Each of them converts as much of the line as it can
+ * without reading or writing past the line and calls the scalar decoder for
+ * the rest, so that the output is bit-exact to the scalar one for any length.
+ */
+
+/// per-dword transformation applied before dropping the 4th byte of each dword
+enum dword_op {
+        DWORD_OP_NONE,  ///< DVS10 -> UYVY, RGBA -> RGB
+        DWORD_OP_V210,  ///< v210 -> UYVY (3x 10-bit -> 3x 8-bit)
+        DWORD_OP_DPX10, ///< DPX10 -> RGB
+};
+
+#define DWORD_OP_BODY(srli, slli, and_, or_, set1) \
+        switch (op) { \
+        case DWORD_OP_NONE: \
+                return in; \
+        case DWORD_OP_V210: \
+                return or_(or_(and_(srli(in, 2), set1(0xff)), and_(srli(in, 4), set1(0xff00))), \
+                                and_(srli(in, 6), set1(0xff0000))); \
+        case DWORD_OP_DPX10: \
+                return or_(or_(srli(in, 24), and_(srli(in, 6), set1(0xff00))), \
+                                and_(slli(in, 12), set1(0xff0000))); \
+        } \
+        return in;
+
+__attribute__((target("ssse3")))
+static inline __m128i dword_op_ssse3(__m128i in, enum dword_op op) {
+        DWORD_OP_BODY(_mm_srli_epi32, _mm_slli_epi32, _mm_and_si128, _mm_or_si128, _mm_set1_epi32)
+}
+
+__attribute__((target("avx2")))
+static inline __m256i dword_op_avx2(__m256i in, enum dword_op op) {
+        DWORD_OP_BODY(_mm256_srli_epi32, _mm256_slli_epi32, _mm256_and_si256, _mm256_or_si256, _mm256_set1_epi32)
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static inline __m512i dword_op_avx512(__m512i in, enum dword_op op) {
+        DWORD_OP_BODY(_mm512_srli_epi32, _mm512_slli_epi32, _mm512_and_si512, _mm512_or_si512, _mm512_set1_epi32)
+}
+
+/**
+ * Transforms each input dword with op and stores its first 3 bytes.
+ * @returns number of bytes written to dst (multiple of 12)
+ */
+__attribute__((target("ssse3")))
+static inline int drop_4th_byte_ssse3(unsigned char *dst, const unsigned char *src, int dst_len, enum dword_op op)
+{
+        const __m128i shuf = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        int done = 0;
+        // 16 B store - the last 4 bytes are overwritten by next iteration
+        for (; done + 16 <= dst_len; done += 12, src += 16) {
+                __m128i in = dword_op_ssse3(_mm_loadu_si128((const __m128i *)(const void *) src), op);
+                _mm_storeu_si128((__m128i *)(void *) (dst + done), _mm_shuffle_epi8(in, shuf));
+        }
+        return done;
+}
+
+/// @copydoc drop_4th_byte_ssse3
+__attribute__((target("avx2")))
+static inline int drop_4th_byte_avx2(unsigned char *dst, const unsigned char *src, int dst_len, enum dword_op op)
+{
+        const __m256i shuf = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        const __m256i perm = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+        int done = 0;
+        for (; done + 32 <= dst_len; done += 24, src += 32) {
+                __m256i in = dword_op_avx2(_mm256_loadu_si256((const __m256i *)(const void *) src), op);
+                in = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(in, shuf), perm);
+                _mm256_storeu_si256((__m256i *)(void *) (dst + done), in);
+        }
+        return done;
+}
+
+/// @copydoc drop_4th_byte_ssse3
+__attribute__((target("avx512f,avx512bw")))
+static inline int drop_4th_byte_avx512(unsigned char *dst, const unsigned char *src, int dst_len, enum dword_op op)
+{
+        const __m512i shuf = _mm512_broadcast_i32x4(_mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+        const __m512i perm = _mm512_setr_epi32(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 15, 15, 15, 15);
+        int done = 0;
+        for (; done + 48 <= dst_len; done += 48, src += 64) {
+                __m512i in = dword_op_avx512(_mm512_loadu_si512(src), op);
+                in = _mm512_permutexvar_epi32(perm, _mm512_shuffle_epi8(in, shuf));
+                _mm512_mask_storeu_epi32(dst + done, 0x0fff, in);
+        }
+        return done;
+}
+
+#define DEFINE_DROP_4TH_DECODER(name, scalar, op, isa, target_str) \
+__attribute__((target(target_str))) \
+static void name ## _ ## isa(unsigned char *dst, const unsigned char *src, int dst_len, \
+                int rshift, int gshift, int bshift) \
+{ \
+        UNUSED(rshift); \
+        UNUSED(gshift); \
+        UNUSED(bshift); \
+        int done = drop_4th_byte_ ## isa(dst, src, dst_len, op); \
+        scalar(dst + done, src + done / 3 * 4, dst_len - done); \
+}
+
+static void vc_copylineRGBAtoRGB_noshift(unsigned char *dst, const unsigned char *src, int dst_len)
+{
+        vc_copylineRGBAtoRGBwithShift(dst, src, dst_len, 0, 8, 16);
+}
+
+DEFINE_DROP_4TH_DECODER(vc_copylinev210, vc_copylinev210, DWORD_OP_V210, ssse3, "ssse3")
+DEFINE_DROP_4TH_DECODER(vc_copylinev210, vc_copylinev210, DWORD_OP_V210, avx2, "avx2")
+DEFINE_DROP_4TH_DECODER(vc_copylinev210, vc_copylinev210, DWORD_OP_V210, avx512, "avx512f,avx512bw")
+DEFINE_DROP_4TH_DECODER(vc_copylineDVS10, vc_copylineDVS10, DWORD_OP_NONE, ssse3, "ssse3")
+DEFINE_DROP_4TH_DECODER(vc_copylineDVS10, vc_copylineDVS10, DWORD_OP_NONE, avx2, "avx2")
+DEFINE_DROP_4TH_DECODER(vc_copylineDVS10, vc_copylineDVS10, DWORD_OP_NONE, avx512, "avx512f,avx512bw")
+DEFINE_DROP_4TH_DECODER(vc_copylineRGBAtoRGB, vc_copylineRGBAtoRGB_noshift, DWORD_OP_NONE, ssse3, "ssse3")
+DEFINE_DROP_4TH_DECODER(vc_copylineRGBAtoRGB, vc_copylineRGBAtoRGB_noshift, DWORD_OP_NONE, avx2, "avx2")
+DEFINE_DROP_4TH_DECODER(vc_copylineRGBAtoRGB, vc_copylineRGBAtoRGB_noshift, DWORD_OP_NONE, avx512, "avx512f,avx512bw")
+DEFINE_DROP_4TH_DECODER(vc_copylineDPX10toRGB, vc_copylineDPX10toRGB, DWORD_OP_DPX10, ssse3, "ssse3")
+DEFINE_DROP_4TH_DECODER(vc_copylineDPX10toRGB, vc_copylineDPX10toRGB, DWORD_OP_DPX10, avx2, "avx2")
+DEFINE_DROP_4TH_DECODER(vc_copylineDPX10toRGB, vc_copylineDPX10toRGB, DWORD_OP_DPX10, avx512, "avx512f,avx512bw")
+
+/// swaps bytes in 16-bit words (YUYV <-> UYVY)
+__attribute__((target("ssse3")))
+static void vc_copylineYUYV_ssse3(unsigned char *dst, const unsigned char *src, int dst_len,
+                int rshift, int gshift, int bshift)
+{
+        UNUSED(rshift);
+        UNUSED(gshift);
+        UNUSED(bshift);
+        const __m128i shuf = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        int done = 0;
+        for (; done + 16 <= dst_len; done += 16) {
+                __m128i in = _mm_loadu_si128((const __m128i *)(const void *) (src + done));
+                _mm_storeu_si128((__m128i *)(void *) (dst + done), _mm_shuffle_epi8(in, shuf));
+        }
+        vc_copylineYUYV(dst + done, src + done, dst_len - done);
+}
+
+/// @copydoc vc_copylineYUYV_ssse3
+__attribute__((target("avx2")))
+static void vc_copylineYUYV_avx2(unsigned char *dst, const unsigned char *src, int dst_len,
+                int rshift, int gshift, int bshift)
+{
+        UNUSED(rshift);
+        UNUSED(gshift);
+        UNUSED(bshift);
+        const __m256i shuf = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                        1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        int done = 0;
+        for (; done + 32 <= dst_len; done += 32) {
+                __m256i in = _mm256_loadu_si256((const __m256i *)(const void *) (src + done));
+                _mm256_storeu_si256((__m256i *)(void *) (dst + done), _mm256_shuffle_epi8(in, shuf));
+        }
+        vc_copylineYUYV(dst + done, src + done, dst_len - done);
+}
+
+/// R10k (big-endian 10-bit RGB) dword to 8-bit r, g and b in 32-bit lanes
+#define R10K_OP_BODY(in, r, g, b, srli, and_, or_, set1) \
+        r = and_(in, set1(0xff)); \
+        g = or_(and_(srli(in, 6), set1(0xfc)), and_(srli(in, 22), set1(0x3))); \
+        b = or_(and_(srli(in, 12), set1(0xf0)), srli(in, 28));
+/// DPX10 (10-bit RGB, R in the most significant bits) dword to 8-bit r, g and b
+#define DPX10_OP_BODY(in, r, g, b, srli, and_, or_, set1) \
+        r = srli(in, 24); \
+        g = and_(srli(in, 14), set1(0xff)); \
+        b = and_(srli(in, 4), set1(0xff));
+
+#define DEFINE_RGB_SHIFT_DECODER(name, body, scalar, isa, target_str, vec, load, store, sll, srli, and_, or_, set1) \
+__attribute__((target(target_str))) \
+static void name ## _ ## isa(unsigned char *dst, const unsigned char *src, int dst_len, \
+                int rshift, int gshift, int bshift) \
+{ \
+        const __m128i rs = _mm_cvtsi32_si128(rshift); \
+        const __m128i gs = _mm_cvtsi32_si128(gshift); \
+        const __m128i bs = _mm_cvtsi32_si128(bshift); \
+        int done = 0; \
+        for (; done + (int) sizeof(vec) <= dst_len; done += sizeof(vec)) { \
+                vec in = load((const vec *)(const void *) (src + done)); \
+                vec r, g, b; \
+                body(in, r, g, b, srli, and_, or_, set1) \
+                store((vec *)(void *) (dst + done), or_(or_(sll(r, rs), sll(g, gs)), sll(b, bs))); \
+        } \
+        scalar(dst + done, src + done, dst_len - done, rshift, gshift, bshift); \
+}
+
+DEFINE_RGB_SHIFT_DECODER(vc_copyliner10k, R10K_OP_BODY, vc_copyliner10k, ssse3, "ssse3", __m128i,
+                _mm_loadu_si128, _mm_storeu_si128, _mm_sll_epi32, _mm_srli_epi32,
+                _mm_and_si128, _mm_or_si128, _mm_set1_epi32)
+DEFINE_RGB_SHIFT_DECODER(vc_copyliner10k, R10K_OP_BODY, vc_copyliner10k, avx2, "avx2", __m256i,
+                _mm256_loadu_si256, _mm256_storeu_si256, _mm256_sll_epi32, _mm256_srli_epi32,
+                _mm256_and_si256, _mm256_or_si256, _mm256_set1_epi32)
+DEFINE_RGB_SHIFT_DECODER(vc_copylineDPX10toRGBA, DPX10_OP_BODY, vc_copylineDPX10toRGBA, ssse3, "ssse3", __m128i,
+                _mm_loadu_si128, _mm_storeu_si128, _mm_sll_epi32, _mm_srli_epi32,
+                _mm_and_si128, _mm_or_si128, _mm_set1_epi32)
+DEFINE_RGB_SHIFT_DECODER(vc_copylineDPX10toRGBA, DPX10_OP_BODY, vc_copylineDPX10toRGBA, avx2, "avx2", __m256i,
+                _mm256_loadu_si256, _mm256_storeu_si256, _mm256_sll_epi32, _mm256_srli_epi32,
+                _mm256_and_si256, _mm256_or_si256, _mm256_set1_epi32)
+
+/**
+ * AVX2 version of vc_copylineToUYVY709() with identical integer arithmetic.
+ * Processes 8 pixels per iteration.
+ */
+__attribute__((target("avx2")))
+static int vc_copylineToUYVY709_avx2(unsigned char *dst, const unsigned char *src, int dst_len,
+                int roff, int goff, int boff, int pix_size)
+{
+        char mask[3][16];
+        for (int i = 0; i < 16; ++i) {
+                mask[0][i] = i % 4 == 0 ? roff + pix_size * (i / 4) : -1;
+                mask[1][i] = i % 4 == 0 ? goff + pix_size * (i / 4) : -1;
+                mask[2][i] = i % 4 == 0 ? boff + pix_size * (i / 4) : -1;
+        }
+        const __m256i rmask = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *) mask[0]));
+        const __m256i gmask = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *) mask[1]));
+        const __m256i bmask = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *) mask[2]));
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i max_val = _mm256_set1_epi32((1<<24) - 1);
+        const __m256i out_shuf = _mm256_setr_epi8(0, 4, 2, 5, 1, 6, 3, 7, -1, -1, -1, -1, -1, -1, -1, -1,
+                        0, 4, 2, 5, 1, 6, 3, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+        // the second half of 3 B pixels is loaded from src + 12, which reads 4 B more
+        const int min_left = pix_size == 3 ? 20 : 16;
+        int done = 0;
+
+        for (; done + min_left <= dst_len; done += 16, src += 8 * pix_size) {
+                __m256i in = _mm256_inserti128_si256(
+                                _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(const void *) src)),
+                                _mm_loadu_si128((const __m128i *)(const void *) (src + 4 * pix_size)), 1);
+                __m256i r = _mm256_shuffle_epi8(in, rmask);
+                __m256i g = _mm256_shuffle_epi8(in, gmask);
+                __m256i b = _mm256_shuffle_epi8(in, bmask);
+
+                __m256i y = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(r, _mm256_set1_epi32(11993)),
+                                        _mm256_mullo_epi32(g, _mm256_set1_epi32(40239))),
+                                _mm256_add_epi32(_mm256_mullo_epi32(b, _mm256_set1_epi32(4063)), _mm256_set1_epi32(1<<20)));
+                __m256i u = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(r, _mm256_set1_epi32(-6619)),
+                                        _mm256_mullo_epi32(g, _mm256_set1_epi32(-22151))),
+                                _mm256_mullo_epi32(b, _mm256_set1_epi32(28770)));
+                __m256i v = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(r, _mm256_set1_epi32(28770)),
+                                        _mm256_mullo_epi32(g, _mm256_set1_epi32(-26149))),
+                                _mm256_mullo_epi32(b, _mm256_set1_epi32(-2621)));
+                // per lane: u01 u23 v01 v23, then (u / 2) rounded towards zero as in C
+                __m256i uv = _mm256_hadd_epi32(u, v);
+                uv = _mm256_srai_epi32(_mm256_add_epi32(uv, _mm256_srli_epi32(uv, 31)), 1);
+                uv = _mm256_add_epi32(uv, _mm256_set1_epi32(1<<23));
+
+                y = _mm256_srli_epi32(_mm256_min_epi32(_mm256_max_epi32(y, zero), max_val), 16);
+                uv = _mm256_srli_epi32(_mm256_min_epi32(_mm256_max_epi32(uv, zero), max_val), 16);
+                __m256i out = _mm256_packus_epi32(uv, y); // u01 u23 v01 v23 y0 y1 y2 y3
+                out = _mm256_shuffle_epi8(_mm256_packus_epi16(out, out), out_shuf);
+                out = _mm256_permute4x64_epi64(out, 0 | 2 << 2);
+                _mm_storeu_si128((__m128i *)(void *) (dst + done), _mm256_castsi256_si128(out));
         }
+        return done;
+}
+
+__attribute__((target("avx2")))
+static void vc_copylineRGBtoUYVY_avx2(unsigned char *dst, const unsigned char *src, int dst_len,
+                int rshift, int gshift, int bshift)
+{
+        UNUSED(rshift);
+        UNUSED(gshift);
+        UNUSED(bshift);
+        int done = vc_copylineToUYVY709_avx2(dst, src, dst_len, 0, 1, 2, 3);
+        vc_copylineRGBtoUYVY(dst + done, src + done / 2 * 3, dst_len - done);
+}
+
+__attribute__((target("avx2")))
+static void vc_copylineBGRtoUYVY_avx2(unsigned char *dst, const unsigned char *src, int dst_len,
+                int rshift, int gshift, int bshift)
+{
+        UNUSED(rshift);
+        UNUSED(gshift);
+        UNUSED(bshift);
+        int done = vc_copylineToUYVY709_avx2(dst, src, dst_len, 2, 1, 0, 3);
+        vc_copylineBGRtoUYVY(dst + done, src + done / 2 * 3, dst_len - done);
+}
+
+__attribute__((target("avx2")))
+static void vc_copylineRGBAtoUYVY_avx2(unsigned char *dst, const unsigned char *src, int dst_len,
+                int rshift, int gshift, int bshift)
+{
+        UNUSED(rshift);
+        UNUSED(gshift);
+        UNUSED(bshift);
+        int done = vc_copylineToUYVY709_avx2(dst, src, dst_len, 0, 1, 2, 4);
+        vc_copylineRGBAtoUYVY(dst + done, src + done / 2 * 4, dst_len - done);
 }
 
+/**
+ * AVX2 version of copylineYUVtoRGB. Uses double precision arithmetic in the
+ * same order as the scalar code so that the result is identical.
+ * @returns number of bytes written (multiple of 24)
+ */
+__attribute__((target("avx2")))
+static int copylineYUVtoRGB_avx2(unsigned char *dst, const unsigned char *src, int dst_len,
+                int y1_off, int y2_off, int u_off, int v_off)
+{
+        char mask[3][16];
+        for (int i = 0; i < 16; ++i) {
+                mask[0][i] = i < 8 ? 4 * (i / 2) + (i % 2 == 0 ? y1_off : y2_off) : -1;
+                mask[1][i] = i < 8 ? 4 * (i / 2) + u_off : -1;
+                mask[2][i] = i < 8 ? 4 * (i / 2) + v_off : -1;
+        }
+        const __m128i ymask = _mm_loadu_si128((const __m128i *)(const void *) mask[0]);
+        const __m128i umask = _mm_loadu_si128((const __m128i *)(const void *) mask[1]);
+        const __m128i vmask = _mm_loadu_si128((const __m128i *)(const void *) mask[2]);
+        const __m128i out_shuf = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        const __m256d zero = _mm256_setzero_pd();
+        const __m256d max_val = _mm256_set1_pd(255);
+        int done = 0;
+
+        // 16 B stores - 4 B after the last pixel are overwritten by next iteration
+        for (; done + 28 <= dst_len; done += 24, src += 16) {
+                __m128i in = _mm_loadu_si128((const __m128i *)(const void *) src);
+                __m128i y8 = _mm_shuffle_epi8(in, ymask);
+                __m128i u8 = _mm_shuffle_epi8(in, umask);
+                __m128i v8 = _mm_shuffle_epi8(in, vmask);
+                for (int half = 0; half < 2; ++half) {
+                        __m256d y = _mm256_cvtepi32_pd(_mm_sub_epi32(_mm_cvtepu8_epi32(y8), _mm_set1_epi32(16)));
+                        __m256d u = _mm256_cvtepi32_pd(_mm_sub_epi32(_mm_cvtepu8_epi32(u8), _mm_set1_epi32(128)));
+                        __m256d v = _mm256_cvtepi32_pd(_mm_sub_epi32(_mm_cvtepu8_epi32(v8), _mm_set1_epi32(128)));
+                        y = _mm256_mul_pd(_mm256_set1_pd(1.164), y);
+                        __m256d r = _mm256_add_pd(y, _mm256_mul_pd(_mm256_set1_pd(1.793), v));
+                        __m256d g = _mm256_sub_pd(_mm256_sub_pd(y, _mm256_mul_pd(_mm256_set1_pd(0.534), v)),
+                                        _mm256_mul_pd(_mm256_set1_pd(0.213), u));
+                        __m256d b = _mm256_add_pd(y, _mm256_mul_pd(_mm256_set1_pd(2.115), u));
+                        __m128i ri = _mm256_cvttpd_epi32(_mm256_min_pd(_mm256_max_pd(r, zero), max_val));
+                        __m128i gi = _mm256_cvttpd_epi32(_mm256_min_pd(_mm256_max_pd(g, zero), max_val));
+                        __m128i bi = _mm256_cvttpd_epi32(_mm256_min_pd(_mm256_max_pd(b, zero), max_val));
+                        __m128i rgb = _mm_or_si128(ri, _mm_or_si128(_mm_slli_epi32(gi, 8), _mm_slli_epi32(bi, 16)));
+                        _mm_storeu_si128((__m128i *)(void *) (dst + done + 12 * half), _mm_shuffle_epi8(rgb, out_shuf));
+                        y8 = _mm_srli_si128(y8, 4);
+                        u8 = _mm_srli_si128(u8, 4);
+                        v8 = _mm_srli_si128(v8, 4);
+                }
+        }
+        return done;
+}
+
+__attribute__((target("avx2")))
+static void vc_copylineUYVYtoRGB_avx2(unsigned char *dst, const unsigned char *src, int dst_len,
+                int rshift, int gshift, int bshift)
+{
+        UNUSED(rshift);
+        UNUSED(gshift);
+        UNUSED(bshift);
+        int done = copylineYUVtoRGB_avx2(dst, src, dst_len, 1, 3, 0, 2);
+        vc_copylineUYVYtoRGB(dst + done, src + done / 3 * 2, dst_len - done);
+}
+
+__attribute__((target("avx2")))
+static void vc_copylineYUYVtoRGB_avx2(unsigned char *dst, const unsigned char *src, int dst_len,
+                int rshift, int gshift, int bshift)
+{
+        UNUSED(rshift);
+        UNUSED(gshift);
+        UNUSED(bshift);
+        int done = copylineYUVtoRGB_avx2(dst, src, dst_len, 0, 2, 1, 3);
+        vc_copylineYUYVtoRGB(dst + done, src + done / 3 * 2, dst_len - done);
+}
+#endif // defined VC_X86_DISPATCH
+
 struct decoder_item {
         decoder_t decoder;
         codec_t in;
         codec_t out;
         bool slow;
+        enum vc_simd_level simd; ///< instruction set extension required by the decoder
 };
 
+/**
+ * Line decoders. If there are more implementations for one conversion, the
+ * fastest must come first - first one supported by the CPU is used.
+ */
 static const struct decoder_item decoders[] = {
-        { (decoder_t) vc_copylineDVS10,       DVS10, UYVY, false },
-        { (decoder_t) vc_copylinev210,        v210,  UYVY, false },
-        { (decoder_t) vc_copylineYUYV,        YUYV,  UYVY, false },
-        { (decoder_t) vc_copyliner10k,        R10k,  RGBA, false },
-        { vc_copylineRGBA,        RGBA,  RGBA, false },
-        { (decoder_t) vc_copylineDVS10toV210, DVS10, v210, false },
-        { (decoder_t) vc_copylineRGBAtoRGB,   RGBA,  RGB, false },
-        { (decoder_t) vc_copylineRGBtoRGBA,   RGB,   RGBA, false },
-        { (decoder_t) vc_copylineRGBtoUYVY,   RGB,   UYVY, true },
-        { (decoder_t) vc_copylineUYVYtoRGB,   UYVY,  RGB, true },
-        { (decoder_t) vc_copylineYUYVtoRGB,   YUYV,  RGB, true },
-        { (decoder_t) vc_copylineBGRtoUYVY,   BGR,   UYVY, true },
-        { (decoder_t) vc_copylineRGBAtoUYVY,  RGBA,  UYVY, true },
-        { (decoder_t) vc_copylineBGRtoRGB,    BGR,   RGB, false },
-        { (decoder_t) vc_copylineDPX10toRGBA, DPX10, RGBA, false },
-        { (decoder_t) vc_copylineDPX10toRGB,  DPX10, RGB, false },
-        { vc_copylineRGB,         RGB,   RGB, false },
+#ifdef VC_X86_DISPATCH
+        { vc_copylineDVS10_avx512,             DVS10, UYVY, false, VC_SIMD_AVX512BW },
+        { vc_copylineDVS10_avx2,               DVS10, UYVY, false, VC_SIMD_AVX2 },
+        { vc_copylineDVS10_ssse3,              DVS10, UYVY, false, VC_SIMD_SSSE3 },
+        { vc_copylinev210_avx512,              v210,  UYVY, false, VC_SIMD_AVX512BW },
+        { vc_copylinev210_avx2,                v210,  UYVY, false, VC_SIMD_AVX2 },
+        { vc_copylinev210_ssse3,               v210,  UYVY, false, VC_SIMD_SSSE3 },
+        { vc_copylineYUYV_avx2,                YUYV,  UYVY, false, VC_SIMD_AVX2 },
+        { vc_copylineYUYV_ssse3,               YUYV,  UYVY, false, VC_SIMD_SSSE3 },
+        { vc_copyliner10k_avx2,                R10k,  RGBA, false, VC_SIMD_AVX2 },
+        { vc_copyliner10k_ssse3,               R10k,  RGBA, false, VC_SIMD_SSSE3 },
+        { vc_copylineRGBAtoRGB_avx512,         RGBA, RGB, false, VC_SIMD_AVX512BW },
+        { vc_copylineRGBAtoRGB_avx2,           RGBA, RGB, false, VC_SIMD_AVX2 },
+        { vc_copylineRGBAtoRGB_ssse3,          RGBA, RGB, false, VC_SIMD_SSSE3 },
+        { vc_copylineRGBtoUYVY_avx2,           RGB,  UYVY, true, VC_SIMD_AVX2 },
+        { vc_copylineUYVYtoRGB_avx2,           UYVY, RGB, true, VC_SIMD_AVX2 },
+        { vc_copylineYUYVtoRGB_avx2,           YUYV, RGB, true, VC_SIMD_AVX2 },
+        { vc_copylineBGRtoUYVY_avx2,           BGR,  UYVY, true, VC_SIMD_AVX2 },
+        { vc_copylineRGBAtoUYVY_avx2,          RGBA, UYVY, true, VC_SIMD_AVX2 },
+        { vc_copylineDPX10toRGBA_avx2,         DPX10, RGBA, false, VC_SIMD_AVX2 },
+        { vc_copylineDPX10toRGBA_ssse3,        DPX10, RGBA, false, VC_SIMD_SSSE3 },
+        { vc_copylineDPX10toRGB_avx512,        DPX10, RGB, false, VC_SIMD_AVX512BW },
+        { vc_copylineDPX10toRGB_avx2,          DPX10, RGB, false, VC_SIMD_AVX2 },
+        { vc_copylineDPX10toRGB_ssse3,         DPX10, RGB, false, VC_SIMD_SSSE3 },
+#endif
+        { (decoder_t) vc_copylineDVS10,       DVS10, UYVY, false, VC_SIMD_NONE },
+        { (decoder_t) vc_copylinev210,        v210,  UYVY, false, VC_SIMD_NONE },
+        { (decoder_t) vc_copylineYUYV,        YUYV,  UYVY, false, VC_SIMD_NONE },
+        { (decoder_t) vc_copyliner10k,        R10k,  RGBA, false, VC_SIMD_NONE },
+        { vc_copylineRGBA,        RGBA,  RGBA, false, VC_SIMD_NONE },
+        { (decoder_t) vc_copylineDVS10toV210, DVS10, v210, false, VC_SIMD_NONE },
+        { (decoder_t) vc_copylineRGBAtoRGB,   RGBA,  RGB, false, VC_SIMD_NONE },
+        { (decoder_t) vc_copylineRGBtoRGBA,   RGB,   RGBA, false, VC_SIMD_NONE },
+        { (decoder_t) vc_copylineRGBtoUYVY,   RGB,   UYVY, true, VC_SIMD_NONE },
+        { (decoder_t) vc_copylineUYVYtoRGB,   UYVY,  RGB, true, VC_SIMD_NONE },
+        { (decoder_t) vc_copylineYUYVtoRGB,   YUYV,  RGB, true, VC_SIMD_NONE },
+        { (decoder_t) vc_copylineBGRtoUYVY,   BGR,   UYVY, true, VC_SIMD_NONE },
+        { (decoder_t) vc_copylineRGBAtoUYVY,  RGBA,  UYVY, true, VC_SIMD_NONE },
+        { (decoder_t) vc_copylineBGRtoRGB,    BGR,   RGB, false, VC_SIMD_NONE },
+        { vc_copylineRGBtoR12L,   RGB,   R12L, false, VC_SIMD_NONE },
+        { vc_copylineR12LtoRGB,   R12L,  RGB, false, VC_SIMD_NONE },
+        { (decoder_t) vc_copylineDPX10toRGBA, DPX10, RGBA, false, VC_SIMD_NONE },
+        { (decoder_t) vc_copylineDPX10toRGB,  DPX10, RGB, false, VC_SIMD_NONE },
+        { vc_copylineRGB,         RGB,   RGB, false, VC_SIMD_NONE },
 };
 
+static bool simd_supported[VC_SIMD_COUNT] = { true }; // VC_SIMD_NONE is always supported
+
+#ifdef VC_X86_DISPATCH
+__attribute__((constructor))
+static void vc_detect_simd(void)
+{
+        __builtin_cpu_init();
+        simd_supported[VC_SIMD_SSSE3] = __builtin_cpu_supports("ssse3");
+        simd_supported[VC_SIMD_AVX2] = __builtin_cpu_supports("avx2");
+        simd_supported[VC_SIMD_AVX512BW] = __builtin_cpu_supports("avx512f") &&
+                __builtin_cpu_supports("avx512bw");
+}
+#endif
+
+bool vc_simd_level_supported(enum vc_simd_level level)
+{
+        return simd_supported[level];
+}
+
 /**
  * Returns line decoder for specifiedn input and output codec.
+ *
+ * If there are more implementations, the fastest one supported by the CPU is
+ * returned. All of them produce identical output.
  */
 decoder_t get_decoder_from_to(codec_t in, codec_t out, bool slow)
 {
         for (unsigned int i = 0; i < sizeof(decoders)/sizeof(struct decoder_item); ++i) {
                 if (decoders[i].in == in && decoders[i].out == out &&
-                                (decoders[i].slow == false || slow == true)) {
+                                (decoders[i].slow == false || slow == true) &&
+                                simd_supported[decoders[i].simd]) {
                         return decoders[i].decoder;
                 }
         }
@@ -1784,6 +2311,500 @@ decoder_t get_decoder_from_to(codec_t in, codec_t out, bool slow)
         return NULL;
 }
 
+/**
+ * Returns given implementation of a line decoder regardless if it is
+ * supported by the CPU (intended for testing).
+ * @retval NULL there is no such implementation
+ */
+decoder_t get_decoder_impl(codec_t in, codec_t out, enum vc_simd_level level)
+{
+        for (unsigned int i = 0; i < sizeof(decoders)/sizeof(struct decoder_item); ++i) {
+                if (decoders[i].in == in && decoders[i].out == out &&
+                                decoders[i].simd == level) {
+                        return decoders[i].decoder;
+                }
+        }
+        return NULL;
+}
+
+#define COST_MEASURE_WIDTH 1920
+#define COST_MEASURE_LINES 16
+#define COST_MEASURE_RUNS 3
+#define COST_MEASURE_MIN_NS 500000 ///< minimal duration of one measured run
+/// costs differing less than that are considered equal (the one earlier in decoders[] or the shorter path
+/// wins) so that the selection does not depend on measurement noise
+#define COST_TOLERANCE 0.2
+
+/// measured cost (ns per pixel) of decoders[i], negative if not usable
+static double decoder_cost[sizeof decoders / sizeof decoders[0]];
+static pthread_once_t decoder_cost_once = PTHREAD_ONCE_INIT;
+
+static uint64_t cost_time_ns(void)
+{
+#ifdef CLOCK_MONOTONIC
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+#else
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return (uint64_t) tv.tv_sec * 1000000000ULL + (uint64_t) tv.tv_usec * 1000ULL;
+#endif
+}
+
+/// @returns duration of iters conversions of COST_MEASURE_LINES lines in ns
+static uint64_t run_decoder(const struct decoder_item *d, unsigned char *dst, const unsigned char *src,
+                size_t buf_len, int dst_linesize, int iters)
+{
+        uint64_t t0 = cost_time_ns();
+        for (int i = 0; i < iters; ++i) {
+                for (int y = 0; y < COST_MEASURE_LINES; ++y) {
+                        d->decoder(dst + y * buf_len, src + y * buf_len, dst_linesize, 0, 8, 16);
+                }
+        }
+        return cost_time_ns() - t0;
+}
+
+/**
+ * Measures cost of the decoders that get_decoder_from_to() would return (the
+ * fastest supported implementation of each conversion).
+ *
+ * Number of iterations is first doubled until a run takes at least
+ * COST_MEASURE_MIN_NS (which also serves as a warm-up), the best of
+ * COST_MEASURE_RUNS such runs is taken.
+ */
+static void measure_decoder_costs(void)
+{
+        size_t buf_len = vc_get_linesize(COST_MEASURE_WIDTH, R12L) + 64; // the largest of our pixfmts
+        unsigned char *src = calloc(1, buf_len * COST_MEASURE_LINES);
+        unsigned char *dst = calloc(1, buf_len * COST_MEASURE_LINES);
+
+        for (unsigned int i = 0; i < sizeof decoders / sizeof decoders[0]; ++i) {
+                decoder_cost[i] = -1.0;
+                if (!simd_supported[decoders[i].simd] || src == NULL || dst == NULL ||
+                                get_decoder_from_to(decoders[i].in, decoders[i].out, true) != decoders[i].decoder) {
+                        continue;
+                }
+                int dst_linesize = vc_get_linesize(COST_MEASURE_WIDTH, decoders[i].out);
+                int iters = 1;
+                while (run_decoder(&decoders[i], dst, src, buf_len, dst_linesize, iters) < COST_MEASURE_MIN_NS) {
+                        iters *= 2;
+                }
+                uint64_t best = UINT64_MAX;
+                for (int run = 0; run < COST_MEASURE_RUNS; ++run) {
+                        uint64_t t = run_decoder(&decoders[i], dst, src, buf_len, dst_linesize, iters);
+                        if (t < best) {
+                                best = t;
+                        }
+                }
+                decoder_cost[i] = (double) best / ((double) iters * COST_MEASURE_WIDTH * COST_MEASURE_LINES);
+                debug_msg("Line decoder %s->%s: %.3f ns/px\n", get_codec_name(decoders[i].in),
+                                get_codec_name(decoders[i].out), decoder_cost[i]);
+        }
+
+        free(src);
+        free(dst);
+}
+
+/// @retval true if cost a is lower than b by more than COST_TOLERANCE
+static bool cost_lower(double a, double b)
+{
+        return a < b * (1.0 - COST_TOLERANCE);
+}
+
+/**
+ * Finds the cheapest chain of line decoders converting in to out.
+ *
+ * Conversions that have a direct decoder are considered as well, so the
+ * direct one is used unless a chain is measured to be faster. Only the last
+ * decoder of the chain uses the requested RGB shifts, the intermediate
+ * formats use the default ones.
+ *
+ * @param slow  allow also slow decoders (see get_decoder_from_to())
+ * @param[out] path  found path, path->steps is 0 if there is none
+ * @retval true if a path was found
+ */
+bool get_conversion_path(codec_t in, codec_t out, bool slow, struct vc_conversion_path *path)
+{
+        memset(path, 0, sizeof *path);
+        if (in == out) {
+                decoder_t dec = get_decoder_from_to(in, out, slow);
+                if (dec == NULL) {
+                        return false;
+                }
+                path->steps = 1;
+                path->codecs[0] = in;
+                path->codecs[1] = out;
+                path->decoders[0] = dec;
+                return true;
+        }
+
+        pthread_once(&decoder_cost_once, measure_decoder_costs);
+
+        // cost[h][c] - cost of the cheapest path from in to c with h steps,
+        // prev[h][c] - index of the last decoder of that path
+        double cost[VC_MAX_CONVERSION_STEPS + 1][VIDEO_CODEC_COUNT];
+        int prev[VC_MAX_CONVERSION_STEPS + 1][VIDEO_CODEC_COUNT];
+        for (int h = 0; h <= VC_MAX_CONVERSION_STEPS; ++h) {
+                for (int c = 0; c < VIDEO_CODEC_COUNT; ++c) {
+                        cost[h][c] = -1.0;
+                        prev[h][c] = -1;
+                }
+        }
+        cost[0][in] = 0.0;
+
+        int best_steps = 0;
+        for (int h = 1; h <= VC_MAX_CONVERSION_STEPS; ++h) {
+                for (unsigned int i = 0; i < sizeof decoders / sizeof decoders[0]; ++i) {
+                        const struct decoder_item *d = &decoders[i];
+                        if (decoder_cost[i] < 0.0 || d->in == d->out || cost[h - 1][d->in] < 0.0 ||
+                                        (d->slow && !slow)) {
+                                continue;
+                        }
+                        double c = cost[h - 1][d->in] + decoder_cost[i];
+                        if (cost[h][d->out] < 0.0 || cost_lower(c, cost[h][d->out])) {
+                                cost[h][d->out] = c;
+                                prev[h][d->out] = i;
+                        }
+                }
+                // prefer shorter path if (nearly) equally expensive
+                if (cost[h][out] >= 0.0 && (best_steps == 0 || cost_lower(cost[h][out], cost[best_steps][out]))) {
+                        best_steps = h;
+                }
+        }
+
+        if (best_steps == 0) {
+                return false;
+        }
+
+        path->steps = best_steps;
+        path->cost = cost[best_steps][out];
+        codec_t c = out;
+        for (int h = best_steps; h > 0; --h) {
+                const struct decoder_item *d = &decoders[prev[h][c]];
+                path->codecs[h] = c;
+                path->decoders[h - 1] = d->decoder;
+                path->slow = path->slow || d->slow;
+                c = d->in;
+        }
+        path->codecs[0] = in;
+
+        return true;
+}
+
+/// per-thread buffers for intermediate results of vc_convert_line()
+struct vc_convert_tmp {
+        unsigned char *buf[2];
+        int len[2];
+};
+static pthread_key_t convert_tmp_key;
+static pthread_once_t convert_tmp_key_once = PTHREAD_ONCE_INIT;
+
+static void convert_tmp_free(void *arg)
+{
+        struct vc_convert_tmp *tmp = arg;
+        free(tmp->buf[0]);
+        free(tmp->buf[1]);
+        free(tmp);
+}
+
+static void convert_tmp_key_create(void)
+{
+        pthread_key_create(&convert_tmp_key, convert_tmp_free);
+}
+
+/**
+ * Converts a line (or its part) using a path obtained from
+ * get_conversion_path(). Intermediate results are stored in a per-thread
+ * buffer that is freed on thread exit.
+ *
+ * @param dst_len  length of output in bytes
+ */
+void vc_convert_line(const struct vc_conversion_path *path, unsigned char *dst,
+                const unsigned char *src, int dst_len, int rshift, int gshift, int bshift)
+{
+        if (path->steps == 1) {
+                path->decoders[0](dst, src, dst_len, rshift, gshift, bshift);
+                return;
+        }
+
+        pthread_once(&convert_tmp_key_once, convert_tmp_key_create);
+        struct vc_convert_tmp *tmp = pthread_getspecific(convert_tmp_key);
+        if (tmp == NULL) {
+                tmp = calloc(1, sizeof *tmp);
+                pthread_setspecific(convert_tmp_key, tmp);
+        }
+
+        double pixels = ceil(dst_len / get_bpp(path->codecs[path->steps]));
+        for (int i = 0; i < path->steps - 1; ++i) {
+                codec_t c = path->codecs[i + 1];
+                int block = get_pf_block_size(c);
+                double blocks = ceil(pixels * get_bpp(c) / block);
+                int len = (int) blocks * block;
+                unsigned char **buf = &tmp->buf[i % 2];
+                if (tmp->len[i % 2] < len) {
+                        free(*buf);
+                        *buf = malloc(len);
+                        tmp->len[i % 2] = len;
+                }
+                path->decoders[i](*buf, src, len, 0, 8, 16);
+                src = *buf;
+        }
+        path->decoders[path->steps - 1](dst, src, dst_len, rshift, gshift, bshift);
+}
+
+/**
+ * @brief Converts I420 or NV12 to UYVY
+ * @param chroma_step 1 for I420, 2 for NV12 (interleaved CbCr plane)
+ */
+static void vc_tile420toUYVY(unsigned char *dst, const unsigned char *src, int width, int height, int chroma_step)
+{
+        struct vc_plane planes[VC_MAX_PLANES];
+        int count = vc_get_planes(width, height, chroma_step == 1 ? I420 : NV12, planes);
+        int dst_linesize = vc_get_linesize(width, UYVY);
+
+        for (int y = 0; y < height; ++y) {
+                const unsigned char *in_y = src + planes[0].offset + y * planes[0].linesize;
+                const unsigned char *in_cb = src + planes[1].offset + y / 2 * planes[1].linesize;
+                const unsigned char *in_cr = count == 3 ? src + planes[2].offset + y / 2 * planes[2].linesize :
+                        in_cb + 1;
+                unsigned char *out = dst + y * dst_linesize;
+                for (int x = 0; x < (width + 1) / 2; ++x) {
+                        *out++ = *in_cb;
+                        *out++ = *in_y++;
+                        *out++ = *in_cr;
+                        *out++ = *in_y++;
+                        in_cb += chroma_step;
+                        in_cr += chroma_step;
+                }
+        }
+}
+
+static void vc_tileI420toUYVY(unsigned char *dst, const unsigned char *src, int width, int height)
+{
+        vc_tile420toUYVY(dst, src, width, height, 1);
+}
+
+static void vc_tileNV12toUYVY(unsigned char *dst, const unsigned char *src, int width, int height)
+{
+        vc_tile420toUYVY(dst, src, width, height, 2);
+}
+
+/**
+ * @brief Converts UYVY to I420 or NV12, chroma of 2 lines is averaged
+ * @param chroma_step 1 for I420, 2 for NV12 (interleaved CbCr plane)
+ */
+static void vc_tileUYVYto420(unsigned char *dst, const unsigned char *src, int width, int height, int chroma_step)
+{
+        struct vc_plane planes[VC_MAX_PLANES];
+        int count = vc_get_planes(width, height, chroma_step == 1 ? I420 : NV12, planes);
+        int src_linesize = vc_get_linesize(width, UYVY);
+
+        for (int y = 0; y < height; ++y) {
+                const unsigned char *in = src + y * src_linesize;
+                unsigned char *out_y = dst + planes[0].offset + y * planes[0].linesize;
+                for (int x = 0; x < (width + 1) / 2; ++x) {
+                        *out_y++ = in[4 * x + 1];
+                        *out_y++ = in[4 * x + 3];
+                }
+        }
+
+        for (int y = 0; y < (height + 1) / 2; ++y) {
+                const unsigned char *in1 = src + 2 * y * src_linesize;
+                const unsigned char *in2 = 2 * y + 1 < height ? in1 + src_linesize : in1;
+                unsigned char *out_cb = dst + planes[1].offset + y * planes[1].linesize;
+                unsigned char *out_cr = count == 3 ? dst + planes[2].offset + y * planes[2].linesize :
+                        out_cb + 1;
+                for (int x = 0; x < (width + 1) / 2; ++x) {
+                        *out_cb = (in1[4 * x] + in2[4 * x] + 1) / 2;
+                        *out_cr = (in1[4 * x + 2] + in2[4 * x + 2] + 1) / 2;
+                        out_cb += chroma_step;
+                        out_cr += chroma_step;
+                }
+        }
+}
+
+static void vc_tileUYVYtoI420(unsigned char *dst, const unsigned char *src, int width, int height)
+{
+        vc_tileUYVYto420(dst, src, width, height, 1);
+}
+
+static void vc_tileUYVYtoNV12(unsigned char *dst, const unsigned char *src, int width, int height)
+{
+        vc_tileUYVYto420(dst, src, width, height, 2);
+}
+
+/**
+ * Packs one line of 4:2:2 10-bit samples to v210. Samples beyond width are
+ * zeroed.
+ */
+static void pack_v210_line(uint32_t *dst, const uint16_t *y, const uint16_t *cb, const uint16_t *cr, int width)
+{
+        for (int x = 0; x < get_aligned_length(width, v210); x += 6) {
+                uint16_t s[12]; // Cb0 Y0 Cr0 Y1 Cb1 Y2 Cr1 Y3 Cb2 Y4 Cr2 Y5
+                for (int i = 0; i < 6; ++i) {
+                        int px = x + i;
+                        s[2 * i + 1] = px < width ? y[px] & 0x3ff : 0;
+                        s[2 * i] = px < width ? ((i % 2 == 0 ? cb : cr)[px / 2] & 0x3ff) : 0;
+                }
+                *dst++ = s[0] | s[1] << 10 | s[2] << 20;
+                *dst++ = s[3] | s[4] << 10 | s[5] << 20;
+                *dst++ = s[6] | s[7] << 10 | s[8] << 20;
+                *dst++ = s[9] | s[10] << 10 | s[11] << 20;
+        }
+}
+
+/// Unpacks one line of v210 to 4:2:2 10-bit samples
+static void unpack_v210_line(uint16_t *y, uint16_t *cb, uint16_t *cr, const uint32_t *src, int width)
+{
+        for (int x = 0; x < width; x += 6) {
+                uint16_t s[12];
+                for (int i = 0; i < 4; ++i) {
+                        uint32_t w = *src++;
+                        s[3 * i] = w & 0x3ff;
+                        s[3 * i + 1] = (w >> 10) & 0x3ff;
+                        s[3 * i + 2] = (w >> 20) & 0x3ff;
+                }
+                for (int i = 0; i < 6 && x + i < width; ++i) {
+                        y[x + i] = s[2 * i + 1];
+                        if (i % 2 == 0) {
+                                cb[(x + i) / 2] = s[2 * i];
+                        } else {
+                                cr[(x + i) / 2] = s[2 * i];
+                        }
+                }
+        }
+}
+
+/**
+ * @brief Converts I210 or P010 to v210
+ */
+static void vc_tile10bitPlanarTov210(unsigned char *dst, const unsigned char *src, int width, int height, codec_t in)
+{
+        struct vc_plane planes[VC_MAX_PLANES];
+        vc_get_planes(width, height, in, planes);
+        int dst_linesize = vc_get_linesize(width, v210);
+        uint16_t *tmp = malloc(3 * get_aligned_length(width, in) * sizeof(uint16_t));
+        uint16_t *cb = tmp + get_aligned_length(width, in);
+        uint16_t *cr = cb + get_aligned_length(width, in);
+
+        for (int y = 0; y < height; ++y) {
+                int chroma_y = in == I210 ? y : y / 2;
+                const uint16_t *in_y = (const uint16_t *)(const void *)(src + planes[0].offset + y * planes[0].linesize);
+                const uint16_t *in_c1 = (const uint16_t *)(const void *)(src + planes[1].offset + chroma_y * planes[1].linesize);
+                if (in == I210) {
+                        pack_v210_line((uint32_t *)(void *)(dst + y * dst_linesize), in_y, in_c1,
+                                        (const uint16_t *)(const void *)(src + planes[2].offset + y * planes[2].linesize), width);
+                        continue;
+                }
+                // P010 - MSB aligned, interleaved chroma
+                for (int x = 0; x < width; ++x) {
+                        tmp[x] = in_y[x] >> 6;
+                }
+                for (int x = 0; x < (width + 1) / 2; ++x) {
+                        cb[x] = in_c1[2 * x] >> 6;
+                        cr[x] = in_c1[2 * x + 1] >> 6;
+                }
+                pack_v210_line((uint32_t *)(void *)(dst + y * dst_linesize), tmp, cb, cr, width);
+        }
+        free(tmp);
+}
+
+static void vc_tileI210tov210(unsigned char *dst, const unsigned char *src, int width, int height)
+{
+        vc_tile10bitPlanarTov210(dst, src, width, height, I210);
+}
+
+static void vc_tileP010tov210(unsigned char *dst, const unsigned char *src, int width, int height)
+{
+        vc_tile10bitPlanarTov210(dst, src, width, height, P010);
+}
+
+/**
+ * @brief Converts v210 to I210 or P010 (for P010, chroma of 2 lines is averaged)
+ */
+static void vc_tilev210To10bitPlanar(unsigned char *dst, const unsigned char *src, int width, int height, codec_t out)
+{
+        struct vc_plane planes[VC_MAX_PLANES];
+        vc_get_planes(width, height, out, planes);
+        int src_linesize = vc_get_linesize(width, v210);
+        int aligned_width = get_aligned_length(width, out);
+        uint16_t *tmp = malloc(5 * aligned_width * sizeof(uint16_t));
+        uint16_t *cb = tmp + aligned_width;
+        uint16_t *cr = cb + aligned_width;
+        uint16_t *cb_prev = cr + aligned_width;
+        uint16_t *cr_prev = cb_prev + aligned_width / 2;
+
+        for (int y = 0; y < height; ++y) {
+                uint16_t *out_y = (uint16_t *)(void *)(dst + planes[0].offset + y * planes[0].linesize);
+                if (out == I210) {
+                        unpack_v210_line(out_y, (uint16_t *)(void *)(dst + planes[1].offset + y * planes[1].linesize),
+                                        (uint16_t *)(void *)(dst + planes[2].offset + y * planes[2].linesize),
+                                        (const uint32_t *)(const void *)(src + y * src_linesize), width);
+                        continue;
+                }
+                unpack_v210_line(tmp, cb, cr, (const uint32_t *)(const void *)(src + y * src_linesize), width);
+                for (int x = 0; x < width; ++x) {
+                        out_y[x] = tmp[x] << 6;
+                }
+                if (y % 2 == 0 && y + 1 < height) { // wait for the other line of the pair
+                        memcpy(cb_prev, cb, (width + 1) / 2 * sizeof(uint16_t));
+                        memcpy(cr_prev, cr, (width + 1) / 2 * sizeof(uint16_t));
+                        continue;
+                }
+                if (y % 2 == 0) { // last odd line
+                        memcpy(cb_prev, cb, (width + 1) / 2 * sizeof(uint16_t));
+                        memcpy(cr_prev, cr, (width + 1) / 2 * sizeof(uint16_t));
+                }
+                uint16_t *out_c = (uint16_t *)(void *)(dst + planes[1].offset + y / 2 * planes[1].linesize);
+                for (int x = 0; x < (width + 1) / 2; ++x) {
+                        *out_c++ = ((cb_prev[x] + cb[x] + 1) / 2) << 6;
+                        *out_c++ = ((cr_prev[x] + cr[x] + 1) / 2) << 6;
+                }
+        }
+        free(tmp);
+}
+
+static void vc_tilev210toI210(unsigned char *dst, const unsigned char *src, int width, int height)
+{
+        vc_tilev210To10bitPlanar(dst, src, width, height, I210);
+}
+
+static void vc_tilev210toP010(unsigned char *dst, const unsigned char *src, int width, int height)
+{
+        vc_tilev210To10bitPlanar(dst, src, width, height, P010);
+}
+
+static const struct {
+        tile_decoder_t decoder;
+        codec_t in;
+        codec_t out;
+} tile_decoders[] = {
+        { vc_tileI420toUYVY, I420, UYVY },
+        { vc_tileNV12toUYVY, NV12, UYVY },
+        { vc_tileUYVYtoI420, UYVY, I420 },
+        { vc_tileUYVYtoNV12, UYVY, NV12 },
+        { vc_tileI210tov210, I210, v210 },
+        { vc_tileP010tov210, P010, v210 },
+        { vc_tilev210toI210, v210, I210 },
+        { vc_tilev210toP010, v210, P010 },
+};
+
+/**
+ * Returns decoder converting whole tiles. This is needed for planar pixel
+ * formats that cannot be converted line by line (see get_decoder_from_to()).
+ * Both input and output have the layout given by vc_get_planes().
+ */
+tile_decoder_t get_tile_decoder_from_to(codec_t in, codec_t out)
+{
+        for (unsigned int i = 0; i < sizeof tile_decoders / sizeof tile_decoders[0]; ++i) {
+                if (tile_decoders[i].in == in && tile_decoders[i].out == out) {
+                        return tile_decoders[i].decoder;
+                }
+        }
+        return NULL;
+}
+
 /**
  * Tries to find specified codec in set of video codecs.
  * The set must by ended by VIDEO_CODEC_NONE.
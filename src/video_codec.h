@@ -65,6 +65,15 @@ extern "C" {
 typedef void (*decoder_t)(unsigned char *dst, const unsigned char *src, int dst_len,
                 int rshift, int gshift, int bshift);
 
+/// Instruction set extension used by a decoder_t implementation
+enum vc_simd_level {
+        VC_SIMD_NONE,     ///< scalar reference implementation
+        VC_SIMD_SSSE3,
+        VC_SIMD_AVX2,
+        VC_SIMD_AVX512BW,
+        VC_SIMD_COUNT
+};
+
 /// Prints list of suppored codecs for video module
 void             show_codec_help(const char *module, const codec_t *codecs8, const codec_t *codecs10, const codec_t *codecs12);
 /// @returns number of bits per color component
@@ -81,10 +90,47 @@ codec_t          get_codec_from_fcc(uint32_t fourcc) ATTRIBUTE(pure);
 codec_t          get_codec_from_name(const char *name) ATTRIBUTE(pure);
 const char      *get_codec_file_extension(codec_t codec) ATTRIBUTE(pure);
 decoder_t        get_decoder_from_to(codec_t in, codec_t out, bool slow) ATTRIBUTE(pure);
+decoder_t        get_decoder_impl(codec_t in, codec_t out, enum vc_simd_level level) ATTRIBUTE(pure);
+bool             vc_simd_level_supported(enum vc_simd_level level) ATTRIBUTE(pure);
+
+#define VC_MAX_CONVERSION_STEPS 3
+/// Chain of line decoders converting between two pixel formats
+struct vc_conversion_path {
+        int       steps;                               ///< number of decoders (0 - no path)
+        codec_t   codecs[VC_MAX_CONVERSION_STEPS + 1]; ///< input, intermediate and output pixel formats
+        decoder_t decoders[VC_MAX_CONVERSION_STEPS];
+        double    cost;                                ///< estimated cost in ns per pixel
+        bool      slow;                                ///< path contains a slow decoder
+};
+bool             get_conversion_path(codec_t in, codec_t out, bool slow, struct vc_conversion_path *path);
+void             vc_convert_line(const struct vc_conversion_path *path, unsigned char *dst,
+                const unsigned char *src, int dst_len, int rshift, int gshift, int bshift);
+
+/**
+ * @brief Defines type for conversions of whole tiles (planar pixel formats)
+ * @param[out] dst     destination buffer
+ * @param[in]  src     source buffer
+ * @param[in]  width   tile width
+ * @param[in]  height  tile height
+ */
+typedef void (*tile_decoder_t)(unsigned char *dst, const unsigned char *src, int width, int height);
+tile_decoder_t   get_tile_decoder_from_to(codec_t in, codec_t out) ATTRIBUTE(pure);
 
 int get_aligned_length(int width, codec_t codec) ATTRIBUTE(pure);
 int get_pf_block_size(codec_t codec) ATTRIBUTE(pure);
 int vc_get_linesize(unsigned int width, codec_t codec) ATTRIBUTE(pure);
+
+#define VC_MAX_PLANES 3
+/// Layout of one plane of a tile, see vc_get_planes()
+struct vc_plane {
+        int offset;   ///< offset from the beginning of tile data (bytes)
+        int linesize; ///< length of a plane line (bytes)
+        int height;   ///< number of plane lines
+};
+int codec_is_planar(codec_t codec) ATTRIBUTE(pure);
+int vc_get_planes(unsigned int width, unsigned int height, codec_t codec,
+                struct vc_plane planes[VC_MAX_PLANES]);
+size_t vc_get_datalen(unsigned int width, unsigned int height, codec_t codec) ATTRIBUTE(pure);
 int codec_is_a_rgb(codec_t codec) ATTRIBUTE(pure);
 bool codec_is_in_set(codec_t codec, codec_t *set) ATTRIBUTE(pure);
 int codec_is_const_size(codec_t codec) ATTRIBUTE(pure);
@@ -112,6 +158,8 @@ void vc_copylineRGBtoUYVY_SSE(unsigned char *dst, const unsigned char *src, int
 void vc_copylineRGBtoGrayscale_SSE(unsigned char *dst, const unsigned char *src, int len);
 void vc_copylineRGBtoR12L(unsigned char *dst, const unsigned char *src, int len,
                 int rshift, int gshift, int bshift);
+void vc_copylineR12LtoRGB(unsigned char *dst, const unsigned char *src, int len,
+                int rshift, int gshift, int bshift);
 void vc_copylineUYVYtoRGB(unsigned char *dst, const unsigned char *src, int len);
 void vc_copylineUYVYtoRGB_SSE(unsigned char *dst, const unsigned char *src, int len);
 void vc_copylineUYVYtoGrayscale(unsigned char *dst, const unsigned char *src, int len);
@@ -393,24 +393,23 @@ static shared_ptr<video_frame> compress_frame_tiles(struct compress_state_real *
         // frame pointer may no longer be valid
         frame = NULL;
 
-        vector<task_result_handle_t> task_handle(separate_tiles.size());
-
         vector <compress_worker_data> data_tile(separate_tiles.size());
         for(unsigned int i = 0; i < separate_tiles.size(); ++i) {
                 struct compress_worker_data *data = &data_tile[i];
                 data->state = s->state[i];
                 data->frame = separate_tiles[i];
                 data->callback = s->funcs->compress_tile_func;
-
-                task_handle[i] = task_run_async(compress_tile_callback, data);
         }
+        // the last (or the only) tile is compressed by this thread, so that
+        // single-tile streams do not hand off to the pool at all
+        task_run_parallel(compress_tile_callback, data_tile.size(), data_tile.data(),
+                        sizeof data_tile[0], nullptr);
 
         vector<shared_ptr<video_frame>> compressed_tiles(separate_tiles.size(), nullptr);
 
         bool failed = false;
         for(unsigned int i = 0; i < separate_tiles.size(); ++i) {
-                struct compress_worker_data *data = (struct compress_worker_data *)
-                        wait_task(task_handle[i]);
+                struct compress_worker_data *data = &data_tile[i];
 
                 if(!data->ret) {
                         failed = true;
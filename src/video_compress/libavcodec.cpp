@@ -54,6 +54,7 @@
 #include "module.h"
 #include "utils/misc.h"
 #include "utils/resource_manager.h"
+#include "utils/video_frame_pool.h"
 #include "utils/worker.h"
 #include "video.h"
 #include "video_compress.h"
@@ -61,8 +62,8 @@
 #include <map>
 #include <regex>
 #include <string>
-#include <thread>
 #include <unordered_map>
+#include <vector>
 
 #ifdef HWACC_VAAPI
 extern "C"
@@ -73,8 +74,14 @@ extern "C"
 }
 #endif
 
+#define CONV_CHUNK_LINES 16 ///< lines converted to intermediate format and then to AVFrame at once
+#define CONV_LINE_PADDING 64
+
 #ifdef __SSE3__
 #include "pmmintrin.h"
+#ifdef __SSSE3__
+#include "tmmintrin.h"
+#endif
 // compat with older Clang compiler
 #ifndef _mm_bslli_si128
 #define _mm_bslli_si128 _mm_slli_si128
@@ -206,8 +213,14 @@ struct state_video_compress_libav {
 
         unsigned char      *decoded; ///< intermediate representation for codecs
                                      ///< that are not directly supported
+        int                 decoded_linesize;
         codec_t             decoded_codec;
-        decoder_t           decoder;
+        decoder_t           decoder; ///< NULL if input is converted directly
+
+        AVFrame            *planar_frame;       ///< planes of input tile passed to encoder as-is, NULL if input is converted
+        tile_decoder_t      tile_decoder;       ///< converts planar input to packed format, NULL if not needed
+        codec_t             tile_decoded_codec; ///< output of tile_decoder
+        unsigned char      *tile_decoded;       ///< buffer for tile_decoder output
 
         codec_t             requested_codec_id;
         long long int       requested_bitrate;
@@ -231,19 +244,30 @@ struct state_video_compress_libav {
 
         bool hwenc;
         AVFrame *hwframe;
+
+        video_frame_pool<default_data_allocator> pool; ///< output frames if AVPacket cannot be passed directly
+        size_t              pool_data_len;             ///< size of pool frames, 0 if pool is not configured
 };
 
-static void to_yuv420p(AVFrame *out_frame, unsigned char *in_data, int width, int height);
-static void to_yuv422p(AVFrame *out_frame, unsigned char *in_data, int width, int height);
-static void to_yuv444p(AVFrame *out_frame, unsigned char *in_data, int width, int height);
-static void to_nv12(AVFrame *out_frame, unsigned char *in_data, int width, int height);
-static void v210_to_yuv420p10le(AVFrame *out_frame, unsigned char *in_data, int width, int height);
-static void v210_to_yuv422p10le(AVFrame *out_frame, unsigned char *in_data, int width, int height);
-static void v210_to_yuv444p10le(AVFrame *out_frame, unsigned char *in_data, int width, int height);
-typedef void (*pixfmt_callback_t)(AVFrame *out_frame, unsigned char *in_data, int width, int height);
+typedef void (*pixfmt_callback_t)(AVFrame *out_frame, unsigned char *in_data, int in_linesize, int width, int height);
 static pixfmt_callback_t select_pixfmt_callback(AVPixelFormat fmt, codec_t src);
 
 
+/**
+ * Planar UltraGrid pixel formats that are passed to the encoder without any
+ * conversion if it accepts corresponding pixel format.
+ */
+static const struct {
+        codec_t codec;
+        AVPixelFormat pix_fmt;
+        int subsampling;
+} planar_pixfmts[] = {
+        { I420, AV_PIX_FMT_YUV420P, 420 },
+        { NV12, AV_PIX_FMT_NV12, 420 },
+        { P010, AV_PIX_FMT_P010LE, 420 },
+        { I210, AV_PIX_FMT_YUV422P10LE, 422 },
+};
+
 static void usage(void);
 static int parse_fmt(struct state_video_compress_libav *s, char *fmt);
 static void cleanup(struct state_video_compress_libav *s);
@@ -498,17 +522,16 @@ struct module * libavcodec_compress_init(struct module *parent, const char *opts
                         return NULL;
         }
 
-        s->params.cpu_count = thread::hardware_concurrency();
-        if(s->params.cpu_count < 1) {
-                log_msg(LOG_LEVEL_WARNING, "Warning: Cannot get number of CPU cores!\n");
-                s->params.cpu_count = 1;
-        }
+        s->params.cpu_count = get_worker_count();
         s->in_frame_part = (AVFrame **) calloc(s->params.cpu_count, sizeof(AVFrame *));
         for(int i = 0; i < s->params.cpu_count; i++) {
                 s->in_frame_part[i] = av_frame_alloc();
         }
 
         s->decoded = NULL;
+        s->planar_frame = NULL;
+        s->tile_decoder = NULL;
+        s->tile_decoded = NULL;
 
         module_init_default(&s->module_data);
         s->module_data.cls = MODULE_CLASS_DATA;
@@ -816,6 +839,14 @@ static bool configure_with(struct state_video_compress_libav *s, struct video_de
         }
 #endif
 
+        // planar input in a format the encoder accepts is passed through directly
+        for (auto const & p : planar_pixfmts) {
+                if (p.codec == desc.color_spec && (s->requested_subsampling == 0 ||
+                                        s->requested_subsampling == p.subsampling)) {
+                        requested_pix_fmts[total_pix_fmts++] = p.pix_fmt;
+                }
+        }
+
         if (s->requested_subsampling == 0) {
                 // for interlaced formats, it is better to use either 422 or 444
                 if (desc.interlacing == INTERLACED_MERGED) {
@@ -934,41 +965,51 @@ static bool configure_with(struct state_video_compress_libav *s, struct video_de
         log_msg(LOG_LEVEL_INFO, "[lavc] Selected pixfmt: %s\n", av_get_pix_fmt_name(pix_fmt));
         s->selected_pixfmt = pix_fmt;
 
-        s->decoded_codec = UYVY; // most compressions use 8-bit YUV formats internally
-        switch(desc.color_spec) {
-                case UYVY:
-                        s->decoder = (decoder_t) memcpy;
-                        break;
-                case YUYV:
-                        s->decoder = (decoder_t) vc_copylineYUYV;
-                        break;
-                case v210:
-                        if (s->selected_pixfmt == AV_PIX_FMT_YUV420P10LE ||
-                                        s->selected_pixfmt == AV_PIX_FMT_YUV422P10LE ||
-                                        s->selected_pixfmt == AV_PIX_FMT_YUV444P10LE) {
-                                s->decoder = (decoder_t) memcpy;
-                                s->decoded_codec = v210;
-                        } else {
-                                s->decoder = (decoder_t) vc_copylinev210;
+        codec_t in_codec = desc.color_spec;
+        if (codec_is_planar(desc.color_spec)) {
+                bool passthrough = false;
+                for (auto const & p : planar_pixfmts) {
+                        passthrough = passthrough || (p.codec == desc.color_spec && p.pix_fmt == pix_fmt);
+                }
+                if (passthrough) {
+                        s->planar_frame = av_frame_alloc();
+                        s->planar_frame->format = pix_fmt;
+                        s->planar_frame->width = desc.width;
+                        s->planar_frame->height = desc.height;
+                } else { // unpack the tile first and continue as with the packed format
+                        in_codec = get_bits_per_component(desc.color_spec) > 8 ? v210 : UYVY;
+                        s->tile_decoder = get_tile_decoder_from_to(desc.color_spec, in_codec);
+                        if (!s->tile_decoder) {
+                                log_msg(LOG_LEVEL_ERROR, "[lavc] Unable to convert %s.\n",
+                                                get_codec_name(desc.color_spec));
+                                return false;
                         }
-                        break;
-                case RGB:
-                        s->decoder = (decoder_t) vc_copylineRGBtoUYVY;
-                        break;
-                case BGR:
-                        s->decoder = (decoder_t) vc_copylineBGRtoUYVY;
-                        break;
-                case RGBA:
-                        s->decoder = (decoder_t) vc_copylineRGBAtoUYVY;
-                        break;
-                default:
+                        s->tile_decoded_codec = in_codec;
+                        s->tile_decoded = (unsigned char *) malloc(vc_get_datalen(desc.width,
+                                                desc.height, in_codec));
+                }
+        }
+
+        if (s->planar_frame) {
+                s->decoder = NULL;
+                s->decoded_codec = desc.color_spec;
+        } else if (select_pixfmt_callback(s->selected_pixfmt, in_codec)) { // direct conversion
+                s->decoder = NULL;
+                s->decoded_codec = in_codec;
+        } else {
+                s->decoded_codec = UYVY; // most compressions use 8-bit YUV formats internally
+                s->decoder = get_decoder_from_to(in_codec, UYVY, true);
+                if (!s->decoder || !select_pixfmt_callback(s->selected_pixfmt, s->decoded_codec)) {
                         log_msg(LOG_LEVEL_ERROR, "[Libavcodec] Unable to find "
                                         "appropriate pixel format.\n");
                         return false;
+                }
+                // every conversion thread decodes CONV_CHUNK_LINES lines at once to its own part
+                s->decoded_linesize = (vc_get_linesize(desc.width, s->decoded_codec) + CONV_LINE_PADDING)
+                        / CONV_LINE_PADDING * CONV_LINE_PADDING;
+                s->decoded = (unsigned char *) malloc(s->params.cpu_count * CONV_CHUNK_LINES * s->decoded_linesize);
         }
 
-        s->decoded = (unsigned char *) malloc(vc_get_linesize(desc.width, s->decoded_codec) * desc.height);
-
         s->in_frame = av_frame_alloc();
         if (!s->in_frame) {
                 log_msg(LOG_LEVEL_ERROR, "Could not allocate video frame\n");
@@ -1015,126 +1056,185 @@ static bool configure_with(struct state_video_compress_libav *s, struct video_de
         s->compressed_desc.tile_count = 1;
 
         s->out_codec = s->compressed_desc.color_spec;
+        s->pool_data_len = 0;
 
         return true;
 }
 
-static void to_yuv420p(AVFrame *out_frame, unsigned char *in_data, int width, int height)
+/*
+ * Packed 8-bit 4:2:2 (UYVY or YUYV) to planar conversions. 4:2:0 chroma is an
+ * average of two lines rounded up at half, which is what _mm_avg_epu8() does,
+ * so that the SSE and the scalar paths produce identical output.
+ */
+
+#ifdef __SSE3__
+/// luma of packed 4:2:2 in the low bytes of 16-bit lanes
+template<codec_t src_codec>
+static inline __m128i packed_y(__m128i yuv)
+{
+        return src_codec == YUYV ? _mm_and_si128(yuv, _mm_set1_epi16(0x00FF)) : _mm_srli_epi16(yuv, 8);
+}
+
+/// chroma of packed 4:2:2 (Cb and Cr alternating) in the low bytes of 16-bit lanes
+template<codec_t src_codec>
+static inline __m128i packed_uv(__m128i yuv)
 {
+        return src_codec == YUYV ? _mm_srli_epi16(yuv, 8) : _mm_and_si128(yuv, _mm_set1_epi16(0x00FF));
+}
+#endif
+
+template<codec_t src_codec>
+static void to_yuv420p(AVFrame *out_frame, unsigned char *in_data, int in_linesize, int width, int height)
+{
+        const int y0_off = src_codec == YUYV ? 0 : 1;
+        const int u_off = src_codec == YUYV ? 1 : 0;
         for(int y = 0; y < height; y += 2) {
                 /*  every even row */
-                unsigned char *src = in_data + y * (width * 2);
+                unsigned char *src = in_data + y * in_linesize;
                 /*  every odd row */
-                unsigned char *src2 = in_data + (y + 1) * (width * 2);
+                unsigned char *src2 = in_data + (y + 1) * in_linesize;
                 unsigned char *dst_y = out_frame->data[0] + out_frame->linesize[0] * y;
                 unsigned char *dst_y2 = out_frame->data[0] + out_frame->linesize[0] * (y + 1);
                 unsigned char *dst_cb = out_frame->data[1] + out_frame->linesize[1] * y / 2;
                 unsigned char *dst_cr = out_frame->data[2] + out_frame->linesize[2] * y / 2;
-                for(int x = 0; x < width / 2; ++x) {
-                        *dst_cb++ = (*src++ + *src2++) / 2;
-                        *dst_y++ = *src++;
-                        *dst_y2++ = *src2++;
-                        *dst_cr++ = (*src++ + *src2++) / 2;
-                        *dst_y++ = *src++;
-                        *dst_y2++ = *src2++;
+                int x = 0;
+#ifdef __SSE3__
+                __m128i umask = _mm_set1_epi16(0x00FF);
+                for (; x < width / 2 - 7; x += 8) {
+                        __m128i yuv = _mm_lddqu_si128((__m128i const*) src);
+                        __m128i yuv2 = _mm_lddqu_si128((__m128i const*) src2);
+                        __m128i yuv3 = _mm_lddqu_si128((__m128i const*) (src + 16));
+                        __m128i yuv4 = _mm_lddqu_si128((__m128i const*) (src2 + 16));
+                        src += 32;
+                        src2 += 32;
+
+                        __m128i y1 = packed_y<src_codec>(yuv);
+                        __m128i y2 = packed_y<src_codec>(yuv2);
+                        __m128i y3 = packed_y<src_codec>(yuv3);
+                        __m128i y4 = packed_y<src_codec>(yuv4);
+                        _mm_storeu_si128((__m128i *) dst_y, _mm_packus_epi16(y1, y3));
+                        _mm_storeu_si128((__m128i *) dst_y2, _mm_packus_epi16(y2, y4));
+                        dst_y += 16;
+                        dst_y2 += 16;
+
+                        __m128i uv = _mm_avg_epu8(packed_uv<src_codec>(yuv), packed_uv<src_codec>(yuv2));
+                        __m128i uv2 = _mm_avg_epu8(packed_uv<src_codec>(yuv3), packed_uv<src_codec>(yuv4));
+                        uv = _mm_packus_epi16(uv, uv2); // U0 V0 U1 V1 ...
+                        __m128i u = _mm_packus_epi16(_mm_and_si128(uv, umask), _mm_setzero_si128());
+                        __m128i v = _mm_packus_epi16(_mm_srli_epi16(uv, 8), _mm_setzero_si128());
+                        _mm_storel_epi64((__m128i *) dst_cb, u);
+                        _mm_storel_epi64((__m128i *) dst_cr, v);
+                        dst_cb += 8;
+                        dst_cr += 8;
+                }
+#endif
+                for(; x < width / 2; ++x) {
+                        *dst_cb++ = (src[u_off] + src2[u_off] + 1) / 2;
+                        *dst_cr++ = (src[u_off + 2] + src2[u_off + 2] + 1) / 2;
+                        *dst_y++ = src[y0_off];
+                        *dst_y++ = src[y0_off + 2];
+                        *dst_y2++ = src2[y0_off];
+                        *dst_y2++ = src2[y0_off + 2];
+                        src += 4;
+                        src2 += 4;
                 }
         }
 }
 
-static void to_yuv422p(AVFrame *out_frame, unsigned char *src, int width, int height)
+template<codec_t src_codec>
+static void to_yuv422p(AVFrame *out_frame, unsigned char *in_data, int in_linesize, int width, int height)
 {
+        const int y0_off = src_codec == YUYV ? 0 : 1;
+        const int u_off = src_codec == YUYV ? 1 : 0;
         for(int y = 0; y < (int) height; ++y) {
+                unsigned char *src = in_data + y * in_linesize;
                 unsigned char *dst_y = out_frame->data[0] + out_frame->linesize[0] * y;
                 unsigned char *dst_cb = out_frame->data[1] + out_frame->linesize[1] * y;
                 unsigned char *dst_cr = out_frame->data[2] + out_frame->linesize[2] * y;
-                for(int x = 0; x < width; x += 2) {
-                        *dst_cb++ = *src++;
-                        *dst_y++ = *src++;
-                        *dst_cr++ = *src++;
-                        *dst_y++ = *src++;
+                int x = 0;
+#ifdef __SSE3__
+                __m128i umask = _mm_set1_epi16(0x00FF);
+                for (; x < width - 15; x += 16) {
+                        __m128i yuv = _mm_lddqu_si128((__m128i const*) src);
+                        __m128i yuv2 = _mm_lddqu_si128((__m128i const*) (src + 16));
+                        src += 32;
+
+                        __m128i y1 = packed_y<src_codec>(yuv);
+                        __m128i y2 = packed_y<src_codec>(yuv2);
+                        _mm_storeu_si128((__m128i *) dst_y, _mm_packus_epi16(y1, y2));
+                        dst_y += 16;
+
+                        __m128i uv = _mm_packus_epi16(packed_uv<src_codec>(yuv), packed_uv<src_codec>(yuv2));
+                        __m128i u = _mm_packus_epi16(_mm_and_si128(uv, umask), _mm_setzero_si128());
+                        __m128i v = _mm_packus_epi16(_mm_srli_epi16(uv, 8), _mm_setzero_si128());
+                        _mm_storel_epi64((__m128i *) dst_cb, u);
+                        _mm_storel_epi64((__m128i *) dst_cr, v);
+                        dst_cb += 8;
+                        dst_cr += 8;
+                }
+#endif
+                for(; x < width - 1; x += 2) {
+                        *dst_cb++ = src[u_off];
+                        *dst_cr++ = src[u_off + 2];
+                        *dst_y++ = src[y0_off];
+                        *dst_y++ = src[y0_off + 2];
+                        src += 4;
                 }
         }
 }
 
-static void to_yuv444p(AVFrame *out_frame, unsigned char *src, int width, int height)
+template<codec_t src_codec>
+static void to_yuv444p(AVFrame *out_frame, unsigned char *in_data, int in_linesize, int width, int height)
 {
+        const int y0_off = src_codec == YUYV ? 0 : 1;
+        const int u_off = src_codec == YUYV ? 1 : 0;
         for(int y = 0; y < height; ++y) {
+                unsigned char *src = in_data + y * in_linesize;
                 unsigned char *dst_y = out_frame->data[0] + out_frame->linesize[0] * y;
                 unsigned char *dst_cb = out_frame->data[1] + out_frame->linesize[1] * y;
                 unsigned char *dst_cr = out_frame->data[2] + out_frame->linesize[2] * y;
-                for(int x = 0; x < width; x += 2) {
-                        *dst_cb++ = *src;
-                        *dst_cb++ = *src++;
-                        *dst_y++ = *src++;
-                        *dst_cr++ = *src;
-                        *dst_cr++ = *src++;
-                        *dst_y++ = *src++;
+                for(int x = 0; x < width - 1; x += 2) {
+                        *dst_cb++ = src[u_off];
+                        *dst_cb++ = src[u_off];
+                        *dst_cr++ = src[u_off + 2];
+                        *dst_cr++ = src[u_off + 2];
+                        *dst_y++ = src[y0_off];
+                        *dst_y++ = src[y0_off + 2];
+                        src += 4;
                 }
         }
 }
 
-static void to_nv12(AVFrame *out_frame, unsigned char *in_data, int width, int height)
+template<codec_t src_codec>
+static void to_nv12(AVFrame *out_frame, unsigned char *in_data, int in_linesize, int width, int height)
 {
+        const int y0_off = src_codec == YUYV ? 0 : 1;
+        const int u_off = src_codec == YUYV ? 1 : 0;
         for(int y = 0; y < height; y += 2) {
                 /*  every even row */
-                unsigned char *src = in_data + y * (width * 2);
+                unsigned char *src = in_data + y * in_linesize;
                 /*  every odd row */
-                unsigned char *src2 = in_data + (y + 1) * (width * 2);
+                unsigned char *src2 = in_data + (y + 1) * in_linesize;
                 unsigned char *dst_y = out_frame->data[0] + out_frame->linesize[0] * y;
                 unsigned char *dst_y2 = out_frame->data[0] + out_frame->linesize[0] * (y + 1);
                 unsigned char *dst_cbcr = out_frame->data[1] + out_frame->linesize[1] * y / 2;
 
                 int x = 0;
 #ifdef __SSE3__
-                __m128i yuv;
-                __m128i yuv2;
-                __m128i y1;
-                __m128i y2;
-                __m128i y3;
-                __m128i y4;
-                __m128i uv;
-                __m128i uv2;
-                __m128i uv3;
-                __m128i uv4;
-                __m128i ymask = _mm_set1_epi32(0xFF00FF00);
-                __m128i dsty;
-                __m128i dsty2;
-                __m128i dstuv;
-
                 for (; x < (width - 15); x += 16){
-                        yuv = _mm_lddqu_si128((__m128i const*) src);
-                        yuv2 = _mm_lddqu_si128((__m128i const*) src2);
-                        src += 16;
-                        src2 += 16;
-
-                        y1 = _mm_and_si128(ymask, yuv);
-                        y1 = _mm_bsrli_si128(y1, 1);
-                        y2 = _mm_and_si128(ymask, yuv2);
-                        y2 = _mm_bsrli_si128(y2, 1);
-
-                        uv = _mm_andnot_si128(ymask, yuv);
-                        uv2 = _mm_andnot_si128(ymask, yuv2);
-
-                        uv = _mm_avg_epu8(uv, uv2);
-
-                        yuv = _mm_lddqu_si128((__m128i const*) src);
-                        yuv2 = _mm_lddqu_si128((__m128i const*) src2);
-                        src += 16;
-                        src2 += 16;
-
-                        y3 = _mm_and_si128(ymask, yuv);
-                        y3 = _mm_bsrli_si128(y3, 1);
-                        y4 = _mm_and_si128(ymask, yuv2);
-                        y4 = _mm_bsrli_si128(y4, 1);
-
-                        uv3 = _mm_andnot_si128(ymask, yuv);
-                        uv4 = _mm_andnot_si128(ymask, yuv2);
-
-                        uv3 = _mm_avg_epu8(uv3, uv4);
-
-                        dsty = _mm_packus_epi16(y1, y3);
-                        dsty2 = _mm_packus_epi16(y2, y4);
-                        dstuv = _mm_packus_epi16(uv, uv3);
+                        __m128i yuv = _mm_lddqu_si128((__m128i const*) src);
+                        __m128i yuv2 = _mm_lddqu_si128((__m128i const*) src2);
+                        __m128i yuv3 = _mm_lddqu_si128((__m128i const*) (src + 16));
+                        __m128i yuv4 = _mm_lddqu_si128((__m128i const*) (src2 + 16));
+                        src += 32;
+                        src2 += 32;
+
+                        __m128i uv = _mm_avg_epu8(packed_uv<src_codec>(yuv), packed_uv<src_codec>(yuv2));
+                        __m128i uv3 = _mm_avg_epu8(packed_uv<src_codec>(yuv3), packed_uv<src_codec>(yuv4));
+
+                        __m128i dsty = _mm_packus_epi16(packed_y<src_codec>(yuv), packed_y<src_codec>(yuv3));
+                        __m128i dsty2 = _mm_packus_epi16(packed_y<src_codec>(yuv2), packed_y<src_codec>(yuv4));
+                        __m128i dstuv = _mm_packus_epi16(uv, uv3);
                         _mm_storeu_si128((__m128i *) dst_y, dsty);
                         _mm_storeu_si128((__m128i *) dst_y2, dsty2);
                         _mm_storeu_si128((__m128i *) dst_cbcr, dstuv);
@@ -1144,23 +1244,25 @@ static void to_nv12(AVFrame *out_frame, unsigned char *in_data, int width, int h
                 }
 #endif
                 for(; x < width - 1; x += 2) {
-                        *dst_cbcr++ = (*src++ + *src2++) / 2;
-                        *dst_y++ = *src++;
-                        *dst_y2++ = *src2++;
-                        *dst_cbcr++ = (*src++ + *src2++) / 2;
-                        *dst_y++ = *src++;
-                        *dst_y2++ = *src2++;
+                        *dst_cbcr++ = (src[u_off] + src2[u_off] + 1) / 2;
+                        *dst_cbcr++ = (src[u_off + 2] + src2[u_off + 2] + 1) / 2;
+                        *dst_y++ = src[y0_off];
+                        *dst_y++ = src[y0_off + 2];
+                        *dst_y2++ = src2[y0_off];
+                        *dst_y2++ = src2[y0_off + 2];
+                        src += 4;
+                        src2 += 4;
                 }
         }
 }
 
-static void v210_to_yuv420p10le(AVFrame *out_frame, unsigned char *in_data, int width, int height)
+static void v210_to_yuv420p10le(AVFrame *out_frame, unsigned char *in_data, int in_linesize, int width, int height)
 {
         for(int y = 0; y < height; y += 2) {
                 /*  every even row */
-                uint32_t *src = (uint32_t *) (in_data + y * vc_get_linesize(width, v210));
+                uint32_t *src = (uint32_t *) (in_data + y * in_linesize);
                 /*  every odd row */
-                uint32_t *src2 = (uint32_t *) (in_data + (y + 1) * vc_get_linesize(width, v210));
+                uint32_t *src2 = (uint32_t *) (in_data + (y + 1) * in_linesize);
                 uint16_t *dst_y = (uint16_t *) (out_frame->data[0] + out_frame->linesize[0] * y);
                 uint16_t *dst_y2 = (uint16_t *) (out_frame->data[0] + out_frame->linesize[0] * (y + 1));
                 uint16_t *dst_cb = (uint16_t *) (out_frame->data[1] + out_frame->linesize[1] * y / 2);
@@ -1215,10 +1317,10 @@ static void v210_to_yuv420p10le(AVFrame *out_frame, unsigned char *in_data, int
         }
 }
 
-static void v210_to_yuv422p10le(AVFrame *out_frame, unsigned char *in_data, int width, int height)
+static void v210_to_yuv422p10le(AVFrame *out_frame, unsigned char *in_data, int in_linesize, int width, int height)
 {
         for(int y = 0; y < height; y += 1) {
-                uint32_t *src = (uint32_t *) (in_data + y * vc_get_linesize(width, v210));
+                uint32_t *src = (uint32_t *) (in_data + y * in_linesize);
                 uint16_t *dst_y = (uint16_t *) (out_frame->data[0] + out_frame->linesize[0] * y);
                 uint16_t *dst_cb = (uint16_t *) (out_frame->data[1] + out_frame->linesize[1] * y);
                 uint16_t *dst_cr = (uint16_t *) (out_frame->data[2] + out_frame->linesize[2] * y);
@@ -1248,10 +1350,10 @@ static void v210_to_yuv422p10le(AVFrame *out_frame, unsigned char *in_data, int
         }
 }
 
-static void v210_to_yuv444p10le(AVFrame *out_frame, unsigned char *in_data, int width, int height)
+static void v210_to_yuv444p10le(AVFrame *out_frame, unsigned char *in_data, int in_linesize, int width, int height)
 {
         for(int y = 0; y < height; y += 1) {
-                uint32_t *src = (uint32_t *) (in_data + y * vc_get_linesize(width, v210));
+                uint32_t *src = (uint32_t *) (in_data + y * in_linesize);
                 uint16_t *dst_y = (uint16_t *) (out_frame->data[0] + out_frame->linesize[0] * y);
                 uint16_t *dst_cb = (uint16_t *) (out_frame->data[1] + out_frame->linesize[1] * y);
                 uint16_t *dst_cr = (uint16_t *) (out_frame->data[2] + out_frame->linesize[2] * y);
@@ -1287,48 +1389,428 @@ static void v210_to_yuv444p10le(AVFrame *out_frame, unsigned char *in_data, int
         }
 }
 
-static pixfmt_callback_t select_pixfmt_callback(AVPixelFormat fmt, codec_t src) {
+/*
+ * RGB-like inputs (RGB, BGR, RGBA, R10k and R12L) are converted to 8-bit planar
+ * YCbCr in one pass over the source. The arithmetic is the 16-bit fixed point
+ * Rec. 709 of vc_copylineToUYVY709() so that 4:2:2 and 4:2:0 output matches
+ * the conversion through UYVY; 4:4:4 keeps chroma of every pixel.
+ */
+#define RGB709_Y(r, g, b) (11993 * (r) + 40239 * (g) + 4063 * (b) + (1<<20))
+#define RGB709_CB(r, g, b) (-6619 * (r) - 22151 * (g) + 28770 * (b))
+#define RGB709_CR(r, g, b) (28770 * (r) - 26149 * (g) - 2621 * (b))
+#define RGB_CONV_SEGMENT 1024 ///< pixels of a line pair converted at once for 4:2:0 (chroma of the 2nd line is kept on stack)
+
+static inline unsigned char fx16_to_8(int val)
+{
+        return min(max(val, 0), (1<<24) - 1) >> 16;
+}
+
+/**
+ * Reads pixels of a source line as 8-bit R, G and B.
+ *
+ * get() returns pixel x, load4() (SSSE3) returns pixels x..x+3 (x is a multiple
+ * of 4) as R | G << 16 and B in 32-bit lanes. load4() may read simd_overread
+ * pixels past the 8 pixels converted at once.
+ */
+template<codec_t> struct rgb_reader;
+
+template<int pix_size, int roff, int goff, int boff>
+struct rgb8_reader {
+        enum { simd_overread = pix_size == 3 ? 2 : 0 };
+        static inline void get(const unsigned char *line, int x, int &r, int &g, int &b) {
+                line += x * pix_size;
+                r = line[roff];
+                g = line[goff];
+                b = line[boff];
+        }
+#ifdef __SSSE3__
+        static inline void load4(const unsigned char *line, int x, __m128i &rg, __m128i &b) {
+                __m128i in = _mm_lddqu_si128((__m128i const *) (line + x * pix_size));
+                rg = _mm_shuffle_epi8(in, _mm_setr_epi8(roff, -1, goff, -1,
+                                        pix_size + roff, -1, pix_size + goff, -1,
+                                        2 * pix_size + roff, -1, 2 * pix_size + goff, -1,
+                                        3 * pix_size + roff, -1, 3 * pix_size + goff, -1));
+                b = _mm_shuffle_epi8(in, _mm_setr_epi8(boff, -1, -1, -1, pix_size + boff, -1, -1, -1,
+                                        2 * pix_size + boff, -1, -1, -1, 3 * pix_size + boff, -1, -1, -1));
+        }
+#endif
+};
+
+template<> struct rgb_reader<RGB> : rgb8_reader<3, 0, 1, 2> {};
+template<> struct rgb_reader<BGR> : rgb8_reader<3, 2, 1, 0> {};
+template<> struct rgb_reader<RGBA> : rgb8_reader<4, 0, 1, 2> {};
+
+/// 8 most significant bits of 10-bit components, see vc_copyliner10k()
+template<> struct rgb_reader<R10k> {
+        enum { simd_overread = 0 };
+        static inline void get(const unsigned char *line, int x, int &r, int &g, int &b) {
+                line += x * 4;
+                r = line[0];
+                g = (line[1] & 0x3f) << 2 | line[2] >> 6;
+                b = (line[2] & 0x0f) << 4 | line[3] >> 4;
+        }
+#ifdef __SSSE3__
+        static inline void load4(const unsigned char *line, int x, __m128i &rg, __m128i &b) {
+                __m128i in = _mm_lddqu_si128((__m128i const *) (line + x * 4));
+                __m128i g = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(in, 6), _mm_set1_epi32(0xfc)),
+                                _mm_and_si128(_mm_srli_epi32(in, 22), _mm_set1_epi32(0x3)));
+                rg = _mm_or_si128(_mm_and_si128(in, _mm_set1_epi32(0xff)), _mm_slli_epi32(g, 16));
+                b = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(in, 12), _mm_set1_epi32(0xf0)),
+                                _mm_srli_epi32(in, 28));
+        }
+#endif
+};
+
+/// 8 most significant bits of 12-bit components, see vc_copylineR12LtoRGB()
+template<> struct rgb_reader<R12L> {
+        enum { simd_overread = 0 };
+        static inline int byte(int x) {
+#ifdef WORDS_BIGENDIAN
+                return (x & ~3) + 3 - (x & 3);
+#else
+                return x;
+#endif
+        }
+        /// component c of a 36-byte block of 8 pixels, two components are packed in 3 bytes
+        static inline int comp(const unsigned char *block, int c) {
+                int i = c / 2 * 3;
+                return c % 2 == 0 ? ((block[byte(i)] >> 4) | (block[byte(i + 1)] << 4)) & 0xff
+                        : block[byte(i + 2)];
+        }
+        static inline void get(const unsigned char *line, int x, int &r, int &g, int &b) {
+                const unsigned char *block = line + x / 8 * 36;
+                r = comp(block, x % 8 * 3);
+                g = comp(block, x % 8 * 3 + 1);
+                b = comp(block, x % 8 * 3 + 2);
+        }
+#ifdef __SSSE3__
+        /**
+         * Four pixels are 12 components in 18 bytes. Every 16-bit lane gets either
+         * the 2 bytes holding an even component (taken as bits 4-11) or the byte
+         * with an odd one (multiplied by 16 to be taken the same way).
+         */
+        static inline void load4(const unsigned char *line, int x, __m128i &rg, __m128i &b) {
+                const unsigned char *src = line + x / 8 * 36 + x % 8 / 4 * 18;
+                __m128i in = _mm_lddqu_si128((__m128i const *) src);
+                __m128i in2 = _mm_lddqu_si128((__m128i const *) (src + 2)); // bytes 16 and 17
+                rg = _mm_or_si128(_mm_shuffle_epi8(in, _mm_setr_epi8(0, 1, 2, -1, 5, -1, 6, 7,
+                                                9, 10, 11, -1, 14, -1, -1, -1)),
+                                _mm_shuffle_epi8(in2, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+                                                -1, -1, -1, -1, -1, -1, 13, 14)));
+                b = _mm_or_si128(_mm_shuffle_epi8(in, _mm_setr_epi8(3, 4, -1, -1, 8, -1, -1, -1,
+                                                12, 13, -1, -1, -1, -1, -1, -1)),
+                                _mm_shuffle_epi8(in2, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+                                                -1, -1, -1, -1, 15, -1, -1, -1)));
+                rg = _mm_mullo_epi16(rg, _mm_setr_epi16(1, 16, 16, 1, 1, 16, 16, 1));
+                b = _mm_mullo_epi16(b, _mm_setr_epi16(1, 1, 16, 1, 1, 1, 16, 1));
+                rg = _mm_and_si128(_mm_srli_epi16(rg, 4), _mm_set1_epi16(0xff));
+                b = _mm_and_si128(_mm_srli_epi16(b, 4), _mm_set1_epi16(0xff));
+        }
+#endif
+};
+
+#ifdef __SSSE3__
+/**
+ * RGB709_Y(), RGB709_CB() and RGB709_CR() of 4 pixels from rgb_reader::load4()
+ * in 32-bit lanes. 40239 does not fit int16 so G is multiplied by
+ * 40239 - 65536 and G << 16 is added.
+ */
+static inline void rgb709_sse(__m128i rg, __m128i b, __m128i &y, __m128i &cb, __m128i &cr)
+{
+        y = _mm_add_epi32(_mm_madd_epi16(rg, _mm_setr_epi16(11993, -25297, 11993, -25297, 11993, -25297, 11993, -25297)),
+                        _mm_madd_epi16(b, _mm_set1_epi32(4063)));
+        y = _mm_add_epi32(y, _mm_add_epi32(_mm_and_si128(rg, _mm_set1_epi32(0xffff0000)), _mm_set1_epi32(1<<20)));
+        cb = _mm_add_epi32(_mm_madd_epi16(rg, _mm_setr_epi16(-6619, -22151, -6619, -22151, -6619, -22151, -6619, -22151)),
+                        _mm_madd_epi16(b, _mm_set1_epi32(28770)));
+        cr = _mm_add_epi32(_mm_madd_epi16(rg, _mm_setr_epi16(28770, -26149, 28770, -26149, 28770, -26149, 28770, -26149)),
+                        _mm_madd_epi16(b, _mm_set1_epi32(-2621 & 0xffff)));
+}
 
-        if (src == v210) {
-                if (fmt == AV_PIX_FMT_YUV420P10LE) {
-                        return v210_to_yuv420p10le;
-                } else if (fmt == AV_PIX_FMT_YUV422P10LE) {
-                        return v210_to_yuv422p10le;
-                } else if (fmt == AV_PIX_FMT_YUV444P10LE) {
-                        return v210_to_yuv444p10le;
+/// chroma of pixel pairs as in vc_copylineToUYVY709() - sum / 2 rounded toward zero
+static inline __m128i rgb709_pair_chroma_sse(__m128i c1, __m128i c2)
+{
+        __m128i sum = _mm_hadd_epi32(c1, c2);
+        sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm_srli_epi32(sum, 31)), 1);
+        return _mm_add_epi32(sum, _mm_set1_epi32(1<<23));
+}
+
+/// converts 8 values (4 if val2 is zero) as fx16_to_8() does to the low bytes
+static inline __m128i fx16_to_8_sse(__m128i val1, __m128i val2)
+{
+        __m128i val = _mm_packs_epi32(_mm_srai_epi32(val1, 16), _mm_srai_epi32(val2, 16));
+        return _mm_packus_epi16(val, val);
+}
+#endif
+
+/**
+ * Converts count pixels of an RGB-like line starting at pixel x (a multiple
+ * of 8) to Y and either Cb and Cr of every pixel pair or of every pixel
+ * (full_chroma). Output pointers correspond to pixel x.
+ */
+template<codec_t src_codec, bool full_chroma>
+static void rgb_line_to_ycbcr(unsigned char *dst_y, unsigned char *dst_cb, unsigned char *dst_cr,
+                const unsigned char *line, int x, int count)
+{
+        typedef rgb_reader<src_codec> reader;
+        int i = 0;
+#ifdef __SSSE3__
+        for (; i + 8 + reader::simd_overread <= count; i += 8) {
+                __m128i y[2], cb[2], cr[2];
+                for (int j = 0; j < 2; ++j) {
+                        __m128i rg, b;
+                        reader::load4(line, x + i + 4 * j, rg, b);
+                        rgb709_sse(rg, b, y[j], cb[j], cr[j]);
+                }
+                _mm_storel_epi64((__m128i *) (dst_y + i), fx16_to_8_sse(y[0], y[1]));
+                if (full_chroma) {
+                        __m128i offset = _mm_set1_epi32(1<<23);
+                        _mm_storel_epi64((__m128i *) (dst_cb + i), fx16_to_8_sse(_mm_add_epi32(cb[0], offset),
+                                                _mm_add_epi32(cb[1], offset)));
+                        _mm_storel_epi64((__m128i *) (dst_cr + i), fx16_to_8_sse(_mm_add_epi32(cr[0], offset),
+                                                _mm_add_epi32(cr[1], offset)));
                 } else {
-                        abort();
+                        int32_t u = _mm_cvtsi128_si32(fx16_to_8_sse(rgb709_pair_chroma_sse(cb[0], cb[1]),
+                                                _mm_setzero_si128()));
+                        int32_t v = _mm_cvtsi128_si32(fx16_to_8_sse(rgb709_pair_chroma_sse(cr[0], cr[1]),
+                                                _mm_setzero_si128()));
+                        memcpy(dst_cb + i / 2, &u, sizeof u);
+                        memcpy(dst_cr + i / 2, &v, sizeof v);
                 }
         }
+#endif
+        for (; i < count - 1; i += 2) {
+                int r, g, b;
+                reader::get(line, x + i, r, g, b);
+                int y1 = RGB709_Y(r, g, b);
+                int u1 = RGB709_CB(r, g, b);
+                int v1 = RGB709_CR(r, g, b);
+                reader::get(line, x + i + 1, r, g, b);
+                int y2 = RGB709_Y(r, g, b);
+                int u2 = RGB709_CB(r, g, b);
+                int v2 = RGB709_CR(r, g, b);
+                dst_y[i] = fx16_to_8(y1);
+                dst_y[i + 1] = fx16_to_8(y2);
+                if (full_chroma) {
+                        dst_cb[i] = fx16_to_8(u1 + (1<<23));
+                        dst_cb[i + 1] = fx16_to_8(u2 + (1<<23));
+                        dst_cr[i] = fx16_to_8(v1 + (1<<23));
+                        dst_cr[i + 1] = fx16_to_8(v2 + (1<<23));
+                } else {
+                        dst_cb[i / 2] = fx16_to_8((u1 + u2) / 2 + (1<<23));
+                        dst_cr[i / 2] = fx16_to_8((v1 + v2) / 2 + (1<<23));
+                }
+        }
+}
 
-        if (is422_8(fmt)) {
-                return to_yuv422p;
-        } else if (is420_8(fmt)) {
-                if (fmt == AV_PIX_FMT_NV12)
-                        return to_nv12;
-                else
-                        return to_yuv420p;
-        } else if (is444_8(fmt)) {
-                return to_yuv444p;
-        } else {
-                log_msg(LOG_LEVEL_FATAL, "[lavc] Unknown subsampling.\n");
-                abort();
+/// dst = (dst + src + 1) / 2, same as _mm_avg_epu8()
+static void avg_line(unsigned char *dst, const unsigned char *src, int len)
+{
+        int i = 0;
+#ifdef __SSE3__
+        for (; i < len - 15; i += 16) {
+                _mm_storeu_si128((__m128i *) (dst + i), _mm_avg_epu8(_mm_lddqu_si128((__m128i const *) (dst + i)),
+                                        _mm_lddqu_si128((__m128i const *) (src + i))));
+        }
+#endif
+        for (; i < len; ++i) {
+                dst[i] = (dst[i] + src[i] + 1) / 2;
+        }
+}
+
+template<codec_t src_codec>
+static void rgb_to_yuv420p(AVFrame *out_frame, unsigned char *in_data, int in_linesize, int width, int height)
+{
+        unsigned char cb2[RGB_CONV_SEGMENT / 2];
+        unsigned char cr2[RGB_CONV_SEGMENT / 2];
+        for (int y = 0; y < height; y += 2) {
+                unsigned char *src = in_data + y * in_linesize;
+                unsigned char *dst_y = out_frame->data[0] + out_frame->linesize[0] * y;
+                unsigned char *dst_cb = out_frame->data[1] + out_frame->linesize[1] * y / 2;
+                unsigned char *dst_cr = out_frame->data[2] + out_frame->linesize[2] * y / 2;
+                for (int x = 0; x < width; x += RGB_CONV_SEGMENT) {
+                        int count = min(RGB_CONV_SEGMENT, width - x);
+                        rgb_line_to_ycbcr<src_codec, false>(dst_y + x, dst_cb + x / 2, dst_cr + x / 2, src, x, count);
+                        rgb_line_to_ycbcr<src_codec, false>(dst_y + out_frame->linesize[0] + x, cb2, cr2,
+                                        src + in_linesize, x, count);
+                        avg_line(dst_cb + x / 2, cb2, count / 2);
+                        avg_line(dst_cr + x / 2, cr2, count / 2);
+                }
+        }
+}
+
+template<codec_t src_codec>
+static void rgb_to_nv12(AVFrame *out_frame, unsigned char *in_data, int in_linesize, int width, int height)
+{
+        unsigned char cb[2][RGB_CONV_SEGMENT / 2];
+        unsigned char cr[2][RGB_CONV_SEGMENT / 2];
+        for (int y = 0; y < height; y += 2) {
+                unsigned char *src = in_data + y * in_linesize;
+                unsigned char *dst_y = out_frame->data[0] + out_frame->linesize[0] * y;
+                unsigned char *dst_cbcr = out_frame->data[1] + out_frame->linesize[1] * y / 2;
+                for (int x = 0; x < width; x += RGB_CONV_SEGMENT) {
+                        int count = min(RGB_CONV_SEGMENT, width - x);
+                        rgb_line_to_ycbcr<src_codec, false>(dst_y + x, cb[0], cr[0], src, x, count);
+                        rgb_line_to_ycbcr<src_codec, false>(dst_y + out_frame->linesize[0] + x, cb[1], cr[1],
+                                        src + in_linesize, x, count);
+                        unsigned char *dst = dst_cbcr + x;
+                        int i = 0;
+#ifdef __SSE3__
+                        for (; i < count / 2 - 15; i += 16) {
+                                __m128i u = _mm_avg_epu8(_mm_lddqu_si128((__m128i const *) (cb[0] + i)),
+                                                _mm_lddqu_si128((__m128i const *) (cb[1] + i)));
+                                __m128i v = _mm_avg_epu8(_mm_lddqu_si128((__m128i const *) (cr[0] + i)),
+                                                _mm_lddqu_si128((__m128i const *) (cr[1] + i)));
+                                _mm_storeu_si128((__m128i *) (dst + 2 * i), _mm_unpacklo_epi8(u, v));
+                                _mm_storeu_si128((__m128i *) (dst + 2 * i + 16), _mm_unpackhi_epi8(u, v));
+                        }
+#endif
+                        for (; i < count / 2; ++i) {
+                                dst[2 * i] = (cb[0][i] + cb[1][i] + 1) / 2;
+                                dst[2 * i + 1] = (cr[0][i] + cr[1][i] + 1) / 2;
+                        }
+                }
+        }
+}
+
+template<codec_t src_codec>
+static void rgb_to_yuv422p(AVFrame *out_frame, unsigned char *in_data, int in_linesize, int width, int height)
+{
+        for (int y = 0; y < height; ++y) {
+                rgb_line_to_ycbcr<src_codec, false>(out_frame->data[0] + out_frame->linesize[0] * y,
+                                out_frame->data[1] + out_frame->linesize[1] * y,
+                                out_frame->data[2] + out_frame->linesize[2] * y,
+                                in_data + y * in_linesize, 0, width);
         }
 }
 
+template<codec_t src_codec>
+static void rgb_to_yuv444p(AVFrame *out_frame, unsigned char *in_data, int in_linesize, int width, int height)
+{
+        for (int y = 0; y < height; ++y) {
+                rgb_line_to_ycbcr<src_codec, true>(out_frame->data[0] + out_frame->linesize[0] * y,
+                                out_frame->data[1] + out_frame->linesize[1] * y,
+                                out_frame->data[2] + out_frame->linesize[2] * y,
+                                in_data + y * in_linesize, 0, width);
+        }
+}
+
+static const struct {
+        codec_t src;
+        AVPixelFormat dst;
+        pixfmt_callback_t func;
+} pixfmt_callbacks[] = {
+        { UYVY, AV_PIX_FMT_YUV420P, to_yuv420p<UYVY> },
+        { UYVY, AV_PIX_FMT_YUVJ420P, to_yuv420p<UYVY> },
+        { UYVY, AV_PIX_FMT_NV12, to_nv12<UYVY> },
+        { UYVY, AV_PIX_FMT_YUV422P, to_yuv422p<UYVY> },
+        { UYVY, AV_PIX_FMT_YUVJ422P, to_yuv422p<UYVY> },
+        { UYVY, AV_PIX_FMT_YUV444P, to_yuv444p<UYVY> },
+        { UYVY, AV_PIX_FMT_YUVJ444P, to_yuv444p<UYVY> },
+        { YUYV, AV_PIX_FMT_YUV420P, to_yuv420p<YUYV> },
+        { YUYV, AV_PIX_FMT_YUVJ420P, to_yuv420p<YUYV> },
+        { YUYV, AV_PIX_FMT_NV12, to_nv12<YUYV> },
+        { YUYV, AV_PIX_FMT_YUV422P, to_yuv422p<YUYV> },
+        { YUYV, AV_PIX_FMT_YUVJ422P, to_yuv422p<YUYV> },
+        { YUYV, AV_PIX_FMT_YUV444P, to_yuv444p<YUYV> },
+        { YUYV, AV_PIX_FMT_YUVJ444P, to_yuv444p<YUYV> },
+        { RGB, AV_PIX_FMT_YUV420P, rgb_to_yuv420p<RGB> },
+        { RGB, AV_PIX_FMT_YUVJ420P, rgb_to_yuv420p<RGB> },
+        { RGB, AV_PIX_FMT_NV12, rgb_to_nv12<RGB> },
+        { RGB, AV_PIX_FMT_YUV422P, rgb_to_yuv422p<RGB> },
+        { RGB, AV_PIX_FMT_YUVJ422P, rgb_to_yuv422p<RGB> },
+        { RGB, AV_PIX_FMT_YUV444P, rgb_to_yuv444p<RGB> },
+        { RGB, AV_PIX_FMT_YUVJ444P, rgb_to_yuv444p<RGB> },
+        { BGR, AV_PIX_FMT_YUV420P, rgb_to_yuv420p<BGR> },
+        { BGR, AV_PIX_FMT_YUVJ420P, rgb_to_yuv420p<BGR> },
+        { BGR, AV_PIX_FMT_NV12, rgb_to_nv12<BGR> },
+        { BGR, AV_PIX_FMT_YUV422P, rgb_to_yuv422p<BGR> },
+        { BGR, AV_PIX_FMT_YUVJ422P, rgb_to_yuv422p<BGR> },
+        { BGR, AV_PIX_FMT_YUV444P, rgb_to_yuv444p<BGR> },
+        { BGR, AV_PIX_FMT_YUVJ444P, rgb_to_yuv444p<BGR> },
+        { RGBA, AV_PIX_FMT_YUV420P, rgb_to_yuv420p<RGBA> },
+        { RGBA, AV_PIX_FMT_YUVJ420P, rgb_to_yuv420p<RGBA> },
+        { RGBA, AV_PIX_FMT_NV12, rgb_to_nv12<RGBA> },
+        { RGBA, AV_PIX_FMT_YUV422P, rgb_to_yuv422p<RGBA> },
+        { RGBA, AV_PIX_FMT_YUVJ422P, rgb_to_yuv422p<RGBA> },
+        { RGBA, AV_PIX_FMT_YUV444P, rgb_to_yuv444p<RGBA> },
+        { RGBA, AV_PIX_FMT_YUVJ444P, rgb_to_yuv444p<RGBA> },
+        { R10k, AV_PIX_FMT_YUV420P, rgb_to_yuv420p<R10k> },
+        { R10k, AV_PIX_FMT_YUVJ420P, rgb_to_yuv420p<R10k> },
+        { R10k, AV_PIX_FMT_NV12, rgb_to_nv12<R10k> },
+        { R10k, AV_PIX_FMT_YUV422P, rgb_to_yuv422p<R10k> },
+        { R10k, AV_PIX_FMT_YUVJ422P, rgb_to_yuv422p<R10k> },
+        { R10k, AV_PIX_FMT_YUV444P, rgb_to_yuv444p<R10k> },
+        { R10k, AV_PIX_FMT_YUVJ444P, rgb_to_yuv444p<R10k> },
+        { R12L, AV_PIX_FMT_YUV420P, rgb_to_yuv420p<R12L> },
+        { R12L, AV_PIX_FMT_YUVJ420P, rgb_to_yuv420p<R12L> },
+        { R12L, AV_PIX_FMT_NV12, rgb_to_nv12<R12L> },
+        { R12L, AV_PIX_FMT_YUV422P, rgb_to_yuv422p<R12L> },
+        { R12L, AV_PIX_FMT_YUVJ422P, rgb_to_yuv422p<R12L> },
+        { R12L, AV_PIX_FMT_YUV444P, rgb_to_yuv444p<R12L> },
+        { R12L, AV_PIX_FMT_YUVJ444P, rgb_to_yuv444p<R12L> },
+        { v210, AV_PIX_FMT_YUV420P10LE, v210_to_yuv420p10le },
+        { v210, AV_PIX_FMT_YUV422P10LE, v210_to_yuv422p10le },
+        { v210, AV_PIX_FMT_YUV444P10LE, v210_to_yuv444p10le },
+};
+
+/**
+ * @returns function converting src directly to fmt, NULL if there is none
+ */
+static pixfmt_callback_t select_pixfmt_callback(AVPixelFormat fmt, codec_t src) {
+        for (auto const & c : pixfmt_callbacks) {
+                if (c.src == src && c.dst == fmt) {
+                        return c.func;
+                }
+        }
+        return NULL;
+}
+
 struct my_task_data {
-        void (*callback)(AVFrame *out_frame, unsigned char *in_data, int width, int height);
+        pixfmt_callback_t callback;
         AVFrame *out_frame;
         unsigned char *in_data;
+        int in_linesize;
         int width;
         int height;
+
+        decoder_t decoder;     ///< decoder to intermediate format, NULL if in_data is converted directly
+        unsigned char *tmp;    ///< CONV_CHUNK_LINES lines of intermediate format
+        int tmp_linesize;
+        int log2_chroma_h;
 };
 
 void *my_task(void *arg);
 
+/**
+ * Converts a slice of input frame to AVFrame. If the input needs to be decoded
+ * first, it is done for CONV_CHUNK_LINES at once, which are converted
+ * immediately while still in cache.
+ */
 void *my_task(void *arg) {
         struct my_task_data *data = (struct my_task_data *) arg;
-        data->callback(data->out_frame, data->in_data, data->width, data->height);
+        if (!data->decoder) {
+                data->callback(data->out_frame, data->in_data, data->in_linesize, data->width, data->height);
+                return NULL;
+        }
+
+        uint8_t *planes[4];
+        memcpy(planes, data->out_frame->data, sizeof planes);
+        for (int y = 0; y < data->height; y += CONV_CHUNK_LINES) {
+                int lines = min(CONV_CHUNK_LINES, data->height - y);
+                for (int i = 0; i < lines; ++i) {
+                        data->decoder(data->tmp + i * data->tmp_linesize,
+                                        data->in_data + (y + i) * data->in_linesize,
+                                        vc_get_linesize(data->width, UYVY), 0, 8, 16);
+                }
+                for (int i = 0; i < 4; ++i) {
+                        if (planes[i]) {
+                                data->out_frame->data[i] = planes[i] + data->out_frame->linesize[i] *
+                                        (i == 0 ? y : y >> data->log2_chroma_h);
+                        }
+                }
+                data->callback(data->out_frame, data->tmp, data->tmp_linesize, data->width, lines);
+        }
+        memcpy(data->out_frame->data, planes, sizeof planes);
         return NULL;
 }
 
@@ -1337,7 +1819,6 @@ static shared_ptr<video_frame> libavcodec_compress_tile(struct module *mod, shar
         struct state_video_compress_libav *s = (struct state_video_compress_libav *) mod->priv_data;
         static int frame_seq = 0;
         int ret;
-        unsigned char *decoded;
         shared_ptr<video_frame> out{};
 
         libavcodec_check_messages(s);
@@ -1351,8 +1832,9 @@ static shared_ptr<video_frame> libavcodec_compress_tile(struct module *mod, shar
                 }
         }
 
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(57, 37, 100)
         auto dispose = [](struct video_frame *frame) {
-#if LIBAVCODEC_VERSION_MAJOR >= 54 && LIBAVCODEC_VERSION_INT < AV_VERSION_INT(57, 37, 100)
+#if LIBAVCODEC_VERSION_MAJOR >= 54
                 AVPacket *pkt = (AVPacket *) frame->callbacks.dispose_udata;
                 av_packet_unref(pkt);
                 free(pkt);
@@ -1362,7 +1844,7 @@ static shared_ptr<video_frame> libavcodec_compress_tile(struct module *mod, shar
                 vf_free(frame);
         };
         out = shared_ptr<video_frame>(vf_alloc_desc(s->compressed_desc), dispose);
-#if LIBAVCODEC_VERSION_MAJOR >= 54 && LIBAVCODEC_VERSION_INT < AV_VERSION_INT(57, 37, 100)
+#if LIBAVCODEC_VERSION_MAJOR >= 54
         int got_output;
         AVPacket *pkt;
         pkt = (AVPacket *) malloc(sizeof(AVPacket));
@@ -1374,27 +1856,30 @@ static shared_ptr<video_frame> libavcodec_compress_tile(struct module *mod, shar
         out->tiles[0].data = (char *) malloc(s->compressed_desc.width *
                         s->compressed_desc.height * 4);
 #endif // LIBAVCODEC_VERSION_MAJOR >= 54
+#endif // LIBAVCODEC_VERSION_INT < AV_VERSION_INT(57, 37, 100)
 
         s->in_frame->pts = frame_seq++;
 
-        if((void *) s->decoder != (void *) memcpy) {
-                unsigned char *line1 = (unsigned char *) tx->tiles[0].data;
-                unsigned char *line2 = (unsigned char *) s->decoded;
-                int src_linesize = vc_get_linesize(tx->tiles[0].width, tx->color_spec);
-                int dst_linesize = tx->tiles[0].width * 2; /* UYVY */
-                for (int i = 0; i < (int) tx->tiles[0].height; ++i) {
-                        s->decoder(line2, line1, dst_linesize,
-                                        0, 8, 16);
-                        line1 += src_linesize;
-                        line2 += dst_linesize;
-                }
-                decoded = s->decoded;
+        AVFrame *frame = s->in_frame;
+        if (s->planar_frame) {
+                struct vc_plane planes[VC_MAX_PLANES];
+                int plane_count = vc_get_planes(tx->tiles[0].width, tx->tiles[0].height,
+                                tx->color_spec, planes);
+                for (int i = 0; i < plane_count; ++i) {
+                        s->planar_frame->data[i] = (uint8_t *) tx->tiles[0].data + planes[i].offset;
+                        s->planar_frame->linesize[i] = planes[i].linesize;
+                }
+                s->planar_frame->pts = s->in_frame->pts;
+                frame = s->planar_frame;
         } else {
-                decoded = (unsigned char *) tx->tiles[0].data;
-        }
-
-        {
-                task_result_handle_t handle[s->params.cpu_count];
+                unsigned char *src = (unsigned char *) tx->tiles[0].data;
+                codec_t src_codec = tx->color_spec;
+                if (s->tile_decoder) {
+                        s->tile_decoder(s->tile_decoded, src, tx->tiles[0].width, tx->tiles[0].height);
+                        src = s->tile_decoded;
+                        src_codec = s->tile_decoded_codec;
+                }
+                int src_linesize = vc_get_linesize(tx->tiles[0].width, src_codec);
                 struct my_task_data data[s->params.cpu_count];
                 for(int i = 0; i < s->params.cpu_count; ++i) {
                         data[i].callback = select_pixfmt_callback(s->selected_pixfmt, s->decoded_codec);
@@ -1410,53 +1895,77 @@ static shared_ptr<video_frame> libavcodec_compress_tile(struct module *mod, shar
                                         height * (s->params.cpu_count - 1);
                         }
                         data[i].width = tx->tiles[0].width;
-                        data[i].in_data = decoded + i * height *
-                                vc_get_linesize(tx->tiles[0].width, s->decoded_codec);
-
-                        // run !
-                        handle[i] = task_run_async(my_task, (void *) &data[i]);
-                }
-
-                for(int i = 0; i < s->params.cpu_count; ++i) {
-                        wait_task(handle[i]);
+                        data[i].in_data = src + i * height * src_linesize;
+                        data[i].in_linesize = src_linesize;
+                        data[i].decoder = s->decoder;
+                        data[i].tmp = s->decoder ? s->decoded + i * CONV_CHUNK_LINES * s->decoded_linesize : NULL;
+                        data[i].tmp_linesize = s->decoded_linesize;
+                        data[i].log2_chroma_h = av_pix_fmt_desc_get(s->selected_pixfmt)->log2_chroma_h;
                 }
+                task_run_parallel(my_task, s->params.cpu_count, data, sizeof data[0], NULL);
         }
 
-        AVFrame *frame = s->in_frame;
 #ifdef HWACC_VAAPI
         if(s->hwenc){
-                av_hwframe_transfer_data(s->hwframe, s->in_frame, 0);
+                av_hwframe_transfer_data(s->hwframe, frame, 0);
                 frame = s->hwframe;
         }
 #endif
 
         /* encode the image */
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 37, 100)
-        out->tiles[0].data_len = 0;
-        if (libav_codec_has_extradata(s->out_codec)) { // we need to store extradata for HuffYUV/FFV1 in the beginning
-                out->tiles[0].data_len += sizeof(uint32_t) + s->codec_ctx->extradata_size;
-                *(uint32_t *) out->tiles[0].data = s->codec_ctx->extradata_size;
-                memcpy(out->tiles[0].data + sizeof(uint32_t), s->codec_ctx->extradata, s->codec_ctx->extradata_size);
-        }
-
         ret = avcodec_send_frame(s->codec_ctx, frame);
-        if (ret == 0) {
-                AVPacket pkt;
-                av_init_packet(&pkt);
-                ret = avcodec_receive_packet(s->codec_ctx, &pkt);
-                while (ret == 0) {
-                        assert(pkt.size + out->tiles[0].data_len <= s->compressed_desc.width * s->compressed_desc.height * 4 - out->tiles[0].data_len);
-                        memcpy((uint8_t *) out->tiles[0].data + out->tiles[0].data_len,
-                                        pkt.data, pkt.size);
-                        out->tiles[0].data_len += pkt.size;
-                        av_packet_unref(&pkt);
-                        ret = avcodec_receive_packet(s->codec_ctx, &pkt);
+        if (ret != 0) {
+		print_libav_error(LOG_LEVEL_WARNING, "[lavc] Error encoding frame", ret);
+                return {};
+        }
+        vector<AVPacket *> pkts;
+        while (true) {
+                AVPacket *pkt = av_packet_alloc();
+                ret = avcodec_receive_packet(s->codec_ctx, pkt);
+                if (ret != 0) {
+                        av_packet_free(&pkt);
+                        break;
                 }
-                if (ret != AVERROR(EAGAIN) && ret != 0) {
-                        print_libav_error(LOG_LEVEL_WARNING, "[lavc] Receive packet error", ret);
+                pkts.push_back(pkt);
+        }
+        if (ret != AVERROR(EAGAIN)) {
+                print_libav_error(LOG_LEVEL_WARNING, "[lavc] Receive packet error", ret);
+        }
+
+        bool has_extradata = libav_codec_has_extradata(s->out_codec); // we need to store extradata for HuffYUV/FFV1 in the beginning
+        if (pkts.size() == 1 && !has_extradata) { // common case - pass the packet buffer without copying
+                out = shared_ptr<video_frame>(vf_alloc_desc(s->compressed_desc), [](struct video_frame *frame) {
+                                AVPacket *pkt = (AVPacket *) frame->callbacks.dispose_udata;
+                                av_packet_free(&pkt);
+                                vf_free(frame);
+                                });
+                out->callbacks.dispose_udata = pkts[0];
+                out->tiles[0].data = (char *) pkts[0]->data;
+                out->tiles[0].data_len = pkts[0]->size;
+        } else if (!pkts.empty() || has_extradata) {
+                size_t len = has_extradata ? sizeof(uint32_t) + s->codec_ctx->extradata_size : 0;
+                for (auto pkt : pkts) {
+                        len += pkt->size;
+                }
+                if (len > s->pool_data_len) { // leave some headroom for bitrate fluctuations
+                        s->pool_data_len = len + len / 2;
+                        s->pool.reconfigure(s->compressed_desc, s->pool_data_len);
+                }
+                out = s->pool.get_frame();
+                out->tiles[0].data_len = 0;
+                if (has_extradata) {
+                        out->tiles[0].data_len += sizeof(uint32_t) + s->codec_ctx->extradata_size;
+                        *(uint32_t *)(void *) out->tiles[0].data = s->codec_ctx->extradata_size;
+                        memcpy(out->tiles[0].data + sizeof(uint32_t), s->codec_ctx->extradata, s->codec_ctx->extradata_size);
+                }
+                for (auto pkt : pkts) {
+                        memcpy((uint8_t *) out->tiles[0].data + out->tiles[0].data_len,
+                                        pkt->data, pkt->size);
+                        out->tiles[0].data_len += pkt->size;
+                        av_packet_free(&pkt);
                 }
         } else {
-		print_libav_error(LOG_LEVEL_WARNING, "[lavc] Error encoding frame", ret);
                 return {};
         }
 #elif LIBAVCODEC_VERSION_MAJOR >= 54
@@ -1535,6 +2044,10 @@ static void cleanup(struct state_video_compress_libav *s)
         }
         free(s->decoded);
         s->decoded = NULL;
+        av_frame_free(&s->planar_frame);
+        free(s->tile_decoded);
+        s->tile_decoded = NULL;
+        s->tile_decoder = NULL;
 
         if(s->hwframe){
                 av_frame_free(&s->hwframe);
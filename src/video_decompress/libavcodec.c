@@ -48,6 +48,7 @@
 #include "lib_common.h"
 #include "tv.h"
 #include "utils/resource_manager.h"
+#include "utils/worker.h"
 #include "video.h"
 #include "video_decompress.h"
 
@@ -59,6 +60,8 @@
 #include "hwaccel_vdpau.h"
 #include "hwaccel_vaapi.h"
 
+#include <libavutil/cpu.h>
+
 #ifdef __cplusplus
 #include <algorithm>
 using std::max;
@@ -83,6 +86,24 @@ using std::min;
 #endif
 #endif
 
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+#define LAVD_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+#define MIN_LINES_PER_CONV_TASK 32
+
+/// Horizontal band of the decoded frame converted by one worker
+struct lavd_conv_band {
+        av_to_uv_convert_t *convert;
+        AVFrame          frame; ///< view of the band rows (data, linesize, format and opaque only)
+        char            *dst;
+        int              width;
+        int              height;
+        int              pitch;
+        task_result_handle_t handle;
+};
+
 struct state_libavcodec_decompress {
         pthread_mutex_t *global_lavcd_lock;
         AVCodecContext  *codec_ctx;
@@ -105,10 +126,13 @@ struct state_libavcodec_decompress {
 #ifdef HWACC_COMMON
         struct hw_accel_state hwaccel;
 #endif
+
+        int              conv_threads;
+        struct lavd_conv_band *conv_bands; ///< one per conv_threads
 };
 
-static int change_pixfmt(AVFrame *frame, unsigned char *dst, int av_codec,
-                codec_t out_codec, int width, int height, int pitch);
+static int change_pixfmt(struct state_libavcodec_decompress *s, AVFrame *frame, unsigned char *dst,
+                int av_codec, codec_t out_codec, int width, int height, int pitch);
 static void error_callback(void *, int, const char *, va_list);
 static enum AVPixelFormat get_format_callback(struct AVCodecContext *s, const enum AVPixelFormat *fmt);
 
@@ -220,6 +244,10 @@ static const struct decoder_info decoders[] = {
 ADD_TO_PARAM(force_lavd_decoder, "force-lavd-decoder", "* force-lavd-decoder=<decoder>[:<decoder2>...]\n"
                 "  Forces specified Libavcodec decoder. If more need to be specified, use colon as a delimiter\n");
 
+ADD_TO_PARAM(lavd_convert_threads, "lavd-convert-threads", "* lavd-convert-threads=<n>\n"
+                "  Number of threads converting decoded frames to output pixel format\n"
+                "  (default number of CPUs)\n");
+
 #ifdef HWACC_COMMON
 ADD_TO_PARAM(force_hw_accel, "use-hw-accel", "* use-hw-accel\n"
                 "  Tries to use hardware acceleration. \n");
@@ -372,6 +400,13 @@ static void * libavcodec_decompress_init(void)
         hwaccel_state_init(&s->hwaccel);
 #endif
 
+        s->conv_threads = av_cpu_count();
+        if (get_commandline_param("lavd-convert-threads")) {
+                s->conv_threads = atoi(get_commandline_param("lavd-convert-threads"));
+        }
+        s->conv_threads = max(s->conv_threads, 1);
+        s->conv_bands = (struct lavd_conv_band *) calloc(s->conv_threads, sizeof(struct lavd_conv_band));
+
         return s;
 }
 
@@ -385,7 +420,8 @@ static int libavcodec_decompress_reconfigure(void *state, struct video_desc desc
         assert(out_codec == UYVY ||
                         out_codec == RGB ||
                         out_codec == v210 ||
-                        out_codec == HW_VDPAU);
+                        out_codec == HW_VDPAU ||
+                        codec_is_planar(out_codec));
 
         s->pitch = pitch;
         s->rshift = rshift;
@@ -404,6 +440,205 @@ static int libavcodec_decompress_reconfigure(void *state, struct video_desc desc
         }
 }
 
+#ifdef LAVD_X86_DISPATCH
+static bool lavd_have_ssse3;
+static bool lavd_have_avx2;
+
+static void lavd_detect_simd(void)
+{
+        __builtin_cpu_init();
+        lavd_have_ssse3 = __builtin_cpu_supports("ssse3");
+        lavd_have_avx2 = __builtin_cpu_supports("avx2");
+}
+
+/**
+ * Interleaves one line of planar 4:2:2 8-bit YUV into UYVY.
+ * @returns number of pixels processed (the rest is left to scalar code)
+ */
+__attribute__((target("avx2")))
+static int yuv422p_to_uyvy_row_avx2(uint8_t *dst, const uint8_t *src_y,
+                const uint8_t *src_cb, const uint8_t *src_cr, int width)
+{
+        int x = 0;
+        for (; x + 32 <= width; x += 32) {
+                __m128i u = _mm_loadu_si128((const __m128i *)(const void *) (src_cb + x / 2));
+                __m128i v = _mm_loadu_si128((const __m128i *)(const void *) (src_cr + x / 2));
+                __m256i uv = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi8(u, v)),
+                                _mm_unpackhi_epi8(u, v), 1);
+                __m256i yy = _mm256_loadu_si256((const __m256i *)(const void *) (src_y + x));
+                // lo = pixels 0-7 | 16-23, hi = 8-15 | 24-31
+                __m256i lo = _mm256_unpacklo_epi8(uv, yy);
+                __m256i hi = _mm256_unpackhi_epi8(uv, yy);
+                _mm256_storeu_si256((__m256i *)(void *) (dst + 2 * x), _mm256_permute2x128_si256(lo, hi, 0x20));
+                _mm256_storeu_si256((__m256i *)(void *) (dst + 2 * x + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+        }
+        return x;
+}
+
+/**
+ * Packs 12 10-bit samples in UYVY order (6 pixels) into 4 v210 words.
+ */
+__attribute__((target("ssse3")))
+static inline void pack_v210_ssse3(uint32_t *dst, const uint16_t *s)
+{
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(const void *) s);
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(const void *) (s + 4));
+        // first and last sample of each word (low and high 16 bits), middle sample
+        __m128i a = _mm_or_si128(
+                        _mm_shuffle_epi8(v0, _mm_setr_epi8(0, 1, 4, 5, 6, 7, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1)),
+                        _mm_shuffle_epi8(v1, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 4, 5, 8, 9, 10, 11, 14, 15)));
+        __m128i b = _mm_or_si128(
+                        _mm_shuffle_epi8(v0, _mm_setr_epi8(2, 3, -1, -1, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                        _mm_shuffle_epi8(v1, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 6, 7, -1, -1, 12, 13, -1, -1)));
+        __m128i res = _mm_and_si128(a, _mm_set1_epi32(0xffff));
+        res = _mm_or_si128(res, _mm_slli_epi32(_mm_srli_epi32(a, 16), 20));
+        res = _mm_or_si128(res, _mm_slli_epi32(b, 10));
+        _mm_storeu_si128((__m128i *)(void *) dst, res);
+}
+
+/**
+ * Converts one line of planar 4:2:2 10-bit YUV to v210.
+ * @returns number of pixels processed (multiple of 6)
+ */
+__attribute__((target("ssse3")))
+static int yuv422p10le_to_v210_row_ssse3(uint32_t *dst, const uint16_t *src_y,
+                const uint16_t *src_cb, const uint16_t *src_cr, int width)
+{
+        int x = 0;
+        for (; x + 24 <= width; x += 24) {
+                uint16_t s[48] __attribute__((aligned(16)));
+                for (int i = 0; i < 3; ++i) {
+                        __m128i cb = _mm_loadl_epi64((const __m128i *)(const void *) (src_cb + x / 2 + 4 * i));
+                        __m128i cr = _mm_loadl_epi64((const __m128i *)(const void *) (src_cr + x / 2 + 4 * i));
+                        __m128i yy = _mm_loadu_si128((const __m128i *)(const void *) (src_y + x + 8 * i));
+                        __m128i uv = _mm_unpacklo_epi16(cb, cr);
+                        _mm_store_si128((__m128i *)(void *) (s + 16 * i), _mm_unpacklo_epi16(uv, yy));
+                        _mm_store_si128((__m128i *)(void *) (s + 16 * i + 8), _mm_unpackhi_epi16(uv, yy));
+                }
+                for (int i = 0; i < 4; ++i) {
+                        pack_v210_ssse3(dst + x / 6 * 4 + 4 * i, s + 12 * i);
+                }
+        }
+        return x;
+}
+
+/// 8-bit variant of yuv422p10le_to_v210_row_ssse3()
+__attribute__((target("ssse3")))
+static int yuv422p_to_v210_row_ssse3(uint32_t *dst, const uint8_t *src_y,
+                const uint8_t *src_cb, const uint8_t *src_cr, int width)
+{
+        const __m128i zero = _mm_setzero_si128();
+        int x = 0;
+        for (; x + 24 <= width; x += 24) {
+                uint16_t s[48] __attribute__((aligned(16)));
+                for (int i = 0; i < 3; ++i) {
+                        int32_t cb4, cr4;
+                        memcpy(&cb4, src_cb + x / 2 + 4 * i, sizeof cb4);
+                        memcpy(&cr4, src_cr + x / 2 + 4 * i, sizeof cr4);
+                        __m128i cb = _mm_slli_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(cb4), zero), 2);
+                        __m128i cr = _mm_slli_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(cr4), zero), 2);
+                        __m128i yy = _mm_slli_epi16(_mm_unpacklo_epi8(
+                                                _mm_loadl_epi64((const __m128i *)(const void *) (src_y + x + 8 * i)), zero), 2);
+                        __m128i uv = _mm_unpacklo_epi16(cb, cr);
+                        _mm_store_si128((__m128i *)(void *) (s + 16 * i), _mm_unpacklo_epi16(uv, yy));
+                        _mm_store_si128((__m128i *)(void *) (s + 16 * i + 8), _mm_unpackhi_epi16(uv, yy));
+                }
+                for (int i = 0; i < 4; ++i) {
+                        pack_v210_ssse3(dst + x / 6 * 4 + 4 * i, s + 12 * i);
+                }
+        }
+        return x;
+}
+
+/**
+ * Converts 8 pixels to RGB24 with the same fixed-point arithmetic as the
+ * scalar code. Writes 4 bytes past the 24 output bytes.
+ */
+__attribute__((target("avx2")))
+static inline void yuv_to_rgb24_8px_avx2(uint8_t *dst, __m128i y8, __m256i r, __m256i g, __m256i b)
+{
+        const __m256i max_val = _mm256_set1_epi32((1<<24) - 1);
+        __m256i y = _mm256_slli_epi32(_mm256_cvtepu8_epi32(y8), 16);
+        r = _mm256_srli_epi32(_mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(r, y), _mm256_setzero_si256()), max_val), 16);
+        g = _mm256_srli_epi32(_mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(g, y), _mm256_setzero_si256()), max_val), 16);
+        b = _mm256_srli_epi32(_mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(b, y), _mm256_setzero_si256()), max_val), 16);
+        __m256i rgb = _mm256_or_si256(r, _mm256_or_si256(_mm256_slli_epi32(g, 8), _mm256_slli_epi32(b, 16)));
+        rgb = _mm256_shuffle_epi8(rgb, _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+        _mm_storeu_si128((__m128i *)(void *) dst, _mm256_castsi256_si128(rgb));
+        _mm_storeu_si128((__m128i *)(void *) (dst + 12), _mm256_extracti128_si256(rgb, 1));
+}
+
+/**
+ * Converts one (or two if dst2 is not NULL) lines of horizontally subsampled
+ * YUV to RGB24. If cr is NULL, chroma is interleaved in cb (NV12).
+ * @returns number of pixels processed (multiple of 8)
+ */
+__attribute__((target("avx2")))
+static int yuv_to_rgb24_row_avx2(uint8_t *dst1, uint8_t *dst2, const uint8_t *src_y1,
+                const uint8_t *src_y2, const uint8_t *src_cb, const uint8_t *src_cr, int width)
+{
+        int x = 0;
+        // last store writes 4 bytes ahead - leave at least 2 pixels for the scalar code
+        for (; x + 10 <= width; x += 8) {
+                __m128i cb, cr;
+                if (src_cr) {
+                        int32_t cb4, cr4;
+                        memcpy(&cb4, src_cb + x / 2, sizeof cb4);
+                        memcpy(&cr4, src_cr + x / 2, sizeof cr4);
+                        cb = _mm_cvtsi32_si128(cb4);
+                        cr = _mm_cvtsi32_si128(cr4);
+                        cb = _mm_unpacklo_epi8(cb, cb);
+                        cr = _mm_unpacklo_epi8(cr, cr);
+                } else {
+                        __m128i cbcr = _mm_loadl_epi64((const __m128i *)(const void *) (src_cb + x));
+                        cb = _mm_shuffle_epi8(cbcr, _mm_setr_epi8(0, 0, 2, 2, 4, 4, 6, 6, -1, -1, -1, -1, -1, -1, -1, -1));
+                        cr = _mm_shuffle_epi8(cbcr, _mm_setr_epi8(1, 1, 3, 3, 5, 5, 7, 7, -1, -1, -1, -1, -1, -1, -1, -1));
+                }
+                __m256i cb32 = _mm256_sub_epi32(_mm256_cvtepu8_epi32(cb), _mm256_set1_epi32(128));
+                __m256i cr32 = _mm256_sub_epi32(_mm256_cvtepu8_epi32(cr), _mm256_set1_epi32(128));
+                __m256i r = _mm256_mullo_epi32(cr32, _mm256_set1_epi32(75700));
+                __m256i g = _mm256_add_epi32(_mm256_mullo_epi32(cb32, _mm256_set1_epi32(-26864)),
+                                _mm256_mullo_epi32(cr32, _mm256_set1_epi32(-38050)));
+                __m256i b = _mm256_mullo_epi32(cb32, _mm256_set1_epi32(133176));
+                yuv_to_rgb24_8px_avx2(dst1 + 3 * x, _mm_loadl_epi64((const __m128i *)(const void *) (src_y1 + x)), r, g, b);
+                if (dst2) {
+                        yuv_to_rgb24_8px_avx2(dst2 + 3 * x, _mm_loadl_epi64((const __m128i *)(const void *) (src_y2 + x)), r, g, b);
+                }
+        }
+        return x;
+}
+
+/**
+ * Converts one line of planar 4:4:4 10-bit YUV to UYVY (chroma is averaged).
+ * @returns number of pixels processed (multiple of 16)
+ */
+__attribute__((target("ssse3")))
+static int yuv444p10le_to_uyvy_row_ssse3(uint8_t *dst, const uint16_t *src_y,
+                const uint16_t *src_cb, const uint16_t *src_cr, int width)
+{
+        const __m128i ones = _mm_set1_epi16(1);
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+                const __m128i *y = (const __m128i *)(const void *) (src_y + x);
+                const __m128i *cb = (const __m128i *)(const void *) (src_cb + x);
+                const __m128i *cr = (const __m128i *)(const void *) (src_cr + x);
+                __m128i y8 = _mm_packus_epi16(_mm_srli_epi16(_mm_loadu_si128(y), 2),
+                                _mm_srli_epi16(_mm_loadu_si128(y + 1), 2));
+                // (c[0] + c[1]) / 2 >> 2
+                __m128i cb16 = _mm_packs_epi32(_mm_srli_epi32(_mm_madd_epi16(_mm_loadu_si128(cb), ones), 3),
+                                _mm_srli_epi32(_mm_madd_epi16(_mm_loadu_si128(cb + 1), ones), 3));
+                __m128i cr16 = _mm_packs_epi32(_mm_srli_epi32(_mm_madd_epi16(_mm_loadu_si128(cr), ones), 3),
+                                _mm_srli_epi32(_mm_madd_epi16(_mm_loadu_si128(cr + 1), ones), 3));
+                __m128i c8 = _mm_packus_epi16(cb16, cr16); // 8x Cb, 8x Cr
+                __m128i cbcr = _mm_unpacklo_epi8(c8, _mm_srli_si128(c8, 8));
+                _mm_storeu_si128((__m128i *)(void *) (dst + 2 * x), _mm_unpacklo_epi8(cbcr, y8));
+                _mm_storeu_si128((__m128i *)(void *) (dst + 2 * x + 16), _mm_unpackhi_epi8(cbcr, y8));
+        }
+        return x;
+}
+#endif // defined LAVD_X86_DISPATCH
+
 static void nv12_to_yuv422(char *dst_buffer, AVFrame *in_frame,
                 int width, int height, int pitch)
 {
@@ -450,6 +685,21 @@ static void yuv420p_to_yuv422(char *dst_buffer, AVFrame *in_frame,
 
                 int x = 0;
 
+#ifdef LAVD_X86_DISPATCH
+                if (lavd_have_avx2) {
+                        yuv422p_to_uyvy_row_avx2((uint8_t *) dst1, (uint8_t *) src_y1,
+                                        (uint8_t *) src_cb, (uint8_t *) src_cr, width);
+                        x = yuv422p_to_uyvy_row_avx2((uint8_t *) dst2, (uint8_t *) src_y2,
+                                        (uint8_t *) src_cb, (uint8_t *) src_cr, width);
+                        src_y1 += x;
+                        src_y2 += x;
+                        src_cb += x / 2;
+                        src_cr += x / 2;
+                        dst1 += 2 * x;
+                        dst2 += 2 * x;
+                }
+#endif
+
 #ifdef __SSE3__
                 __m128i y1;
                 __m128i y2;
@@ -533,7 +783,21 @@ static void yuv420p_to_v210(char *dst_buffer, AVFrame *in_frame,
                 uint32_t *dst1 = (uint32_t *)(void *)(dst_buffer + (y * 2) * pitch);
                 uint32_t *dst2 = (uint32_t *)(void *)(dst_buffer + (y * 2 + 1) * pitch);
 
-                for(int x = 0; x < width / 6; ++x) {
+                int x = 0;
+#ifdef LAVD_X86_DISPATCH
+                if (lavd_have_ssse3) {
+                        yuv422p_to_v210_row_ssse3(dst1, src_y1, src_cb, src_cr, width);
+                        x = yuv422p_to_v210_row_ssse3(dst2, src_y2, src_cb, src_cr, width) / 6;
+                        src_y1 += 6 * x;
+                        src_y2 += 6 * x;
+                        src_cb += 3 * x;
+                        src_cr += 3 * x;
+                        dst1 += 4 * x;
+                        dst2 += 4 * x;
+                }
+#endif
+
+                for(; x < width / 6; ++x) {
                         uint32_t w0_0, w0_1, w0_2, w0_3;
                         uint32_t w1_0, w1_1, w1_2, w1_3;
 
@@ -563,8 +827,8 @@ static void yuv420p_to_v210(char *dst_buffer, AVFrame *in_frame,
                         w1_2 = w1_2 | (*src_cb << 2) << 20;
                         src_cb++;
 
-                        w0_3 = *src_y1++;
-                        w1_3 = *src_y2++;
+                        w0_3 = *src_y1++ << 2;
+                        w1_3 = *src_y2++ << 2;
                         w0_3 = w0_3 | (*src_cr << 2) << 10;
                         w1_3 = w1_3 | (*src_cr << 2) << 10;
                         src_cr++;
@@ -592,7 +856,18 @@ static void yuv422p_to_yuv422(char *dst_buffer, AVFrame *in_frame,
                 char *src_cb = (char *) in_frame->data[1] + in_frame->linesize[1] * y;
                 char *src_cr = (char *) in_frame->data[2] + in_frame->linesize[2] * y;
                 char *dst = dst_buffer + pitch * y;
-                for(int x = 0; x < width / 2; ++x) {
+                int x = 0;
+#ifdef LAVD_X86_DISPATCH
+                if (lavd_have_avx2) {
+                        x = yuv422p_to_uyvy_row_avx2((uint8_t *) dst, (uint8_t *) src_y,
+                                        (uint8_t *) src_cb, (uint8_t *) src_cr, width) / 2;
+                        src_y += 2 * x;
+                        src_cb += x;
+                        src_cr += x;
+                        dst += 4 * x;
+                }
+#endif
+                for(; x < width / 2; ++x) {
                         *dst++ = *src_cb++;
                         *dst++ = *src_y++;
                         *dst++ = *src_cr++;
@@ -610,7 +885,18 @@ static void yuv422p_to_v210(char *dst_buffer, AVFrame *in_frame,
                 uint8_t *src_cr = (in_frame->data[2] + in_frame->linesize[2] * y);
                 uint32_t *dst = (uint32_t *)(void *)(dst_buffer + y * pitch);
 
-                for(int x = 0; x < width / 6; ++x) {
+                int x = 0;
+#ifdef LAVD_X86_DISPATCH
+                if (lavd_have_ssse3) {
+                        x = yuv422p_to_v210_row_ssse3(dst, src_y, src_cb, src_cr, width) / 6;
+                        src_y += 6 * x;
+                        src_cb += 3 * x;
+                        src_cr += 3 * x;
+                        dst += 4 * x;
+                }
+#endif
+
+                for(; x < width / 6; ++x) {
                         uint32_t w0_0, w0_1, w0_2, w0_3;
 
                         w0_0 = *src_cb++ << 2;
@@ -711,7 +997,16 @@ static void nv12_to_rgb24(char *dst_buffer, AVFrame *in_frame,
                 unsigned char *src_y = (unsigned char *) in_frame->data[0] + in_frame->linesize[0] * y;
                 unsigned char *src_cbcr = (unsigned char *) in_frame->data[1] + in_frame->linesize[1] * (y / 2);
                 unsigned char *dst = (unsigned char *) dst_buffer + pitch * y;
-                for(int x = 0; x < width / 2; ++x) {
+                int x = 0;
+#ifdef LAVD_X86_DISPATCH
+                if (lavd_have_avx2) {
+                        x = yuv_to_rgb24_row_avx2(dst, NULL, src_y, NULL, src_cbcr, NULL, width) / 2;
+                        src_y += 2 * x;
+                        src_cbcr += 2 * x;
+                        dst += 6 * x;
+                }
+#endif
+                for(; x < width / 2; ++x) {
                         int cb = *src_cbcr++ - 128;
                         int cr = *src_cbcr++ - 128;
                         int y = *src_y++ << 16;
@@ -741,7 +1036,17 @@ static void yuv422p_to_rgb24(char *dst_buffer, AVFrame *in_frame,
                 unsigned char *src_cb = (unsigned char *) in_frame->data[1] + in_frame->linesize[1] * y;
                 unsigned char *src_cr = (unsigned char *) in_frame->data[2] + in_frame->linesize[2] * y;
                 unsigned char *dst = (unsigned char *) dst_buffer + pitch * y;
-                for(int x = 0; x < width / 2; ++x) {
+                int x = 0;
+#ifdef LAVD_X86_DISPATCH
+                if (lavd_have_avx2) {
+                        x = yuv_to_rgb24_row_avx2(dst, NULL, src_y, NULL, src_cb, src_cr, width) / 2;
+                        src_y += 2 * x;
+                        src_cb += x;
+                        src_cr += x;
+                        dst += 6 * x;
+                }
+#endif
+                for(; x < width / 2; ++x) {
                         int cb = *src_cb++ - 128;
                         int cr = *src_cr++ - 128;
                         int y = *src_y++ << 16;
@@ -773,7 +1078,19 @@ static void yuv420p_to_rgb24(char *dst_buffer, AVFrame *in_frame,
                 unsigned char *src_cr = (unsigned char *) in_frame->data[2] + in_frame->linesize[2] * y;
                 unsigned char *dst1 = (unsigned char *) dst_buffer + pitch * (y * 2);
                 unsigned char *dst2 = (unsigned char *) dst_buffer + pitch * (y * 2 + 1);
-                for(int x = 0; x < width / 2; ++x) {
+                int x = 0;
+#ifdef LAVD_X86_DISPATCH
+                if (lavd_have_avx2) {
+                        x = yuv_to_rgb24_row_avx2(dst1, dst2, src_y1, src_y2, src_cb, src_cr, width) / 2;
+                        src_y1 += 2 * x;
+                        src_y2 += 2 * x;
+                        src_cb += x;
+                        src_cr += x;
+                        dst1 += 6 * x;
+                        dst2 += 6 * x;
+                }
+#endif
+                for(; x < width / 2; ++x) {
                         int cb = *src_cb++ - 128;
                         int cr = *src_cr++ - 128;
                         int y = *src_y1++ << 16;
@@ -836,7 +1153,21 @@ static void yuv420p10le_to_v210(char *dst_buffer, AVFrame *in_frame,
                 uint32_t *dst1 = (uint32_t *)(void *)(dst_buffer + (y * 2) * pitch);
                 uint32_t *dst2 = (uint32_t *)(void *)(dst_buffer + (y * 2 + 1) * pitch);
 
-                for(int x = 0; x < width / 6; ++x) {
+                int x = 0;
+#ifdef LAVD_X86_DISPATCH
+                if (lavd_have_ssse3) {
+                        yuv422p10le_to_v210_row_ssse3(dst1, src_y1, src_cb, src_cr, width);
+                        x = yuv422p10le_to_v210_row_ssse3(dst2, src_y2, src_cb, src_cr, width) / 6;
+                        src_y1 += 6 * x;
+                        src_y2 += 6 * x;
+                        src_cb += 3 * x;
+                        src_cr += 3 * x;
+                        dst1 += 4 * x;
+                        dst2 += 4 * x;
+                }
+#endif
+
+                for(; x < width / 6; ++x) {
                         uint32_t w0_0, w0_1, w0_2, w0_3;
                         uint32_t w1_0, w1_1, w1_2, w1_3;
 
@@ -896,7 +1227,18 @@ static void yuv422p10le_to_v210(char *dst_buffer, AVFrame *in_frame,
                 uint16_t *src_cr = (uint16_t *)(void *)(in_frame->data[2] + in_frame->linesize[2] * y);
                 uint32_t *dst = (uint32_t *)(void *)(dst_buffer + y * pitch);
 
-                for(int x = 0; x < width / 6; ++x) {
+                int x = 0;
+#ifdef LAVD_X86_DISPATCH
+                if (lavd_have_ssse3) {
+                        x = yuv422p10le_to_v210_row_ssse3(dst, src_y, src_cb, src_cr, width) / 6;
+                        src_y += 6 * x;
+                        src_cb += 3 * x;
+                        src_cr += 3 * x;
+                        dst += 4 * x;
+                }
+#endif
+
+                for(; x < width / 6; ++x) {
                         uint32_t w0_0, w0_1, w0_2, w0_3;
 
                         w0_0 = *src_cb++;
@@ -1023,8 +1365,18 @@ static void yuv444p10le_to_uyvy(char *dst_buffer, AVFrame *in_frame,
                 uint16_t *src_cr = (uint16_t *)(void *)(in_frame->data[2] + in_frame->linesize[2] * y);
                 uint8_t *dst = (uint8_t *)(void *)(dst_buffer + y * pitch);
 
-                for(int x = 0; x < width / 2; ++x) {
-                        *dst++ = (src_cb[0] + src_cb[0]) / 2 >> 2;
+                int x = 0;
+#ifdef LAVD_X86_DISPATCH
+                if (lavd_have_ssse3) {
+                        x = yuv444p10le_to_uyvy_row_ssse3(dst, src_y, src_cb, src_cr, width) / 2;
+                        src_y += 2 * x;
+                        src_cb += 2 * x;
+                        src_cr += 2 * x;
+                        dst += 4 * x;
+                }
+#endif
+                for(; x < width / 2; ++x) {
+                        *dst++ = (src_cb[0] + src_cb[1]) / 2 >> 2;
                         *dst++ = *src_y++ >> 2;
                         *dst++ = (src_cr[0] + src_cr[1]) / 2 >> 2;
                         *dst++ = *src_y++ >> 2;
@@ -1037,12 +1389,12 @@ static void yuv444p10le_to_uyvy(char *dst_buffer, AVFrame *in_frame,
 static void yuv420p10le_to_rgb24(char *dst_buffer, AVFrame *in_frame,
                 int width, int height, int pitch)
 {
-        char *tmp = malloc(vc_get_linesize(UYVY, width) * height);
+        char *tmp = malloc(vc_get_linesize(width, UYVY) * height);
         char *uyvy = tmp;
-        yuv420p10le_to_uyvy(uyvy, in_frame, width, height, vc_get_linesize(UYVY, width));
+        yuv420p10le_to_uyvy(uyvy, in_frame, width, height, vc_get_linesize(width, UYVY));
         for (int i = 0; i < height; i++) {
                 vc_copylineUYVYtoRGB((unsigned char *) dst_buffer, (unsigned char *) uyvy, vc_get_linesize(RGB, width));
-                uyvy += vc_get_linesize(UYVY, width);
+                uyvy += vc_get_linesize(width, UYVY);
                 dst_buffer += pitch;
         }
         free(tmp);
@@ -1051,12 +1403,12 @@ static void yuv420p10le_to_rgb24(char *dst_buffer, AVFrame *in_frame,
 static void yuv422p10le_to_rgb24(char *dst_buffer, AVFrame *in_frame,
                 int width, int height, int pitch)
 {
-        char *tmp = malloc(vc_get_linesize(UYVY, width) * height);
+        char *tmp = malloc(vc_get_linesize(width, UYVY) * height);
         char *uyvy = tmp;
-        yuv422p10le_to_uyvy(uyvy, in_frame, width, height, vc_get_linesize(UYVY, width));
+        yuv422p10le_to_uyvy(uyvy, in_frame, width, height, vc_get_linesize(width, UYVY));
         for (int i = 0; i < height; i++) {
                 vc_copylineUYVYtoRGB((unsigned char *) dst_buffer, (unsigned char *) uyvy, vc_get_linesize(RGB, width));
-                uyvy += vc_get_linesize(UYVY, width);
+                uyvy += vc_get_linesize(width, UYVY);
                 dst_buffer += pitch;
         }
         free(tmp);
@@ -1065,17 +1417,85 @@ static void yuv422p10le_to_rgb24(char *dst_buffer, AVFrame *in_frame,
 static void yuv444p10le_to_rgb24(char *dst_buffer, AVFrame *in_frame,
                 int width, int height, int pitch)
 {
-        char *tmp = malloc(vc_get_linesize(UYVY, width) * height);
+        char *tmp = malloc(vc_get_linesize(width, UYVY) * height);
         char *uyvy = tmp;
-        yuv444p10le_to_uyvy(uyvy, in_frame, width, height, vc_get_linesize(UYVY, width));
+        yuv444p10le_to_uyvy(uyvy, in_frame, width, height, vc_get_linesize(width, UYVY));
         for (int i = 0; i < height; i++) {
                 vc_copylineUYVYtoRGB((unsigned char *) dst_buffer, (unsigned char *) uyvy, vc_get_linesize(RGB, width));
-                uyvy += vc_get_linesize(UYVY, width);
+                uyvy += vc_get_linesize(width, UYVY);
                 dst_buffer += pitch;
         }
         free(tmp);
 }
 
+/**
+ * Copies planes of the AVFrame to a planar UltraGrid pixel format with the
+ * same plane structure (no conversion is needed).
+ */
+static void copy_planes(char *dst_buffer, AVFrame *in_frame, int width, int height, codec_t out_codec)
+{
+        struct vc_plane planes[VC_MAX_PLANES];
+        int count = vc_get_planes(width, height, out_codec, planes);
+        for (int i = 0; i < count; ++i) {
+                for (int y = 0; y < planes[i].height; ++y) {
+                        memcpy(dst_buffer + planes[i].offset + y * planes[i].linesize,
+                                        in_frame->data[i] + y * in_frame->linesize[i], planes[i].linesize);
+                }
+        }
+}
+
+static void yuv420p_to_i420(char *dst_buffer, AVFrame *in_frame,
+                int width, int height, int pitch)
+{
+        UNUSED(pitch);
+        copy_planes(dst_buffer, in_frame, width, height, I420);
+}
+
+static void nv12_to_nv12(char *dst_buffer, AVFrame *in_frame,
+                int width, int height, int pitch)
+{
+        UNUSED(pitch);
+        copy_planes(dst_buffer, in_frame, width, height, NV12);
+}
+
+static void p010le_to_p010(char *dst_buffer, AVFrame *in_frame,
+                int width, int height, int pitch)
+{
+        UNUSED(pitch);
+        copy_planes(dst_buffer, in_frame, width, height, P010);
+}
+
+static void yuv422p10le_to_i210(char *dst_buffer, AVFrame *in_frame,
+                int width, int height, int pitch)
+{
+        UNUSED(pitch);
+        copy_planes(dst_buffer, in_frame, width, height, I210);
+}
+
+static void yuv420p10le_to_p010(char *dst_buffer, AVFrame *in_frame,
+                int width, int height, int pitch)
+{
+        UNUSED(pitch);
+        struct vc_plane planes[VC_MAX_PLANES];
+        vc_get_planes(width, height, P010, planes);
+        for (int y = 0; y < planes[0].height; ++y) {
+                uint16_t *src = (uint16_t *)(void *)(in_frame->data[0] + in_frame->linesize[0] * y);
+                uint16_t *dst = (uint16_t *)(void *)(dst_buffer + planes[0].offset + planes[0].linesize * y);
+                for (int x = 0; x < width; ++x) {
+                        *dst++ = *src++ << 6;
+                }
+        }
+        for (int y = 0; y < planes[1].height; ++y) {
+                uint16_t *src_cb = (uint16_t *)(void *)(in_frame->data[1] + in_frame->linesize[1] * y);
+                uint16_t *src_cr = (uint16_t *)(void *)(in_frame->data[2] + in_frame->linesize[2] * y);
+                uint16_t *dst = (uint16_t *)(void *)(dst_buffer + planes[1].offset + planes[1].linesize * y);
+                for (int x = 0; x < (width + 1) / 2; ++x) {
+                        *dst++ = *src_cb++ << 6;
+                        *dst++ = *src_cr++ << 6;
+                }
+        }
+}
+
 static void not_implemented_conv(char *dst_buffer, AVFrame *in_frame,
                 int width, int height, int pitch)
 {
@@ -1111,15 +1531,17 @@ static void av_vdpau_to_ug_vdpau(char *dst_buffer, AVFrame *in_frame,
 static const struct {
         int av_codec;
         codec_t uv_codec;
-        void (*convert)(char *dst_buffer, AVFrame *in_frame, int width, int height, int pitch);
+        av_to_uv_convert_t *convert;
 } convert_funcs[] = {
         // 10-bit YUV
         {AV_PIX_FMT_YUV420P10LE, v210, yuv420p10le_to_v210},
         {AV_PIX_FMT_YUV420P10LE, UYVY, yuv420p10le_to_uyvy},
         {AV_PIX_FMT_YUV420P10LE, RGB, yuv420p10le_to_rgb24},
+        {AV_PIX_FMT_YUV420P10LE, P010, yuv420p10le_to_p010},
         {AV_PIX_FMT_YUV422P10LE, v210, yuv422p10le_to_v210},
         {AV_PIX_FMT_YUV422P10LE, UYVY, yuv422p10le_to_uyvy},
         {AV_PIX_FMT_YUV422P10LE, RGB, yuv422p10le_to_rgb24},
+        {AV_PIX_FMT_YUV422P10LE, I210, yuv422p10le_to_i210},
         {AV_PIX_FMT_YUV444P10LE, v210, yuv444p10le_to_v210},
         {AV_PIX_FMT_YUV444P10LE, UYVY, yuv444p10le_to_uyvy},
         {AV_PIX_FMT_YUV444P10LE, RGB, yuv444p10le_to_rgb24},
@@ -1127,6 +1549,7 @@ static const struct {
         {AV_PIX_FMT_YUV420P, v210, yuv420p_to_v210},
         {AV_PIX_FMT_YUV420P, UYVY, yuv420p_to_yuv422},
         {AV_PIX_FMT_YUV420P, RGB, yuv420p_to_rgb24},
+        {AV_PIX_FMT_YUV420P, I420, yuv420p_to_i420},
         {AV_PIX_FMT_YUV422P, v210, yuv422p_to_v210},
         {AV_PIX_FMT_YUV422P, UYVY, yuv422p_to_yuv422},
         {AV_PIX_FMT_YUV422P, RGB, yuv422p_to_rgb24},
@@ -1137,6 +1560,7 @@ static const struct {
         {AV_PIX_FMT_YUVJ420P, v210, yuv420p_to_v210},
         {AV_PIX_FMT_YUVJ420P, UYVY, yuv420p_to_yuv422},
         {AV_PIX_FMT_YUVJ420P, RGB, yuv420p_to_rgb24},
+        {AV_PIX_FMT_YUVJ420P, I420, yuv420p_to_i420},
         {AV_PIX_FMT_YUVJ422P, v210, yuv422p_to_v210},
         {AV_PIX_FMT_YUVJ422P, UYVY, yuv422p_to_yuv422},
         {AV_PIX_FMT_YUVJ422P, RGB, yuv422p_to_rgb24},
@@ -1147,6 +1571,9 @@ static const struct {
         {AV_PIX_FMT_NV12, v210, not_implemented_conv},
         {AV_PIX_FMT_NV12, UYVY, nv12_to_yuv422},
         {AV_PIX_FMT_NV12, RGB, nv12_to_rgb24},
+        {AV_PIX_FMT_NV12, NV12, nv12_to_nv12},
+        // 10-bit semi-planar YUV
+        {AV_PIX_FMT_P010LE, P010, p010le_to_p010},
         // RGB
         {AV_PIX_FMT_RGB24, v210, not_implemented_conv},
         {AV_PIX_FMT_RGB24, UYVY, rgb24_to_uyvy},
@@ -1157,6 +1584,23 @@ static const struct {
 #endif
 };
 
+#ifdef LAVD_X86_DISPATCH
+static pthread_once_t lavd_simd_detect_once = PTHREAD_ONCE_INIT;
+#endif
+
+av_to_uv_convert_t *get_av_to_uv_conversion(int av_codec, codec_t uv_codec) {
+#ifdef LAVD_X86_DISPATCH
+        pthread_once(&lavd_simd_detect_once, lavd_detect_simd);
+#endif
+        for (unsigned int i = 0; i < sizeof convert_funcs / sizeof convert_funcs[0]; ++i) {
+                if (convert_funcs[i].av_codec == av_codec &&
+                                convert_funcs[i].uv_codec == uv_codec) {
+                        return convert_funcs[i].convert;
+                }
+        }
+        return NULL;
+}
+
 static enum AVPixelFormat get_format_callback(struct AVCodecContext *s __attribute__((unused)), const enum AVPixelFormat *fmt)
 {
         if (log_level >= LOG_LEVEL_DEBUG) {
@@ -1229,8 +1673,12 @@ static enum AVPixelFormat get_format_callback(struct AVCodecContext *s __attribu
 /**
  * Changes pixel format from frame to native (currently UYVY).
  *
+ * Frame is split to horizontal bands converted in parallel (see
+ * lavd-convert-threads), HW surfaces are passed as a whole.
+ *
  * @todo             figure out color space transformations - eg. JPEG returns full-scale YUV.
  *                   And not in the ITU-T Rec. 701 (eventually Rec. 609) scale.
+ * @param  s         decompress state (holds band descriptions)
  * @param  frame     video frame returned from libavcodec decompress
  * @param  dst       destination buffer where data will be stored
  * @param  av_codec  libav pixel format
@@ -1242,24 +1690,23 @@ static enum AVPixelFormat get_format_callback(struct AVCodecContext *s __attribu
  * @see    yuvj422p_to_yuv422
  * @see    yuv420p_to_yuv422
  */
-static int change_pixfmt(AVFrame *frame, unsigned char *dst, int av_codec,
-                codec_t out_codec, int width, int height, int pitch) {
+static void *convert_band_task(void *arg)
+{
+        struct lavd_conv_band *band = (struct lavd_conv_band *) arg;
+        band->convert(band->dst, &band->frame, band->width, band->height, band->pitch);
+        return NULL;
+}
+
+static int change_pixfmt(struct state_libavcodec_decompress *s, AVFrame *frame, unsigned char *dst,
+                int av_codec, codec_t out_codec, int width, int height, int pitch) {
         assert(out_codec == UYVY ||
                         out_codec == RGB ||
                         out_codec == v210 ||
-                        out_codec == HW_VDPAU);
+                        out_codec == HW_VDPAU ||
+                        codec_is_planar(out_codec));
 
-        void (*convert)(char *dst_buffer, AVFrame *in_frame, int width, int height, int pitch) = NULL;
-        for (unsigned int i = 0; i < sizeof convert_funcs / sizeof convert_funcs[0]; ++i) {
-                if (convert_funcs[i].av_codec == av_codec &&
-                                convert_funcs[i].uv_codec == out_codec) {
-                        convert = convert_funcs[i].convert;
-                }
-        }
-
-        if (convert) {
-                convert((char *) dst, frame, width, height, pitch);
-        } else {
+        av_to_uv_convert_t *convert = get_av_to_uv_conversion(av_codec, out_codec);
+        if (!convert) {
                 log_msg(LOG_LEVEL_ERROR, "Unsupported pixel "
                                 "format: %s (id %d)\n",
                                 av_get_pix_fmt_name(
@@ -1267,6 +1714,45 @@ static int change_pixfmt(AVFrame *frame, unsigned char *dst, int av_codec,
                 return FALSE;
         }
 
+        const AVPixFmtDescriptor *fmt_desc = av_pix_fmt_desc_get(av_codec);
+        int bands = min(s->conv_threads, height / MIN_LINES_PER_CONV_TASK);
+        // planar outputs are plain plane copies, which cannot be split by pitch
+        if (bands <= 1 || fmt_desc == NULL || (fmt_desc->flags & AV_PIX_FMT_FLAG_HWACCEL) ||
+                        codec_is_planar(out_codec)) {
+                convert((char *) dst, frame, width, height, pitch);
+                return TRUE;
+        }
+
+        // keep band boundaries even so that 4:2:0 line pairs are not split
+        int band_height = (height / bands) & ~1;
+        for (int i = 0; i < bands; ++i) {
+                struct lavd_conv_band *band = &s->conv_bands[i];
+                int start = i * band_height;
+                band->convert = convert;
+                for (int p = 0; p < AV_NUM_DATA_POINTERS; ++p) {
+                        if (frame->data[p] == NULL) {
+                                band->frame.data[p] = NULL;
+                                continue;
+                        }
+                        int plane_start = p == 1 || p == 2 ? start >> fmt_desc->log2_chroma_h : start;
+                        band->frame.data[p] = frame->data[p] + frame->linesize[p] * plane_start;
+                        band->frame.linesize[p] = frame->linesize[p];
+                }
+                band->frame.format = frame->format;
+                band->frame.opaque = frame->opaque;
+                band->dst = (char *) dst + start * pitch;
+                band->width = width;
+                band->height = i == bands - 1 ? height - start : band_height;
+                band->pitch = pitch;
+                if (i < bands - 1) {
+                        band->handle = task_run_async(convert_band_task, band);
+                }
+        }
+        convert_band_task(&s->conv_bands[bands - 1]);
+        for (int i = 0; i < bands - 1; ++i) {
+                wait_task(s->conv_bands[i].handle);
+        }
+
         return TRUE;
 }
 
@@ -1359,7 +1845,7 @@ static decompress_status libavcodec_decompress(void *state, unsigned char *dst,
                                         transfer_frame(&s->hwaccel, s->frame);
                                 }
 #endif
-                                bool ret = change_pixfmt(s->frame, dst, s->frame->format,
+                                bool ret = change_pixfmt(s, s->frame, dst, s->frame->format,
                                                 s->out_codec, s->desc.width, s->desc.height, s->pitch);
                                 if(ret == TRUE) {
                                         s->last_frame_seq_initialized = true;
@@ -1429,6 +1915,7 @@ static void libavcodec_decompress_done(void *state)
 
         rm_release_shared_lock(LAVCD_LOCK_NAME);
 
+        free(s->conv_bands);
         free(s);
 }
 
@@ -1448,6 +1935,16 @@ static const struct decode_from_to *libavcodec_decompress_get_decoders() {
                 { VP9, UYVY, 500 },
                 { HFYU, UYVY, 500 },
                 { FFV1, UYVY, 500 },
+                // planar outputs are used only by the displays that list them explicitly
+                { H264, I420, 500 },
+                { H265, I420, 500 },
+                { VP8, I420, 500 },
+                { VP9, I420, 500 },
+                { H264, NV12, 500 },
+                { H265, NV12, 500 },
+                { H264, I210, 500 },
+                { H265, I210, 500 },
+                { H265, P010, 500 },
         };
 
         static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
@@ -40,6 +40,7 @@
 #include "config_win32.h"
 #include "lib_common.h"
 #include "debug.h"
+#include "host.h"
 #include "video.h"
 #include "video_display.h"
 
@@ -113,22 +114,26 @@ static void display_pipe_run(void *state)
         UNUSED(state);
 }
 
+ADD_TO_PARAM(pipe_planar, "pipe-planar", "* pipe-planar\n"
+                "  Offer also planar pixel formats in reflector transcoding so that decoded\n"
+                "  frames may be passed to libavcodec encoder without repacking\n");
 static int display_pipe_get_property(void *state, int property, void *val, size_t *len)
 {
         UNUSED(state);
-        codec_t codecs[] = {UYVY};
+        codec_t codecs[] = {UYVY, I420, NV12, P010, I210};
+        size_t codecs_len = get_commandline_param("pipe-planar") ? sizeof codecs : sizeof codecs[0];
         enum interlacing_t supported_il_modes[] = {PROGRESSIVE, INTERLACED_MERGED, SEGMENTED_FRAME};
         int rgb_shift[] = {0, 8, 16};
 
         switch (property) {
                 case DISPLAY_PROPERTY_CODECS:
-                        if(sizeof(codecs) <= *len) {
-                                memcpy(val, codecs, sizeof(codecs));
+                        if(codecs_len <= *len) {
+                                memcpy(val, codecs, codecs_len);
                         } else {
                                 return FALSE;
                         }
 
-                        *len = sizeof(codecs);
+                        *len = codecs_len;
                         break;
                 case DISPLAY_PROPERTY_RGB_SHIFT:
                         if(sizeof(rgb_shift) > *len) {
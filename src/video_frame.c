@@ -95,7 +95,7 @@ struct video_frame * vf_alloc_desc(struct video_desc desc)
                 if(codec_is_const_size(desc.color_spec)){
                         buf->tiles[i].data_len = get_pf_block_size(desc.color_spec);
                 } else {
-                        buf->tiles[i].data_len = vc_get_linesize(desc.width, desc.color_spec) * desc.height;
+                        buf->tiles[i].data_len = vc_get_datalen(desc.width, desc.height, desc.color_spec);
                 }
         }
 
@@ -115,9 +115,8 @@ struct video_frame * vf_alloc_desc_data(struct video_desc desc)
                 if(codec_is_const_size(desc.color_spec)){
                         buf->tiles[i].data_len = get_pf_block_size(desc.color_spec);
                 } else {
-                        buf->tiles[i].data_len = vc_get_linesize(desc.width,
-                                        desc.color_spec) *
-                                desc.height;
+                        buf->tiles[i].data_len = vc_get_datalen(desc.width,
+                                        desc.height, desc.color_spec);
                 }
                 buf->tiles[i].data = (char *) malloc(buf->tiles[i].data_len);
                 assert(buf->tiles[i].data != NULL);
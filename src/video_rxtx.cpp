@@ -44,6 +44,7 @@
 
 #include "debug.h"
 
+#include <algorithm>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -69,12 +70,26 @@
 
 using namespace std;
 
+ADD_TO_PARAM(pipeline_depth, "pipeline-depth",
+                "* pipeline-depth=<n>\n"
+                "  Number of captured frames that may wait for compression (default 1). With\n"
+                "  0, frames are compressed by the capture thread.\n");
+static int get_pipeline_depth() {
+        if (get_commandline_param("pipeline-depth")) {
+                return max(atoi(get_commandline_param("pipeline-depth")), 0);
+        }
+        return 1;
+}
+
 video_rxtx::video_rxtx(map<string, param_u> const &params): m_port_id("default"), m_paused(params.at("paused").b),
                 m_report_paused_play(false), m_rxtx_mode(params.at("rxtx_mode").i),
                 m_parent(static_cast<struct module *>(params.at("parent").ptr)),
                 m_frames_sent(0ull), m_compression(nullptr),
                 m_exporter(static_cast<struct exporter *>(params.at("exporter").ptr)),
-                m_thread_id(), m_poisoned(false), m_joined(true) {
+                m_thread_id(), m_poisoned(false), m_joined(true),
+                m_compress_queue(get_pipeline_depth()), m_compress_thread_id(),
+                m_compress_thread_started(false), m_stats_t0(chrono::steady_clock::now()),
+                m_stage_time(), m_stage_count() {
 
         module_init_default(&m_sender_mod);
         m_sender_mod.cls = MODULE_CLASS_SENDER;
@@ -128,6 +143,14 @@ void video_rxtx::start() {
                 throw string("Unable to create sender thread!\n");
         }
         m_joined = false;
+
+        if (get_pipeline_depth() > 0) {
+                if (pthread_create(&m_compress_thread_id, NULL, video_rxtx::compress_thread,
+                                        (void *) this) != 0) {
+                        throw string("Unable to create compress thread!\n");
+                }
+                m_compress_thread_started = true;
+        }
 }
 
 void video_rxtx::join() {
@@ -136,6 +159,10 @@ void video_rxtx::join() {
         }
         send(NULL); // pass poisoned pill
         pthread_join(m_thread_id, NULL);
+        if (m_compress_thread_started) {
+                pthread_join(m_compress_thread_id, NULL);
+                m_compress_thread_started = false;
+        }
         m_joined = true;
 }
 
@@ -152,8 +179,13 @@ void video_rxtx::send(shared_ptr<video_frame> frame) {
         if (!frame && m_poisoned) {
                 return;
         }
-        compress_frame(m_compression, frame);
-        if (!frame) {
+        bool poisoned = !frame;
+        if (m_compress_thread_started) {
+                m_compress_queue.push(move(frame));
+        } else {
+                compress_frame(m_compression, move(frame));
+        }
+        if (poisoned) {
                 m_poisoned = true;
         }
 }
@@ -162,6 +194,54 @@ void *video_rxtx::sender_thread(void *args) {
         return static_cast<video_rxtx *>(args)->sender_loop();
 }
 
+void *video_rxtx::compress_thread(void *args) {
+        return static_cast<video_rxtx *>(args)->compress_loop();
+}
+
+/**
+ * Compresses frames passed by send() so that the capture of the next frame
+ * overlaps with the compression (and sending of the previous one).
+ */
+void *video_rxtx::compress_loop() {
+        while (true) {
+                shared_ptr<video_frame> frame = m_compress_queue.pop();
+                bool poisoned = !frame;
+                auto t0 = chrono::steady_clock::now();
+                // pass ownership so that the frame is released as soon as possible
+                compress_frame(m_compression, move(frame));
+                if (poisoned) {
+                        return NULL;
+                }
+                add_stage_time(PIPELINE_COMPRESS, chrono::duration_cast<chrono::duration<double>>(
+                                        chrono::steady_clock::now() - t0).count());
+        }
+}
+
+/**
+ * Records duration of processing of one frame in the given stage. Averages
+ * are printed in verbose mode every 5 seconds.
+ */
+void video_rxtx::add_stage_time(enum pipeline_stage stage, double seconds) {
+        lock_guard<mutex> lk(m_stats_lock);
+        m_stage_time[stage] += seconds;
+        m_stage_count[stage] += 1;
+
+        auto now = chrono::steady_clock::now();
+        if (chrono::duration_cast<chrono::duration<double>>(now - m_stats_t0).count() < 5.0) {
+                return;
+        }
+        double avg_ms[PIPELINE_STAGE_COUNT];
+        for (int i = 0; i < PIPELINE_STAGE_COUNT; ++i) {
+                avg_ms[i] = m_stage_count[i] > 0 ? m_stage_time[i] / m_stage_count[i] * 1000.0 : 0.0;
+                m_stage_time[i] = 0.0;
+                m_stage_count[i] = 0;
+        }
+        log_msg(LOG_LEVEL_VERBOSE, "[video_rxtx] Average stage duration: capture %.2f ms, "
+                        "compress %.2f ms, send %.2f ms\n", avg_ms[PIPELINE_CAPTURE],
+                        avg_ms[PIPELINE_COMPRESS], avg_ms[PIPELINE_SEND]);
+        m_stats_t0 = now;
+}
+
 int video_rxtx::check_sender_messages() {
         int ret = 0;
         // process external messages
@@ -196,8 +276,11 @@ void *video_rxtx::sender_loop() {
 
                 tx_frame->paused_play = ret == STREAM_PAUSED_PLAY;
 
-                send_frame(tx_frame);
+                auto t0 = chrono::steady_clock::now();
+                send_frame(move(tx_frame));
                 m_frames_sent += 1;
+                add_stage_time(PIPELINE_SEND, chrono::duration_cast<chrono::duration<double>>(
+                                        chrono::steady_clock::now() - t0).count());
         }
 
 exit:
@@ -41,11 +41,13 @@
 #include <chrono>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 
 #include "module.h"
+#include "utils/synchronized_queue.h"
 
-#define VIDEO_RXTX_ABI_VERSION 2
+#define VIDEO_RXTX_ABI_VERSION 3
 
 struct display;
 struct module;
@@ -70,10 +72,26 @@ struct video_rxtx_info {
 
 #define STREAM_PAUSED_PLAY 1
 
+/// stages of the sender pipeline, see video_rxtx::add_stage_time()
+enum pipeline_stage {
+        PIPELINE_CAPTURE,
+        PIPELINE_COMPRESS,
+        PIPELINE_SEND,
+        PIPELINE_STAGE_COUNT
+};
+
 class video_rxtx {
 public:
         virtual ~video_rxtx();
         void send(std::shared_ptr<struct video_frame>);
+        /**
+         * @returns true if send() returns before the frame is compressed,
+         * so that the caller may grab next frame in the meanwhile
+         */
+        bool is_pipelined() const {
+                return m_compress_thread_started;
+        }
+        void add_stage_time(enum pipeline_stage stage, double seconds);
         static const char *get_long_name(std::string const & short_name);
         static void *receiver_thread(void *arg) {
                 video_rxtx *rxtx = static_cast<video_rxtx *>(arg);
@@ -104,6 +122,8 @@ private:
         virtual void *(*get_receiver_thread())(void *arg) = 0;
         static void *sender_thread(void *args);
         void *sender_loop();
+        static void *compress_thread(void *args);
+        void *compress_loop();
         virtual struct response *process_sender_message(struct msg_sender *, int *status) {
                 *status = 0;
                 return NULL;
@@ -115,6 +135,16 @@ private:
 
         pthread_t m_thread_id;
         bool m_poisoned, m_joined;
+
+        /// frames waiting for compression (only if pipeline depth is nonzero)
+        synchronized_queue<std::shared_ptr<struct video_frame>, -1> m_compress_queue;
+        pthread_t m_compress_thread_id;
+        bool m_compress_thread_started;
+
+        std::mutex m_stats_lock;
+        std::chrono::steady_clock::time_point m_stats_t0;
+        double m_stage_time[PIPELINE_STAGE_COUNT];
+        int m_stage_count[PIPELINE_STAGE_COUNT];
 };
 
 class video_rxtx_loader {
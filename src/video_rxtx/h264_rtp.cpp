@@ -79,15 +79,8 @@ h264_rtp_video_rxtx::h264_rtp_video_rxtx(std::map<std::string, param_u> const &p
 
 void h264_rtp_video_rxtx::send_frame(shared_ptr<video_frame> tx_frame)
 {
-        if (m_connections_count == 1) { /* normal/default case - only one connection */
-            tx_send_h264(m_tx, tx_frame.get(), m_network_devices[0]);
-        } else {
-            //TODO to be tested, the idea is to reply per destiny
-                for (int i = 0; i < m_connections_count; ++i) {
-                    tx_send_h264(m_tx, tx_frame.get(),
-                                        m_network_devices[i]);
-                }
-        }
+        // the frame is packetized once and sent to all destinations
+        tx_send_h264_multi(m_tx, tx_frame.get(), m_network_devices, m_connections_count);
         if ((m_rxtx_mode & MODE_RECEIVER) == 0) { // send RTCP (receiver thread would otherwise do this
                 struct timeval curr_time;
                 uint32_t ts;
@@ -0,0 +1,172 @@
+/**
+ * @file   tools/crypto_bench.cpp
+ * @brief  Measures single-core throughput of packet encryption modes
+ */
+/*
+ * Copyright (c) 2018 CESNET z.s.p.o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif // HAVE_CONFIG_H
+
+#include "crypto/openssl_decrypt.h"
+#include "crypto/openssl_encrypt.h"
+#include "host.h"
+#include "lib_common.h"
+#include "rtp/rtp_types.h"
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#define DEFAULT_DATA_SIZE (64 * 1024 * 1024)
+#define PASSPHRASE "benchmark"
+
+using namespace std;
+
+void exit_uv(int status);
+
+void exit_uv(int status)
+{
+        exit(status);
+}
+
+/**
+ * Encrypts and decrypts data_size bytes split into packets of packet_size
+ * bytes with given mode.
+ * @retval  0 success
+ * @retval -1 mode is not available in this build
+ * @retval  1 decrypted data doesn't match the original
+ */
+static int bench(const struct openssl_encrypt_info *enc_funcs, const struct openssl_decrypt_info *dec_funcs,
+                enum openssl_mode mode, int packet_size, size_t data_size, double *enc_mbps, double *dec_mbps)
+{
+        struct openssl_encrypt *encryption;
+        struct openssl_decrypt *decryption;
+        if (enc_funcs->init(&encryption, PASSPHRASE, mode) != 0) {
+                return -1;
+        }
+        if (dec_funcs->init(&decryption, PASSPHRASE) != 0) {
+                enc_funcs->destroy(encryption);
+                return -1;
+        }
+
+        int packets = data_size / packet_size;
+        vector<char> plaintext(packet_size * packets);
+        for (auto & c : plaintext) {
+                c = rand();
+        }
+        int max_len = packet_size + enc_funcs->get_overhead(encryption);
+        vector<char> ciphertext(max_len * packets);
+        vector<int> ciphertext_len(packets);
+        vector<char> decrypted(packet_size * packets);
+        video_payload_hdr_t aad{};
+
+        auto t0 = chrono::steady_clock::now();
+        for (int i = 0; i < packets; ++i) {
+                aad[1] = i;
+                ciphertext_len[i] = enc_funcs->encrypt(encryption, plaintext.data() + i * packet_size, packet_size,
+                                (char *) aad, sizeof aad, ciphertext.data() + i * max_len);
+        }
+        auto t1 = chrono::steady_clock::now();
+        bool ok = true;
+        for (int i = 0; i < packets; ++i) {
+                aad[1] = i;
+                ok = dec_funcs->decrypt(decryption, ciphertext.data() + i * max_len, ciphertext_len[i],
+                                (char *) aad, sizeof aad, decrypted.data() + i * packet_size, mode) == packet_size && ok;
+        }
+        auto t2 = chrono::steady_clock::now();
+
+        enc_funcs->destroy(encryption);
+        dec_funcs->destroy(decryption);
+
+        double mbytes = (double) packets * packet_size / 1000.0 / 1000.0;
+        *enc_mbps = mbytes / chrono::duration_cast<chrono::duration<double>>(t1 - t0).count();
+        *dec_mbps = mbytes / chrono::duration_cast<chrono::duration<double>>(t2 - t1).count();
+        return ok && plaintext == decrypted ? 0 : 1;
+}
+
+/**
+ * Usage: crypto_bench [<packet_size> [<data_size>]]
+ *
+ * Prints single-threaded encryption/decryption throughput of all cipher
+ * modes usable for --encryption. Modes not available in this build are
+ * skipped.
+ */
+int main(int argc, char *argv[])
+{
+        int packet_size = argc > 1 ? atoi(argv[1]) : 1400;
+        size_t data_size = argc > 2 ? atol(argv[2]) : DEFAULT_DATA_SIZE;
+
+        auto enc_funcs = static_cast<const struct openssl_encrypt_info *>(load_library("openssl_encrypt",
+                                LIBRARY_CLASS_UNDEFINED, OPENSSL_ENCRYPT_ABI_VERSION));
+        auto dec_funcs = static_cast<const struct openssl_decrypt_info *>(load_library("openssl_decrypt",
+                                LIBRARY_CLASS_UNDEFINED, OPENSSL_DECRYPT_ABI_VERSION));
+        if (!enc_funcs || !dec_funcs) {
+                cerr << "UltraGrid was build without OpenSSL support!\n";
+                return 1;
+        }
+
+        const struct {
+                const char *name;
+                enum openssl_mode mode;
+        } modes[] = {
+                { "cfb", MODE_AES128_CFB },
+#ifdef HAVE_AES_CTR128_ENCRYPT
+                { "ctr", MODE_AES128_CTR },
+#endif
+                { "gcm", MODE_AES128_GCM },
+        };
+        int ret = 0;
+
+        cout << "packet size " << packet_size << " B\n";
+        for (auto const & m : modes) {
+                double enc = 0.0, dec = 0.0;
+                int rc = bench(enc_funcs, dec_funcs, m.mode, packet_size, data_size, &enc, &dec);
+                if (rc == -1) {
+                        cout << setw(4) << m.name << ": not available\n";
+                        continue;
+                }
+                cout << setw(4) << m.name << ": encrypt " << setw(8) << fixed << setprecision(1) << enc
+                        << " MB/s, decrypt " << setw(8) << dec << " MB/s" << (rc == 0 ? "" : " - DECRYPTED DATA MISMATCH") << "\n";
+                if (rc != 0) {
+                        ret = 1;
+                }
+        }
+        return ret;
+}
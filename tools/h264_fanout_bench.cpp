@@ -0,0 +1,185 @@
+/**
+ * @file   tools/h264_fanout_bench.cpp
+ * @brief  Measures per-destination cost of sending H.264 frames to multiple RTP sessions
+ */
+/*
+ * Copyright (c) 2024 CESNET z.s.p.o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif // HAVE_CONFIG_H
+
+#include "host.h"
+#include "module.h"
+#include "rtp/rtp.h"
+#include "transmit.h"
+#include "video_frame.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#define BASE_PORT 15004
+#define DEFAULT_FRAME_SIZE (100 * 1000)
+#define DEFAULT_ITERATIONS 200
+#define MAX_SESSIONS 16
+#define MTU 1500
+
+using namespace std;
+
+void exit_uv(int status);
+
+void exit_uv(int status)
+{
+        exit(status);
+}
+
+/**
+ * Creates Annex-B frame of NAL units of random length without start code
+ * emulation.
+ */
+static vector<char> generate_frame(int size)
+{
+        vector<char> buf;
+        while ((int) buf.size() < size) {
+                buf.insert(buf.end(), {0, 0, 0, 1, 0x65});
+                int len = 100 + rand() % (size / 4);
+                for (int i = 0; i < len; ++i) {
+                        buf.push_back(2 + rand() % 250);
+                }
+        }
+        return buf;
+}
+
+static void noop_callback(struct rtp *session, rtp_event *e)
+{
+        (void) session;
+        (void) e;
+}
+
+/// @returns slope of least-squares line fitted to (x[i], y[i])
+static double fit_slope(vector<double> const &x, vector<double> const &y)
+{
+        double mean_x = 0.0, mean_y = 0.0;
+        for (size_t i = 0; i < x.size(); ++i) {
+                mean_x += x[i] / x.size();
+                mean_y += y[i] / y.size();
+        }
+        double cov = 0.0, var = 0.0;
+        for (size_t i = 0; i < x.size(); ++i) {
+                cov += (x[i] - mean_x) * (y[i] - mean_y);
+                var += (x[i] - mean_x) * (x[i] - mean_x);
+        }
+        return var > 0.0 ? cov / var : 0.0;
+}
+
+/**
+ * Usage: h264_fanout_bench [<iterations> [<frame_size>]]
+ *
+ * Sends frames to 1..MAX_SESSIONS loopback sessions, once with tx_send_h264()
+ * per session (parsing the frame again for each of them) and once with
+ * tx_send_h264_multi(), and prints time per frame and marginal cost of each
+ * additional session (slope of a line fitted to all measurements).
+ *
+ * Each variant uses its own tx and set of sessions and the variant that runs
+ * first alternates, so that neither benefits from sockets warmed by the other.
+ */
+int main(int argc, char *argv[])
+{
+        int iterations = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+        int frame_size = argc > 2 ? atoi(argv[2]) : DEFAULT_FRAME_SIZE;
+
+        struct tx *tx[2];
+        vector<struct rtp *> sessions[2];
+        for (int v = 0; v < 2; ++v) {
+                tx[v] = tx_init_h264(NULL, MTU, TX_MEDIA_VIDEO, NULL, NULL, RATE_UNLIMITED);
+                if (tx[v] == NULL) {
+                        cerr << "Unable to initialize transmission!\n";
+                        return 1;
+                }
+                for (int i = 0; i < MAX_SESSIONS; ++i) {
+                        sessions[v].push_back(rtp_init("127.0.0.1", 0, BASE_PORT + 2 * (v * MAX_SESSIONS + i), 255,
+                                                5 * 1024 * 1024, FALSE, noop_callback, NULL, 4, false));
+                        if (sessions[v].back() == NULL) {
+                                cerr << "Unable to create RTP session!\n";
+                                return 1;
+                        }
+                }
+        }
+
+        vector<char> data = generate_frame(frame_size);
+        struct video_frame *frame = vf_alloc(1);
+        frame->tiles[0].data = data.data();
+        frame->tiles[0].data_len = data.size();
+
+        cout << "sessions\tper-session send [us/frame]\tmulti send [us/frame]" << endl;
+        vector<double> counts, serial_us, multi_us;
+        for (int count = 1; count <= MAX_SESSIONS; count *= 2) {
+                double us[2];
+                for (int k = 0; k < 2; ++k) {
+                        int v = (k + counts.size()) % 2; // 0 - per-session send, 1 - multi send
+                        auto t0 = chrono::steady_clock::now();
+                        for (int it = 0; it < iterations; ++it) {
+                                if (v == 0) {
+                                        for (int i = 0; i < count; ++i) {
+                                                tx_send_h264(tx[v], frame, sessions[v][i]);
+                                        }
+                                } else {
+                                        tx_send_h264_multi(tx[v], frame, sessions[v].data(), count);
+                                }
+                        }
+                        auto t1 = chrono::steady_clock::now();
+                        us[v] = chrono::duration_cast<chrono::duration<double, micro>>(t1 - t0).count() / iterations;
+                }
+                counts.push_back(count);
+                serial_us.push_back(us[0]);
+                multi_us.push_back(us[1]);
+                cout << count << "\t\t" << us[0] << "\t\t\t\t" << us[1] << endl;
+        }
+        cout << "marginal cost per session: per-session send " << fit_slope(counts, serial_us)
+                << " us, multi send " << fit_slope(counts, multi_us) << " us" << endl;
+
+        frame->tiles[0].data = NULL;
+        vf_free(frame);
+        for (int v = 0; v < 2; ++v) {
+                for (auto s : sessions[v]) {
+                        rtp_done(s);
+                }
+                module_done(CAST_MODULE(tx[v]));
+        }
+        return 0;
+}
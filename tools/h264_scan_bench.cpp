@@ -0,0 +1,169 @@
+/**
+ * @file   tools/h264_scan_bench.cpp
+ * @brief  Measures throughput of H.264 Annex-B start code scanners
+ */
+/*
+ * Copyright (c) 2024 CESNET z.s.p.o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif // HAVE_CONFIG_H
+
+#include "host.h"
+#include "rtp/rtpenc_h264.h"
+#include "video_codec.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#define DEFAULT_FRAME_SIZE (1000 * 1000)
+#define DEFAULT_ITERATIONS 500
+
+using namespace std;
+
+void exit_uv(int status);
+
+void exit_uv(int status)
+{
+        exit(status);
+}
+
+/**
+ * Creates Annex-B frame of NAL units of random length. Payload bytes are zero
+ * with probability zero_prob and start code emulation is prevented the same
+ * way as the encoder does (by inserting 0x03).
+ */
+static vector<uint8_t> generate_frame(int size, double zero_prob)
+{
+        vector<uint8_t> buf;
+        while ((int) buf.size() < size) {
+                buf.insert(buf.end(), {0, 0, 0, 1, 0x65});
+                int len = 100 + rand() % (size / 16);
+                int zeros = 0;
+                for (int i = 0; i < len; ++i) {
+                        uint8_t val = (double) rand() / RAND_MAX < zero_prob ? 0 : 1 + rand() % 255;
+                        if (zeros == 2 && val <= 3) {
+                                buf.push_back(3);
+                                zeros = 0;
+                        }
+                        buf.push_back(val);
+                        zeros = val == 0 ? zeros + 1 : 0;
+                }
+                buf.push_back(0x80); // rbsp_stop_one_bit
+        }
+        return buf;
+}
+
+static const char *level_name(enum vc_simd_level level)
+{
+        switch (level) {
+        case VC_SIMD_NONE: return "scalar";
+        case VC_SIMD_SSSE3: return "SSE2";
+        case VC_SIMD_AVX2: return "AVX2";
+        case VC_SIMD_AVX512BW: return "AVX-512BW";
+        default: return "?";
+        }
+}
+
+/**
+ * Usage: h264_scan_bench [<iterations> [<frame_size>]]
+ *
+ * Scans synthetic bitstreams with each supported rtpenc_h264_find_startcode_t
+ * implementation and prints throughput. Besides a typical payload, a stream
+ * with many zero bytes (the worst case for the vector scanners) is tested.
+ */
+int main(int argc, char *argv[])
+{
+        int iterations = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+        int frame_size = argc > 2 ? atoi(argv[2]) : DEFAULT_FRAME_SIZE;
+
+        const struct {
+                const char *name;
+                double zero_prob;
+        } streams[] = {
+                { "random payload", 1.0 / 256 },
+                { "zero-heavy payload", 0.3 },
+        };
+
+        for (auto const &stream : streams) {
+                vector<uint8_t> data = generate_frame(frame_size, stream.zero_prob);
+                const uint8_t *end = data.data() + data.size();
+                cout << stream.name << " (" << data.size() << " B):\n";
+                int ref_count = -1;
+                for (int l = VC_SIMD_NONE; l < VC_SIMD_COUNT; ++l) {
+                        enum vc_simd_level level = (enum vc_simd_level) l;
+                        rtpenc_h264_find_startcode_t find_startcode = rtpenc_h264_get_find_startcode(level);
+                        if (find_startcode == NULL || !vc_simd_level_supported(level)) {
+                                continue;
+                        }
+                        int count = 0;
+                        auto t0 = chrono::steady_clock::now();
+                        for (int it = 0; it < iterations; ++it) {
+                                count = 0;
+                                for (const uint8_t *p = find_startcode(data.data(), end); p != end;
+                                                p = find_startcode(p + 3, end)) {
+                                        count += 1;
+                                }
+                        }
+                        auto t1 = chrono::steady_clock::now();
+                        if (ref_count == -1) {
+                                ref_count = count;
+                        } else if (count != ref_count) {
+                                cerr << level_name(level) << ": found " << count << " start codes, expected " << ref_count << "\n";
+                                return 1;
+                        }
+                        double secs = chrono::duration_cast<chrono::duration<double>>(t1 - t0).count();
+                        cout << "\t" << level_name(level) << ":\t" << (double) data.size() * iterations / secs / 1e9 << " GB/s\n";
+                }
+
+                struct rtpenc_h264_state *st = rtpenc_h264_init_state();
+                int nal_count = 0;
+                auto t0 = chrono::steady_clock::now();
+                for (int it = 0; it < iterations; ++it) {
+                        nal_count = rtpenc_h264_find_nals(st, data.data(), data.size());
+                }
+                auto t1 = chrono::steady_clock::now();
+                rtpenc_h264_done_state(st);
+                double secs = chrono::duration_cast<chrono::duration<double>>(t1 - t0).count();
+                cout << "\trtpenc_h264_find_nals:\t" << (double) data.size() * iterations / secs / 1e9 << " GB/s ("
+                        << nal_count << " NAL units)\n";
+        }
+
+        return 0;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file   tools/lavd_conv_bench.cpp
+ * @brief  Measures speed of libavcodec decompressor output pixel format conversions
+ */
+/*
+ * Copyright (c) 2018 CESNET z.s.p.o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif // HAVE_CONFIG_H
+
+#include "libavcodec_common.h"
+#include "video_codec.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+void exit_uv(int status);
+
+void exit_uv(int status)
+{
+        exit(status);
+}
+
+/**
+ * Usage: lavd_conv_bench [<width> <height> [<iterations>]]
+ *
+ * Prints single-threaded time per pixel of conversions from decoded AVFrame
+ * to UltraGrid pixel formats.
+ */
+int main(int argc, char *argv[])
+{
+        int width = argc > 2 ? atoi(argv[1]) : 3840;
+        int height = argc > 2 ? atoi(argv[2]) : 2160;
+        int iterations = argc > 3 ? atoi(argv[3]) : 20;
+
+        const struct {
+                enum AVPixelFormat av_codec;
+                int depth;
+                codec_t uv_codec;
+        } pairs[] = {
+                { AV_PIX_FMT_YUV420P10LE, 10, v210 },
+                { AV_PIX_FMT_YUV420P10LE, 10, UYVY },
+                { AV_PIX_FMT_YUV420P10LE, 10, RGB },
+                { AV_PIX_FMT_YUV422P10LE, 10, v210 },
+                { AV_PIX_FMT_YUV422P10LE, 10, UYVY },
+                { AV_PIX_FMT_YUV422P10LE, 10, RGB },
+                { AV_PIX_FMT_YUV444P10LE, 10, v210 },
+                { AV_PIX_FMT_YUV444P10LE, 10, UYVY },
+                { AV_PIX_FMT_YUV444P10LE, 10, RGB },
+                { AV_PIX_FMT_YUV420P, 8, v210 },
+                { AV_PIX_FMT_YUV420P, 8, UYVY },
+                { AV_PIX_FMT_YUV420P, 8, RGB },
+                { AV_PIX_FMT_YUV422P, 8, v210 },
+                { AV_PIX_FMT_YUV422P, 8, UYVY },
+                { AV_PIX_FMT_YUV422P, 8, RGB },
+                { AV_PIX_FMT_YUV444P, 8, v210 },
+                { AV_PIX_FMT_YUV444P, 8, UYVY },
+                { AV_PIX_FMT_YUV444P, 8, RGB },
+                { AV_PIX_FMT_NV12, 8, UYVY },
+                { AV_PIX_FMT_NV12, 8, RGB },
+                { AV_PIX_FMT_RGB24, 8, UYVY },
+                { AV_PIX_FMT_RGB24, 8, RGB },
+        };
+
+        cout << width << "x" << height << ", " << iterations << " iterations\n";
+        for (auto const & p : pairs) {
+                av_to_uv_convert_t *convert = get_av_to_uv_conversion(p.av_codec, p.uv_codec);
+                if (!convert) {
+                        cerr << "No conversion from " << av_get_pix_fmt_name(p.av_codec) << " to " << get_codec_name(p.uv_codec) << "\n";
+                        return 1;
+                }
+
+                AVFrame *frame = av_frame_alloc();
+                frame->format = p.av_codec;
+                frame->width = width;
+                frame->height = height;
+                if (av_frame_get_buffer(frame, 32) != 0) {
+                        cerr << "Unable to allocate frame\n";
+                        return 1;
+                }
+                // keep samples in the range of the format bit depth
+                for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; ++i) {
+                        uint8_t *data = frame->buf[i]->data;
+                        for (int j = 0; j < frame->buf[i]->size; ++j) {
+                                data[j] = p.depth > 8 && j % 2 == 1 ? rand() & ((1 << (p.depth - 8)) - 1) : rand();
+                        }
+                }
+
+                int pitch = vc_get_linesize(width, p.uv_codec);
+                vector<char> out(pitch * height);
+                convert(out.data(), frame, width, height, pitch); // warm-up
+                auto t0 = chrono::steady_clock::now();
+                for (int i = 0; i < iterations; ++i) {
+                        convert(out.data(), frame, width, height, pitch);
+                }
+                auto t1 = chrono::steady_clock::now();
+                av_frame_free(&frame);
+
+                double ns_per_pixel = chrono::duration_cast<chrono::duration<double, nano>>(t1 - t0).count()
+                        / iterations / width / height;
+                cout << setw(12) << av_get_pix_fmt_name(p.av_codec) << " -> " << setw(4) << get_codec_name(p.uv_codec)
+                        << ": " << fixed << setprecision(3) << ns_per_pixel << " ns/pixel\n";
+        }
+        return 0;
+}
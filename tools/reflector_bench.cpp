@@ -0,0 +1,180 @@
+/**
+ * @file   tools/reflector_bench.cpp
+ * @brief  Measures hd-rum-translator style packet fan-out rate over loopback
+ */
+/*
+ * Copyright (c) 2024 CESNET z.s.p.o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif // HAVE_CONFIG_H
+
+#include "host.h"
+#include "rtp/net_udp.h"
+#include "rtp/rtp.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#define BASE_PORT 15004
+#define DEFAULT_PACKET_SIZE 1400
+#define DEFAULT_DURATION 2
+#define MAX_REPLICAS 32
+#define SEND_WINDOW 64 ///< same as the hd-rum-translator writer
+
+using namespace std;
+
+void exit_uv(int status);
+
+void exit_uv(int status)
+{
+        exit(status);
+}
+
+struct result {
+        double sent_pps;
+        double received_pps;
+};
+
+/**
+ * Sends the same window of packets to every replica, either one udp_send()
+ * per packet and replica (batch == 0) or one batch per replica.
+ */
+static result run(int replicas, int batch, int duration, int packet_size)
+{
+        vector<socket_udp *> rx;
+        vector<socket_udp *> tx;
+        for (int i = 0; i < replicas; ++i) {
+                rx.push_back(udp_init("127.0.0.1", BASE_PORT + 2 * i, 0, 255, 4, true));
+                tx.push_back(udp_init("127.0.0.1", 0, BASE_PORT + 2 * i, 255, 4, false));
+                if (rx.back() == NULL || tx.back() == NULL) {
+                        cerr << "Unable to create sockets!\n";
+                        exit(1);
+                }
+                udp_set_recv_buf(rx.back(), 4 * 1024 * 1024);
+                udp_set_send_batch(tx.back(), batch);
+        }
+
+        atomic<bool> should_exit{false};
+        long long received = 0;
+        thread receiver([&]() {
+                while (!should_exit) {
+                        for (auto *s : rx) {
+                                struct timeval timeout{0, 0};
+                                while (udp_not_empty(s, &timeout)) {
+                                        char *data;
+                                        udp_recv_data(s, &data);
+                                        udp_packet_free(data);
+                                        received++;
+                                }
+                        }
+                        this_thread::yield();
+                }
+        });
+
+        vector<char> buf(SEND_WINDOW * packet_size);
+        struct iovec window[SEND_WINDOW];
+        for (int i = 0; i < SEND_WINDOW; ++i) {
+                window[i].iov_base = buf.data() + i * packet_size;
+                window[i].iov_len = packet_size;
+        }
+
+        long long sent = 0;
+        auto start = chrono::steady_clock::now();
+        auto end = start + chrono::seconds(duration);
+        while (chrono::steady_clock::now() < end) {
+                for (auto *s : tx) {
+                        if (batch == 0) {
+                                for (int j = 0; j < SEND_WINDOW; ++j) {
+                                        udp_send(s, (char *) window[j].iov_base, packet_size);
+                                }
+                        } else {
+                                udp_async_start(s, SEND_WINDOW);
+                                for (int j = 0; j < SEND_WINDOW; ++j) {
+                                        udp_sendv(s, &window[j], 1, NULL);
+                                }
+                                udp_async_wait(s);
+                        }
+                }
+                sent += (long long) SEND_WINDOW * replicas;
+        }
+        double seconds = chrono::duration_cast<chrono::duration<double>>(chrono::steady_clock::now() - start).count();
+
+        this_thread::sleep_for(chrono::milliseconds(100)); // let the receiver drain
+        should_exit = true;
+        receiver.join();
+        for (int i = 0; i < replicas; ++i) {
+                udp_exit(tx[i]);
+                udp_exit(rx[i]);
+        }
+
+        return { sent / seconds, received / seconds };
+}
+
+/**
+ * Usage: reflector_bench [<seconds> [<packet_size>]]
+ *
+ * Reports packets per second (summed over all replicas) for replica counts
+ * 1..MAX_REPLICAS with serial udp_send() and with batched sending.
+ */
+int main(int argc, char *argv[])
+{
+        int duration = argc > 1 ? atoi(argv[1]) : DEFAULT_DURATION;
+        int packet_size = argc > 2 ? atoi(argv[2]) : DEFAULT_PACKET_SIZE;
+
+        socket_udp *probe = udp_init("127.0.0.1", 0, BASE_PORT, 255, 4, false);
+        if (probe == NULL) {
+                cerr << "Unable to create sockets!\n";
+                return 1;
+        }
+        bool batching = udp_set_send_batch(probe, 0) == TRUE;
+        udp_exit(probe);
+        if (!batching) {
+                cout << "sendmmsg() not available, batched mode falls back to per-packet sends\n";
+        }
+
+        cout << "replicas\tserial sent/rcvd kpps\tbatched sent/rcvd kpps\n";
+        for (int replicas = 1; replicas <= MAX_REPLICAS; replicas *= 2) {
+                result serial = run(replicas, 0, duration, packet_size);
+                result batched = run(replicas, SEND_WINDOW, duration, packet_size);
+                cout << replicas << "\t\t"
+                        << serial.sent_pps / 1000.0 << " / " << serial.received_pps / 1000.0 << "\t\t"
+                        << batched.sent_pps / 1000.0 << " / " << batched.received_pps / 1000.0 << "\n";
+        }
+        return 0;
+}
@@ -0,0 +1,164 @@
+/**
+ * @file   tools/rs_bench.cpp
+ * @brief  Measures Reed-Solomon (zfec) encoding and decoding throughput
+ */
+/*
+ * Copyright (c) 2018 CESNET z.s.p.o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif // HAVE_CONFIG_H
+
+#include "host.h"
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+extern "C" {
+#include "rs/fec.h"
+}
+
+#define DEFAULT_FRAME_SIZE (1024 * 1024)
+#define ITERATIONS 20
+
+using namespace std;
+
+void exit_uv(int status);
+
+void exit_uv(int status)
+{
+        exit(status);
+}
+
+/**
+ * Encodes a frame with given k/n and then decodes it with as many primary
+ * blocks lost as possible (min(n - k, k)).
+ * @returns false if decoded data doesn't match the original
+ */
+static bool bench(unsigned int k, unsigned int n, size_t frame_size, double *enc_mbps, double *dec_mbps)
+{
+        size_t sz = (frame_size + k - 1) / k;
+        vector<vector<gf>> blocks(n, vector<gf>(sz));
+        for (unsigned int i = 0; i < k; ++i) {
+                for (size_t j = 0; j < sz; ++j) {
+                        blocks[i][j] = rand();
+                }
+        }
+        vector<const gf *> src(k);
+        for (unsigned int i = 0; i < k; ++i) {
+                src[i] = blocks[i].data();
+        }
+        vector<gf *> fecs(n - k);
+        vector<unsigned> block_nums(n - k);
+        for (unsigned int i = 0; i < n - k; ++i) {
+                fecs[i] = blocks[k + i].data();
+                block_nums[i] = k + i;
+        }
+
+        fec_t *code = fec_new(k, n);
+
+        auto t0 = chrono::steady_clock::now();
+        for (int i = 0; i < ITERATIONS; ++i) {
+                fec_encode(code, src.data(), fecs.data(), block_nums.data(), n - k, sz);
+        }
+        auto t1 = chrono::steady_clock::now();
+
+        // replace first <lost> primary blocks with parity
+        unsigned int lost = min(n - k, k);
+        vector<const gf *> inpkts(k);
+        vector<unsigned> index(k);
+        for (unsigned int i = 0; i < k; ++i) {
+                inpkts[i] = i < lost ? blocks[k + i].data() : blocks[i].data();
+                index[i] = i < lost ? k + i : i;
+        }
+        vector<vector<gf>> out(lost, vector<gf>(sz));
+        vector<gf *> outpkts(lost);
+        for (unsigned int i = 0; i < lost; ++i) {
+                outpkts[i] = out[i].data();
+        }
+
+        auto t2 = chrono::steady_clock::now();
+        for (int i = 0; i < ITERATIONS; ++i) {
+                fec_decode(code, inpkts.data(), outpkts.data(), index.data(), sz);
+        }
+        auto t3 = chrono::steady_clock::now();
+        fec_free(code);
+
+        bool ok = true;
+        for (unsigned int i = 0; i < lost; ++i) {
+                ok = ok && memcmp(out[i].data(), blocks[i].data(), sz) == 0;
+        }
+
+        double bytes = (double) ITERATIONS * k * sz / 1000.0 / 1000.0;
+        *enc_mbps = bytes / chrono::duration_cast<chrono::duration<double>>(t1 - t0).count();
+        *dec_mbps = bytes / chrono::duration_cast<chrono::duration<double>>(t3 - t2).count();
+        return ok;
+}
+
+/**
+ * Usage: rs_bench [<frame_size>]
+ *
+ * Prints encode/decode throughput (of source data) for all supported
+ * GF(2^8) implementations and several k/n settings.
+ */
+int main(int argc, char *argv[])
+{
+        size_t frame_size = argc > 1 ? atol(argv[1]) : DEFAULT_FRAME_SIZE;
+        const unsigned int params[][2] = { { 128, 224 }, { 200, 240 }, { 200, 255 }, { 64, 96 }, { 32, 64 } };
+        int ret = 0;
+
+        cout << "frame size " << frame_size << " B\n";
+        for (const char *impl : { "scalar", "ssse3", "avx2" }) {
+                if (fec_select_impl(impl) == NULL) {
+                        cout << impl << ": not supported\n";
+                        continue;
+                }
+                for (auto const & p : params) {
+                        double enc, dec;
+                        bool ok = bench(p[0], p[1], frame_size, &enc, &dec);
+                        cout << setw(6) << impl << " k=" << setw(3) << p[0] << " n=" << setw(3) << p[1]
+                                << ": encode " << setw(8) << fixed << setprecision(1) << enc << " MB/s, decode "
+                                << setw(8) << dec << " MB/s" << (ok ? "" : " - DECODED DATA MISMATCH") << "\n";
+                        if (!ok) {
+                                ret = 1;
+                        }
+                }
+        }
+        return ret;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file   tools/udp_recv_bench.cpp
+ * @brief  Measures packet rate of multithreaded UDP receiving over loopback
+ */
+/*
+ * Copyright (c) 2018 CESNET z.s.p.o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif // HAVE_CONFIG_H
+
+#include "host.h"
+#include "rtp/net_udp.h"
+#include "rtp/rtp.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#define DEFAULT_PORT 15004
+#define DEFAULT_PACKET_SIZE 1400
+#define DEFAULT_DURATION 5
+
+using namespace std;
+
+void exit_uv(int status);
+
+void exit_uv(int status)
+{
+        exit(status);
+}
+
+/**
+ * Usage: udp_recv_bench [<seconds> [<packet_size> [<key>=<val>...]]]
+ *
+ * Additional arguments are passed as --param options (eg. udp-queue-len=10000).
+ */
+int main(int argc, char *argv[])
+{
+        int duration = argc > 1 ? atoi(argv[1]) : DEFAULT_DURATION;
+        int packet_size = argc > 2 ? atoi(argv[2]) : DEFAULT_PACKET_SIZE;
+        for (int i = 3; i < argc; ++i) {
+                string param = argv[i];
+                size_t delim = param.find('=');
+                commandline_params[param.substr(0, delim)] = delim == string::npos ? string() : param.substr(delim + 1);
+        }
+
+        socket_udp *rx = udp_init("127.0.0.1", DEFAULT_PORT, 0, 255, 4, true);
+        socket_udp *tx = udp_init("127.0.0.1", 0, DEFAULT_PORT, 255, 4, false);
+        if (rx == NULL || tx == NULL) {
+                cerr << "Unable to create sockets!\n";
+                return 1;
+        }
+        udp_set_recv_buf(rx, 16 * 1024 * 1024);
+
+        atomic<bool> should_exit{false};
+        long long sent = 0;
+        thread sender([&]() {
+                char buf[RTP_MAX_MTU] = {};
+                while (!should_exit) {
+                        if (udp_send(tx, buf, packet_size) > 0) {
+                                sent++;
+                        }
+                }
+        });
+
+        long long received = 0;
+        auto start = chrono::steady_clock::now();
+        auto end = start + chrono::seconds(duration);
+        while (chrono::steady_clock::now() < end) {
+                struct timeval timeout{0, 100000};
+                while (udp_not_empty(rx, &timeout)) {
+                        char *data;
+                        udp_recv_data(rx, &data);
+                        udp_packet_free(data);
+                        if (++received % 1024 == 0 && chrono::steady_clock::now() >= end) {
+                                break;
+                        }
+                }
+        }
+        double seconds = chrono::duration_cast<chrono::duration<double>>(chrono::steady_clock::now() - start).count();
+
+        struct udp_recv_queue_stats stats;
+        udp_get_recv_queue_stats(rx, &stats);
+
+        should_exit = true;
+        sender.join();
+        udp_exit(tx);
+        udp_exit(rx);
+
+        cout << "packet size " << packet_size << " B: received " << received << " of " << sent << " packets, "
+                << received / seconds / 1000.0 << " kpps\n";
+        cout << "receive queue: capacity " << stats.capacity << ", max occupancy " << stats.max_occupancy
+                << ", dropped " << stats.dropped << "\n";
+        return 0;
+}
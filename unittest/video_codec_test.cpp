@@ -0,0 +1,185 @@
+#include <cppunit/config/SourcePrefix.h>
+#include "video_codec_test.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#include "video_codec.h"
+
+using namespace std;
+
+// Registers the fixture into the 'registry'
+CPPUNIT_TEST_SUITE_REGISTRATION( video_codec_test );
+
+video_codec_test::video_codec_test()
+{
+}
+
+video_codec_test::~video_codec_test()
+{
+}
+
+void
+video_codec_test::setUp()
+{
+}
+
+
+void
+video_codec_test::tearDown()
+{
+}
+
+/**
+ * Checks that every SIMD line decoder supported by the CPU produces exactly
+ * the same output as the scalar one, including the line tails and without
+ * writing past the line.
+ */
+void
+video_codec_test::testSimdDecodersMatchScalar()
+{
+        const struct {
+                codec_t in;
+                codec_t out;
+        } pairs[] = {
+                { v210, UYVY }, { DVS10, UYVY }, { YUYV, UYVY }, { R10k, RGBA },
+                { RGBA, RGB }, { RGB, UYVY }, { BGR, UYVY }, { RGBA, UYVY },
+                { UYVY, RGB }, { YUYV, RGB }, { DPX10, RGBA }, { DPX10, RGB },
+        };
+        const int widths[] = { 6, 12, 18, 30, 48, 90, 1278, 1920 };
+        const int shifts[][3] = { { 0, 8, 16 }, { 16, 8, 0 } };
+        const int guard = 64;
+
+        srand(0);
+        for (const auto & p : pairs) {
+                decoder_t scalar = get_decoder_impl(p.in, p.out, VC_SIMD_NONE);
+                CPPUNIT_ASSERT(scalar != nullptr);
+                for (int level = VC_SIMD_SSSE3; level < VC_SIMD_COUNT; ++level) {
+                        decoder_t simd = get_decoder_impl(p.in, p.out, (enum vc_simd_level) level);
+                        if (simd == nullptr || !vc_simd_level_supported((enum vc_simd_level) level)) {
+                                continue;
+                        }
+                        for (int width : widths) {
+                                int src_len = vc_get_linesize(width, p.in);
+                                int dst_len = vc_get_linesize(width, p.out);
+                                vector<unsigned char> src(src_len);
+                                for (auto & b : src) {
+                                        b = rand();
+                                }
+                                for (const auto & s : shifts) {
+                                        vector<unsigned char> ref(dst_len + 2 * guard, 0xAB);
+                                        vector<unsigned char> out(dst_len + 2 * guard, 0xAB);
+                                        scalar(ref.data() + guard, src.data(), dst_len, s[0], s[1], s[2]);
+                                        simd(out.data() + guard, src.data(), dst_len, s[0], s[1], s[2]);
+                                        ostringstream oss;
+                                        oss << get_codec_name(p.in) << "->" << get_codec_name(p.out)
+                                                << " level " << level << " width " << width;
+                                        CPPUNIT_ASSERT_MESSAGE(oss.str(), ref == out);
+                                }
+                        }
+                }
+        }
+}
+
+/**
+ * Checks that a multi-step conversion gives the same result as the
+ * individual decoders applied one after another.
+ */
+void
+video_codec_test::testConversionPath()
+{
+        const int width = 1920;
+
+        struct vc_conversion_path path;
+        CPPUNIT_ASSERT(get_conversion_path(v210, UYVY, false, &path));
+        CPPUNIT_ASSERT_EQUAL(1, path.steps);
+        CPPUNIT_ASSERT(!get_conversion_path(UYVY, R12L, false, &path));
+        CPPUNIT_ASSERT_EQUAL(0, path.steps);
+
+        // RGB -> R12L -> RGB must be lossless
+        vector<unsigned char> rgb(vc_get_linesize(width, RGB));
+        for (auto & b : rgb) {
+                b = rand();
+        }
+        vector<unsigned char> r12l(vc_get_linesize(width, R12L));
+        vector<unsigned char> rgb2(rgb.size());
+        get_decoder_from_to(RGB, R12L, false)(r12l.data(), rgb.data(), r12l.size(), 0, 8, 16);
+        get_decoder_from_to(R12L, RGB, false)(rgb2.data(), r12l.data(), rgb2.size(), 0, 8, 16);
+        CPPUNIT_ASSERT(rgb == rgb2);
+
+        CPPUNIT_ASSERT(get_conversion_path(R12L, UYVY, true, &path));
+        CPPUNIT_ASSERT(path.steps >= 2);
+        CPPUNIT_ASSERT(path.codecs[0] == R12L && path.codecs[path.steps] == UYVY);
+        CPPUNIT_ASSERT(path.slow);
+
+        // whole line and its first part (as if decoding one packet)
+        for (int len : { vc_get_linesize(width, UYVY), vc_get_linesize(width / 2, UYVY) }) {
+                vector<unsigned char> ref(len);
+                vector<unsigned char> out(len);
+                vector<unsigned char> in = r12l;
+                for (int i = 0; i < path.steps; ++i) {
+                        vector<unsigned char> tmp(vc_get_linesize(width, path.codecs[i + 1]));
+                        path.decoders[i](tmp.data(), in.data(), i == path.steps - 1 ? len :
+                                        (int) tmp.size(), 0, 8, 16);
+                        in = tmp;
+                }
+                memcpy(ref.data(), in.data(), len);
+                vc_convert_line(&path, out.data(), r12l.data(), len, 0, 8, 16);
+                CPPUNIT_ASSERT(ref == out);
+        }
+}
+
+/**
+ * Checks layout of planar pixel formats and that conversions of whole tiles
+ * are lossless where expected.
+ */
+void
+video_codec_test::testPlanarFormats()
+{
+        const int width = 1920;
+        const int height = 10;
+
+        for (codec_t codec : { I420, NV12, P010, I210, UYVY }) {
+                struct vc_plane planes[VC_MAX_PLANES];
+                int count = vc_get_planes(width, height, codec, planes);
+                CPPUNIT_ASSERT_EQUAL(codec_is_planar(codec) ? (codec == NV12 || codec == P010 ? 2 : 3) : 1, count);
+                CPPUNIT_ASSERT_EQUAL(0, planes[0].offset);
+                for (int i = 1; i < count; ++i) {
+                        CPPUNIT_ASSERT_EQUAL(planes[i - 1].offset + planes[i - 1].linesize * planes[i - 1].height,
+                                        planes[i].offset);
+                }
+                CPPUNIT_ASSERT_EQUAL((size_t) (planes[count - 1].offset + planes[count - 1].linesize *
+                                        planes[count - 1].height), vc_get_datalen(width, height, codec));
+        }
+        CPPUNIT_ASSERT_EQUAL((size_t) width * height * 3 / 2, vc_get_datalen(width, height, I420));
+
+        // I210 -> v210 -> I210 must be lossless
+        vector<uint16_t> i210(vc_get_datalen(width, height, I210) / 2);
+        for (auto & s : i210) {
+                s = rand() & 0x3ff;
+        }
+        vector<unsigned char> v210_tile(vc_get_datalen(width, height, v210));
+        vector<uint16_t> i210_2(i210.size());
+        get_tile_decoder_from_to(I210, v210)(v210_tile.data(), (unsigned char *) i210.data(), width, height);
+        get_tile_decoder_from_to(v210, I210)((unsigned char *) i210_2.data(), v210_tile.data(), width, height);
+        CPPUNIT_ASSERT(i210 == i210_2);
+
+        // UYVY -> 4:2:0 -> UYVY is lossless if chroma of line pairs is equal
+        int linesize = vc_get_linesize(width, UYVY);
+        vector<unsigned char> uyvy(vc_get_datalen(width, height, UYVY));
+        for (int y = 0; y < height; ++y) {
+                for (int x = 0; x < linesize; ++x) {
+                        uyvy[y * linesize + x] = y % 2 == 1 && x % 2 == 0 ?
+                                uyvy[(y - 1) * linesize + x] : rand();
+                }
+        }
+        for (codec_t codec : { I420, NV12 }) {
+                vector<unsigned char> planar(vc_get_datalen(width, height, codec));
+                vector<unsigned char> uyvy2(uyvy.size());
+                get_tile_decoder_from_to(UYVY, codec)(planar.data(), uyvy.data(), width, height);
+                get_tile_decoder_from_to(codec, UYVY)(uyvy2.data(), planar.data(), width, height);
+                CPPUNIT_ASSERT(uyvy == uyvy2);
+        }
+}
@@ -0,0 +1,25 @@
+#ifndef VIDEO_CODEC_TEST_H
+#define VIDEO_CODEC_TEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class video_codec_test : public CPPUNIT_NS::TestFixture
+{
+  CPPUNIT_TEST_SUITE( video_codec_test );
+  CPPUNIT_TEST( testSimdDecodersMatchScalar );
+  CPPUNIT_TEST( testConversionPath );
+  CPPUNIT_TEST( testPlanarFormats );
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  video_codec_test();
+  ~video_codec_test();
+  void setUp();
+  void tearDown();
+
+  void testSimdDecodersMatchScalar();
+  void testConversionPath();
+  void testPlanarFormats();
+};
+
+#endif //  VIDEO_CODEC_TEST_H